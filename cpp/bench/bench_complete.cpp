@@ -0,0 +1,159 @@
+// Autocomplete benchmark for the title / artist completion index.
+//
+// Builds a synthetic catalog (titles of Zipfian words, artists drawn
+// Zipfian from a smaller pool so that weights differ), reports build time,
+// image size and the time to map a saved image back, then top-k latency
+// (mean, p50, p99) for prefixes of several lengths cut from real titles
+// and artists, on the mapped index.
+
+#include "completion_index.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsedMicros(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+// Pronounceable word for a vocabulary rank
+std::string makeWord(size_t rank) {
+    static const char* syllables[] = {"la", "mo", "ri", "sa", "te", "vu", "ne", "ko",
+                                      "da", "pi", "lu", "ge", "ba", "so", "fi", "ra"};
+    std::string word;
+    do {
+        word += syllables[rank % 16];
+        rank /= 16;
+    } while (rank > 0);
+    word[0] = static_cast<char>(word[0] - 'a' + 'A');
+    return word;
+}
+
+class ZipfSampler {
+private:
+    std::vector<double> cdf;
+
+public:
+    ZipfSampler(size_t n, double exponent) : cdf(n) {
+        double sum = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            sum += 1.0 / std::pow(static_cast<double>(i + 1), exponent);
+            cdf[i] = sum;
+        }
+        for (auto& value : cdf) value /= sum;
+    }
+
+    size_t operator()(std::mt19937_64& rng) const {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        return static_cast<size_t>(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+    }
+};
+
+void printUsage(const char* programName) {
+    std::printf("Usage: %s [--n SONGS] [--artists A] [--vocab WORDS] [--queries Q] [--k K] "
+                "[--seed S]\n", programName);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t n = 200000;
+    size_t artistPool = 20000;
+    size_t vocab = 5000;
+    size_t queries = 20000;
+    size_t k = 10;
+    unsigned long long seed = 11;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        unsigned long long value = std::strtoull(argv[i + 1], nullptr, 10);
+        if (option == "--n") n = value;
+        else if (option == "--artists") artistPool = value;
+        else if (option == "--vocab") vocab = value;
+        else if (option == "--queries") queries = value;
+        else if (option == "--k") k = value;
+        else if (option == "--seed") seed = value;
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc % 2 == 0 || n == 0 || artistPool == 0 || vocab == 0 || queries == 0 || k == 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::mt19937_64 rng(seed);
+    ZipfSampler words(vocab, 1.0);
+    ZipfSampler artistRank(artistPool, 0.9);
+    std::uniform_int_distribution<size_t> titleWords(1, 5);
+
+    std::vector<std::string> artistNames(artistPool);
+    for (size_t a = 0; a < artistPool; ++a) {
+        artistNames[a] = makeWord(words(rng)) + " " + makeWord(words(rng));
+    }
+    std::vector<std::string> titles(n);
+    std::vector<std::string> artists(n);
+    for (size_t s = 0; s < n; ++s) {
+        size_t length = titleWords(rng);
+        for (size_t w = 0; w < length; ++w) {
+            if (w > 0) titles[s] += ' ';
+            titles[s] += makeWord(words(rng));
+        }
+        artists[s] = artistNames[artistRank(rng)];
+    }
+    std::vector<const std::string*> titlePointers(n);
+    std::vector<const std::string*> artistPointers(n);
+    for (size_t s = 0; s < n; ++s) {
+        titlePointers[s] = &titles[s];
+        artistPointers[s] = &artists[s];
+    }
+
+    CompletionIndex built;
+    Clock::time_point start = Clock::now();
+    built.build(titlePointers, artistPointers);
+    double buildMs = elapsedMicros(start) / 1000.0;
+    std::printf("catalog: %zu songs, %zu distinct titles/artists\n", n, built.entryCount());
+    std::printf("build: %.0f ms, image %.2f MB\n", buildMs, built.memoryBytes() / 1048576.0);
+
+    const char* path = "bench_complete.idx";
+    built.save(path);
+    CompletionIndex index;
+    start = Clock::now();
+    index.load(path, titlePointers, artistPointers);
+    std::printf("load: %.2f ms (%s)\n", elapsedMicros(start) / 1000.0,
+                index.mapped() ? "mapped" : "read");
+    std::remove(path);
+
+    std::printf("\n%-8s %10s %10s %10s %10s\n", "prefix", "results", "mean_us", "p50_us", "p99_us");
+    const size_t lengths[] = {0, 1, 2, 3, 5, 8};
+    std::uniform_int_distribution<size_t> pickSong(0, n - 1);
+    std::vector<double> latencies(queries);
+    for (size_t length : lengths) {
+        size_t results = 0;
+        double sum = 0.0;
+        for (size_t q = 0; q < queries; ++q) {
+            size_t song = pickSong(rng);
+            const std::string& source = q % 2 == 0 ? titles[song] : artists[song];
+            std::string prefix = source.substr(0, length);
+
+            start = Clock::now();
+            results += index.complete(prefix, k).size();
+            latencies[q] = elapsedMicros(start);
+            sum += latencies[q];
+        }
+        std::sort(latencies.begin(), latencies.end());
+        std::printf("%-8s %10.1f %10.2f %10.2f %10.2f\n", (std::to_string(length) + " bytes").c_str(),
+                    static_cast<double>(results) / queries, sum / queries, latencies[queries / 2],
+                    latencies[queries * 99 / 100]);
+    }
+    return 0;
+}
@@ -0,0 +1,182 @@
+// Substring index benchmark for the lyrics FM-index.
+//
+// Builds a synthetic lyrics pool (Zipfian words, some of them non-ASCII),
+// reports suffix array / index build time, index size against the raw
+// text, and count / locate latency for substrings cut from the corpus,
+// next to a std::string::find scan over every document. Locate cost grows
+// with the number of occurrences, so it is timed on the first --locate.
+
+#include "fm_index.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsedMicros(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+// Pronounceable word for a vocabulary rank; every seventh uses UTF-8 syllables
+std::string makeWord(size_t rank) {
+    static const char* latin[] = {"la", "mo", "ri", "sa", "te", "vu", "ne", "ko",
+                                  "da", "pi", "lu", "ge", "ba", "so", "fi", "ra"};
+    static const char* greek[] = {"\xce\xb1", "\xce\xbc\xce\xbf", "\xcf\x81\xce\xb9", "\xcf\x83\xce\xb1"};
+    std::string word;
+    bool utf8 = rank % 7 == 3;
+    do {
+        word += utf8 ? greek[rank % 4] : latin[rank % 16];
+        rank /= utf8 ? 4 : 16;
+    } while (rank > 0);
+    return word;
+}
+
+class ZipfSampler {
+private:
+    std::vector<double> cdf;
+
+public:
+    ZipfSampler(size_t n, double exponent) : cdf(n) {
+        double sum = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            sum += 1.0 / std::pow(static_cast<double>(i + 1), exponent);
+            cdf[i] = sum;
+        }
+        for (auto& value : cdf) value /= sum;
+    }
+
+    size_t operator()(std::mt19937_64& rng) const {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        return static_cast<size_t>(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+    }
+};
+
+void printUsage(const char* programName) {
+    std::printf("Usage: %s [--n DOCS] [--vocab WORDS] [--queries Q] [--sample RATE] "
+                "[--threads T] [--locate LIMIT] [--seed S]\n", programName);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t n = 50000;
+    size_t vocab = 20000;
+    size_t queries = 1000;
+    uint32_t sample = 32;
+    unsigned threads = 0;
+    unsigned long long seed = 5;
+    size_t locateLimit = 1000;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        unsigned long long value = std::strtoull(argv[i + 1], nullptr, 10);
+        if (option == "--n") n = value;
+        else if (option == "--vocab") vocab = value;
+        else if (option == "--queries") queries = value;
+        else if (option == "--sample") sample = static_cast<uint32_t>(value);
+        else if (option == "--threads") threads = static_cast<unsigned>(value);
+        else if (option == "--seed") seed = value;
+        else if (option == "--locate") locateLimit = value;
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc % 2 == 0 || n == 0 || vocab < 16 || queries == 0 || sample == 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> words(vocab);
+    for (size_t i = 0; i < vocab; ++i) words[i] = makeWord(i);
+
+    std::mt19937_64 rng(seed);
+    ZipfSampler zipf(vocab, 1.05);
+    std::uniform_int_distribution<size_t> lyricLength(40, 220);
+    std::vector<std::string> lyrics(n);
+    size_t rawBytes = 0;
+    for (size_t d = 0; d < n; ++d) {
+        size_t length = lyricLength(rng);
+        for (size_t w = 0; w < length; ++w) {
+            if (w > 0) lyrics[d] += (w % 8 == 0) ? " / " : " ";
+            lyrics[d] += words[zipf(rng)];
+        }
+        rawBytes += lyrics[d].size();
+    }
+    std::printf("corpus: %zu docs, %.1f MB of lyrics\n", n, rawBytes / 1048576.0);
+
+    std::vector<const std::string*> documents(n);
+    for (size_t d = 0; d < n; ++d) documents[d] = &lyrics[d];
+
+    FmIndex index;
+    FmIndex::Params params;
+    params.threads = threads;
+    params.sampleRate = sample;
+    Clock::time_point start = Clock::now();
+    index.build(documents, params);
+    double buildMs = elapsedMicros(start) / 1000.0;
+    std::printf("build: %.0f ms (%.2f MB/s), index %.1f MB = %.2fx raw lyrics (sample rate %u)\n",
+                buildMs, rawBytes / 1048576.0 / (buildMs / 1000.0), index.memoryBytes() / 1048576.0,
+                static_cast<double>(index.memoryBytes()) / rawBytes, sample);
+
+    std::printf("\n%-10s %12s %12s %12s %12s %14s\n", "pattern", "occ/q", "count_us", "locate_us",
+                "us/occ", "scan_us");
+    const size_t lengths[] = {3, 5, 8, 12};
+    std::uniform_int_distribution<size_t> pickDoc(0, n - 1);
+    for (size_t length : lengths) {
+        double countSum = 0.0;
+        double locateSum = 0.0;
+        size_t occurrences = 0;
+        size_t located = 0;
+        std::vector<std::string> patterns(queries);
+
+        for (size_t q = 0; q < queries; ++q) {
+            const std::string& source = lyrics[pickDoc(rng)];
+            size_t offset = std::uniform_int_distribution<size_t>(0, source.size() - length)(rng);
+            patterns[q] = source.substr(offset, length);
+
+            start = Clock::now();
+            size_t found = index.count(patterns[q]);
+            countSum += elapsedMicros(start);
+
+            start = Clock::now();
+            auto positions = index.locate(patterns[q], locateLimit);
+            locateSum += elapsedMicros(start);
+            occurrences += found;
+            located += positions.size();
+            if (positions.size() != std::min(found, locateLimit)) {
+                std::printf("error: locate found %zu of %zu occurrences\n", positions.size(), found);
+                return 1;
+            }
+        }
+
+        // A scan reads every lyric for every query, so only a few are timed
+        size_t scanQueries = std::min<size_t>(queries, 10);
+        double scanSum = 0.0;
+        for (size_t q = 0; q < scanQueries; ++q) {
+            start = Clock::now();
+            size_t found = 0;
+            for (const auto& text : lyrics) {
+                for (size_t at = text.find(patterns[q]); at != std::string::npos;
+                     at = text.find(patterns[q], at + 1)) {
+                    found++;
+                }
+            }
+            scanSum += elapsedMicros(start);
+            if (found == 0) std::printf("error: scan missed a sampled pattern\n");
+        }
+
+        std::printf("%-10s %12.1f %12.2f %12.1f %12.1f %14.0f\n",
+                    (std::to_string(length) + " bytes").c_str(),
+                    static_cast<double>(occurrences) / queries, countSum / queries,
+                    locateSum / queries, locateSum / std::max<size_t>(1, located), scanSum / scanQueries);
+    }
+    return 0;
+}
@@ -0,0 +1,238 @@
+// Recall-vs-latency benchmark for the HNSW index against exact search.
+//
+// Generates clustered unit vectors (songs tend to group by style), builds
+// the index, then sweeps ef and reports recall@k and per-query latency
+// percentiles next to brute-force search over the same store. The sweep is
+// repeated with int8 and product-quantized vectors (with and without exact
+// re-ranking) to show the memory / recall trade-off.
+
+#include "distance_kernels.h"
+#include "embedding.h"
+#include "hnsw.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsedMicros(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+void fillClustered(EmbeddingStore& store, size_t clusters, std::mt19937_64& rng) {
+    size_t dim = store.dimension();
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+
+    std::vector<float> centers(clusters * dim);
+    for (auto& value : centers) value = normal(rng);
+
+    std::uniform_int_distribution<size_t> pick(0, clusters - 1);
+    for (size_t i = 0; i < store.size(); ++i) {
+        const float* center = &centers[pick(rng) * dim];
+        float* row = store.row(i);
+        for (size_t d = 0; d < dim; ++d) row[d] = center[d] + 0.35f * normal(rng);
+        EmbeddingStore::normalize(row, dim);
+    }
+}
+
+std::vector<uint32_t> exactSearch(const EmbeddingStore& store, const float* query, size_t k) {
+    std::vector<std::pair<float, uint32_t>> scored(store.size());
+    for (size_t i = 0; i < store.size(); ++i) {
+        scored[i] = std::make_pair(store.distance(query, i), static_cast<uint32_t>(i));
+    }
+    size_t top = std::min(k, scored.size());
+    std::partial_sort(scored.begin(), scored.begin() + top, scored.end());
+
+    std::vector<uint32_t> ids(top);
+    for (size_t i = 0; i < top; ++i) ids[i] = scored[i].second;
+    return ids;
+}
+
+struct QuerySet {
+    size_t dim;
+    size_t k;
+    std::vector<float> data;
+    std::vector<std::vector<uint32_t>> truth;
+
+    size_t size() const { return truth.size(); }
+    const float* query(size_t q) const { return &data[q * dim]; }
+};
+
+void sweepEf(const char* label, const HnswIndex& index, const QuerySet& queries, size_t rerank) {
+    const size_t efValues[] = {10, 20, 40, 80, 160, 320};
+    for (size_t ef : efValues) {
+        if (ef < queries.k) continue;
+
+        std::vector<double> latency(queries.size());
+        size_t hits = 0;
+        double sum = 0.0;
+        for (size_t q = 0; q < queries.size(); ++q) {
+            Clock::time_point start = Clock::now();
+            auto results = index.search(queries.query(q), queries.k, ef, HnswIndex::Filter(), rerank);
+            latency[q] = elapsedMicros(start);
+            sum += latency[q];
+
+            std::unordered_set<uint32_t> expected(queries.truth[q].begin(), queries.truth[q].end());
+            for (const auto& result : results) hits += expected.count(result.id);
+        }
+
+        size_t expectedHits = 0;
+        for (const auto& ids : queries.truth) expectedHits += ids.size();
+        double recall = static_cast<double>(hits) / std::max<size_t>(1, expectedHits);
+        std::printf("%-14s %-6zu %10.4f %12.1f %12.1f %12.1f\n", label, ef, recall,
+                    sum / queries.size(), percentile(latency, 0.5), percentile(latency, 0.99));
+    }
+}
+
+// Brute-force scan with asymmetric distances, the cost of search without a graph
+double flatScanMicros(const EmbeddingStore& store, const QuerySet& queries) {
+    PreparedQuery prepared;
+    double total = 0.0;
+    float sink = 0.0f;
+    size_t scans = std::min<size_t>(queries.size(), 20);
+    for (size_t q = 0; q < scans; ++q) {
+        Clock::time_point start = Clock::now();
+        store.prepare(queries.query(q), prepared);
+        for (size_t i = 0; i < store.size(); ++i) sink += store.distance(prepared, i);
+        total += elapsedMicros(start);
+    }
+    if (sink == -1.0f) std::printf(" ");
+    return total / scans;
+}
+
+void printUsage(const char* programName) {
+    std::printf("Usage: %s [--n N] [--dim D] [--queries Q] [--k K] [--M M] "
+                "[--efc EF] [--threads T] [--seed S]\n", programName);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t n = 100000;
+    size_t dim = 128;
+    size_t queries = 500;
+    size_t k = 10;
+    HnswIndex::Params params;
+    unsigned long long seed = 7;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        unsigned long long value = std::strtoull(argv[i + 1], nullptr, 10);
+        if (option == "--n") n = value;
+        else if (option == "--dim") dim = value;
+        else if (option == "--queries") queries = value;
+        else if (option == "--k") k = value;
+        else if (option == "--M") params.M = value;
+        else if (option == "--efc") params.efConstruction = value;
+        else if (option == "--threads") params.threads = static_cast<unsigned>(value);
+        else if (option == "--seed") seed = value;
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc % 2 == 0 || n == 0 || dim == 0 || queries == 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::mt19937_64 rng(seed);
+    EmbeddingStore store;
+    store.reset(dim, n);
+    fillClustered(store, std::max<size_t>(8, n / 1000), rng);
+
+    // Queries are perturbed catalog vectors, like "more songs like this one"
+    std::normal_distribution<float> noise(0.0f, 0.1f);
+    std::uniform_int_distribution<size_t> pick(0, n - 1);
+    std::vector<float> queryData(queries * dim);
+    for (size_t q = 0; q < queries; ++q) {
+        const float* base = store.row(pick(rng));
+        float* query = &queryData[q * dim];
+        for (size_t d = 0; d < dim; ++d) query[d] = base[d] + noise(rng);
+        EmbeddingStore::normalize(query, dim);
+    }
+
+    std::printf("songs=%zu dim=%zu queries=%zu k=%zu M=%zu efConstruction=%zu kernels=%s\n",
+                n, dim, queries, k, params.M, params.efConstruction, distanceKernelName());
+
+    HnswIndex index;
+    Clock::time_point start = Clock::now();
+    index.build(store, params);
+    double buildMs = elapsedMicros(start) / 1000.0;
+    std::printf("build: %.1f ms (%.2f us/song), graph %.1f MB\n",
+                buildMs, buildMs * 1000.0 / n, index.memoryBytes() / 1048576.0);
+
+    QuerySet querySet;
+    querySet.dim = dim;
+    querySet.k = k;
+    querySet.data.swap(queryData);
+    querySet.truth.resize(queries);
+
+    std::vector<double> exactLatency(queries);
+    double exactSum = 0.0;
+    for (size_t q = 0; q < queries; ++q) {
+        start = Clock::now();
+        querySet.truth[q] = exactSearch(store, querySet.query(q), k);
+        exactLatency[q] = elapsedMicros(start);
+        exactSum += exactLatency[q];
+    }
+
+    std::printf("\n%-14s %-6s %10s %12s %12s %12s\n", "encoding", "ef", "recall@k",
+                "mean_us", "p50_us", "p99_us");
+    std::printf("%-14s %-6s %10.4f %12.1f %12.1f %12.1f\n", "exact", "-", 1.0,
+                exactSum / queries, percentile(exactLatency, 0.5),
+                percentile(exactLatency, 0.99));
+    sweepEf("float32", index, querySet, 0);
+
+    struct Variant {
+        const char* label;
+        VectorEncoding encoding;
+        size_t rerank;
+    };
+    const Variant variants[] = {
+        {"int8", VectorEncoding::Int8, 0},
+        {"pq", VectorEncoding::Product, 0},
+        {"pq+rerank", VectorEncoding::Product, 4 * k},
+    };
+
+    std::vector<std::pair<std::string, EmbeddingStore>> encoded;
+    for (const Variant& variant : variants) {
+        EmbeddingStore copy = store;
+        start = Clock::now();
+        copy.quantize(variant.encoding, 0, variant.rerank > 0, params.threads);
+        double quantizeMs = elapsedMicros(start) / 1000.0;
+
+        index.attach(copy);
+        sweepEf(variant.label, index, querySet, variant.rerank);
+        encoded.push_back(std::make_pair(std::string(variant.label), copy));
+        encoded.back().first += " (" + std::to_string(static_cast<long long>(quantizeMs)) + " ms to encode)";
+    }
+    index.attach(store);
+
+    std::printf("\n%-36s %14s %12s %14s\n", "vectors", "bytes/song", "shrink", "flat_scan_us");
+    double floatBytes = static_cast<double>(store.memoryBytes()) / n;
+    std::printf("%-36s %14.1f %11.1fx %14.1f\n", "float32", floatBytes, 1.0,
+                flatScanMicros(store, querySet));
+    for (const auto& entry : encoded) {
+        double bytes = static_cast<double>(entry.second.memoryBytes()) / n;
+        std::printf("%-36s %14.1f %11.1fx %14.1f\n", entry.first.c_str(), bytes,
+                    floatBytes / bytes, flatScanMicros(entry.second, querySet));
+    }
+
+    return 0;
+}
@@ -0,0 +1,415 @@
+// Catalog benchmark for loading, emotion filtering and JSON output.
+//
+// For each catalog size, writes a synthetic songs.csv (Zipfian emotions,
+// artists and lyric words, some quoted fields with commas), then measures
+// EmotionPlaylist loading with its per-index build stages, filterByEmotions
+// with 1, 2, 4 and all emotions, toJson of the one-emotion result, and the
+// end-to-end latency of the emotion_playlist CLI on the same file.
+//
+// The daemon's request path (server.h) must not touch the heap once warm:
+// a few representative requests are answered repeatedly and the run fails
+// (exit status 1) if any of them allocates. Allocations are only counted
+// with COUNT_ALLOCATIONS (tests/test_playlist.cpp runs the same check under
+// ctest); with it, every benchmark also reports heap allocations per call.
+//
+// Where perf_event_open is permitted, each timed phase also records cycles,
+// instructions, LLC, branch and dTLB misses, shown per song in the table
+// and per call in the JSON; elsewhere those columns are left out.
+//
+// Results (rows produced; bytes for to_json and serve) are printed as a table and,
+// with --json, written one JSON object per line. --baseline compares min_ns
+// against such a file and exits with status 1 when any benchmark is slower
+// than the baseline by more than --tolerance percent.
+
+#include "perf_counters.h"
+#include "playlist.h"
+#include "profile.h"
+#include "server.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef EMOTION_PLAYLIST_CLI
+#define EMOTION_PLAYLIST_CLI "emotion_playlist"
+#endif
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Requests answered per steady-state allocation check
+const size_t SERVE_CHECKS = 1000;
+
+uint64_t elapsedNanos(Clock::time_point start) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+}
+
+class ZipfSampler {
+private:
+    std::vector<double> cdf;
+
+public:
+    ZipfSampler(size_t n, double exponent) : cdf(n) {
+        double sum = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            sum += 1.0 / std::pow(static_cast<double>(i + 1), exponent);
+            cdf[i] = sum;
+        }
+        for (auto& value : cdf) value /= sum;
+    }
+
+    size_t operator()(std::mt19937_64& rng) const {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        return static_cast<size_t>(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+    }
+};
+
+// Pronounceable word for a vocabulary rank
+std::string makeWord(size_t rank) {
+    static const char* syllables[] = {"la", "mo", "ri", "sa", "te", "vu", "ne", "ko",
+                                      "da", "pi", "lu", "ge", "ba", "so", "fi", "ra"};
+    std::string word;
+    do {
+        word += syllables[rank % 16];
+        rank /= 16;
+    } while (rank > 0);
+    return word;
+}
+
+void writeCatalog(const std::string& path, size_t n, unsigned long long seed) {
+    static const char* emotions[] = {"happy", "sad", "calm", "energetic", "romantic", "angry",
+                                     "nostalgic", "hopeful", "melancholic", "excited",
+                                     "peaceful", "anxious"};
+    std::mt19937_64 rng(seed);
+    ZipfSampler emotion(12, 1.0);
+    ZipfSampler artist(std::max<size_t>(1, n / 20), 0.9);
+    ZipfSampler word(20000, 1.0);
+    std::uniform_int_distribution<size_t> lyricWords(20, 80);
+
+    std::ofstream out(path);
+    out << "id,title,artist,lyrics,emotion\n";
+    std::string lyrics;
+    for (size_t i = 0; i < n; ++i) {
+        lyrics.clear();
+        size_t length = lyricWords(rng);
+        for (size_t w = 0; w < length; ++w) {
+            if (w > 0) lyrics += w % 9 == 0 ? ", " : " ";
+            lyrics += makeWord(word(rng));
+        }
+        out << i + 1 << ",\"" << makeWord(word(rng)) << ' ' << makeWord(word(rng)) << "\",Artist "
+            << artist(rng) << ",\"" << lyrics << "\"," << emotions[emotion(rng)] << '\n';
+    }
+}
+
+void freeList(SongNode* head) {
+    while (head != nullptr) {
+        SongNode* next = head->next;
+        delete head;
+        head = next;
+    }
+}
+
+size_t listLength(const SongNode* head) {
+    size_t count = 0;
+    for (; head != nullptr; head = head->next) count++;
+    return count;
+}
+
+struct Result {
+    std::string name;
+    size_t songs;
+    size_t rows;
+    uint64_t meanNs;
+    uint64_t minNs;
+    uint64_t allocations;    // per call
+    uint64_t allocatedBytes; // per call
+    PerfCounters::Sample counters; // per call
+};
+
+class Runner {
+public:
+    std::vector<Result> results;
+    PerfCounters perf;
+
+    void printHeader() const {
+        std::printf("%-24s %10s %10s %14s %14s", "benchmark", "songs", "rows", "mean_ms", "min_ms");
+        if (countingAllocations()) std::printf(" %12s %12s", "allocs/call", "bytes/call");
+        if (perf.available()) {
+            std::printf(" %6s %10s %10s %10s %10s", "ipc", "cyc/song", "llc/song", "brm/song", "dtlb/song");
+        }
+        std::printf("\n");
+    }
+
+    void add(const std::string& name, size_t songs, size_t rows, const std::vector<uint64_t>& times,
+             uint64_t allocations, uint64_t allocatedBytes, const PerfCounters::Sample& counters) {
+        uint64_t sum = 0;
+        for (uint64_t t : times) sum += t;
+        results.push_back(Result{name, songs, rows, sum / times.size(),
+                                 *std::min_element(times.begin(), times.end()), allocations,
+                                 allocatedBytes, counters});
+        const Result& r = results.back();
+        std::printf("%-24s %10zu %10zu %14.3f %14.3f", r.name.c_str(), r.songs, r.rows,
+                    r.meanNs / 1e6, r.minNs / 1e6);
+        if (countingAllocations()) {
+            std::printf(" %12llu %12llu", static_cast<unsigned long long>(r.allocations),
+                        static_cast<unsigned long long>(r.allocatedBytes));
+        }
+        if (perf.available()) {
+            printRatio(r.counters, PerfCounters::Instructions, PerfCounters::Cycles, 1, 6, 2);
+            const PerfCounters::Event perSong[] = {PerfCounters::Cycles, PerfCounters::LlcMisses,
+                                                   PerfCounters::BranchMisses, PerfCounters::DtlbMisses};
+            for (PerfCounters::Event event : perSong) {
+                printRatio(r.counters, event, PerfCounters::EVENT_COUNT, songs, 10, 3);
+            }
+        }
+        std::printf("\n");
+    }
+
+    // Time fn repeat times; fn returns the rows it produced
+    template <typename Fn>
+    void time(const std::string& name, size_t songs, size_t repeat, Fn fn) {
+        std::vector<uint64_t> times;
+        times.reserve(repeat); // keep the runner's own allocations out of the count
+        size_t rows = 0;
+        uint64_t allocations = threadAllocations();
+        uint64_t allocatedBytes = threadAllocatedBytes();
+        PerfCounters::Sample before = perf.read();
+        for (size_t r = 0; r < repeat; ++r) {
+            Clock::time_point start = Clock::now();
+            rows = fn();
+            times.push_back(elapsedNanos(start));
+        }
+        PerfCounters::Sample counters = PerfCounters::difference(perf.read(), before);
+        for (uint64_t& value : counters.value) value /= repeat;
+        add(name, songs, rows, times, (threadAllocations() - allocations) / repeat,
+            (threadAllocatedBytes() - allocatedBytes) / repeat, counters);
+    }
+
+private:
+    // counters[event] / (counters[per] or divisor), or "-" when not counted
+    static void printRatio(const PerfCounters::Sample& counters, PerfCounters::Event event,
+                           PerfCounters::Event per, size_t divisor, int width, int precision) {
+        bool valid = counters.has(event) && (per == PerfCounters::EVENT_COUNT || counters.has(per));
+        double denominator = per == PerfCounters::EVENT_COUNT ? static_cast<double>(divisor)
+                                                               : static_cast<double>(counters.value[per]);
+        if (!valid || denominator == 0.0) {
+            std::printf(" %*s", width, "-");
+        } else {
+            std::printf(" %*.*f", width, precision, counters.value[event] / denominator);
+        }
+    }
+};
+
+std::string jsonLine(const Result& r) {
+    std::string line = "{\"benchmark\": \"" + r.name + "\", \"songs\": " + std::to_string(r.songs) +
+                       ", \"rows\": " + std::to_string(r.rows) + ", \"mean_ns\": " + std::to_string(r.meanNs) +
+                       ", \"min_ns\": " + std::to_string(r.minNs);
+    if (countingAllocations()) {
+        line += ", \"allocations\": " + std::to_string(r.allocations) +
+                ", \"allocated_bytes\": " + std::to_string(r.allocatedBytes);
+    }
+    for (int e = 0; e < PerfCounters::EVENT_COUNT; ++e) {
+        PerfCounters::Event event = static_cast<PerfCounters::Event>(e);
+        if (r.counters.has(event)) {
+            line += ", \"" + std::string(PerfCounters::name(event)) + "\": " + std::to_string(r.counters.value[e]);
+        }
+    }
+    return line + "}";
+}
+
+// Value of "key": in a line written by jsonLine
+std::string jsonField(const std::string& line, const std::string& key) {
+    size_t at = line.find("\"" + key + "\": ");
+    if (at == std::string::npos) return "";
+    at += key.size() + 4;
+    if (line[at] == '"') return line.substr(at + 1, line.find('"', at + 1) - at - 1);
+    return line.substr(at, line.find_first_of(",}", at) - at);
+}
+
+// min_ns by (benchmark, songs) from a --json file
+std::map<std::pair<std::string, size_t>, uint64_t> readBaseline(const std::string& path) {
+    std::map<std::pair<std::string, size_t>, uint64_t> baseline;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::string name = jsonField(line, "benchmark");
+        std::string songs = jsonField(line, "songs");
+        std::string minNs = jsonField(line, "min_ns");
+        if (name.empty() || songs.empty() || minNs.empty()) continue;
+        baseline[std::make_pair(name, std::stoul(songs))] = std::stoull(minNs);
+    }
+    return baseline;
+}
+
+std::vector<size_t> parseSizes(const std::string& text) {
+    std::vector<size_t> sizes;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = text.find(',', start);
+        if (end == std::string::npos) end = text.size();
+        sizes.push_back(std::strtoull(text.substr(start, end - start).c_str(), nullptr, 10));
+        start = end + 1;
+    }
+    return sizes;
+}
+
+void printUsage(const char* programName) {
+    std::printf("Usage: %s [--sizes N,N,...] [--repeat R] [--seed S] [--json PATH] "
+                "[--baseline PATH] [--tolerance PCT] [--cli PATH]\n", programName);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<size_t> sizes = {10000, 100000, 1000000};
+    size_t repeat = 5;
+    unsigned long long seed = 7;
+    std::string jsonPath;
+    std::string baselinePath;
+    double tolerance = 20.0;
+    std::string cli = EMOTION_PLAYLIST_CLI;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        std::string value = argv[i + 1];
+        if (option == "--sizes") sizes = parseSizes(value);
+        else if (option == "--repeat") repeat = std::strtoull(value.c_str(), nullptr, 10);
+        else if (option == "--seed") seed = std::strtoull(value.c_str(), nullptr, 10);
+        else if (option == "--json") jsonPath = value;
+        else if (option == "--baseline") baselinePath = value;
+        else if (option == "--tolerance") tolerance = std::strtod(value.c_str(), nullptr);
+        else if (option == "--cli") cli = value;
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc % 2 == 0 || repeat == 0 || std::find(sizes.begin(), sizes.end(), 0) != sizes.end()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    Runner runner;
+    if (!runner.perf.available()) {
+        std::fprintf(stderr, "note: hardware counters unavailable (%s); timing only\n",
+                     std::strerror(runner.perf.error()));
+    }
+    if (!countingAllocations()) {
+        std::fprintf(stderr, "note: built without COUNT_ALLOCATIONS; serve allocations not checked\n");
+    }
+    runner.printHeader();
+    for (size_t n : sizes) {
+        std::string path = "bench_playlist_" + std::to_string(n) + ".csv";
+        writeCatalog(path, n, seed);
+
+        // Loading is timed once; its stages come from the playlist's own profile
+        QueryProfile profile;
+        uint64_t allocations = threadAllocations();
+        uint64_t allocatedBytes = threadAllocatedBytes();
+        PerfCounters::Sample before = runner.perf.read();
+        Clock::time_point start = Clock::now();
+        EmotionPlaylist* playlist = nullptr;
+        {
+            ProfileSession session(&profile);
+            playlist = new EmotionPlaylist(path);
+        }
+        uint64_t loadNanos = elapsedNanos(start);
+        PerfCounters::Sample counters = PerfCounters::difference(runner.perf.read(), before);
+        runner.add("load", n, n, std::vector<uint64_t>(1, loadNanos), threadAllocations() - allocations,
+                   threadAllocatedBytes() - allocatedBytes, counters);
+        for (const StageTiming& stage : profile.stages) {
+            runner.add(std::string("load/") + stage.name, n, stage.rowsOut != 0 ? stage.rowsOut : stage.rowsIn,
+                       std::vector<uint64_t>(1, stage.nanos), stage.allocations, stage.allocatedBytes,
+                       PerfCounters::Sample());
+        }
+
+        std::vector<std::string> emotions = playlist->getAvailableEmotions();
+        const size_t counts[] = {1, 2, 4, emotions.size()};
+        for (size_t count : counts) {
+            std::vector<std::string> selected(emotions.begin(),
+                                              emotions.begin() + std::min(count, emotions.size()));
+            std::string name = count == emotions.size() ? "filter/all" : "filter/" + std::to_string(count);
+            runner.time(name, n, repeat, [&]() {
+                SongNode* songs = playlist->filterByEmotions(selected);
+                size_t rows = listLength(songs);
+                freeList(songs);
+                return rows;
+            });
+        }
+
+        SongNode* songs = playlist->filterByEmotions(std::vector<std::string>(1, emotions[0]));
+        runner.time("to_json", n, repeat, [&]() { return playlist->toJson(songs).size(); });
+        freeList(songs);
+
+        // Steady-state daemon requests: warm the handler's buffers once,
+        // then every further answer must come without a heap allocation
+        RequestHandler handler(*playlist);
+        Arena& arena = threadArena();
+        auto answer = [&](const std::string& request) {
+            size_t bytes;
+            {
+                ArenaString response{ArenaAllocator<char>(arena)};
+                handler.handle(request.data(), request.size(), response);
+                bytes = response.size();
+            }
+            arena.reset();
+            return bytes;
+        };
+        const std::string requests[] = {"emotions=" + emotions[0] + "&k=10",
+                                        "emotions=" + emotions[0] + "," + emotions[1 % emotions.size()] + "&k=50",
+                                        "emotions=*&k=10"};
+        for (const std::string& request : requests) answer(request);
+        for (const std::string& request : requests) {
+            uint64_t allocationsBefore = threadAllocations();
+            for (size_t r = 0; r < SERVE_CHECKS; ++r) answer(request);
+            uint64_t allocated = threadAllocations() - allocationsBefore;
+            if (allocated != 0) {
+                std::fprintf(stderr, "Error: request '%s' made %llu heap allocations in %zu calls\n",
+                             request.c_str(), static_cast<unsigned long long>(allocated), SERVE_CHECKS);
+                return 1;
+            }
+        }
+        runner.time("serve/" + emotions[0], n, SERVE_CHECKS, [&]() { return answer(requests[0]); });
+        delete playlist;
+
+        std::string command = "\"" + cli + "\" " + path + " " + emotions[0] + " > /dev/null";
+        runner.time("cli/" + emotions[0], n, repeat, [&]() {
+            if (std::system(command.c_str()) != 0) {
+                std::fprintf(stderr, "Error: '%s' failed\n", command.c_str());
+                std::exit(1);
+            }
+            return size_t(0);
+        });
+        std::remove(path.c_str());
+    }
+
+    if (!jsonPath.empty()) {
+        std::ofstream out(jsonPath);
+        for (const Result& r : runner.results) out << jsonLine(r) << '\n';
+    }
+
+    if (baselinePath.empty()) return 0;
+    std::map<std::pair<std::string, size_t>, uint64_t> baseline = readBaseline(baselinePath);
+    int regressions = 0;
+    std::printf("\n%-24s %10s %14s %14s %8s\n", "benchmark", "songs", "baseline_ms", "min_ms", "change");
+    for (const Result& r : runner.results) {
+        auto previous = baseline.find(std::make_pair(r.name, r.songs));
+        if (previous == baseline.end() || previous->second == 0) continue;
+        double change = 100.0 * (static_cast<double>(r.minNs) / previous->second - 1.0);
+        bool regressed = change > tolerance;
+        regressions += regressed ? 1 : 0;
+        std::printf("%-24s %10zu %14.3f %14.3f %+7.1f%%%s\n", r.name.c_str(), r.songs,
+                    previous->second / 1e6, r.minNs / 1e6, change, regressed ? "  REGRESSION" : "");
+    }
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,322 @@
+// Keyword search benchmark for the lyrics inverted index.
+//
+// Builds a synthetic corpus with a Zipfian vocabulary (a few very common
+// words, a long tail of rare ones), indexes it, and reports build time,
+// index size and BM25 query latency for typical query shapes. Posting
+// compression is reported against plain uint32 arrays, along with decode
+// throughput next to a straight read of the same data uncompressed.
+// Phrase and NEAR queries are sampled from indexed lyrics and compared
+// with scanning every lyrics string.
+
+#include "text_index.h"
+#include "tokenizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsedMicros(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+// Pronounceable word for a vocabulary rank
+std::string makeWord(size_t rank) {
+    static const char* syllables[] = {"la", "mo", "ri", "sa", "te", "vu", "ne", "ko",
+                                      "da", "pi", "lu", "ge", "ba", "so", "fi", "ra"};
+    std::string word;
+    do {
+        word += syllables[rank % 16];
+        rank /= 16;
+    } while (rank > 0);
+    return word;
+}
+
+class ZipfSampler {
+private:
+    std::vector<double> cdf;
+
+public:
+    ZipfSampler(size_t n, double exponent) : cdf(n) {
+        double sum = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            sum += 1.0 / std::pow(static_cast<double>(i + 1), exponent);
+            cdf[i] = sum;
+        }
+        for (auto& value : cdf) value /= sum;
+    }
+
+    size_t operator()(std::mt19937_64& rng) const {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        return static_cast<size_t>(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+    }
+};
+
+struct QueryShape {
+    const char* name;
+    size_t terms;
+    bool requireAll;
+    size_t minRank; // skip the very common words for selective queries
+};
+
+void printUsage(const char* programName) {
+    std::printf("Usage: %s [--n DOCS] [--vocab WORDS] [--queries Q] [--k K] "
+                "[--threads T] [--seed S] [--positions 0|1]\n", programName);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t n = 200000;
+    size_t vocab = 50000;
+    size_t queries = 1000;
+    size_t k = 10;
+    unsigned threads = 0;
+    unsigned long long seed = 11;
+    bool positions = true;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        unsigned long long value = std::strtoull(argv[i + 1], nullptr, 10);
+        if (option == "--n") n = value;
+        else if (option == "--vocab") vocab = value;
+        else if (option == "--queries") queries = value;
+        else if (option == "--k") k = value;
+        else if (option == "--threads") threads = static_cast<unsigned>(value);
+        else if (option == "--seed") seed = value;
+        else if (option == "--positions") positions = value != 0;
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc % 2 == 0 || n == 0 || vocab < 100 || queries == 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> words(vocab);
+    for (size_t i = 0; i < vocab; ++i) words[i] = makeWord(i);
+
+    std::mt19937_64 rng(seed);
+    ZipfSampler zipf(vocab, 1.05);
+    std::uniform_int_distribution<size_t> lyricLength(40, 220);
+    std::uniform_int_distribution<size_t> titleLength(1, 4);
+
+    std::vector<std::string> titles(n);
+    std::vector<std::string> lyrics(n);
+    size_t rawBytes = 0;
+    Clock::time_point start = Clock::now();
+    for (size_t d = 0; d < n; ++d) {
+        size_t titleWords = titleLength(rng);
+        for (size_t w = 0; w < titleWords; ++w) {
+            if (w > 0) titles[d] += ' ';
+            titles[d] += words[zipf(rng)];
+        }
+        size_t lyricWords = lyricLength(rng);
+        for (size_t w = 0; w < lyricWords; ++w) {
+            if (w > 0) lyrics[d] += (w % 8 == 0) ? " / " : " ";
+            lyrics[d] += words[zipf(rng)];
+        }
+        rawBytes += titles[d].size() + lyrics[d].size();
+    }
+    std::printf("corpus: %zu docs, %zu-word vocabulary, %.1f MB of text (generated in %.0f ms)\n",
+                n, vocab, rawBytes / 1048576.0, elapsedMicros(start) / 1000.0);
+
+    std::vector<TextDocument> documents(n);
+    for (size_t d = 0; d < n; ++d) documents[d] = TextDocument{&titles[d], &lyrics[d]};
+
+    TextIndex index;
+    TextIndex::Params params;
+    params.threads = threads;
+    params.positions = positions;
+    start = Clock::now();
+    index.build(documents, params);
+    double buildMs = elapsedMicros(start) / 1000.0;
+    std::printf("build: %.1f ms (%.2f us/doc), %zu terms, %zu postings, index %.1f MB "
+                "(%.2f bytes/posting)\n", buildMs, buildMs * 1000.0 / n, index.termCount(),
+                index.postingCount(), index.memoryBytes() / 1048576.0,
+                static_cast<double>(index.memoryBytes()) / std::max<size_t>(1, index.postingCount()));
+
+    std::printf("postings: %.1f MB compressed vs %.1f MB as uint32 (%.2fx), %s decoder\n",
+                index.postingBytes() / 1048576.0, index.uncompressedPostingBytes() / 1048576.0,
+                static_cast<double>(index.uncompressedPostingBytes()) /
+                    std::max<size_t>(1, index.postingBytes()),
+                postingDecoderName());
+    if (positions) {
+        std::printf("positions: %.1f MB (%.2f bytes/posting)\n", index.positionBytes() / 1048576.0,
+                    static_cast<double>(index.positionBytes()) /
+                        std::max<size_t>(1, index.postingCount()));
+    }
+
+    // Decode throughput: walk every block of the 200 longest lists, then
+    // sum the same doc ids from a flat array as the memory-bandwidth ceiling
+    std::vector<std::pair<size_t, const CompressedPostings*>> longest;
+    for (size_t i = 0; i < std::min<size_t>(vocab, 2000); ++i) {
+        const CompressedPostings* list = index.postingsFor(words[i]);
+        if (list != nullptr) longest.push_back(std::make_pair(list->size(), list));
+    }
+    std::sort(longest.rbegin(), longest.rend());
+    longest.resize(std::min<size_t>(longest.size(), 200));
+
+    std::vector<uint32_t> flat;
+    uint32_t block[POSTING_BLOCK];
+    for (const auto& entry : longest) {
+        for (size_t b = 0; b < entry.second->blockCount(); ++b) {
+            entry.second->decodeDocs(b, block);
+            flat.insert(flat.end(), block, block + entry.second->blockSize(b));
+        }
+    }
+
+    const int rounds = 5;
+    uint64_t checksum = 0;
+    start = Clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (const auto& entry : longest) {
+            for (size_t b = 0; b < entry.second->blockCount(); ++b) {
+                entry.second->decodeDocs(b, block);
+                checksum += block[entry.second->blockSize(b) - 1];
+            }
+        }
+    }
+    double decodeUs = elapsedMicros(start);
+    start = Clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (uint32_t doc : flat) checksum += doc;
+    }
+    double readUs = elapsedMicros(start);
+    double decoded = static_cast<double>(flat.size()) * rounds;
+    std::printf("decode: %.0f M docs/s (flat uint32 read: %.0f M docs/s) [checksum %llu]\n",
+                decoded / std::max(decodeUs, 1e-3), decoded / std::max(readUs, 1e-3),
+                static_cast<unsigned long long>(checksum));
+
+    const QueryShape shapes[] = {
+        {"1 term", 1, false, 50},
+        {"2 terms OR", 2, false, 20},
+        {"2 terms AND", 2, true, 20},
+        {"3 terms OR", 3, false, 10},
+        {"3 terms AND", 3, true, 10},
+        {"common AND rare", 2, true, 0},
+    };
+
+    std::printf("\n%-16s %10s %12s %12s %12s\n", "query", "hits/q", "mean_us", "p50_us", "p99_us");
+    for (const QueryShape& shape : shapes) {
+        std::vector<double> latency(queries);
+        double sum = 0.0;
+        size_t hits = 0;
+        std::vector<std::string> terms;
+        std::uniform_int_distribution<size_t> rareRank(vocab / 10, vocab - 1);
+
+        for (size_t q = 0; q < queries; ++q) {
+            terms.clear();
+            if (shape.minRank == 0) {
+                terms.push_back(words[q % 5]);
+                terms.push_back(words[rareRank(rng)]);
+            } else {
+                while (terms.size() < shape.terms) {
+                    size_t rank = zipf(rng);
+                    if (rank >= shape.minRank) terms.push_back(words[rank]);
+                }
+            }
+
+            start = Clock::now();
+            auto results = index.search(terms, k, shape.requireAll);
+            latency[q] = elapsedMicros(start);
+            sum += latency[q];
+            hits += results.size();
+        }
+
+        std::printf("%-16s %10.1f %12.1f %12.1f %12.1f\n", shape.name,
+                    static_cast<double>(hits) / queries, sum / queries,
+                    percentile(latency, 0.5), percentile(latency, 0.99));
+    }
+
+    if (!positions) return 0;
+
+    // Phrases and NEAR pairs cut from random lyrics, within one line so
+    // that a plain substring scan finds the phrases as well
+    std::printf("\n%-16s %10s %12s %12s %12s\n", "positional", "hits/q", "mean_us", "p50_us", "p99_us");
+    const size_t lengths[] = {2, 4, 0};
+    std::vector<std::string> tokens;
+    std::vector<std::string> scanPhrases;
+    std::uniform_int_distribution<size_t> pickDoc(0, n - 1);
+    for (size_t length : lengths) {
+        std::vector<double> latency(queries);
+        double sum = 0.0;
+        size_t hits = 0;
+        for (size_t q = 0; q < queries; ++q) {
+            tokenize(lyrics[pickDoc(rng)], tokens);
+            size_t span = length == 0 ? 4 : length;
+            size_t line = std::uniform_int_distribution<size_t>(0, (tokens.size() - 1) / 8)(rng);
+            size_t lineStart = line * 8;
+            size_t lineEnd = std::min(tokens.size(), lineStart + 8);
+            if (lineEnd - lineStart < span) lineStart = lineEnd - std::min(span, lineEnd);
+            size_t first = lineStart + std::uniform_int_distribution<size_t>(
+                0, lineEnd - lineStart - std::min(span, lineEnd - lineStart))(rng);
+
+            ProximityClause clause;
+            if (length == 0) {
+                // Outer words of a four-word window, at most two words apart
+                clause.phrase = false;
+                clause.distance = 3;
+                clause.terms.push_back(tokens[first]);
+                clause.terms.push_back(tokens[std::min(first + 3, tokens.size() - 1)]);
+            } else {
+                std::string phrase;
+                for (size_t w = first; w < std::min(first + length, tokens.size()); ++w) {
+                    clause.terms.push_back(tokens[w]);
+                    phrase += (phrase.empty() ? "" : " ") + tokens[w];
+                }
+                if (length == 4) scanPhrases.push_back(phrase);
+            }
+
+            start = Clock::now();
+            auto results = index.searchProximity(std::vector<ProximityClause>(1, clause), k);
+            latency[q] = elapsedMicros(start);
+            sum += latency[q];
+            hits += results.size();
+        }
+
+        std::string name = length == 0 ? "NEAR/3" : "phrase " + std::to_string(length) + " words";
+        std::printf("%-16s %10.1f %12.1f %12.1f %12.1f\n", name.c_str(),
+                    static_cast<double>(hits) / queries, sum / queries,
+                    percentile(latency, 0.5), percentile(latency, 0.99));
+    }
+
+    // The scan has no ranking, so it stops at k hits like a LIMIT would
+    size_t scanQueries = std::min<size_t>(scanPhrases.size(), 20);
+    std::vector<double> latency(scanQueries);
+    double sum = 0.0;
+    size_t hits = 0;
+    for (size_t q = 0; q < scanQueries; ++q) {
+        start = Clock::now();
+        size_t found = 0;
+        for (size_t d = 0; d < n && found < k; ++d) {
+            if (lyrics[d].find(scanPhrases[q]) != std::string::npos) found++;
+        }
+        latency[q] = elapsedMicros(start);
+        sum += latency[q];
+        hits += found;
+    }
+    if (scanQueries > 0) {
+        std::printf("%-16s %10.1f %12.1f %12.1f %12.1f\n", "scan 4 words",
+                    static_cast<double>(hits) / scanQueries, sum / scanQueries,
+                    percentile(latency, 0.5), percentile(latency, 0.99));
+    }
+
+    return 0;
+}
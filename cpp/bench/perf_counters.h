@@ -0,0 +1,123 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+// Hardware performance counters for benchmark phases, read through Linux
+// perf_event_open. Each counter is opened on its own, user space only, for
+// the calling thread and the threads and processes it starts; a counter the kernel or hypervisor refuses (no PMU,
+// perf_event_paranoid, seccomp) is simply reported as unavailable, so
+// benchmarks run unchanged where counters are not permitted.
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+class PerfCounters {
+public:
+    enum Event { Cycles, Instructions, LlcMisses, BranchMisses, DtlbMisses, EVENT_COUNT };
+
+    struct Sample {
+        bool valid[EVENT_COUNT];
+        uint64_t value[EVENT_COUNT];
+
+        bool has(Event event) const { return valid[event]; }
+    };
+
+    PerfCounters() : openError(ENOSYS) {
+        for (int e = 0; e < EVENT_COUNT; ++e) fds[e] = -1;
+#ifdef __linux__
+        const uint64_t dtlbReadMiss = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        fds[Cycles] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        openError = fds[Cycles] >= 0 ? 0 : errno;
+        fds[Instructions] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        fds[LlcMisses] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        fds[BranchMisses] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        fds[DtlbMisses] = open(PERF_TYPE_HW_CACHE, dtlbReadMiss);
+#endif
+    }
+
+    ~PerfCounters() {
+#ifdef __linux__
+        for (int e = 0; e < EVENT_COUNT; ++e) {
+            if (fds[e] >= 0) close(fds[e]);
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // Any counter opened
+    bool available() const {
+        for (int e = 0; e < EVENT_COUNT; ++e) {
+            if (fds[e] >= 0) return true;
+        }
+        return false;
+    }
+
+    // Why cycles could not be counted (errno), 0 if they can
+    int error() const { return openError; }
+
+    static const char* name(Event event) {
+        static const char* names[] = {"cycles", "instructions", "llc_misses", "branch_misses",
+                                      "dtlb_misses"};
+        return names[event];
+    }
+
+    // Counts since the counters were opened; take one before and one after
+    // a phase and subtract
+    Sample read() const {
+        Sample sample;
+        for (int e = 0; e < EVENT_COUNT; ++e) {
+            sample.valid[e] = false;
+            sample.value[e] = 0;
+#ifdef __linux__
+            // value, time enabled, time running; scale up when multiplexed
+            uint64_t counts[3] = {0, 0, 0};
+            if (fds[e] >= 0 && ::read(fds[e], counts, sizeof(counts)) == sizeof(counts)) {
+                sample.valid[e] = true;
+                sample.value[e] = counts[2] == 0 || counts[2] == counts[1] ? counts[0]
+                    : static_cast<uint64_t>(static_cast<double>(counts[0]) * counts[1] / counts[2]);
+            }
+#endif
+        }
+        return sample;
+    }
+
+    static Sample difference(const Sample& after, const Sample& before) {
+        Sample delta;
+        for (int e = 0; e < EVENT_COUNT; ++e) {
+            delta.valid[e] = after.valid[e] && before.valid[e];
+            delta.value[e] = delta.valid[e] ? after.value[e] - before.value[e] : 0;
+        }
+        return delta;
+    }
+
+private:
+    int fds[EVENT_COUNT];
+    int openError;
+
+#ifdef __linux__
+    static int open(uint32_t type, uint64_t config) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.inherit = 1; // also count threads and child processes
+        long fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        return static_cast<int>(fd);
+    }
+#endif
+};
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,68 @@
+#include "arena.h"
+#include <algorithm>
+#include <cstdint>
+
+Arena::Arena(size_t chunkBytes) : current(0), used(0), retired(0) {
+    chunks.reserve(16);
+    chunks.emplace_back(new char[chunkBytes], chunkBytes);
+}
+
+Arena::~Arena() {
+    for (const Chunk& chunk : chunks) delete[] chunk.data;
+}
+
+void* Arena::allocate(size_t bytes, size_t alignment) {
+    uintptr_t base = reinterpret_cast<uintptr_t>(chunks[current].data);
+    size_t offset = ((base + used + alignment - 1) & ~(alignment - 1)) - base;
+    if (offset + bytes > chunks[current].size) {
+        grow(bytes, alignment);
+        offset = 0; // new chunks come from operator new[], aligned for any type
+    }
+    used = offset + bytes;
+    return chunks[current].data + offset;
+}
+
+void Arena::deallocate(void* memory, size_t bytes) {
+    // Only the latest block can be given back
+    if (static_cast<char*>(memory) + bytes == chunks[current].data + used) {
+        used -= bytes;
+    }
+}
+
+void Arena::grow(size_t bytes, size_t alignment) {
+    retired += used;
+    used = 0;
+    // Later chunks double, so a request needs few of them however large
+    size_t size = std::max(bytes + alignment, chunks[current].size * 2);
+    chunks.emplace_back(new char[size], size);
+    current = chunks.size() - 1;
+}
+
+void Arena::reset() {
+    if (chunks.size() > 1) {
+        // Outgrown: trade the chunks for one as large as all of them, so
+        // the next batch this size fits without the global allocator
+        size_t size = bytesReserved();
+        for (const Chunk& chunk : chunks) delete[] chunk.data;
+        chunks.clear();
+        chunks.emplace_back(new char[size], size);
+    }
+    current = 0;
+    used = 0;
+    retired = 0;
+}
+
+size_t Arena::bytesUsed() const {
+    return retired + used;
+}
+
+size_t Arena::bytesReserved() const {
+    size_t total = 0;
+    for (const Chunk& chunk : chunks) total += chunk.size;
+    return total;
+}
+
+Arena& threadArena() {
+    thread_local Arena arena;
+    return arena;
+}
@@ -0,0 +1,86 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Bump allocator for the temporaries of one request. Allocation moves a
+// pointer through a chunk, freeing is a no-op (except for the most recent
+// block, which is handed back so a growing buffer can reuse its space), and
+// reset() releases everything at once. Chunks are kept across resets: a
+// reset after a batch that needed more than one replaces them with a
+// single chunk of their combined size, so the arena settles at the largest
+// batch and, once warm, serves every batch with no call to the global
+// allocator.
+class Arena {
+public:
+    explicit Arena(size_t chunkBytes = DEFAULT_CHUNK);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment);
+    void deallocate(void* memory, size_t bytes);
+
+    // Invalidates everything allocated since the last reset
+    void reset();
+
+    size_t bytesUsed() const;     // since the last reset
+    size_t bytesReserved() const; // held in chunks
+
+    static constexpr size_t DEFAULT_CHUNK = 1 << 18;
+
+private:
+    struct Chunk {
+        char* data;
+        size_t size;
+
+        Chunk(char* data, size_t size) : data(data), size(size) {}
+    };
+
+    std::vector<Chunk> chunks;
+    size_t current; // chunk being filled
+    size_t used;    // bytes of it in use
+    size_t retired; // bytes used in chunks before current
+
+    void grow(size_t bytes, size_t alignment);
+};
+
+// The calling thread's request arena; the server resets it after each
+// batch of requests
+Arena& threadArena();
+
+// Standard allocator over an Arena, for containers that live no longer
+// than the request
+template <typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(Arena& arena) : arena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T* memory, size_t n) { arena->deallocate(memory, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+private:
+    template <typename U>
+    friend class ArenaAllocator;
+
+    Arena* arena;
+};
+
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif // ARENA_H
@@ -0,0 +1,410 @@
+#include "completion_index.h"
+#include "fuzzy_index.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <queue>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PLAYLIST_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char COMPLETION_MAGIC[8] = {'E', 'P', 'C', 'O', 'M', 'P', '0', '1'};
+const uint32_t NO_ENTRY = UINT32_MAX;
+
+uint64_t hashCatalog(const std::vector<const std::string*>& titles,
+                     const std::vector<const std::string*>& artists) {
+    uint64_t hash = 1469598103934665603ULL;
+    auto append = [&hash](const std::string* value) {
+        if (value != nullptr) {
+            for (char c : *value) hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+        }
+        hash = (hash ^ 0xffu) * 1099511628211ULL;
+    };
+    for (const std::string* title : titles) append(title);
+    for (const std::string* artist : artists) append(artist);
+    return hash;
+}
+
+size_t alignUp(size_t bytes) {
+    return (bytes + 7) & ~static_cast<size_t>(7);
+}
+
+} // namespace
+
+// Image layout: Header, nodes, entries, label bytes, text bytes. Node 0 is
+// the root; the children of a node are contiguous and ordered by their
+// first label byte. Entries are in normalized-key order.
+struct CompletionIndex::Header {
+    char magic[8];
+    uint64_t catalogHash;
+    uint64_t nodeCount;
+    uint64_t entryCount;
+    uint64_t labelBytes;
+    uint64_t textBytes;
+};
+
+struct CompletionIndex::Node {
+    uint32_t labelStart;  // edge label from the parent, in labels
+    uint32_t labelLength;
+    uint32_t firstChild;
+    uint32_t childCount;
+    uint32_t maxWeight;   // best entry weight in this subtree
+    uint32_t bestEntry;   // first entry in key order with that weight
+    uint32_t entry;       // entry whose key ends here, or NO_ENTRY
+};
+
+struct CompletionIndex::Entry {
+    uint32_t textStart; // display text, in texts
+    uint32_t textLength;
+    uint32_t weight;
+    uint32_t kinds;
+};
+
+CompletionIndex::CompletionIndex()
+    : mapping(nullptr), imageBytes(0), header(nullptr), nodes(nullptr), entries(nullptr),
+      labels(nullptr), texts(nullptr) {}
+
+CompletionIndex::~CompletionIndex() {
+    clear();
+}
+
+void CompletionIndex::clear() {
+#ifdef PLAYLIST_MMAP
+    if (mapping != nullptr) munmap(mapping, imageBytes);
+#endif
+    mapping = nullptr;
+    image.clear();
+    image.shrink_to_fit();
+    imageBytes = 0;
+    header = nullptr;
+    nodes = nullptr;
+    entries = nullptr;
+    labels = nullptr;
+    texts = nullptr;
+}
+
+size_t CompletionIndex::entryCount() const {
+    return header == nullptr ? 0 : static_cast<size_t>(header->entryCount);
+}
+
+void CompletionIndex::build(const std::vector<const std::string*>& titles,
+                            const std::vector<const std::string*>& artists) {
+    clear();
+
+    struct Value {
+        std::string display;
+        uint32_t weight;
+        uint32_t kinds;
+    };
+    std::map<std::string, Value> values;
+    auto add = [&values](const std::string* value, uint32_t kind) {
+        if (value == nullptr) return;
+        std::string key = FuzzyIndex::normalize(*value);
+        if (key.empty()) return;
+        auto inserted = values.emplace(key, Value{*value, 0, 0});
+        if (inserted.second) {
+            // Display the first spelling seen, without surrounding spaces
+            std::string& display = inserted.first->second.display;
+            display.erase(0, display.find_first_not_of(" \t\n\r"));
+            display.erase(display.find_last_not_of(" \t\n\r") + 1);
+        }
+        inserted.first->second.weight++;
+        inserted.first->second.kinds |= kind;
+    };
+    for (const std::string* title : titles) add(title, KIND_TITLE);
+    for (const std::string* artist : artists) add(artist, KIND_ARTIST);
+
+    std::vector<std::string> keys;
+    std::vector<Entry> entryList;
+    std::string textBlob;
+    keys.reserve(values.size());
+    for (const auto& value : values) {
+        keys.push_back(value.first);
+        entryList.push_back(Entry{static_cast<uint32_t>(textBlob.size()),
+                                  static_cast<uint32_t>(value.second.display.size()),
+                                  value.second.weight, value.second.kinds});
+        textBlob += value.second.display;
+    }
+    values.clear();
+
+    // Radix tree over the sorted keys. fill() completes a node covering keys
+    // [low, high) that all share their first depth bytes; its children are
+    // allocated together so that they stay contiguous.
+    std::vector<Node> nodeList(1, Node{0, 0, 0, 0, 0, NO_ENTRY, NO_ENTRY});
+    std::string labelBlob;
+    struct Builder {
+        const std::vector<std::string>& keys;
+        const std::vector<Entry>& entries;
+        std::vector<Node>& nodes;
+        std::string& labels;
+
+        void fill(size_t index, size_t low, size_t high, size_t depth) {
+            uint32_t entry = NO_ENTRY;
+            if (low < high && keys[low].size() == depth) entry = static_cast<uint32_t>(low++);
+
+            std::vector<size_t> bounds;
+            for (size_t i = low; i < high; ++i) {
+                if (i == low || keys[i][depth] != keys[i - 1][depth]) bounds.push_back(i);
+            }
+            bounds.push_back(high);
+
+            size_t firstChild = nodes.size();
+            size_t childCount = bounds.size() - 1;
+            nodes.resize(nodes.size() + childCount);
+            for (size_t c = 0; c < childCount; ++c) {
+                // The child's label runs to the longest prefix its keys share
+                const std::string& first = keys[bounds[c]];
+                const std::string& last = keys[bounds[c + 1] - 1];
+                size_t end = depth + 1;
+                while (end < first.size() && end < last.size() && first[end] == last[end]) end++;
+
+                Node& child = nodes[firstChild + c];
+                child.labelStart = static_cast<uint32_t>(labels.size());
+                child.labelLength = static_cast<uint32_t>(end - depth);
+                labels.append(first, depth, end - depth);
+                fill(firstChild + c, bounds[c], bounds[c + 1], end);
+            }
+
+            Node& node = nodes[index];
+            node.firstChild = static_cast<uint32_t>(firstChild);
+            node.childCount = static_cast<uint32_t>(childCount);
+            node.entry = entry;
+            node.maxWeight = 0;
+            node.bestEntry = NO_ENTRY;
+            if (entry != NO_ENTRY) {
+                node.maxWeight = entries[entry].weight;
+                node.bestEntry = entry;
+            }
+            for (size_t c = 0; c < childCount; ++c) {
+                const Node& child = nodes[firstChild + c];
+                if (child.maxWeight > node.maxWeight ||
+                    (child.maxWeight == node.maxWeight && child.bestEntry < node.bestEntry)) {
+                    node.maxWeight = child.maxWeight;
+                    node.bestEntry = child.bestEntry;
+                }
+            }
+        }
+    };
+    Builder builder{keys, entryList, nodeList, labelBlob};
+    builder.fill(0, 0, keys.size(), 0);
+
+    if (labelBlob.size() >= UINT32_MAX || textBlob.size() >= UINT32_MAX) {
+        throw std::runtime_error("Catalog too large for the completion index");
+    }
+
+    Header head;
+    std::memcpy(head.magic, COMPLETION_MAGIC, sizeof(head.magic));
+    head.catalogHash = hashCatalog(titles, artists);
+    head.nodeCount = nodeList.size();
+    head.entryCount = entryList.size();
+    head.labelBytes = labelBlob.size();
+    head.textBytes = textBlob.size();
+
+    size_t bytes = sizeof(Header) + nodeList.size() * sizeof(Node) + entryList.size() * sizeof(Entry) +
+                   labelBlob.size() + textBlob.size();
+    image.assign(alignUp(bytes) / sizeof(uint64_t), 0);
+    char* out = reinterpret_cast<char*>(image.data());
+    std::memcpy(out, &head, sizeof(Header));
+    out += sizeof(Header);
+    std::memcpy(out, nodeList.data(), nodeList.size() * sizeof(Node));
+    out += nodeList.size() * sizeof(Node);
+    std::memcpy(out, entryList.data(), entryList.size() * sizeof(Entry));
+    out += entryList.size() * sizeof(Entry);
+    std::memcpy(out, labelBlob.data(), labelBlob.size());
+    out += labelBlob.size();
+    std::memcpy(out, textBlob.data(), textBlob.size());
+
+    attach(image.data(), bytes);
+}
+
+bool CompletionIndex::attach(const void* data, size_t bytes) {
+    if (bytes < sizeof(Header)) return false;
+    const Header* head = static_cast<const Header*>(data);
+    if (std::memcmp(head->magic, COMPLETION_MAGIC, sizeof(head->magic)) != 0) return false;
+
+    // Counts are checked one at a time so that the products cannot overflow
+    if (head->nodeCount == 0 || head->nodeCount > bytes / sizeof(Node) ||
+        head->entryCount > bytes / sizeof(Entry) || head->labelBytes > bytes ||
+        head->textBytes > bytes) {
+        return false;
+    }
+    size_t expected = sizeof(Header) + head->nodeCount * sizeof(Node) +
+                      head->entryCount * sizeof(Entry) + head->labelBytes + head->textBytes;
+    if (expected != bytes) return false;
+
+    const char* base = static_cast<const char*>(data);
+    const Node* nodeArray = reinterpret_cast<const Node*>(base + sizeof(Header));
+    const Entry* entryArray = reinterpret_cast<const Entry*>(nodeArray + head->nodeCount);
+    const char* labelBytes = reinterpret_cast<const char*>(entryArray + head->entryCount);
+
+    // Every child range, label, entry and text must lie inside the image,
+    // and children must come after their parent (so searches terminate)
+    for (uint64_t i = 0; i < head->nodeCount; ++i) {
+        const Node& node = nodeArray[i];
+        if (node.labelStart > head->labelBytes || node.labelLength > head->labelBytes - node.labelStart ||
+            (i > 0 && node.labelLength == 0) || node.firstChild > head->nodeCount ||
+            node.childCount > head->nodeCount - node.firstChild ||
+            (node.childCount > 0 && node.firstChild <= i) ||
+            (node.entry != NO_ENTRY && node.entry >= head->entryCount) ||
+            (node.bestEntry != NO_ENTRY && node.bestEntry >= head->entryCount)) {
+            return false;
+        }
+    }
+    for (uint64_t i = 0; i < head->entryCount; ++i) {
+        const Entry& entry = entryArray[i];
+        if (entry.textStart > head->textBytes || entry.textLength > head->textBytes - entry.textStart) {
+            return false;
+        }
+    }
+
+    header = head;
+    nodes = nodeArray;
+    entries = entryArray;
+    labels = labelBytes;
+    texts = labelBytes + head->labelBytes;
+    imageBytes = bytes;
+    return true;
+}
+
+std::vector<CompletionIndex::Completion> CompletionIndex::complete(const std::string& prefix,
+                                                                   size_t n) const {
+    std::vector<Completion> results;
+    if (header == nullptr || n == 0) return results;
+
+    std::string key = FuzzyIndex::normalize(prefix);
+    if (!key.empty() && std::isspace(static_cast<unsigned char>(prefix.back()))) key += ' ';
+
+    // Walk down to the node whose subtree holds every key with this prefix
+    uint32_t current = 0;
+    size_t matched = 0;
+    while (matched < key.size()) {
+        const Node& node = nodes[current];
+        const Node* children = nodes + node.firstChild;
+        const Node* child = std::lower_bound(children, children + node.childCount,
+                                             static_cast<unsigned char>(key[matched]),
+                                             [this](const Node& candidate, unsigned char byte) {
+                                                 return static_cast<unsigned char>(labels[candidate.labelStart]) < byte;
+                                             });
+        if (child == children + node.childCount ||
+            labels[child->labelStart] != key[matched]) {
+            return results;
+        }
+        size_t length = std::min<size_t>(child->labelLength, key.size() - matched);
+        if (std::memcmp(labels + child->labelStart, key.data() + matched, length) != 0) {
+            return results;
+        }
+        matched += length;
+        current = static_cast<uint32_t>(child - nodes);
+    }
+
+    // Best-first over subtrees (keyed by their best weight) and entries. A
+    // subtree never ranks below what it contains, so entries come out in
+    // final order.
+    struct Item {
+        uint32_t weight;
+        uint32_t order; // entry index, or a subtree's bestEntry
+        uint32_t node;  // NO_ENTRY for an entry
+    };
+    auto worse = [](const Item& a, const Item& b) {
+        if (a.weight != b.weight) return a.weight < b.weight;
+        if (a.order != b.order) return a.order > b.order;
+        return a.node == NO_ENTRY && b.node != NO_ENTRY; // expand before emitting
+    };
+    std::priority_queue<Item, std::vector<Item>, decltype(worse)> queue(worse);
+    queue.push(Item{nodes[current].maxWeight, nodes[current].bestEntry, current});
+
+    while (!queue.empty() && results.size() < n) {
+        Item item = queue.top();
+        queue.pop();
+        if (item.node == NO_ENTRY) {
+            const Entry& entry = entries[item.order];
+            results.push_back(Completion{std::string(texts + entry.textStart, entry.textLength),
+                                         entry.weight, entry.kinds});
+            continue;
+        }
+        const Node& node = nodes[item.node];
+        if (node.entry != NO_ENTRY) {
+            queue.push(Item{entries[node.entry].weight, node.entry, NO_ENTRY});
+        }
+        for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; ++c) {
+            queue.push(Item{nodes[c].maxWeight, nodes[c].bestEntry, c});
+        }
+    }
+    return results;
+}
+
+void CompletionIndex::save(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open()) {
+        throw std::runtime_error("Could not write completion index: " + path);
+    }
+    if (header != nullptr) {
+        out.write(reinterpret_cast<const char*>(header), static_cast<std::streamsize>(imageBytes));
+    }
+    if (!out) {
+        throw std::runtime_error("Failed writing completion index: " + path);
+    }
+}
+
+void CompletionIndex::load(const std::string& path, const std::vector<const std::string*>& titles,
+                           const std::vector<const std::string*>& artists) {
+    clear();
+
+#ifdef PLAYLIST_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open completion index: " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(Header))) {
+        close(fd);
+        throw std::runtime_error("Not a completion index file: " + path);
+    }
+    size_t bytes = static_cast<size_t>(info.st_size);
+    void* data = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("Could not map completion index: " + path);
+    }
+    mapping = data;
+    imageBytes = bytes;
+#else
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in.is_open()) {
+        throw std::runtime_error("Could not open completion index: " + path);
+    }
+    size_t bytes = static_cast<size_t>(in.tellg());
+    image.assign(alignUp(bytes) / sizeof(uint64_t), 0);
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(image.data()), static_cast<std::streamsize>(bytes));
+    if (!in) {
+        clear();
+        throw std::runtime_error("Could not read completion index: " + path);
+    }
+    const void* data = image.data();
+#endif
+
+    if (bytes < sizeof(Header) ||
+        std::memcmp(static_cast<const Header*>(data)->magic, COMPLETION_MAGIC, sizeof(COMPLETION_MAGIC)) != 0) {
+        clear();
+        throw std::runtime_error("Not a completion index file: " + path);
+    }
+    if (static_cast<const Header*>(data)->catalogHash != hashCatalog(titles, artists)) {
+        clear();
+        throw std::runtime_error("Completion index does not match the loaded catalog: " + path);
+    }
+    if (!attach(data, bytes)) {
+        clear();
+        throw std::runtime_error("Corrupt completion index: " + path);
+    }
+}
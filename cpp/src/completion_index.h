@@ -0,0 +1,71 @@
+#ifndef COMPLETION_INDEX_H
+#define COMPLETION_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Prefix autocomplete over song titles and artists. Normalized values
+// (see FuzzyIndex::normalize) are stored in a path-compressed trie whose
+// nodes carry the best weight in their subtree, so the top n completions
+// of a prefix are found best-first without visiting the rest of it.
+//
+// The whole index is one flat, pointer-free image: build() assembles it in
+// memory, save() writes it as is and load() maps the file read-only, so a
+// saved index is usable immediately and shared between processes.
+class CompletionIndex {
+public:
+    static constexpr uint32_t KIND_TITLE = 1;
+    static constexpr uint32_t KIND_ARTIST = 2;
+
+    struct Completion {
+        std::string text; // as first seen in the catalog
+        uint32_t weight;  // songs with this title plus songs by this artist
+        uint32_t kinds;   // KIND_TITLE and/or KIND_ARTIST
+    };
+
+    CompletionIndex();
+    ~CompletionIndex();
+    CompletionIndex(const CompletionIndex&) = delete;
+    CompletionIndex& operator=(const CompletionIndex&) = delete;
+
+    // Every title and artist of every song; weights count songs
+    void build(const std::vector<const std::string*>& titles,
+               const std::vector<const std::string*>& artists);
+    void clear();
+    bool empty() const { return header == nullptr; }
+
+    // Top n completions of prefix by weight, ties in alphabetical order. A
+    // trailing space in prefix only completes whole words.
+    std::vector<Completion> complete(const std::string& prefix, size_t n) const;
+
+    // Persist / map back; load checks the index against the same catalog
+    void save(const std::string& path) const;
+    void load(const std::string& path, const std::vector<const std::string*>& titles,
+              const std::vector<const std::string*>& artists);
+
+    bool mapped() const { return mapping != nullptr; }
+    size_t entryCount() const;
+    size_t memoryBytes() const { return imageBytes; }
+
+private:
+    struct Header;
+    struct Node;
+    struct Entry;
+
+    std::vector<uint64_t> image; // built image (uint64 keeps it aligned)
+    void* mapping;               // or the mapped file
+    size_t imageBytes;
+
+    const Header* header;
+    const Node* nodes;
+    const Entry* entries;
+    const char* labels;
+    const char* texts;
+
+    // Point at an image and check its structure; false if it is invalid
+    bool attach(const void* data, size_t bytes);
+};
+
+#endif // COMPLETION_INDEX_H
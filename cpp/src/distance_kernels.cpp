@@ -0,0 +1,162 @@
+#include "distance_kernels.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define PLAYLIST_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+float l2SquaredScalar(const float* a, const float* b, size_t dimension) {
+    // Four independent accumulators let the compiler vectorize the loop
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+    size_t i = 0;
+    for (; i + 4 <= dimension; i += 4) {
+        float d0 = a[i] - b[i];
+        float d1 = a[i + 1] - b[i + 1];
+        float d2 = a[i + 2] - b[i + 2];
+        float d3 = a[i + 3] - b[i + 3];
+        s0 += d0 * d0;
+        s1 += d1 * d1;
+        s2 += d2 * d2;
+        s3 += d3 * d3;
+    }
+    for (; i < dimension; ++i) {
+        float d = a[i] - b[i];
+        s0 += d * d;
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+float scalarCodeDistanceScalar(const float* query, const float* weight,
+                               const uint8_t* codes, size_t dimension) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < dimension; ++i) {
+        float d = query[i] - static_cast<float>(codes[i]);
+        sum += weight[i] * d * d;
+    }
+    return sum;
+}
+
+float tableDistanceScalar(const float* table, const uint8_t* codes, size_t subspaces) {
+    float s0 = 0.0f, s1 = 0.0f;
+    size_t j = 0;
+    for (; j + 2 <= subspaces; j += 2) {
+        s0 += table[j * 256 + codes[j]];
+        s1 += table[(j + 1) * 256 + codes[j + 1]];
+    }
+    for (; j < subspaces; ++j) s0 += table[j * 256 + codes[j]];
+    return s0 + s1;
+}
+
+#ifdef PLAYLIST_X86_DISPATCH
+
+__attribute__((target("avx2,fma")))
+float horizontalSum(__m256 v) {
+    __m128 low = _mm256_castps256_ps128(v);
+    __m128 high = _mm256_extractf128_ps(v, 1);
+    low = _mm_add_ps(low, high);
+    low = _mm_add_ps(low, _mm_movehl_ps(low, low));
+    low = _mm_add_ss(low, _mm_shuffle_ps(low, low, 0x55));
+    return _mm_cvtss_f32(low);
+}
+
+__attribute__((target("avx2,fma")))
+float l2SquaredAvx2(const float* a, const float* b, size_t dimension) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= dimension; i += 16) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+    }
+    for (; i + 8 <= dimension; i += 8) {
+        __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        acc0 = _mm256_fmadd_ps(d, d, acc0);
+    }
+    float sum = horizontalSum(_mm256_add_ps(acc0, acc1));
+    for (; i < dimension; ++i) {
+        float d = a[i] - b[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+float scalarCodeDistanceAvx2(const float* query, const float* weight,
+                             const uint8_t* codes, size_t dimension) {
+    __m256 acc = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= dimension; i += 8) {
+        __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(codes + i));
+        __m256 decoded = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(packed));
+        __m256 d = _mm256_sub_ps(_mm256_loadu_ps(query + i), decoded);
+        acc = _mm256_fmadd_ps(_mm256_mul_ps(d, d), _mm256_loadu_ps(weight + i), acc);
+    }
+    float sum = horizontalSum(acc);
+    for (; i < dimension; ++i) {
+        float d = query[i] - static_cast<float>(codes[i]);
+        sum += weight[i] * d * d;
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+float tableDistanceAvx2(const float* table, const uint8_t* codes, size_t subspaces) {
+    const __m256i rowOffsets = _mm256_setr_epi32(0, 256, 512, 768, 1024, 1280, 1536, 1792);
+    __m256 acc = _mm256_setzero_ps();
+    size_t j = 0;
+    for (; j + 8 <= subspaces; j += 8) {
+        __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(codes + j));
+        __m256i index = _mm256_add_epi32(_mm256_cvtepu8_epi32(packed), rowOffsets);
+        acc = _mm256_add_ps(acc, _mm256_i32gather_ps(table + j * 256, index, 4));
+    }
+    float sum = horizontalSum(acc);
+    for (; j < subspaces; ++j) sum += table[j * 256 + codes[j]];
+    return sum;
+}
+
+#endif // PLAYLIST_X86_DISPATCH
+
+struct KernelTable {
+    float (*l2Squared)(const float*, const float*, size_t);
+    float (*scalarCode)(const float*, const float*, const uint8_t*, size_t);
+    float (*table)(const float*, const uint8_t*, size_t);
+    const char* name;
+};
+
+KernelTable selectKernels() {
+#ifdef PLAYLIST_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return KernelTable{l2SquaredAvx2, scalarCodeDistanceAvx2, tableDistanceAvx2, "avx2"};
+    }
+#endif
+    return KernelTable{l2SquaredScalar, scalarCodeDistanceScalar, tableDistanceScalar, "scalar"};
+}
+
+const KernelTable& kernels() {
+    static const KernelTable table = selectKernels();
+    return table;
+}
+
+} // namespace
+
+float l2SquaredKernel(const float* a, const float* b, size_t dimension) {
+    return kernels().l2Squared(a, b, dimension);
+}
+
+float scalarCodeDistanceKernel(const float* query, const float* weight,
+                               const uint8_t* codes, size_t dimension) {
+    return kernels().scalarCode(query, weight, codes, dimension);
+}
+
+float tableDistanceKernel(const float* table, const uint8_t* codes, size_t subspaces) {
+    return kernels().table(table, codes, subspaces);
+}
+
+const char* distanceKernelName() {
+    return kernels().name;
+}
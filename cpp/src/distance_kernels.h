@@ -0,0 +1,26 @@
+#ifndef DISTANCE_KERNELS_H
+#define DISTANCE_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Distance kernels used by the embedding store. Each call dispatches once
+// (on first use) to an AVX2/FMA implementation when the CPU supports it,
+// falling back to portable scalar code elsewhere.
+
+// Squared L2 distance between two float vectors
+float l2SquaredKernel(const float* a, const float* b, size_t dimension);
+
+// Weighted squared distance between a prepared float query and 8-bit codes:
+// sum(weight[d] * (query[d] - code[d])^2)
+float scalarCodeDistanceKernel(const float* query, const float* weight,
+                               const uint8_t* codes, size_t dimension);
+
+// Sum of table[j * 256 + codes[j]] over all subspaces (product quantization
+// asymmetric distance with a per-query lookup table)
+float tableDistanceKernel(const float* table, const uint8_t* codes, size_t subspaces);
+
+// Name of the implementation selected for this CPU ("avx2" or "scalar")
+const char* distanceKernelName();
+
+#endif // DISTANCE_KERNELS_H
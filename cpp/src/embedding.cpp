@@ -0,0 +1,190 @@
+#include "embedding.h"
+#include "distance_kernels.h"
+#include "tokenizer.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+float l2Squared(const float* a, const float* b, size_t dimension) {
+    return l2SquaredKernel(a, b, dimension);
+}
+
+VectorEncoding parseVectorEncoding(const std::string& name) {
+    if (name == "float32" || name == "float") return VectorEncoding::Float32;
+    if (name == "int8" || name == "sq8") return VectorEncoding::Int8;
+    if (name == "pq") return VectorEncoding::Product;
+    throw std::invalid_argument("Unknown vector encoding: " + name);
+}
+
+const char* vectorEncodingName(VectorEncoding encoding) {
+    switch (encoding) {
+        case VectorEncoding::Int8: return "int8";
+        case VectorEncoding::Product: return "pq";
+        default: return "float32";
+    }
+}
+
+void EmbeddingStore::reset(size_t dimension, size_t rows) {
+    dim = dimension;
+    count = rows;
+    encoding = VectorEncoding::Float32;
+    data.assign(dimension * rows, 0.0f);
+    codes.clear();
+    codeSize = 0;
+}
+
+float EmbeddingStore::distance(const float* query, size_t i) const {
+    return l2SquaredKernel(query, row(i), dim);
+}
+
+void EmbeddingStore::quantize(VectorEncoding target, size_t subspaces, bool keepFloat,
+                              unsigned threads) {
+    if (target == encoding) return;
+    if (empty()) {
+        encoding = target;
+        return;
+    }
+    if (!hasFloat()) {
+        throw std::runtime_error("Cannot re-quantize embeddings without float vectors");
+    }
+
+    if (target == VectorEncoding::Float32) {
+        codes.clear();
+        codes.shrink_to_fit();
+        codeSize = 0;
+        encoding = target;
+        return;
+    }
+
+    if (target == VectorEncoding::Int8) {
+        scalar.train(data.data(), count, dim);
+        codeSize = scalar.codeSize();
+    } else {
+        if (subspaces == 0) {
+            // Default to 8 dimensions per subspace, the usual PQ sweet spot
+            subspaces = std::max<size_t>(1, dim / 8);
+            while (dim % subspaces != 0) --subspaces;
+        }
+        product.train(data.data(), count, dim, subspaces, threads, 42);
+        codeSize = product.codeSize();
+    }
+
+    codes.assign(count * codeSize, 0);
+    unsigned threadCount = threads != 0 ? threads : std::thread::hardware_concurrency();
+    threadCount = std::max(1u, threadCount);
+    size_t chunk = (count + threadCount - 1) / threadCount;
+
+    auto worker = [this, target, chunk](size_t begin) {
+        TRACE_SCOPE("embeddings/quantize");
+        size_t end = std::min(count, begin + chunk);
+        for (size_t i = begin; i < end; ++i) {
+            if (target == VectorEncoding::Int8) {
+                scalar.encode(row(i), &codes[i * codeSize]);
+            } else {
+                product.encode(row(i), &codes[i * codeSize]);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t begin = chunk; begin < count; begin += chunk) {
+        workers.emplace_back(worker, begin);
+    }
+    worker(0);
+    for (auto& t : workers) t.join();
+
+    encoding = target;
+    if (!keepFloat) {
+        data.clear();
+        data.shrink_to_fit();
+    }
+}
+
+void EmbeddingStore::prepare(const float* query, PreparedQuery& prepared) const {
+    switch (encoding) {
+        case VectorEncoding::Int8:
+            prepared.values.resize(dim);
+            scalar.prepare(query, prepared.values.data());
+            break;
+        case VectorEncoding::Product:
+            prepared.table.resize(product.tableSize());
+            product.computeTable(query, prepared.table.data());
+            break;
+        default:
+            prepared.values.assign(query, query + dim);
+            break;
+    }
+}
+
+float EmbeddingStore::distance(const PreparedQuery& prepared, size_t i) const {
+    switch (encoding) {
+        case VectorEncoding::Int8:
+            return scalar.distance(prepared.values.data(), &codes[i * codeSize]);
+        case VectorEncoding::Product:
+            return product.distance(prepared.table.data(), &codes[i * codeSize]);
+        default:
+            return l2SquaredKernel(prepared.values.data(), row(i), dim);
+    }
+}
+
+void EmbeddingStore::decode(size_t i, float* out) const {
+    switch (encoding) {
+        case VectorEncoding::Int8:
+            scalar.decode(&codes[i * codeSize], out);
+            break;
+        case VectorEncoding::Product:
+            product.decode(&codes[i * codeSize], out);
+            break;
+        default:
+            std::copy(row(i), row(i) + dim, out);
+            break;
+    }
+}
+
+size_t EmbeddingStore::memoryBytes() const {
+    size_t bytes = data.capacity() * sizeof(float) + codes.capacity();
+    if (encoding == VectorEncoding::Int8) bytes += scalar.memoryBytes();
+    if (encoding == VectorEncoding::Product) bytes += product.memoryBytes();
+    return bytes;
+}
+
+void EmbeddingStore::normalize(float* vec, size_t dimension) {
+    double norm = 0.0;
+    for (size_t i = 0; i < dimension; ++i) {
+        norm += static_cast<double>(vec[i]) * vec[i];
+    }
+    if (norm <= 0.0) return;
+
+    float inv = static_cast<float>(1.0 / std::sqrt(norm));
+    for (size_t i = 0; i < dimension; ++i) {
+        vec[i] *= inv;
+    }
+}
+
+void EmbeddingStore::embedText(const std::string& text, float* out, size_t dimension) {
+    for (size_t i = 0; i < dimension; ++i) out[i] = 0.0f;
+    if (dimension == 0) return;
+
+    std::vector<std::string> tokens;
+    tokenize(text, tokens);
+
+    std::unordered_map<unsigned long long, int> counts;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        counts[hashToken(tokens[i])]++;
+        if (i + 1 < tokens.size()) {
+            counts[hashToken(tokens[i] + " " + tokens[i + 1])]++;
+        }
+    }
+
+    for (const auto& entry : counts) {
+        unsigned long long h = entry.first;
+        size_t slot = static_cast<size_t>(h % dimension);
+        float sign = ((h >> 63) & 1ULL) ? -1.0f : 1.0f;
+        out[slot] += sign * (1.0f + std::log(static_cast<float>(entry.second)));
+    }
+
+    normalize(out, dimension);
+}
@@ -0,0 +1,89 @@
+#ifndef EMBEDDING_H
+#define EMBEDDING_H
+
+#include "quantization.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// How vectors are held in memory
+enum class VectorEncoding {
+    Float32, // 4 bytes per dimension, exact
+    Int8,    // 1 byte per dimension, per-dimension scalar quantization
+    Product  // 1 byte per subspace, product quantization
+};
+
+// A query mapped into the store's encoding, reused across many distance
+// calls (the PQ lookup table is computed once per query)
+struct PreparedQuery {
+    std::vector<float> values;
+    std::vector<float> table;
+};
+
+// Dense per-song embedding vectors, stored row-major and addressed by
+// song ordinal (position in load order). Vectors are L2-normalized so
+// squared L2 distance orders results the same way as cosine similarity.
+class EmbeddingStore {
+private:
+    size_t dim;
+    size_t count;
+    VectorEncoding encoding;
+    std::vector<float> data;    // float rows; dropped after quantize() unless kept
+    std::vector<uint8_t> codes; // quantized rows, codeSize bytes each
+    size_t codeSize;
+    ScalarQuantizer scalar;
+    ProductQuantizer product;
+
+public:
+    EmbeddingStore() : dim(0), count(0), encoding(VectorEncoding::Float32), codeSize(0) {}
+
+    // Allocate zeroed float storage for count vectors of the given dimension
+    void reset(size_t dimension, size_t rows);
+
+    size_t dimension() const { return dim; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    VectorEncoding vectorEncoding() const { return encoding; }
+
+    // Float rows are available (always before quantize(), afterwards only
+    // when kept for re-ranking)
+    bool hasFloat() const { return !data.empty(); }
+    float* row(size_t i) { return data.data() + i * dim; }
+    const float* row(size_t i) const { return data.data() + i * dim; }
+
+    // Exact squared L2 distance between query and float row i
+    float distance(const float* query, size_t i) const;
+
+    // Encode every row. subspaces applies to Product (0 picks dim/8 or the
+    // largest divisor below it). Float rows are released unless keepFloat.
+    void quantize(VectorEncoding target, size_t subspaces = 0, bool keepFloat = false,
+                  unsigned threads = 0);
+
+    // Map a query into the current encoding, then measure stored rows
+    // against it (asymmetric: the query itself stays full precision)
+    void prepare(const float* query, PreparedQuery& prepared) const;
+    float distance(const PreparedQuery& prepared, size_t i) const;
+
+    // Reconstruct row i as floats (exact for Float32, approximate otherwise)
+    void decode(size_t i, float* out) const;
+
+    // Bytes held by vector data, codes and codebooks
+    size_t memoryBytes() const;
+
+    // Derive a vector from free text with signed feature hashing over
+    // word unigrams and bigrams (log-scaled term frequency, L2-normalized).
+    static void embedText(const std::string& text, float* out, size_t dimension);
+
+    // Scale a vector to unit length (left untouched if it is all zeros)
+    static void normalize(float* vec, size_t dimension);
+};
+
+// Squared L2 distance between two vectors
+float l2Squared(const float* a, const float* b, size_t dimension);
+
+// Parse "float32", "int8" or "pq"; throws std::invalid_argument otherwise
+VectorEncoding parseVectorEncoding(const std::string& name);
+const char* vectorEncodingName(VectorEncoding encoding);
+
+#endif // EMBEDDING_H
@@ -0,0 +1,282 @@
+#include "fm_index.h"
+#include "suffix_array.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+const char FM_MAGIC[8] = {'E', 'P', 'F', 'M', 'I', 'X', '0', '2'};
+
+// Bytes 0 and 1 are reserved for the sentinel and the document separator
+const uint8_t SENTINEL = 0;
+const uint8_t SEPARATOR = 1;
+
+// Rows per thread below which locate stays single-threaded
+const size_t PARALLEL_LOCATE_MIN = 4096;
+
+inline uint8_t foldByte(unsigned char c) {
+    if (c >= 'A' && c <= 'Z') return static_cast<uint8_t>(c + ('a' - 'A'));
+    if (c == SENTINEL || c == SEPARATOR) return ' ';
+    return c;
+}
+
+// Text as indexed: folded documents, each followed by a separator, then
+// the sentinel. Hashed (FNV-1a) so a saved index can be checked.
+uint64_t hashText(const std::vector<const std::string*>& documents, std::vector<uint8_t>* text) {
+    uint64_t hash = 1469598103934665603ULL;
+    auto append = [&hash, text](uint8_t byte) {
+        hash = (hash ^ byte) * 1099511628211ULL;
+        if (text != nullptr) text->push_back(byte);
+    };
+    for (const std::string* document : documents) {
+        if (document != nullptr) {
+            for (char c : *document) append(foldByte(static_cast<unsigned char>(c)));
+        }
+        append(SEPARATOR);
+    }
+    append(SENTINEL);
+    return hash;
+}
+
+template <typename T>
+void writePod(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void readPod(std::ifstream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+} // namespace
+
+FmIndex::FmIndex() : sampleRate(32), textLength(0), textHash(0) {
+    std::memset(symbolStarts, 0, sizeof(symbolStarts));
+}
+
+void FmIndex::clear() {
+    bwt = WaveletTree();
+    sampled = RankBitVector();
+    samples.clear();
+    documentStarts.clear();
+    std::memset(symbolStarts, 0, sizeof(symbolStarts));
+    textLength = 0;
+    textHash = 0;
+}
+
+void FmIndex::build(const std::vector<const std::string*>& documents, const Params& params) {
+    clear();
+    sampleRate = std::max<uint32_t>(1, params.sampleRate);
+
+    std::vector<uint8_t> text;
+    size_t total = documents.size() + 1;
+    for (const std::string* document : documents) total += document != nullptr ? document->size() : 0;
+    if (total >= UINT32_MAX) throw std::runtime_error("Text too large for the substring index");
+    text.reserve(total);
+    textHash = hashText(documents, &text);
+    textLength = text.size();
+
+    documentStarts.reserve(documents.size());
+    uint32_t offset = 0;
+    for (const std::string* document : documents) {
+        documentStarts.push_back(offset);
+        offset += static_cast<uint32_t>(document != nullptr ? document->size() : 0) + 1;
+    }
+
+    std::vector<uint32_t> suffixArray = buildSuffixArray(text, params.threads);
+
+    // BWT row j holds the byte before suffix sa[j]; sampled rows keep the
+    // suffix position when it is a multiple of the sampling rate
+    std::vector<uint8_t> transform(text.size());
+    sampled.reserve(text.size());
+    for (size_t j = 0; j < suffixArray.size(); ++j) {
+        uint32_t position = suffixArray[j];
+        transform[j] = text[position == 0 ? text.size() - 1 : position - 1];
+        bool keep = position % sampleRate == 0;
+        sampled.push(keep);
+        if (keep) samples.push_back(position);
+    }
+    sampled.finalize();
+    samples.shrink_to_fit();
+    std::vector<uint32_t>().swap(suffixArray);
+    std::vector<uint8_t>().swap(text);
+
+    uint64_t counts[256] = {0};
+    for (uint8_t byte : transform) counts[byte]++;
+    symbolStarts[0] = 0;
+    for (int c = 0; c < 256; ++c) symbolStarts[c + 1] = symbolStarts[c] + counts[c];
+
+    bwt.build(transform);
+}
+
+bool FmIndex::range(const std::string& pattern, size_t& begin, size_t& end) const {
+    begin = 0;
+    end = static_cast<size_t>(textLength);
+    if (empty()) return false;
+
+    // Backward search: extend the match one byte to the left at a time
+    for (size_t i = pattern.size(); i-- > 0;) {
+        uint8_t c = foldByte(static_cast<unsigned char>(pattern[i]));
+        begin = static_cast<size_t>(symbolStarts[c]) + bwt.rank(c, begin);
+        end = static_cast<size_t>(symbolStarts[c]) + bwt.rank(c, end);
+        if (begin >= end) return false;
+    }
+    return true;
+}
+
+size_t FmIndex::count(const std::string& pattern) const {
+    size_t begin = 0;
+    size_t end = 0;
+    if (pattern.empty() || !range(pattern, begin, end)) return 0;
+    return end - begin;
+}
+
+// Walk LF (to the suffix one byte earlier) until a sampled row, which
+// takes fewer than sampleRate steps in an intact index; the bound keeps a
+// damaged one that got past load() from walking forever
+uint32_t FmIndex::suffixPosition(size_t row) const {
+    uint32_t steps = 0;
+    while (!sampled.get(row) && steps < sampleRate) {
+        size_t rank = 0;
+        uint8_t c = bwt.inverseSelect(row, rank);
+        row = static_cast<size_t>(symbolStarts[c]) + rank;
+        steps++;
+    }
+    return samples[sampled.rank1(row)] + steps;
+}
+
+std::vector<FmIndex::Occurrence> FmIndex::locate(const std::string& pattern, size_t limit) const {
+    std::vector<Occurrence> occurrences;
+    size_t begin = 0;
+    size_t end = 0;
+    if (pattern.empty() || limit == 0 || !range(pattern, begin, end)) return occurrences;
+    if (end - begin > limit) end = begin + limit;
+
+    occurrences.resize(end - begin);
+    auto worker = [&](size_t first, size_t last) {
+        TRACE_SCOPE("fm_index/locate");
+        for (size_t row = first; row < last; ++row) {
+            uint32_t position = suffixPosition(row);
+            auto it = std::upper_bound(documentStarts.begin(), documentStarts.end(), position);
+            uint32_t document = static_cast<uint32_t>(it - documentStarts.begin() - 1);
+            occurrences[row - begin] = Occurrence{document, position - documentStarts[document]};
+        }
+    };
+
+    size_t rows = end - begin;
+    unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+    threadCount = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threadCount, rows / PARALLEL_LOCATE_MIN)));
+    size_t chunk = (rows + threadCount - 1) / threadCount;
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threadCount; ++t) {
+        size_t first = begin + t * chunk;
+        if (first < end) workers.emplace_back(worker, first, std::min(end, first + chunk));
+    }
+    worker(begin, std::min(end, begin + chunk));
+    for (auto& t : workers) t.join();
+    return occurrences;
+}
+
+size_t FmIndex::memoryBytes() const {
+    if (empty()) return 0;
+    return bwt.memoryBytes() + sampled.memoryBytes() + samples.capacity() * sizeof(uint32_t) +
+           documentStarts.capacity() * sizeof(uint32_t) + sizeof(symbolStarts);
+}
+
+void FmIndex::save(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open()) {
+        throw std::runtime_error("Could not write substring index: " + path);
+    }
+
+    unsigned long long documents = documentStarts.size();
+    unsigned long long sampleCount = samples.size();
+    out.write(FM_MAGIC, sizeof(FM_MAGIC));
+    writePod(out, textLength);
+    writePod(out, textHash);
+    writePod(out, documents);
+    writePod(out, sampleRate);
+    out.write(reinterpret_cast<const char*>(symbolStarts), sizeof(symbolStarts));
+    out.write(reinterpret_cast<const char*>(documentStarts.data()),
+              documentStarts.size() * sizeof(uint32_t));
+    writePod(out, sampleCount);
+    out.write(reinterpret_cast<const char*>(samples.data()), samples.size() * sizeof(uint32_t));
+    sampled.save(out);
+    bwt.save(out);
+
+    if (!out) {
+        throw std::runtime_error("Failed writing substring index: " + path);
+    }
+}
+
+void FmIndex::load(const std::string& path, const std::vector<const std::string*>& documents) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("Could not open substring index: " + path);
+    }
+
+    char magic[sizeof(FM_MAGIC)];
+    in.read(magic, sizeof(magic));
+    if (!in || std::memcmp(magic, FM_MAGIC, sizeof(magic)) != 0) {
+        throw std::runtime_error("Not a substring index file: " + path);
+    }
+
+    clear();
+    unsigned long long documentCount = 0;
+    unsigned long long sampleCount = 0;
+    readPod(in, textLength);
+    readPod(in, textHash);
+    readPod(in, documentCount);
+    readPod(in, sampleRate);
+    uint64_t expectedLength = documents.size() + 1;
+    for (const std::string* document : documents) expectedLength += document != nullptr ? document->size() : 0;
+    if (!in || documentCount != documents.size() || textLength != expectedLength ||
+        textHash != hashText(documents, nullptr)) {
+        clear();
+        throw std::runtime_error("Substring index does not match the loaded catalog: " + path);
+    }
+
+    in.read(reinterpret_cast<char*>(symbolStarts), sizeof(symbolStarts));
+    documentStarts.resize(static_cast<size_t>(documentCount));
+    in.read(reinterpret_cast<char*>(documentStarts.data()), documentStarts.size() * sizeof(uint32_t));
+    readPod(in, sampleCount);
+    // Everything a query indexes with is checked against the text length
+    // before it is trusted: documents start at 0 and ascend, the C array
+    // ascends to the text length, and samples are positions in the text
+    bool valid = static_cast<bool>(in) && sampleRate > 0 && symbolStarts[0] == 0 &&
+                 symbolStarts[256] == textLength && sampleCount <= textLength / sampleRate + 1 &&
+                 (documentStarts.empty() || documentStarts[0] == 0);
+    for (size_t d = 0; valid && d < documentStarts.size(); ++d) {
+        valid = documentStarts[d] < textLength && (d == 0 || documentStarts[d] > documentStarts[d - 1]);
+    }
+    for (int c = 0; valid && c < 256; ++c) valid = symbolStarts[c] <= symbolStarts[c + 1];
+    try {
+        if (valid) {
+            samples.resize(static_cast<size_t>(sampleCount));
+            in.read(reinterpret_cast<char*>(samples.data()), samples.size() * sizeof(uint32_t));
+            sampled.load(in);
+            bwt.load(in);
+            valid = static_cast<bool>(in) && sampled.size() == textLength && bwt.size() == textLength &&
+                    sampled.rank1(sampled.size()) == samples.size();
+        }
+        for (size_t i = 0; valid && i < samples.size(); ++i) {
+            valid = samples[i] < textLength && samples[i] % sampleRate == 0;
+        }
+        // Each byte's BWT rows are exactly as many as it occurs, so LF
+        // steps stay inside the text
+        for (int c = 0; valid && c < 256; ++c) {
+            valid = symbolStarts[c + 1] - symbolStarts[c] == bwt.rank(static_cast<uint8_t>(c), bwt.size());
+        }
+    } catch (const std::runtime_error&) {
+        valid = false;
+    }
+    if (!valid) {
+        clear();
+        throw std::runtime_error("Corrupt substring index: " + path);
+    }
+}
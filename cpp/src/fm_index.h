@@ -0,0 +1,68 @@
+#ifndef FM_INDEX_H
+#define FM_INDEX_H
+
+#include "succinct.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Compressed substring index (FM-index) over a pool of documents, e.g. all
+// lyrics. The documents are concatenated with separators, ASCII-lowercased,
+// and stored only as the Burrows-Wheeler transform in a Huffman-shaped
+// wavelet tree plus every sampleRate-th suffix array entry, which together
+// take less memory than the text itself.
+//
+// count() costs O(pattern length) rank steps whatever the catalog size;
+// locate() adds up to sampleRate LF steps per occurrence. Patterns match
+// any byte sequence within one document, with no tokenization.
+class FmIndex {
+public:
+    struct Params {
+        unsigned threads;    // suffix array threads, 0 = hardware concurrency
+        uint32_t sampleRate; // suffix array sampling; larger = smaller, slower locate
+
+        Params() : threads(0), sampleRate(32) {}
+    };
+
+    struct Occurrence {
+        uint32_t document;
+        uint32_t offset; // byte offset within the document
+    };
+
+    FmIndex();
+
+    void build(const std::vector<const std::string*>& documents, const Params& params = Params());
+    void clear();
+    bool empty() const { return textLength == 0; }
+
+    // Occurrences of pattern (ASCII case-insensitive)
+    size_t count(const std::string& pattern) const;
+
+    // Up to limit occurrences, in no particular order
+    std::vector<Occurrence> locate(const std::string& pattern, size_t limit = SIZE_MAX) const;
+
+    // Persist / restore; load checks the index against the same documents
+    void save(const std::string& path) const;
+    void load(const std::string& path, const std::vector<const std::string*>& documents);
+
+    size_t documentCount() const { return documentStarts.size(); }
+    size_t textBytes() const { return static_cast<size_t>(textLength); }
+    size_t memoryBytes() const;
+
+private:
+    WaveletTree bwt;
+    uint64_t symbolStarts[257];           // first BWT row of each byte (C array)
+    RankBitVector sampled;                // rows whose suffix position is kept
+    std::vector<uint32_t> samples;        // those positions, in row order
+    std::vector<uint32_t> documentStarts; // text offset of each document
+    uint32_t sampleRate;
+    uint64_t textLength;
+    uint64_t textHash;
+
+    // BWT rows [begin, end) of suffixes starting with pattern
+    bool range(const std::string& pattern, size_t& begin, size_t& end) const;
+    uint32_t suffixPosition(size_t row) const;
+};
+
+#endif // FM_INDEX_H
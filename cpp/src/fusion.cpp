@@ -0,0 +1,52 @@
+#include "fusion.h"
+#include <algorithm>
+#include <unordered_map>
+
+std::vector<ScoredCandidate> fuseRankings(const std::vector<std::vector<ScoredCandidate>>& lists,
+                                          FusionMethod method, size_t k,
+                                          const std::vector<double>& weights, double rrfK) {
+    std::unordered_map<uint32_t, double> fused;
+    size_t total = 0;
+    for (const auto& list : lists) total += list.size();
+    fused.reserve(total);
+
+    for (size_t l = 0; l < lists.size(); ++l) {
+        const auto& list = lists[l];
+        if (list.empty()) continue;
+        double weight = l < weights.size() ? weights[l] : 1.0;
+
+        if (method == FusionMethod::ReciprocalRank) {
+            for (size_t rank = 0; rank < list.size(); ++rank) {
+                fused[list[rank].id] += weight / (rrfK + static_cast<double>(rank + 1));
+            }
+            continue;
+        }
+
+        // Scores from different retrievers live on different scales
+        double best = list.front().score;
+        double worst = list.front().score;
+        for (const auto& candidate : list) {
+            best = std::max(best, candidate.score);
+            worst = std::min(worst, candidate.score);
+        }
+        double range = best - worst;
+        for (const auto& candidate : list) {
+            double normalised = range > 0.0 ? (candidate.score - worst) / range : 1.0;
+            fused[candidate.id] += weight * normalised;
+        }
+    }
+
+    std::vector<ScoredCandidate> results;
+    results.reserve(fused.size());
+    for (const auto& entry : fused) results.push_back(ScoredCandidate{entry.first, entry.second});
+
+    // Ties go to the lower ordinal so output is deterministic
+    auto better = [](const ScoredCandidate& a, const ScoredCandidate& b) {
+        if (a.score != b.score) return a.score > b.score;
+        return a.id < b.id;
+    };
+    size_t top = std::min(k, results.size());
+    std::partial_sort(results.begin(), results.begin() + top, results.end(), better);
+    results.resize(top);
+    return results;
+}
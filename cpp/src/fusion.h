@@ -0,0 +1,27 @@
+#ifndef FUSION_H
+#define FUSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A retrieved song ordinal with its retriever score (higher is better)
+struct ScoredCandidate {
+    uint32_t id;
+    double score;
+};
+
+// How candidate lists from several retrievers are merged
+enum class FusionMethod {
+    ReciprocalRank, // sum of weight / (rrfK + rank), rank starting at 1
+    WeightedScore   // sum of weight * min-max normalised score
+};
+
+// Merge ranked lists (each sorted best first) into the top k candidates.
+// weights may be empty (all 1.0) or hold one weight per list.
+std::vector<ScoredCandidate> fuseRankings(const std::vector<std::vector<ScoredCandidate>>& lists,
+                                          FusionMethod method, size_t k,
+                                          const std::vector<double>& weights = std::vector<double>(),
+                                          double rrfK = 60.0);
+
+#endif // FUSION_H
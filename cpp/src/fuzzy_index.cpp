@@ -0,0 +1,238 @@
+#include "fuzzy_index.h"
+#include <algorithm>
+#include <cctype>
+#include <utility>
+
+namespace {
+
+const uint64_t FNV_OFFSET = 1469598103934665603ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+const uint32_t EMPTY_SLOT = UINT32_MAX;
+
+// FNV-1a of text[0..length) without the bytes at skipA and skipB, folded
+// to 32 bits
+uint32_t hashWithout(const char* text, size_t length, size_t skipA, size_t skipB) {
+    uint64_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < length; ++i) {
+        if (i == skipA || i == skipB) continue;
+        hash ^= static_cast<unsigned char>(text[i]);
+        hash *= FNV_PRIME;
+    }
+    // Mix in the length so that deletions of different sizes never collide
+    // by construction
+    hash ^= length - (skipA < length) - (skipB < length);
+    hash *= FNV_PRIME;
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+// Hashes of every string made by deleting up to maxDistance bytes from the
+// prefix of value, deduplicated
+void deletionHashes(const std::string& value, unsigned maxDistance, std::vector<uint32_t>& out) {
+    out.clear();
+    size_t length = std::min(value.size(), FuzzyIndex::PREFIX_LENGTH);
+    const char* text = value.data();
+    const size_t none = SIZE_MAX;
+
+    out.push_back(hashWithout(text, length, none, none));
+    if (maxDistance >= 1) {
+        for (size_t i = 0; i < length; ++i) out.push_back(hashWithout(text, length, i, none));
+    }
+    if (maxDistance >= 2) {
+        for (size_t i = 0; i < length; ++i) {
+            for (size_t j = i + 1; j < length; ++j) out.push_back(hashWithout(text, length, i, j));
+        }
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+inline uint32_t slotFor(uint32_t hash, uint32_t mask) {
+    return (hash * 0x9e3779b1u) & mask;
+}
+
+} // namespace
+
+unsigned editDistance(const std::string& a, const std::string& b, unsigned limit) {
+    size_t n = a.size();
+    size_t m = b.size();
+    size_t gap = n > m ? n - m : m - n;
+    if (gap > limit) return limit + 1;
+    if (n == 0 || m == 0) return static_cast<unsigned>(n + m);
+
+    // Three rolling rows of the dynamic programme: i - 2, i - 1 and i.
+    // Catalog values are short, so they usually fit on the stack.
+    const size_t STACK_COLUMNS = 128;
+    unsigned stackRows[3 * STACK_COLUMNS];
+    std::vector<unsigned> heapRows;
+    unsigned* before = stackRows;
+    if (m + 1 > STACK_COLUMNS) {
+        heapRows.resize(3 * (m + 1));
+        before = heapRows.data();
+    }
+    unsigned* previous = before + (m + 1);
+    unsigned* current = previous + (m + 1);
+    for (size_t j = 0; j <= m; ++j) previous[j] = static_cast<unsigned>(j);
+
+    // Only cells within limit of the diagonal can stay within limit; the
+    // cell just outside the band on each side holds limit + 1
+    const unsigned over = limit + 1;
+    for (size_t i = 1; i <= n; ++i) {
+        size_t low = i > limit ? i - limit : 1;
+        size_t high = std::min(m, i + limit);
+        current[low - 1] = low == 1 ? static_cast<unsigned>(i) : over;
+        unsigned rowMin = over;
+        for (size_t j = low; j <= high; ++j) {
+            unsigned cost = a[i - 1] == b[j - 1] ? 0 : 1;
+            unsigned best = std::min(std::min(previous[j] + 1, current[j - 1] + 1),
+                                     previous[j - 1] + cost);
+            if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1]) {
+                best = std::min(best, before[j - 2] + 1);
+            }
+            current[j] = std::min(best, over);
+            rowMin = std::min(rowMin, current[j]);
+        }
+        if (high < m) current[high + 1] = over;
+        if (rowMin > limit) return over;
+        std::swap(before, previous);
+        std::swap(previous, current);
+    }
+    return std::min(previous[m], limit + 1);
+}
+
+std::string FuzzyIndex::normalize(const std::string& value) {
+    std::string normalized;
+    normalized.reserve(value.size());
+    bool pendingSpace = false;
+    for (char c : value) {
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            pendingSpace = !normalized.empty();
+            continue;
+        }
+        if (pendingSpace) {
+            normalized += ' ';
+            pendingSpace = false;
+        }
+        normalized += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return normalized;
+}
+
+void FuzzyIndex::build(const std::vector<const std::string*>& values) {
+    clear();
+
+    // Intern the normalized values
+    std::vector<uint32_t> itemTerms(values.size());
+    for (size_t item = 0; item < values.size(); ++item) {
+        std::string normalized = normalize(*values[item]);
+        auto inserted = termIds.emplace(normalized, static_cast<uint32_t>(terms.size()));
+        if (inserted.second) terms.push_back(normalized);
+        itemTerms[item] = inserted.first->second;
+    }
+
+    itemStarts.assign(terms.size() + 1, 0);
+    for (uint32_t term : itemTerms) itemStarts[term + 1]++;
+    for (size_t t = 0; t < terms.size(); ++t) itemStarts[t + 1] += itemStarts[t];
+    itemIds.resize(values.size());
+    std::vector<uint32_t> fill(itemStarts.begin(), itemStarts.end() - 1);
+    for (size_t item = 0; item < values.size(); ++item) {
+        itemIds[fill[itemTerms[item]]++] = static_cast<uint32_t>(item);
+    }
+
+    // Deletion dictionary, grouped by hash
+    std::vector<std::pair<uint32_t, uint32_t>> entries;
+    std::vector<uint32_t> hashes;
+    for (size_t t = 0; t < terms.size(); ++t) {
+        deletionHashes(terms[t], MAX_DISTANCE, hashes);
+        for (uint32_t hash : hashes) entries.emplace_back(hash, static_cast<uint32_t>(t));
+    }
+    std::sort(entries.begin(), entries.end());
+
+    groupTerms.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (i == 0 || entries[i].first != entries[i - 1].first) {
+            groupHashes.push_back(entries[i].first);
+            groupStarts.push_back(static_cast<uint32_t>(i));
+        }
+        groupTerms.push_back(entries[i].second);
+    }
+    groupStarts.push_back(static_cast<uint32_t>(entries.size()));
+
+    // At most 3/4 full
+    size_t capacity = 16;
+    while (capacity * 3 < groupHashes.size() * 4) capacity *= 2;
+    slots.assign(capacity, EMPTY_SLOT);
+    mask = static_cast<uint32_t>(capacity - 1);
+    for (size_t g = 0; g < groupHashes.size(); ++g) {
+        uint32_t slot = slotFor(groupHashes[g], mask);
+        while (slots[slot] != EMPTY_SLOT) slot = (slot + 1) & mask;
+        slots[slot] = static_cast<uint32_t>(g);
+    }
+}
+
+void FuzzyIndex::clear() {
+    terms.clear();
+    termIds.clear();
+    itemStarts.assign(1, 0);
+    itemIds.clear();
+    groupHashes.clear();
+    groupStarts.clear();
+    groupTerms.clear();
+    slots.clear();
+    mask = 0;
+}
+
+int FuzzyIndex::find(const std::string& query) const {
+    auto it = termIds.find(normalize(query));
+    return it == termIds.end() ? -1 : static_cast<int>(it->second);
+}
+
+int FuzzyIndex::findGroup(uint32_t hash) const {
+    if (slots.empty()) return -1;
+    for (uint32_t slot = slotFor(hash, mask);; slot = (slot + 1) & mask) {
+        uint32_t group = slots[slot];
+        if (group == EMPTY_SLOT) return -1;
+        if (groupHashes[group] == hash) return static_cast<int>(group);
+    }
+}
+
+std::vector<FuzzyIndex::Match> FuzzyIndex::lookup(const std::string& query, unsigned maxDistance,
+                                                  size_t limit) const {
+    std::vector<Match> matches;
+    maxDistance = std::min(maxDistance, MAX_DISTANCE);
+    std::string normalized = normalize(query);
+
+    std::vector<uint32_t> hashes;
+    deletionHashes(normalized, maxDistance, hashes);
+    std::vector<uint32_t> candidates;
+    for (uint32_t hash : hashes) {
+        int group = findGroup(hash);
+        if (group < 0) continue;
+        candidates.insert(candidates.end(), groupTerms.begin() + groupStarts[group],
+                          groupTerms.begin() + groupStarts[group + 1]);
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    for (uint32_t term : candidates) {
+        unsigned distance = editDistance(normalized, terms[term], maxDistance);
+        if (distance <= maxDistance) matches.push_back(Match{term, distance});
+    }
+
+    std::sort(matches.begin(), matches.end(), [this](const Match& a, const Match& b) {
+        if (a.distance != b.distance) return a.distance < b.distance;
+        uint32_t itemsA = itemStarts[a.term + 1] - itemStarts[a.term];
+        uint32_t itemsB = itemStarts[b.term + 1] - itemStarts[b.term];
+        if (itemsA != itemsB) return itemsA > itemsB;
+        return a.term < b.term;
+    });
+    if (matches.size() > limit) matches.resize(limit);
+    return matches;
+}
+
+size_t FuzzyIndex::memoryBytes() const {
+    size_t bytes = sizeof(*this);
+    for (const auto& term : terms) bytes += term.capacity() * 2 + 48; // vector copy + map node
+    return bytes + itemStarts.capacity() * sizeof(uint32_t) + itemIds.capacity() * sizeof(uint32_t) +
+           groupHashes.capacity() * sizeof(uint32_t) + groupStarts.capacity() * sizeof(uint32_t) +
+           groupTerms.capacity() * sizeof(uint32_t) + slots.capacity() * sizeof(uint32_t);
+}
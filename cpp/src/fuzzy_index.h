@@ -0,0 +1,76 @@
+#ifndef FUZZY_INDEX_H
+#define FUZZY_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Optimal string alignment distance (insertions, deletions, substitutions
+// and swaps of adjacent bytes), or limit + 1 once it exceeds limit
+unsigned editDistance(const std::string& a, const std::string& b, unsigned limit);
+
+// Typo-tolerant lookup of short catalog values such as emotions, artists
+// and titles (SymSpell). Every distinct value is indexed under each string
+// obtained by deleting up to MAX_DISTANCE bytes from its first
+// PREFIX_LENGTH bytes; a query generates its own deletions the same way
+// and only the values they hit are verified with editDistance. Values and
+// queries are compared after normalize().
+class FuzzyIndex {
+public:
+    static constexpr unsigned MAX_DISTANCE = 2;
+    static constexpr size_t PREFIX_LENGTH = 7;
+
+    struct Match {
+        uint32_t term;
+        unsigned distance;
+    };
+
+    FuzzyIndex() : itemStarts(1, 0), mask(0) {}
+
+    // Index values[i] as item i; values equal after normalize() share a term
+    void build(const std::vector<const std::string*>& values);
+    void clear();
+
+    // Term equal to the normalized query, or -1
+    int find(const std::string& query) const;
+
+    // Up to limit terms within maxDistance (at most MAX_DISTANCE) of the
+    // query, closest first, then by number of items
+    std::vector<Match> lookup(const std::string& query, unsigned maxDistance = MAX_DISTANCE,
+                              size_t limit = 10) const;
+
+    const std::string& term(uint32_t id) const { return terms[id]; }
+    size_t termCount() const { return terms.size(); }
+
+    // Ascending items that have this term
+    const uint32_t* items(uint32_t id, size_t& count) const {
+        count = itemStarts[id + 1] - itemStarts[id];
+        return itemIds.data() + itemStarts[id];
+    }
+
+    size_t memoryBytes() const;
+
+    // ASCII-lowercase, trim and collapse runs of whitespace to one space
+    static std::string normalize(const std::string& value);
+
+private:
+    std::vector<std::string> terms;
+    std::unordered_map<std::string, uint32_t> termIds;
+    std::vector<uint32_t> itemStarts; // CSR: items of term t at itemIds[itemStarts[t]..]
+    std::vector<uint32_t> itemIds;
+
+    // Deletion dictionary: one group of term ids per distinct deletion
+    // hash, found through an open-addressed table of group numbers. Hash
+    // collisions only add candidates, which are verified anyway.
+    std::vector<uint32_t> groupHashes;
+    std::vector<uint32_t> groupStarts;
+    std::vector<uint32_t> groupTerms;
+    std::vector<uint32_t> slots;
+    uint32_t mask;
+
+    int findGroup(uint32_t hash) const;
+};
+
+#endif // FUZZY_INDEX_H
@@ -0,0 +1,485 @@
+#include "hnsw.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+const char HNSW_MAGIC[8] = {'E', 'P', 'H', 'N', 'S', 'W', '0', '2'};
+
+// Smallest uniform draw in level assignment, which bounds the top level
+const double MIN_LEVEL_DRAW = 1e-12;
+
+// Links per node beyond this are taken for corruption, not a real build
+const unsigned long long MAX_LINKS = 1 << 12;
+
+// Fingerprint of the float vectors, eight bytes per step, so a saved graph
+// is only used with the vectors it was built over
+uint64_t hashVectors(const EmbeddingStore& store) {
+    const uint64_t PRIME = 0x100000001b3ULL;
+    uint64_t hash = (0xcbf29ce484222325ULL ^ store.size()) * PRIME;
+    hash = (hash ^ store.dimension()) * PRIME;
+    if (store.empty()) return hash;
+    const char* bytes = reinterpret_cast<const char*>(store.row(0));
+    size_t length = store.size() * store.dimension() * sizeof(float);
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * PRIME;
+        hash ^= hash >> 29;
+    }
+    for (; i < length; ++i) hash = (hash ^ static_cast<unsigned char>(bytes[i])) * PRIME;
+    return hash;
+}
+
+// Per-thread visited marks, cleared in O(1) by bumping the epoch
+struct VisitedList {
+    std::vector<unsigned short> marks;
+    unsigned short epoch = 0;
+
+    void prepare(size_t n) {
+        if (marks.size() < n) {
+            marks.assign(n, 0);
+            epoch = 0;
+        }
+        if (++epoch == 0) {
+            std::fill(marks.begin(), marks.end(), 0);
+            epoch = 1;
+        }
+    }
+
+    bool visit(uint32_t id) {
+        if (marks[id] == epoch) return false;
+        marks[id] = epoch;
+        return true;
+    }
+};
+
+VisitedList& visitedList() {
+    thread_local VisitedList list;
+    return list;
+}
+
+// Reused per thread so steady-state searches do not reallocate the PQ table
+PreparedQuery& preparedQuery() {
+    thread_local PreparedQuery prepared;
+    return prepared;
+}
+
+template <typename T>
+void writePod(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void readPod(std::ifstream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+} // namespace
+
+HnswIndex::HnswIndex()
+    : store(nullptr), maxM(16), maxM0(32), efConstruction(200),
+      maxLevel(-1), entryPoint(NO_NODE), vectorHash(0) {}
+
+void HnswIndex::clear() {
+    store = nullptr;
+    vectorHash = 0;
+    maxLevel = -1;
+    entryPoint = NO_NODE;
+    levels.clear();
+    level0Links.clear();
+    upperLinks.clear();
+}
+
+uint32_t* HnswIndex::linksAt(uint32_t node, int level) {
+    if (level == 0) return &level0Links[static_cast<size_t>(node) * (maxM0 + 1)];
+    return &upperLinks[node][static_cast<size_t>(level - 1) * (maxM + 1)];
+}
+
+const uint32_t* HnswIndex::linksAt(uint32_t node, int level) const {
+    if (level == 0) return &level0Links[static_cast<size_t>(node) * (maxM0 + 1)];
+    return &upperLinks[node][static_cast<size_t>(level - 1) * (maxM + 1)];
+}
+
+void HnswIndex::copyLinks(uint32_t node, int level, std::vector<uint32_t>& out) const {
+    std::unique_lock<std::mutex> lock;
+    if (linkLocks) lock = std::unique_lock<std::mutex>(linkLocks[node]);
+
+    const uint32_t* links = linksAt(node, level);
+    out.assign(links + 1, links + 1 + links[0]);
+}
+
+float HnswIndex::nodeDistance(uint32_t a, uint32_t b) const {
+    return l2Squared(store->row(a), store->row(b), store->dimension());
+}
+
+void HnswIndex::attach(const EmbeddingStore& source) {
+    if (source.size() != levels.size()) {
+        throw std::runtime_error("HNSW index does not match the embedding store");
+    }
+    store = &source;
+}
+
+void HnswIndex::allocateLinks() {
+    size_t n = levels.size();
+    level0Links.assign(n * (maxM0 + 1), 0);
+    upperLinks.assign(n, std::vector<uint32_t>());
+    for (size_t i = 0; i < n; ++i) {
+        if (levels[i] > 0) {
+            upperLinks[i].assign(static_cast<size_t>(levels[i]) * (maxM + 1), 0);
+        }
+    }
+}
+
+std::vector<HnswIndex::Candidate> HnswIndex::searchLayer(const PreparedQuery& query, uint32_t entry,
+                                                         size_t ef, int level,
+                                                         const Filter* accept) const {
+    VisitedList& visited = visitedList();
+    visited.prepare(levels.size());
+
+    // candidates: min-heap on distance; results: max-heap holding the best ef
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+    std::priority_queue<Candidate> results;
+
+    float entryDist = store->distance(query, entry);
+    visited.visit(entry);
+    candidates.push(Candidate{entryDist, entry});
+    if (accept == nullptr || (*accept)(entry)) {
+        results.push(Candidate{entryDist, entry});
+    }
+
+    std::vector<uint32_t> neighbors;
+    while (!candidates.empty()) {
+        Candidate current = candidates.top();
+        if (results.size() >= ef && current.distance > results.top().distance) break;
+        candidates.pop();
+
+        copyLinks(current.id, level, neighbors);
+        for (uint32_t neighbor : neighbors) {
+            if (!visited.visit(neighbor)) continue;
+
+            float d = store->distance(query, neighbor);
+            if (results.size() < ef || d < results.top().distance) {
+                candidates.push(Candidate{d, neighbor});
+                if (accept == nullptr || (*accept)(neighbor)) {
+                    results.push(Candidate{d, neighbor});
+                    if (results.size() > ef) results.pop();
+                }
+            }
+        }
+    }
+
+    std::vector<Candidate> out;
+    out.reserve(results.size());
+    while (!results.empty()) {
+        out.push_back(results.top());
+        results.pop();
+    }
+    return out;
+}
+
+uint32_t HnswIndex::greedyDescend(const PreparedQuery& query, uint32_t entry, int fromLevel,
+                                  int toLevel) const {
+    uint32_t current = entry;
+    float currentDist = store->distance(query, current);
+    std::vector<uint32_t> neighbors;
+
+    for (int level = fromLevel; level > toLevel; --level) {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            copyLinks(current, level, neighbors);
+            for (uint32_t neighbor : neighbors) {
+                float d = store->distance(query, neighbor);
+                if (d < currentDist) {
+                    currentDist = d;
+                    current = neighbor;
+                    changed = true;
+                }
+            }
+        }
+    }
+    return current;
+}
+
+void HnswIndex::selectNeighbors(std::vector<Candidate>& candidates, size_t count) const {
+    std::sort(candidates.begin(), candidates.end());
+    if (candidates.size() <= count) return;
+
+    // Keep a candidate only if it is closer to the base than to every
+    // neighbour already kept; this preserves links across clusters.
+    std::vector<Candidate> selected;
+    selected.reserve(count);
+    for (const Candidate& candidate : candidates) {
+        if (selected.size() >= count) break;
+        bool keep = true;
+        for (const Candidate& chosen : selected) {
+            if (nodeDistance(candidate.id, chosen.id) < candidate.distance) {
+                keep = false;
+                break;
+            }
+        }
+        if (keep) selected.push_back(candidate);
+    }
+    candidates.swap(selected);
+}
+
+void HnswIndex::insert(uint32_t node) {
+    int nodeLevel = levels[node];
+    PreparedQuery& query = preparedQuery();
+    store->prepare(store->row(node), query);
+
+    std::unique_lock<std::mutex> entryLock(entryMutex);
+    int topLevel = maxLevel;
+    uint32_t entry = entryPoint;
+    if (nodeLevel <= topLevel) entryLock.unlock();
+
+    if (entry == NO_NODE) {
+        entryPoint = node;
+        maxLevel = nodeLevel;
+        return;
+    }
+
+    entry = greedyDescend(query, entry, topLevel, nodeLevel);
+
+    for (int level = std::min(nodeLevel, topLevel); level >= 0; --level) {
+        std::vector<Candidate> found = searchLayer(query, entry, efConstruction, level, nullptr);
+        if (found.empty()) continue;
+
+        selectNeighbors(found, maxM);
+        entry = found.front().id;
+
+        {
+            std::lock_guard<std::mutex> lock(linkLocks[node]);
+            uint32_t* links = linksAt(node, level);
+            links[0] = static_cast<uint32_t>(found.size());
+            for (size_t i = 0; i < found.size(); ++i) links[i + 1] = found[i].id;
+        }
+
+        size_t capacity = level == 0 ? maxM0 : maxM;
+        for (const Candidate& neighbor : found) {
+            std::lock_guard<std::mutex> lock(linkLocks[neighbor.id]);
+            uint32_t* links = linksAt(neighbor.id, level);
+            if (links[0] < capacity) {
+                links[++links[0]] = node;
+                continue;
+            }
+
+            // Neighbour is full: re-select its links including the new node
+            std::vector<Candidate> pool;
+            pool.reserve(capacity + 1);
+            pool.push_back(Candidate{neighbor.distance, node});
+            for (uint32_t i = 1; i <= links[0]; ++i) {
+                pool.push_back(Candidate{nodeDistance(neighbor.id, links[i]), links[i]});
+            }
+            selectNeighbors(pool, capacity);
+            links[0] = static_cast<uint32_t>(pool.size());
+            for (size_t i = 0; i < pool.size(); ++i) links[i + 1] = pool[i].id;
+        }
+    }
+
+    if (nodeLevel > topLevel) {
+        entryPoint = node;
+        maxLevel = nodeLevel;
+    }
+}
+
+void HnswIndex::build(const EmbeddingStore& source, const Params& params) {
+    if (!source.empty() && (!source.hasFloat() || source.vectorEncoding() != VectorEncoding::Float32)) {
+        throw std::runtime_error("HNSW build needs unquantized float vectors");
+    }
+
+    store = &source;
+    vectorHash = hashVectors(source);
+    maxM = std::max<size_t>(2, params.M);
+    maxM0 = maxM * 2;
+    efConstruction = std::max(params.efConstruction, maxM);
+    maxLevel = -1;
+    entryPoint = NO_NODE;
+
+    size_t n = source.size();
+    levels.assign(n, 0);
+
+    std::mt19937_64 rng(params.seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    double levelScale = 1.0 / std::log(static_cast<double>(maxM));
+    for (size_t i = 0; i < n; ++i) {
+        double u = std::max(uniform(rng), MIN_LEVEL_DRAW);
+        levels[i] = static_cast<int>(-std::log(u) * levelScale);
+    }
+
+    allocateLinks();
+    if (n == 0) return;
+
+    linkLocks.reset(new std::mutex[n]);
+    insert(0);
+
+    unsigned threadCount = params.threads != 0 ? params.threads : std::thread::hardware_concurrency();
+    threadCount = std::max(1u, std::min<unsigned>(threadCount, static_cast<unsigned>(n)));
+
+    std::atomic<size_t> next(1);
+    auto worker = [&]() {
+        TRACE_SCOPE("hnsw/insert");
+        for (size_t i = next++; i < n; i = next++) {
+            insert(static_cast<uint32_t>(i));
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threadCount; ++t) workers.emplace_back(worker);
+    worker();
+    for (auto& t : workers) t.join();
+
+    linkLocks.reset();
+}
+
+std::vector<HnswIndex::Result> HnswIndex::search(const float* query, size_t k, size_t ef,
+                                                 const Filter& accept, size_t rerank) const {
+    std::vector<Result> results;
+    if (empty() || k == 0) return results;
+
+    bool exactRerank = rerank > k && store->hasFloat() &&
+                       store->vectorEncoding() != VectorEncoding::Float32;
+
+    PreparedQuery& prepared = preparedQuery();
+    store->prepare(query, prepared);
+
+    uint32_t entry = greedyDescend(prepared, entryPoint, maxLevel, 0);
+    const Filter* filter = accept ? &accept : nullptr;
+    size_t breadth = std::max(ef, exactRerank ? rerank : k);
+    std::vector<Candidate> found = searchLayer(prepared, entry, breadth, 0, filter);
+
+    std::sort(found.begin(), found.end());
+    if (exactRerank) {
+        // Approximate distances picked the shortlist; exact ones order it
+        for (Candidate& c : found) c.distance = store->distance(query, c.id);
+        std::sort(found.begin(), found.end());
+    }
+    if (found.size() > k) found.resize(k);
+
+    results.reserve(found.size());
+    for (const Candidate& c : found) results.push_back(Result{c.distance, c.id});
+    return results;
+}
+
+size_t HnswIndex::memoryBytes() const {
+    size_t bytes = levels.capacity() * sizeof(int) + level0Links.capacity() * sizeof(uint32_t);
+    bytes += upperLinks.capacity() * sizeof(std::vector<uint32_t>);
+    for (const auto& links : upperLinks) bytes += links.capacity() * sizeof(uint32_t);
+    return bytes;
+}
+
+void HnswIndex::save(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open()) {
+        throw std::runtime_error("Could not write HNSW index: " + path);
+    }
+
+    unsigned long long n = levels.size();
+    unsigned long long dim = store != nullptr ? store->dimension() : 0;
+    unsigned long long m = maxM;
+    unsigned long long ef = efConstruction;
+
+    out.write(HNSW_MAGIC, sizeof(HNSW_MAGIC));
+    writePod(out, n);
+    writePod(out, dim);
+    writePod(out, m);
+    writePod(out, ef);
+    writePod(out, maxLevel);
+    writePod(out, entryPoint);
+    writePod(out, vectorHash);
+    out.write(reinterpret_cast<const char*>(levels.data()), levels.size() * sizeof(int));
+    out.write(reinterpret_cast<const char*>(level0Links.data()),
+              level0Links.size() * sizeof(uint32_t));
+    for (const auto& links : upperLinks) {
+        out.write(reinterpret_cast<const char*>(links.data()), links.size() * sizeof(uint32_t));
+    }
+
+    if (!out) {
+        throw std::runtime_error("Failed writing HNSW index: " + path);
+    }
+}
+
+void HnswIndex::load(const std::string& path, const EmbeddingStore& source) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("Could not open HNSW index: " + path);
+    }
+
+    char magic[sizeof(HNSW_MAGIC)];
+    in.read(magic, sizeof(magic));
+    if (!in || std::memcmp(magic, HNSW_MAGIC, sizeof(magic)) != 0) {
+        throw std::runtime_error("Not an HNSW index file: " + path);
+    }
+
+    unsigned long long n = 0, dim = 0, m = 0, ef = 0;
+    readPod(in, n);
+    readPod(in, dim);
+    readPod(in, m);
+    readPod(in, ef);
+    readPod(in, maxLevel);
+    readPod(in, entryPoint);
+    uint64_t hash = 0;
+    readPod(in, hash);
+
+    if (!in || m < 2 || m > MAX_LINKS) {
+        clear();
+        throw std::runtime_error("Truncated or corrupt HNSW index: " + path);
+    }
+    if (!source.empty() && !source.hasFloat()) {
+        clear();
+        throw std::runtime_error("HNSW index can only be checked against float vectors; load it before quantizing");
+    }
+    if (n != source.size() || dim != source.dimension() || hash != hashVectors(source)) {
+        clear();
+        throw std::runtime_error("HNSW index was built over different vectors than the loaded catalog: " + path);
+    }
+
+    store = &source;
+    vectorHash = hash;
+    maxM = static_cast<size_t>(m);
+    maxM0 = maxM * 2;
+    efConstruction = static_cast<size_t>(ef);
+
+    // Levels size the link tables, so check them before allocating
+    levels.resize(static_cast<size_t>(n));
+    in.read(reinterpret_cast<char*>(levels.data()), levels.size() * sizeof(int));
+    int levelLimit = static_cast<int>(-std::log(MIN_LEVEL_DRAW) / std::log(static_cast<double>(maxM)));
+    bool levelsValid = static_cast<bool>(in) &&
+                       (n == 0 ? maxLevel == -1 : entryPoint < n && maxLevel == levels[entryPoint]);
+    for (size_t node = 0; levelsValid && node < levels.size(); ++node) {
+        levelsValid = levels[node] >= 0 && levels[node] <= std::min(levelLimit, maxLevel);
+    }
+    if (!levelsValid) {
+        clear();
+        throw std::runtime_error("Truncated or corrupt HNSW index: " + path);
+    }
+    allocateLinks();
+    in.read(reinterpret_cast<char*>(level0Links.data()), level0Links.size() * sizeof(uint32_t));
+    for (auto& links : upperLinks) {
+        in.read(reinterpret_cast<char*>(links.data()), links.size() * sizeof(uint32_t));
+    }
+
+    bool valid = static_cast<bool>(in);
+    for (size_t node = 0; valid && node < levels.size(); ++node) {
+        for (int level = 0; valid && level <= levels[node]; ++level) {
+            const uint32_t* links = linksAt(static_cast<uint32_t>(node), level);
+            valid = links[0] <= (level == 0 ? maxM0 : maxM);
+            for (uint32_t i = 1; valid && i <= links[0]; ++i) valid = links[i] < n;
+        }
+    }
+
+    if (!valid) {
+        clear();
+        throw std::runtime_error("Truncated or corrupt HNSW index: " + path);
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef HNSW_H
+#define HNSW_H
+
+#include "embedding.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Hierarchical Navigable Small World graph for approximate nearest
+// neighbour search over an EmbeddingStore. Node ids are song ordinals.
+class HnswIndex {
+public:
+    struct Params {
+        size_t M;                 // links per node on upper layers (2*M on layer 0)
+        size_t efConstruction;    // candidate list size while inserting
+        unsigned threads;         // build threads, 0 = hardware concurrency
+        unsigned long long seed;  // level assignment seed
+
+        Params() : M(16), efConstruction(200), threads(0), seed(42) {}
+    };
+
+    struct Result {
+        float distance;
+        uint32_t id;
+    };
+
+    // Return false to exclude a node from the results (it is still traversed)
+    typedef std::function<bool(uint32_t)> Filter;
+
+    HnswIndex();
+
+    // Build the graph over every vector in the store, inserting in parallel.
+    // Needs the store's float vectors, so build before quantizing.
+    void build(const EmbeddingStore& store, const Params& params = Params());
+
+    // k nearest neighbours of query, best first. ef trades recall for latency
+    // and is raised to k if smaller. Distances follow the store's encoding;
+    // with rerank > k on a quantized store that kept its float vectors, the
+    // best max(ef, rerank) candidates are re-scored exactly before the top k
+    // is cut.
+    std::vector<Result> search(const float* query, size_t k, size_t ef,
+                               const Filter& accept = Filter(), size_t rerank = 0) const;
+
+    // Persist the graph; the vectors themselves are not written
+    void save(const std::string& path) const;
+
+    // Load a graph written by save() and attach it to store. Throws if the
+    // file is unreadable or corrupt, or was built over other vectors (the
+    // file keeps a fingerprint of them); store must still hold its float
+    // vectors for that check.
+    void load(const std::string& path, const EmbeddingStore& store);
+
+    // Point the graph at another store holding the same vectors (e.g. a
+    // quantized copy). Throws if the row count differs.
+    void attach(const EmbeddingStore& store);
+
+    // Drop the graph and detach from its store
+    void clear();
+
+    size_t size() const { return levels.size(); }
+    bool empty() const { return levels.empty(); }
+    size_t memoryBytes() const;
+
+private:
+    static const uint32_t NO_NODE = 0xffffffffu;
+
+    const EmbeddingStore* store;
+    size_t maxM;
+    size_t maxM0;
+    size_t efConstruction;
+    int maxLevel;
+    uint32_t entryPoint;
+    uint64_t vectorHash; // hashVectors() of the store the graph was built over
+
+    std::vector<int> levels;                       // top layer of each node
+    std::vector<uint32_t> level0Links;             // [count, ids...] per node
+    std::vector<std::vector<uint32_t>> upperLinks; // layers 1..level per node
+
+    // Only present while building
+    std::unique_ptr<std::mutex[]> linkLocks;
+    std::mutex entryMutex;
+
+    uint32_t* linksAt(uint32_t node, int level);
+    const uint32_t* linksAt(uint32_t node, int level) const;
+    void copyLinks(uint32_t node, int level, std::vector<uint32_t>& out) const;
+
+    float nodeDistance(uint32_t a, uint32_t b) const;
+
+    struct Candidate {
+        float distance;
+        uint32_t id;
+        bool operator<(const Candidate& other) const { return distance < other.distance; }
+        bool operator>(const Candidate& other) const { return distance > other.distance; }
+    };
+
+    // Best-first search of one layer, returns up to ef results (unordered)
+    std::vector<Candidate> searchLayer(const PreparedQuery& query, uint32_t entry, size_t ef,
+                                       int level, const Filter* accept) const;
+    uint32_t greedyDescend(const PreparedQuery& query, uint32_t entry, int fromLevel,
+                           int toLevel) const;
+    void selectNeighbors(std::vector<Candidate>& candidates, size_t count) const;
+    void insert(uint32_t node);
+    void allocateLinks();
+};
+
+#endif // HNSW_H
@@ -0,0 +1,46 @@
+#include "id_index.h"
+
+namespace {
+
+// Ids looked up ahead of the current one in findMany
+const size_t PREFETCH_DISTANCE = 16;
+
+} // namespace
+
+void IdIndex::build(const std::vector<int>& ids) {
+    clear();
+    size_t capacity = 16;
+    shift = 60;
+    while (capacity < ids.size() * 2) {
+        capacity *= 2;
+        shift--;
+    }
+    slots.assign(capacity, Slot{0, -1});
+
+    for (size_t ordinal = 0; ordinal < ids.size(); ++ordinal) {
+        size_t slot = slotFor(ids[ordinal]);
+        while (slots[slot].ordinal >= 0 && slots[slot].id != ids[ordinal]) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        if (slots[slot].ordinal >= 0) continue; // duplicate id
+        slots[slot] = Slot{ids[ordinal], static_cast<int>(ordinal)};
+        count++;
+    }
+}
+
+void IdIndex::clear() {
+    slots.clear();
+    count = 0;
+    shift = 64;
+}
+
+void IdIndex::findMany(const int* ids, size_t idCount, int* ordinals) const {
+    for (size_t i = 0; i < idCount; ++i) {
+#if defined(__GNUC__) || defined(__clang__)
+        if (i + PREFETCH_DISTANCE < idCount && !slots.empty()) {
+            __builtin_prefetch(&slots[slotFor(ids[i + PREFETCH_DISTANCE])]);
+        }
+#endif
+        ordinals[i] = find(ids[i]);
+    }
+}
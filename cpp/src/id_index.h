@@ -0,0 +1,52 @@
+#ifndef ID_INDEX_H
+#define ID_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Primary-key index from song id to ordinal: an open-addressed hash table
+// of (id, ordinal) pairs, at most half full, probed linearly. A lookup is
+// usually one cache line; findMany() prefetches the slots of later ids so
+// that a batch overlaps its cache misses instead of paying them in turn.
+class IdIndex {
+public:
+    IdIndex() : count(0), shift(64) {}
+
+    // Index ids[ordinal]; when an id repeats, the first ordinal wins
+    void build(const std::vector<int>& ids);
+    void clear();
+
+    // Ordinal of id, or -1
+    int find(int id) const {
+        if (slots.empty()) return -1;
+        for (size_t slot = slotFor(id);; slot = (slot + 1) & (slots.size() - 1)) {
+            if (slots[slot].ordinal < 0) return -1;
+            if (slots[slot].id == id) return slots[slot].ordinal;
+        }
+    }
+
+    // ordinals[i] = find(ids[i]) for a whole batch
+    void findMany(const int* ids, size_t idCount, int* ordinals) const;
+
+    size_t size() const { return count; }
+    size_t memoryBytes() const { return slots.capacity() * sizeof(Slot); }
+
+private:
+    struct Slot {
+        int id;
+        int ordinal; // -1 marks an empty slot
+    };
+
+    std::vector<Slot> slots;
+    size_t count;
+    unsigned shift; // 64 - log2(slot count)
+
+    // Fibonacci hashing: the top bits of id * 2^64 / phi
+    size_t slotFor(int id) const {
+        return static_cast<size_t>((static_cast<uint64_t>(static_cast<uint32_t>(id)) *
+                                    0x9e3779b97f4a7c15ULL) >> shift);
+    }
+};
+
+#endif // ID_INDEX_H
@@ -1,17 +1,81 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 #include "playlist.h"
+#include "profile.h"
+#include "server.h"
+#include "trace.h"
+#include <csignal>
+#include <pthread.h>
+#include <thread>
 
 void printUsage(const char* programName) {
-    std::cout << "Usage: " << programName << " <songs_csv_path> <emotions>\n";
-    std::cout << "  emotions: comma-separated list (e.g., 'happy,excited')\n";
+    std::cout << "Usage: " << programName << " <songs_csv_path> <emotions> [options]\n";
+    std::cout << "  emotions: comma-separated list (e.g., 'happy,excited'), or '*' for all;\n";
+    std::cout << "            misspelled emotions are corrected and reported in did_you_mean\n";
+    std::cout << "\nOptions:\n";
+    std::cout << "  --text <query>        BM25 keyword search over titles and lyrics\n";
+    std::cout << "                        (plain words or text:\"...\"), limited to <emotions>;\n";
+    std::cout << "                        \"quoted phrases\" and 'a NEAR/3 b' match by position\n";
+    std::cout << "  --match <mode>        any (default) or all query words must appear\n";
+    std::cout << "  --query <expr>        boolean query over emotion:, artist:, title: and text:\n";
+    std::cout << "                        with AND, OR, NOT and parentheses, limited to <emotions>,\n";
+    std::cout << "                        e.g. '(happy OR excited) AND NOT artist:\"Melancholy Souls\"'\n";
+    std::cout << "  --explain <expr>      run a --query and print its plan with estimated and actual rows\n";
+    std::cout << "  --profile <bool>      true adds per-stage timings, rows and allocations to the output\n";
+    std::cout << "  --serve <port>        answer 'emotions=happy,sad&k=10' request lines over TCP\n";
+    std::cout << "                        (port 0 picks one; <emotions> is not used); GET /metrics\n";
+    std::cout << "                        on the same port serves Prometheus metrics; 'complete=gol&k=5'\n";
+    std::cout << "                        lines get autocomplete answers (see --complete-index)\n";
+    std::cout << "  --workers <n>         threads serving connections (default 4)\n";
+    std::cout << "  --query-log <path>    with --serve, record every request to <path> for replay_queries\n";
+    std::cout << "  --trace <path>        write spans of this run (on every thread) as Chrome trace JSON;\n";
+    std::cout << "                        with --serve, written when SIGINT or SIGTERM stops the server\n";
+    std::cout << "  --stats <scope>       bytes per catalog structure and per song as JSON: 'loaded'\n";
+    std::cout << "                        (after a plain load) or 'all' (after building every index;\n";
+    std::cout << "                        honours --embeddings and --quantize)\n";
+    std::cout << "  --regex <pattern>     songs whose title, artist or lyrics match <pattern>\n";
+    std::cout << "                        (prefix (?i) to ignore case), in catalog order\n";
+    std::cout << "  --substring <text>    songs whose lyrics contain <text> anywhere (partial words,\n";
+    std::cout << "                        any script), most occurrences first\n";
+    std::cout << "  --fm-index <path>     load the substring index from <path>; build and save it if missing\n";
+    std::cout << "  --artist <name>       songs by <name>; a misspelled name (up to 2 edits) is\n";
+    std::cout << "                        resolved to the closest artist and reported in did_you_mean\n";
+    std::cout << "  --more-from <id>      other songs by the artist of song <id>\n";
+    std::cout << "  --title <name>        songs titled <name>, typo-tolerant like --artist\n";
+    std::cout << "  --complete <prefix>   titles and artists starting with <prefix>, most songs first\n";
+    std::cout << "  --complete-index <path> map the autocomplete index from <path>; build and save it if missing\n";
+    std::cout << "  --ids <id,id,...>     the songs with these ids, in the given order\n";
+    std::cout << "  --similar <id>        songs closest to <id> by lyric embedding\n";
+    std::cout << "  --k <n>               number of ranked songs to return (default 10)\n";
+    std::cout << "  --ef <n>              HNSW search breadth, higher = better recall (default 64)\n";
+    std::cout << "  --index <path>        load the HNSW index from <path>; build and save it if missing\n";
+    std::cout << "  --embeddings <path>   per-song vectors as 'id,v1,...,vN' lines\n";
+    std::cout << "  --quantize <enc>      store vectors as float32 (default), int8 or pq\n";
+    std::cout << "  --rerank <n>          re-score the top <n> quantized candidates exactly\n";
+    std::cout << "  --hybrid <text>       keyword + embedding search fused into one ranking\n";
+    std::cout << "                        (with --similar, that song's vector replaces the text's)\n";
+    std::cout << "  --fusion <method>     rrf (reciprocal rank fusion, default) or weighted\n";
+    std::cout << "  --semantic-weight <w> weight of the embedding ranking, 0..1 (default 0.5)\n";
+    std::cout << "  --depth <n>           candidates per retriever before fusion (default 100)\n";
     std::cout << "\nExample:\n";
     std::cout << "  " << programName << " ../data/songs.csv happy,excited\n";
+    std::cout << "  " << programName << " ../data/songs.csv '*' --similar 1 --k 5\n";
+    std::cout << "  " << programName << " ../data/songs.csv happy --text 'text:\"golden rays\"'\n";
+    std::cout << "  " << programName << " ../data/songs.csv '*' --text '\"golden rays\"'\n";
+    std::cout << "  " << programName << " ../data/songs.csv '*' --regex '(?i)danc(e|ing) (through|under)'\n";
+    std::cout << "  " << programName << " ../data/songs.csv '*' --substring 'shine' --fm-index lyrics.fm\n";
+    std::cout << "  " << programName << " ../data/songs.csv hapy --artist 'club nigths'\n";
+    std::cout << "  " << programName << " ../data/songs.csv '*' --complete 'sun' --k 5 --complete-index names.idx\n";
+    std::cout << "  " << programName << " ../data/songs.csv happy --hybrid 'golden rays'\n";
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
+    if (argc < 3) {
         printUsage(argv[0]);
         return 1;
     }
@@ -19,44 +83,390 @@ int main(int argc, char* argv[]) {
     std::string csvPath = argv[1];
     std::string emotionsStr = argv[2];
 
+    bool textSearch = false;
+    std::string textQuery;
+    bool matchAll = false;
+    bool regexSearch = false;
+    std::string regexPattern;
+    bool substringSearch = false;
+    std::string substringText;
+    std::string fmIndexPath;
+    std::string artistName;
+    std::string titleName;
+    bool completePrefix = false;
+    std::string prefix;
+    std::string completeIndexPath;
+    std::vector<int> songIds;
+    int moreFrom = -1;
+    bool querySearch = false;
+    std::string queryText;
+    bool explain = false;
+    bool profiling = false;
+    int servePort = -1;
+    size_t workers = 4;
+    std::string tracePath;
+    std::string queryLogPath;
+    std::string statsScope;
+    int similarTo = -1;
+    size_t k = 10;
+    size_t ef = 64;
+    std::string indexPath;
+    std::string embeddingsPath;
+    VectorEncoding encoding = VectorEncoding::Float32;
+    size_t rerank = 0;
+    bool hybrid = false;
+    std::string hybridText;
+    HybridOptions hybridOptions;
+
+    for (int i = 3; i < argc; ++i) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        std::string value = argv[++i];
+
+        try {
+            if (option == "--text") {
+                textSearch = true;
+                textQuery = value;
+            } else if (option == "--match") {
+                if (value != "any" && value != "all") {
+                    throw std::invalid_argument(value);
+                }
+                matchAll = value == "all";
+            } else if (option == "--query") {
+                querySearch = true;
+                queryText = value;
+            } else if (option == "--explain") {
+                querySearch = true;
+                explain = true;
+                queryText = value;
+            } else if (option == "--profile") {
+                if (value != "true" && value != "false") {
+                    throw std::invalid_argument(value);
+                }
+                profiling = value == "true";
+            } else if (option == "--serve") {
+                servePort = std::stoi(value);
+            } else if (option == "--workers") {
+                workers = std::stoul(value);
+            } else if (option == "--query-log") {
+                queryLogPath = value;
+            } else if (option == "--stats") {
+                if (value != "loaded" && value != "all") {
+                    throw std::invalid_argument(value);
+                }
+                statsScope = value;
+            } else if (option == "--trace") {
+                tracePath = value;
+            } else if (option == "--regex") {
+                regexSearch = true;
+                regexPattern = value;
+            } else if (option == "--substring") {
+                substringSearch = true;
+                substringText = value;
+            } else if (option == "--fm-index") {
+                fmIndexPath = value;
+            } else if (option == "--artist") {
+                artistName = value;
+            } else if (option == "--more-from") {
+                moreFrom = std::stoi(value);
+            } else if (option == "--title") {
+                titleName = value;
+            } else if (option == "--complete") {
+                completePrefix = true;
+                prefix = value;
+            } else if (option == "--complete-index") {
+                completeIndexPath = value;
+            } else if (option == "--ids") {
+                size_t start = 0;
+                while (start <= value.size()) {
+                    size_t end = value.find(',', start);
+                    if (end == std::string::npos) end = value.size();
+                    songIds.push_back(std::stoi(value.substr(start, end - start)));
+                    start = end + 1;
+                }
+            } else if (option == "--similar") {
+                similarTo = std::stoi(value);
+            } else if (option == "--k") {
+                k = std::stoul(value);
+            } else if (option == "--ef") {
+                ef = std::stoul(value);
+            } else if (option == "--index") {
+                indexPath = value;
+            } else if (option == "--embeddings") {
+                embeddingsPath = value;
+            } else if (option == "--quantize") {
+                encoding = parseVectorEncoding(value);
+            } else if (option == "--rerank") {
+                rerank = std::stoul(value);
+            } else if (option == "--hybrid") {
+                hybrid = true;
+                hybridText = value;
+            } else if (option == "--fusion") {
+                if (value == "rrf") {
+                    hybridOptions.method = FusionMethod::ReciprocalRank;
+                } else if (value == "weighted") {
+                    hybridOptions.method = FusionMethod::WeightedScore;
+                } else {
+                    throw std::invalid_argument(value);
+                }
+            } else if (option == "--semantic-weight") {
+                size_t parsed = 0;
+                double weight = std::stod(value, &parsed);
+                // Written so that NaN is rejected too
+                if (parsed != value.size() || !(weight >= 0.0 && weight <= 1.0)) {
+                    throw std::invalid_argument(value);
+                }
+                hybridOptions.semanticWeight = weight;
+            } else if (option == "--depth") {
+                hybridOptions.depth = std::stoul(value);
+            } else {
+                std::cerr << "Error: Unknown option " << option << std::endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Error: Invalid value for " << option << ": " << value << std::endl;
+            return 1;
+        }
+    }
+
+    if (!tracePath.empty() && !tracingCompiled()) {
+        std::cerr << "Error: --trace needs a build with -DTRACING=ON" << std::endl;
+        return 1;
+    }
+
     try {
+        if (!tracePath.empty()) startTracing();
+        
+        // Stages of this run are recorded only with --profile true
+        QueryProfile profile;
+        ProfileSession session(profiling ? &profile : nullptr);
+        
         // Load songs from CSV
+        ProfileStage loadStage("load");
+        auto loadStart = std::chrono::steady_clock::now();
         EmotionPlaylist playlist(csvPath);
-        
-        // Parse emotions
+        auto loadNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - loadStart).count();
+        if (profiling) {
+            size_t loaded = 0;
+            for (SongNode* node = playlist.getAllSongs(); node != nullptr; node = node->next) loaded++;
+            loadStage.setRowsOut(loaded);
+        }
+        loadStage.stop();
+
+        // Reuse a persisted autocomplete index when one exists, otherwise build it
+        auto prepareCompletions = [&playlist, &completeIndexPath]() {
+            if (!completeIndexPath.empty() && std::ifstream(completeIndexPath).good()) {
+                playlist.loadCompletionIndex(completeIndexPath);
+            } else {
+                playlist.buildCompletionIndex();
+                if (!completeIndexPath.empty()) {
+                    playlist.saveCompletionIndex(completeIndexPath);
+                }
+            }
+        };
+
+        if (servePort >= 0) {
+            // SIGINT and SIGTERM stop the server cleanly; they are blocked
+            // before any thread starts and taken by a waiting thread
+            sigset_t signals;
+            sigemptyset(&signals);
+            sigaddset(&signals, SIGINT);
+            sigaddset(&signals, SIGTERM);
+            pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+            prepareCompletions();
+            std::unique_ptr<QueryLog> queryLog;
+            if (!queryLogPath.empty()) queryLog.reset(new QueryLog(queryLogPath));
+            PlaylistServer server(playlist, servePort, workers);
+            server.metrics().recordLoad(static_cast<uint64_t>(loadNanos));
+            server.logQueries(queryLog.get());
+            std::cerr << "Serving on port " << server.port() << std::endl;
+            std::thread waiter([&server, signals]() {
+                int received;
+                sigwait(&signals, &received);
+                server.stop();
+            });
+            server.run();
+            waiter.join();
+            if (queryLog && queryLog->dropped() > 0) {
+                std::cerr << "Warning: query log dropped " << queryLog->dropped() << " requests" << std::endl;
+            }
+            if (!tracePath.empty()) writeTrace(tracePath);
+            return 0;
+        }
+
+        if (!statsScope.empty()) {
+            if (statsScope == "all") {
+                if (!embeddingsPath.empty()) playlist.loadEmbeddings(embeddingsPath);
+                playlist.buildVectorIndex();
+                if (encoding != VectorEncoding::Float32) playlist.quantizeEmbeddings(encoding, rerank);
+                playlist.buildSubstringIndex();
+                playlist.buildCompletionIndex();
+            }
+            std::vector<MemoryUsage> usage = playlist.memoryUsage();
+            size_t songs = playlist.getSongCount();
+            size_t total = 0;
+            for (const MemoryUsage& part : usage) total += part.bytes;
+            auto perSong = [songs](size_t bytes) {
+                char number[32];
+                std::snprintf(number, sizeof(number), "%.1f", songs == 0 ? 0.0 : static_cast<double>(bytes) / songs);
+                return std::string(number);
+            };
+            std::cout << "{\"songs\": " << songs << ", \"bytes\": " << total
+                      << ", \"bytes_per_song\": " << perSong(total) << ", \"parts\": [";
+            for (size_t i = 0; i < usage.size(); ++i) {
+                std::cout << (i == 0 ? "" : ", ") << "{\"part\": \"" << usage[i].part << "\", \"bytes\": "
+                          << usage[i].bytes << ", \"bytes_per_song\": " << perSong(usage[i].bytes) << "}";
+            }
+            std::cout << "]}" << std::endl;
+            if (!tracePath.empty()) writeTrace(tracePath);
+            return 0;
+        }
+
+        // Parse emotions ('*' selects every emotion)
+        ProfileStage resolveStage("resolve");
         std::vector<std::string> emotions;
-        size_t start = 0;
-        size_t end = emotionsStr.find(',');
-        
-        while (end != std::string::npos) {
-            emotions.push_back(emotionsStr.substr(start, end - start));
-            start = end + 1;
-            end = emotionsStr.find(',', start);
+        if (emotionsStr != "*") {
+            size_t start = 0;
+            size_t end = emotionsStr.find(',');
+
+            while (end != std::string::npos) {
+                emotions.push_back(emotionsStr.substr(start, end - start));
+                start = end + 1;
+                end = emotionsStr.find(',', start);
+            }
+            emotions.push_back(emotionsStr.substr(start));
         }
-        emotions.push_back(emotionsStr.substr(start));
-        
+
         // Trim whitespace from emotions
         for (auto& emotion : emotions) {
             emotion.erase(0, emotion.find_first_not_of(" \t\n\r"));
             emotion.erase(emotion.find_last_not_of(" \t\n\r") + 1);
         }
-        
-        // Filter songs by emotions
-        SongNode* filteredSongs = playlist.filterByEmotions(emotions);
-        
-        // Output as JSON
-        std::cout << playlist.toJson(filteredSongs) << std::endl;
-        
-        // Clean up the filtered songs list (since it's a new list created by filterByEmotions)
+
+        if (completePrefix) {
+            prepareCompletions();
+            std::cout << playlist.toJson(playlist.complete(prefix, k)) << std::endl;
+            if (!tracePath.empty()) writeTrace(tracePath);
+            return 0;
+        }
+
+        // Resolve misspelled emotions up front so every search path uses
+        // (and the output reports) the same correction
+        std::vector<SpellingCorrection> corrections;
+        std::string plan; // --explain output
+        resolveStage.setRowsIn(emotions.size());
+        emotions = playlist.resolveEmotions(emotions, &corrections);
+        resolveStage.setRowsOut(emotions.size());
+        resolveStage.stop();
+
+        ProfileStage searchStage("search");
+        SongNode* filteredSongs = nullptr;
+        if (!songIds.empty()) {
+            // Hydrate by primary key; unknown ids are left out
+            SongNode* tail = nullptr;
+            for (const Song* song : playlist.getSongs(songIds)) {
+                if (song == nullptr) continue;
+                SongNode* node = new SongNode(*song);
+                if (filteredSongs == nullptr) {
+                    filteredSongs = node;
+                } else {
+                    tail->next = node;
+                }
+                tail = node;
+            }
+        } else if (querySearch) {
+            filteredSongs = playlist.searchQuery(queryText, emotions, k, &corrections,
+                                                 explain ? &plan : nullptr);
+        } else if (moreFrom >= 0) {
+            filteredSongs = playlist.moreFromArtist(moreFrom, emotions, k);
+        } else if (!artistName.empty()) {
+            filteredSongs = playlist.findByArtist(artistName, emotions, k, &corrections);
+        } else if (!titleName.empty()) {
+            filteredSongs = playlist.findByTitle(titleName, emotions, k, &corrections);
+        } else if (textSearch) {
+            filteredSongs = playlist.searchText(textQuery, emotions, k, matchAll);
+        } else if (regexSearch) {
+            filteredSongs = playlist.searchRegex(regexPattern, emotions, k);
+        } else if (substringSearch) {
+            // Reuse a persisted index when one exists, otherwise build it
+            if (!fmIndexPath.empty() && std::ifstream(fmIndexPath).good()) {
+                playlist.loadSubstringIndex(fmIndexPath);
+            } else {
+                playlist.buildSubstringIndex();
+                if (!fmIndexPath.empty()) {
+                    playlist.saveSubstringIndex(fmIndexPath);
+                }
+            }
+            filteredSongs = playlist.searchSubstring(substringText, emotions, k);
+        } else if (similarTo >= 0 || hybrid) {
+            if (!embeddingsPath.empty()) {
+                playlist.loadEmbeddings(embeddingsPath);
+            }
+
+            // Reuse a persisted index when one exists, otherwise build it
+            if (!indexPath.empty() && std::ifstream(indexPath).good()) {
+                playlist.loadVectorIndex(indexPath);
+            } else {
+                playlist.buildVectorIndex();
+                if (!indexPath.empty()) {
+                    playlist.saveVectorIndex(indexPath);
+                }
+            }
+
+            if (encoding != VectorEncoding::Float32) {
+                playlist.quantizeEmbeddings(encoding, rerank);
+            }
+
+            if (hybrid) {
+                hybridOptions.k = k;
+                hybridOptions.ef = ef;
+                hybridOptions.seedSongId = similarTo;
+                filteredSongs = playlist.hybridSearch(hybridText, emotions, hybridOptions);
+            } else {
+                filteredSongs = playlist.findSimilar(similarTo, k, ef, emotions);
+            }
+        } else {
+            // Filter songs by emotions
+            filteredSongs = playlist.filterByEmotions(emotions);
+        }
+        size_t resultCount = 0;
+        for (SongNode* node = filteredSongs; node != nullptr; node = node->next) {
+            resultCount++;
+        }
+        searchStage.setRowsOut(resultCount);
+        searchStage.stop();
+
+        // Output as JSON, or the query plan for --explain
+        if (explain) {
+            std::cout << plan;
+        } else {
+            ProfileStage serializeStage("serialize", resultCount);
+            std::string json = playlist.toJson(filteredSongs, corrections);
+            serializeStage.stop();
+            if (profiling) {
+                profile.bytesSerialized = json.size();
+                json.insert(json.size() - 1, ", \"profile\": " + profile.toJson());
+            }
+            std::cout << json << std::endl;
+        }
+
+        // Clean up the result list (a new list owned by the caller)
         SongNode* current = filteredSongs;
         while (current != nullptr) {
             SongNode* next = current->next;
             delete current;
             current = next;
         }
-        
+
+        if (!tracePath.empty()) writeTrace(tracePath);
         return 0;
-        
+
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;
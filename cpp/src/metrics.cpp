@@ -0,0 +1,166 @@
+#include "metrics.h"
+#include <cstdio>
+#include "playlist.h"
+#include "profile.h"
+
+namespace {
+
+// Upper bounds of the latency buckets, in nanoseconds
+const uint64_t BUCKET_NANOS[ServerMetrics::LATENCY_BUCKETS] = {
+    10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000,
+    5000000, 10000000, 25000000, 50000000, 100000000, 250000000, 500000000, 1000000000};
+
+const char* TYPE_NAMES[ServerMetrics::REQUEST_TYPE_COUNT] = {"playlist", "profiled", "completion", "error", "scrape"};
+
+std::atomic<size_t> nextShard(0);
+
+void header(std::string& out, const char* name, const char* type, const char* help) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+void sample(std::string& out, const std::string& name, const std::string& labels, const char* value) {
+    out += name;
+    if (!labels.empty()) out += "{" + labels + "}";
+    out += ' ';
+    out += value;
+    out += '\n';
+}
+
+void sample(std::string& out, const std::string& name, const std::string& labels, uint64_t value) {
+    sample(out, name, labels, std::to_string(value).c_str());
+}
+
+void sample(std::string& out, const std::string& name, const std::string& labels, double value) {
+    char number[32];
+    std::snprintf(number, sizeof(number), "%.9g", value);
+    sample(out, name, labels, number);
+}
+
+} // namespace
+
+ServerMetrics::ServerMetrics() : loadNanos(0), loads(0) {
+    for (Shard& shard : shards) {
+        for (size_t t = 0; t < REQUEST_TYPE_COUNT; ++t) {
+            shard.requests[t] = 0;
+            shard.latencyNanos[t] = 0;
+            for (auto& bucket : shard.latency[t]) bucket = 0;
+        }
+        shard.responseBytes = 0;
+        shard.connections = 0;
+        shard.allocations = 0;
+    }
+}
+
+ServerMetrics::Shard& ServerMetrics::local() {
+    // Threads take shards round robin on first use
+    thread_local size_t index = nextShard.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+    return shards[index];
+}
+
+void ServerMetrics::recordRequest(RequestType type, uint64_t nanos, size_t responseBytes) {
+    Shard& shard = local();
+    size_t bucket = 0;
+    while (bucket < LATENCY_BUCKETS && nanos > BUCKET_NANOS[bucket]) bucket++;
+    shard.requests[type].fetch_add(1, std::memory_order_relaxed);
+    shard.latencyNanos[type].fetch_add(nanos, std::memory_order_relaxed);
+    shard.latency[type][bucket].fetch_add(1, std::memory_order_relaxed);
+    shard.responseBytes.fetch_add(responseBytes, std::memory_order_relaxed);
+}
+
+void ServerMetrics::recordConnection() {
+    local().connections.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ServerMetrics::recordAllocations(uint64_t count) {
+    if (count != 0) local().allocations.fetch_add(count, std::memory_order_relaxed);
+}
+
+void ServerMetrics::recordLoad(uint64_t nanos) {
+    loadNanos.store(nanos, std::memory_order_relaxed);
+    loads.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string ServerMetrics::scrape(const EmotionPlaylist& playlist) const {
+    // Sum the shards; a scrape racing with requests may see some of them
+    // counted but not yet timed, which the next scrape evens out
+    uint64_t requests[REQUEST_TYPE_COUNT] = {};
+    uint64_t latencyNanos[REQUEST_TYPE_COUNT] = {};
+    uint64_t latency[REQUEST_TYPE_COUNT][LATENCY_BUCKETS + 1] = {};
+    uint64_t responseBytes = 0;
+    uint64_t connections = 0;
+    uint64_t allocations = 0;
+    for (const Shard& shard : shards) {
+        for (size_t t = 0; t < REQUEST_TYPE_COUNT; ++t) {
+            requests[t] += shard.requests[t].load(std::memory_order_relaxed);
+            latencyNanos[t] += shard.latencyNanos[t].load(std::memory_order_relaxed);
+            for (size_t b = 0; b <= LATENCY_BUCKETS; ++b) {
+                latency[t][b] += shard.latency[t][b].load(std::memory_order_relaxed);
+            }
+        }
+        responseBytes += shard.responseBytes.load(std::memory_order_relaxed);
+        connections += shard.connections.load(std::memory_order_relaxed);
+        allocations += shard.allocations.load(std::memory_order_relaxed);
+    }
+
+    std::string out;
+    header(out, "playlist_requests_total", "counter", "Requests answered, by type.");
+    for (size_t t = 0; t < REQUEST_TYPE_COUNT; ++t) {
+        sample(out, "playlist_requests_total", std::string("type=\"") + TYPE_NAMES[t] + "\"",
+               requests[t]);
+    }
+
+    header(out, "playlist_request_duration_seconds", "histogram", "Time to answer a request, by type.");
+    for (size_t t = 0; t < REQUEST_TYPE_COUNT; ++t) {
+        std::string type = std::string("type=\"") + TYPE_NAMES[t] + "\"";
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b <= LATENCY_BUCKETS; ++b) {
+            cumulative += latency[t][b];
+            char bound[32];
+            if (b < LATENCY_BUCKETS) {
+                std::snprintf(bound, sizeof(bound), "%g", BUCKET_NANOS[b] / 1e9);
+            } else {
+                std::snprintf(bound, sizeof(bound), "+Inf");
+            }
+            sample(out, "playlist_request_duration_seconds_bucket", type + ",le=\"" + bound + "\"",
+                   cumulative);
+        }
+        sample(out, "playlist_request_duration_seconds_sum", type, latencyNanos[t] / 1e9);
+        sample(out, "playlist_request_duration_seconds_count", type, requests[t]);
+    }
+
+    header(out, "playlist_response_bytes_total", "counter", "Bytes of responses sent.");
+    sample(out, "playlist_response_bytes_total", "", responseBytes);
+    header(out, "playlist_connections_total", "counter", "Connections accepted.");
+    sample(out, "playlist_connections_total", "", connections);
+    if (countingAllocations()) {
+        header(out, "playlist_serve_allocations_total", "counter",
+               "Heap allocations made by workers serving requests.");
+        sample(out, "playlist_serve_allocations_total", "", allocations);
+    }
+
+    header(out, "playlist_catalog_songs", "gauge", "Songs in the loaded catalog.");
+    sample(out, "playlist_catalog_songs", "", static_cast<uint64_t>(playlist.getSongCount()));
+    header(out, "playlist_catalog_emotions", "gauge", "Emotions in the loaded catalog.");
+    sample(out, "playlist_catalog_emotions", "", static_cast<uint64_t>(playlist.getAvailableEmotions().size()));
+    header(out, "playlist_catalog_parse_warnings", "gauge", "CSV records skipped by the last load.");
+    sample(out, "playlist_catalog_parse_warnings", "", static_cast<uint64_t>(playlist.getParseWarnings()));
+    header(out, "playlist_catalog_loads_total", "counter", "Catalog loads.");
+    sample(out, "playlist_catalog_loads_total", "", loads.load(std::memory_order_relaxed));
+    header(out, "playlist_catalog_load_seconds", "gauge", "Duration of the last catalog load.");
+    sample(out, "playlist_catalog_load_seconds", "", loadNanos.load(std::memory_order_relaxed) / 1e9);
+
+    header(out, "playlist_memory_bytes", "gauge", "Bytes held by each part of the catalog.");
+    for (const MemoryUsage& usage : playlist.memoryUsage()) {
+        sample(out, "playlist_memory_bytes", std::string("part=\"") + usage.part + "\"",
+               static_cast<uint64_t>(usage.bytes));
+    }
+    return out;
+}
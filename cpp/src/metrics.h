@@ -0,0 +1,56 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class EmotionPlaylist;
+
+// Live counters and latency histograms of the daemon, exposed in the
+// Prometheus text format. Recording is lock-free: each thread adds into
+// its own shard (relaxed atomics on separate cache lines, shared only when
+// there are more threads than shards) and a scrape sums the shards.
+class ServerMetrics {
+public:
+    enum RequestType { Playlist, Profiled, Completion, Error, Scrape, REQUEST_TYPE_COUNT };
+
+    ServerMetrics();
+
+    ServerMetrics(const ServerMetrics&) = delete;
+    ServerMetrics& operator=(const ServerMetrics&) = delete;
+
+    void recordRequest(RequestType type, uint64_t nanos, size_t responseBytes);
+    void recordConnection();
+    // Heap allocations a worker made while serving a connection's turn;
+    // shown only with COUNT_ALLOCATIONS, and 0 once workers are warm
+    void recordAllocations(uint64_t count);
+
+    // Catalog (re)load time, shown until the next load
+    void recordLoad(uint64_t nanos);
+
+    // Counters, histograms and the playlist's catalog gauges
+    std::string scrape(const EmotionPlaylist& playlist) const;
+
+    static constexpr size_t SHARDS = 16;
+    static constexpr size_t LATENCY_BUCKETS = 16; // plus +Inf
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> requests[REQUEST_TYPE_COUNT];
+        std::atomic<uint64_t> latencyNanos[REQUEST_TYPE_COUNT];
+        std::atomic<uint64_t> latency[REQUEST_TYPE_COUNT][LATENCY_BUCKETS + 1];
+        std::atomic<uint64_t> responseBytes;
+        std::atomic<uint64_t> connections;
+        std::atomic<uint64_t> allocations;
+    };
+
+    Shard shards[SHARDS];
+    std::atomic<uint64_t> loadNanos;
+    std::atomic<uint64_t> loads;
+
+    Shard& local(); // the calling thread's shard
+};
+
+#endif // METRICS_H
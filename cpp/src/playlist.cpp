@@ -1,12 +1,92 @@
 #include "playlist.h"
+#include "profile.h"
+#include "regex_matcher.h"
+#include "substring_search.h"
+#include "tokenizer.h"
+#include "trace.h"
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
 #include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <future>
 #include <iostream>
-#include <regex>
+#include <memory>
+#include <unordered_set>
+#include <thread>
 
-EmotionPlaylist::EmotionPlaylist(const std::string& csvPath) : songHead(nullptr), emotionHead(nullptr) {
+namespace {
+
+// Dimension of vectors derived from lyrics when none are supplied
+const size_t DEFAULT_EMBEDDING_DIM = 128;
+
+// Running hash of catalog records: eight bytes per step, order-sensitive
+uint64_t hashRecord(uint64_t hash, const std::string& record) {
+    const uint64_t PRIME = 0x100000001b3ULL;
+    hash = (hash ^ record.size()) * PRIME;
+    size_t i = 0;
+    for (; i + 8 <= record.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, record.data() + i, sizeof(word));
+        hash = (hash ^ word) * PRIME;
+        hash ^= hash >> 29;
+    }
+    for (; i < record.size(); ++i) hash = (hash ^ static_cast<unsigned char>(record[i])) * PRIME;
+    return hash;
+}
+
+// Heap bytes behind s; short strings live inside the object
+size_t stringHeapBytes(const std::string& s) {
+    static const size_t INLINE_CAPACITY = std::string().capacity();
+    return s.capacity() > INLINE_CAPACITY ? s.capacity() + 1 : 0;
+}
+
+size_t songHeapBytes(const Song& song) {
+    return stringHeapBytes(song.title) + stringHeapBytes(song.artist) + stringHeapBytes(song.lyrics) +
+           stringHeapBytes(song.emotion);
+}
+
+// Bitmap objects are counted in the vector's capacity, their chunks apart
+size_t bitmapBytes(const std::vector<SongBitmap>& bitmaps) {
+    size_t bytes = bitmaps.capacity() * sizeof(SongBitmap);
+    for (const SongBitmap& bitmap : bitmaps) bytes += bitmap.memoryBytes() - sizeof(SongBitmap);
+    return bytes;
+}
+
+// JSON escapes of input appended to out, which may be a std::string or an
+// ArenaString
+template <typename String>
+void appendJsonString(String& out, const std::string& input) {
+    for (char c : input) {
+        switch (c) {
+            case '\"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 32) {
+                    // For control characters, use \u00XX format
+                    char buf[7];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += c;
+                }
+        }
+    }
+}
+
+} // namespace
+
+EmotionPlaylist::EmotionPlaylist(const std::string& csvPath)
+    : songHead(nullptr), songTail(nullptr), emotionHead(nullptr), vectorRerank(0),
+      textEmbeddings(false), parseWarnings(0), catalogVersion(0) {
     loadFromCsv(csvPath);
 }
 
@@ -35,14 +115,14 @@ void EmotionPlaylist::clearEmotionList() {
     emotionHead = nullptr;
 }
 
-std::string EmotionPlaylist::trim(const std::string& str) {
+std::string EmotionPlaylist::trim(const std::string& str) const {
     size_t first = str.find_first_not_of(" \t\n\r");
     if (first == std::string::npos) return "";
     size_t last = str.find_last_not_of(" \t\n\r");
     return str.substr(first, last - first + 1);
 }
 
-std::string EmotionPlaylist::unquote(const std::string& str) {
+std::string EmotionPlaylist::unquote(const std::string& str) const {
     std::string result = trim(str);
     if (result.length() >= 2 && result.front() == '"' && result.back() == '"') {
         return result.substr(1, result.length() - 2);
@@ -87,12 +167,25 @@ void EmotionPlaylist::loadFromCsv(const std::string& csvPath) {
     // Clear existing data
     clearSongList(songHead);
     songHead = nullptr;
+    songTail = nullptr;
+    songTable.clear();
+    songIds.clear();
     clearEmotionList();
+    textIndex.clear();
+    vectorIndex.clear();
+    lyricsIndex.clear();
+    completions.clear();
+    embeddings.reset(0, 0);
+    vectorRerank = 0;
+    textEmbeddings = false;
+    parseWarnings = 0;
+    catalogVersion = 0xcbf29ce484222325ULL;
     
     std::string line;
     bool isHeader = true;
     int lineNumber = 0;
     
+    ProfileStage readStage("read_csv");
     while (std::getline(file, line)) {
         lineNumber++;
         
@@ -103,11 +196,23 @@ void EmotionPlaylist::loadFromCsv(const std::string& csvPath) {
         
         if (line.empty()) continue;
         
+        // A quoted field may contain newlines; read on until its quotes close
+        size_t quotes = static_cast<size_t>(std::count(line.begin(), line.end(), '"'));
+        std::string continuation;
+        while (quotes % 2 != 0 && std::getline(file, continuation)) {
+            lineNumber++;
+            quotes += static_cast<size_t>(std::count(continuation.begin(), continuation.end(), '"'));
+            line += '\n';
+            line += continuation;
+        }
+        
+        catalogVersion = hashRecord(catalogVersion, line);
         auto fields = parseCsvLine(line);
         
         if (fields.size() < 5) {
             std::cerr << "Warning: Skipping malformed line " << lineNumber 
                       << ": " << line << std::endl;
+            parseWarnings++;
             continue;
         }
         
@@ -123,6 +228,7 @@ void EmotionPlaylist::loadFromCsv(const std::string& csvPath) {
             if (song.title.empty() || song.artist.empty() || song.emotion.empty()) {
                 std::cerr << "Warning: Skipping line " << lineNumber 
                           << " with empty required fields" << std::endl;
+                parseWarnings++;
                 continue;
             }
             
@@ -133,31 +239,51 @@ void EmotionPlaylist::loadFromCsv(const std::string& csvPath) {
             // Create a new node for the song
             SongNode* newNode = new SongNode(song);
             
-            // Add to the main song list (singly linked list)
+            // Add to the end of the main song list (singly linked list)
             if (songHead == nullptr) {
                 songHead = newNode;
             } else {
-                // Add to the end of the list
-                SongNode* current = songHead;
-                while (current->next != nullptr) {
-                    current = current->next;
-                }
-                current->next = newNode;
+                songTail->next = newNode;
             }
+            songTail = newNode;
+            songTable.push_back(newNode);
             
         } catch (const std::exception& e) {
             std::cerr << "Warning: Error parsing line " << lineNumber 
                       << ": " << e.what() << std::endl;
+            parseWarnings++;
         }
     }
     
     file.close();
+    readStage.setRowsIn(static_cast<size_t>(lineNumber));
+    readStage.setRowsOut(songTable.size());
+    readStage.stop();
     
     if (songHead == nullptr) {
         std::cerr << "Warning: No valid songs found in " << csvPath << std::endl;
     }
     
+    ProfileStage idStage("id_index", songTable.size());
+    std::vector<int> ids(songTable.size());
+    for (size_t ordinal = 0; ordinal < songTable.size(); ++ordinal) {
+        ids[ordinal] = songTable[ordinal]->data.id;
+    }
+    songIds.build(ids);
+    idStage.stop();
+    if (songIds.size() != songTable.size()) {
+        std::cerr << "Warning: " << songTable.size() - songIds.size()
+                  << " songs share an id with an earlier song; lookups by id return the first" << std::endl;
+    }
+    
+    ProfileStage emotionStage("emotion_index", songTable.size());
     buildEmotionIndex();
+    emotionStage.stop();
+    ProfileStage textStage("text_index", songTable.size());
+    buildTextIndex();
+    textStage.stop();
+    ProfileStage fuzzyStage("fuzzy_index", songTable.size());
+    buildFuzzyIndexes();
 }
 
 EmotionNode* EmotionPlaylist::findEmotion(const std::string& emotion) const {
@@ -174,26 +300,27 @@ EmotionNode* EmotionPlaylist::findEmotion(const std::string& emotion) const {
 void EmotionPlaylist::addSongToEmotion(EmotionNode* emotionNode, const Song& song) {
     SongNode* newNode = new SongNode(song);
     
+    // Add to the end of the list
     if (emotionNode->songList == nullptr) {
         emotionNode->songList = newNode;
     } else {
-        // Add to the end of the list
-        SongNode* current = emotionNode->songList;
-        while (current->next != nullptr) {
-            current = current->next;
-        }
-        current->next = newNode;
+        emotionNode->songTail->next = newNode;
     }
+    emotionNode->songTail = newNode;
 }
 
 void EmotionPlaylist::buildEmotionIndex() {
     // Clear existing emotion index
     clearEmotionList();
+    songEmotion.assign(songTable.size(), 0);
+    emotionSongs.clear();
+    
+    EmotionNode* lastEmotion = nullptr;
+    int emotionCount = 0;
     
     // Iterate through all songs and build the emotion index
-    SongNode* current = songHead;
-    while (current != nullptr) {
-        const Song& song = current->data;
+    for (size_t ordinal = 0; ordinal < songTable.size(); ++ordinal) {
+        const Song& song = songTable[ordinal]->data;
         
         // Find or create emotion node
         EmotionNode* emotionNode = findEmotion(song.emotion);
@@ -201,37 +328,401 @@ void EmotionPlaylist::buildEmotionIndex() {
         if (emotionNode == nullptr) {
             // Create a new emotion node
             emotionNode = new EmotionNode(song.emotion);
+            emotionNode->id = emotionCount++;
             
-            // Add to the doubly linked list of emotions
+            // Add to the end of the doubly linked list of emotions
             if (emotionHead == nullptr) {
                 emotionHead = emotionNode;
             } else {
-                // Add to the end of the list
-                EmotionNode* lastEmotion = emotionHead;
-                while (lastEmotion->next != nullptr) {
-                    lastEmotion = lastEmotion->next;
-                }
                 lastEmotion->next = emotionNode;
                 emotionNode->prev = lastEmotion;
             }
+            lastEmotion = emotionNode;
+            emotionSongs.push_back(SongBitmap());
         }
         
         // Add song to the emotion's song list
         addSongToEmotion(emotionNode, song);
+        songEmotion[ordinal] = emotionNode->id;
+        emotionSongs[static_cast<size_t>(emotionNode->id)].append(static_cast<uint32_t>(ordinal));
+    }
+}
+
+void EmotionPlaylist::buildTextIndex() {
+    std::vector<TextDocument> documents;
+    documents.reserve(songTable.size());
+    for (SongNode* node : songTable) {
+        documents.push_back(TextDocument{&node->data.title, &node->data.lyrics});
+    }
+    textIndex.build(documents);
+}
+
+void EmotionPlaylist::buildFuzzyIndexes() {
+    std::vector<const std::string*> values;
+    for (EmotionNode* node = emotionHead; node != nullptr; node = node->next) {
+        values.push_back(&node->emotion);
+    }
+    emotionNames.build(values);
+    
+    values.clear();
+    for (SongNode* node : songTable) {
+        values.push_back(&node->data.artist);
+    }
+    artistNames.build(values);
+    artistSongs.assign(artistNames.termCount(), SongBitmap());
+    songArtist.assign(songTable.size(), 0);
+    for (uint32_t term = 0; term < artistNames.termCount(); ++term) {
+        size_t count = 0;
+        const uint32_t* ordinals = artistNames.items(term, count);
+        for (size_t i = 0; i < count; ++i) {
+            artistSongs[term].append(ordinals[i]);
+            songArtist[ordinals[i]] = term;
+        }
+    }
+    
+    values.clear();
+    for (SongNode* node : songTable) {
+        values.push_back(&node->data.title);
+    }
+    titleNames.build(values);
+    songTitle.assign(songTable.size(), 0);
+    for (uint32_t term = 0; term < titleNames.termCount(); ++term) {
+        size_t count = 0;
+        const uint32_t* ordinals = titleNames.items(term, count);
+        for (size_t i = 0; i < count; ++i) songTitle[ordinals[i]] = term;
+    }
+}
+
+std::vector<std::string> EmotionPlaylist::resolveEmotions(
+        const std::vector<std::string>& emotions,
+        std::vector<SpellingCorrection>* corrections) const {
+    std::vector<const EmotionNode*> byId;
+    for (EmotionNode* node = emotionHead; node != nullptr; node = node->next) {
+        byId.push_back(node);
+    }
+    
+    std::vector<std::string> resolved;
+    for (const auto& emotion : emotions) {
+        if (trim(emotion).empty()) continue;
         
-        current = current->next;
+        int term = emotionNames.find(emotion);
+        unsigned distance = 0;
+        if (term < 0) {
+            std::vector<FuzzyIndex::Match> matches =
+                emotionNames.lookup(emotion, FuzzyIndex::MAX_DISTANCE, 1);
+            if (!matches.empty()) {
+                term = static_cast<int>(matches[0].term);
+                distance = matches[0].distance;
+            }
+        }
+        if (term < 0) {
+            resolved.push_back(FuzzyIndex::normalize(emotion));
+            continue;
+        }
+        
+        size_t count = 0;
+        const uint32_t* ids = emotionNames.items(static_cast<uint32_t>(term), count);
+        resolved.push_back(byId[ids[0]]->emotion);
+        if (distance > 0 && corrections != nullptr) {
+            corrections->push_back(SpellingCorrection{"emotion", trim(emotion), resolved.back(), distance});
+        }
     }
+    return resolved;
 }
 
-bool EmotionPlaylist::songExistsInList(SongNode* head, int songId) const {
-    SongNode* current = head;
-    while (current != nullptr) {
-        if (current->data.id == songId) {
+int EmotionPlaylist::resolveName(const FuzzyIndex& names, const char* field,
+                                 const std::string& value,
+                                 std::vector<SpellingCorrection>* corrections) const {
+    int term = names.find(value);
+    if (term >= 0) return term;
+    
+    std::vector<FuzzyIndex::Match> matches = names.lookup(value, FuzzyIndex::MAX_DISTANCE, 1);
+    if (matches.empty()) return -1;
+    if (corrections != nullptr) {
+        corrections->push_back(SpellingCorrection{field, trim(value), names.term(matches[0].term),
+                                                  matches[0].distance});
+    }
+    return static_cast<int>(matches[0].term);
+}
+
+SongBitmap EmotionPlaylist::restrictToEmotions(const SongBitmap& songs,
+                                               const std::vector<std::string>& emotions) const {
+    if (emotions.empty()) return songs;
+    
+    SongBitmap allowed;
+    for (const auto& emotion : resolveEmotions(emotions)) {
+        EmotionNode* node = findEmotion(emotion);
+        if (node != nullptr) {
+            allowed = SongBitmap::unite(allowed, emotionSongs[static_cast<size_t>(node->id)]);
+        }
+    }
+    return SongBitmap::intersect(songs, allowed);
+}
+
+SongNode* EmotionPlaylist::buildResultList(const SongBitmap& songs, size_t k) const {
+    std::vector<ScoredCandidate> candidates;
+    for (uint32_t ordinal : songs.values(k)) {
+        candidates.push_back(ScoredCandidate{ordinal, 0.0});
+    }
+    return buildResultList(candidates);
+}
+
+SongNode* EmotionPlaylist::findByArtist(const std::string& artist,
+                                        const std::vector<std::string>& emotions, size_t k,
+                                        std::vector<SpellingCorrection>* corrections) const {
+    int term = resolveName(artistNames, "artist", artist, corrections);
+    if (term < 0) return nullptr;
+    return buildResultList(restrictToEmotions(artistSongs[static_cast<size_t>(term)], emotions), k);
+}
+
+SongNode* EmotionPlaylist::findByTitle(const std::string& title,
+                                       const std::vector<std::string>& emotions, size_t k,
+                                       std::vector<SpellingCorrection>* corrections) const {
+    int term = resolveName(titleNames, "title", title, corrections);
+    if (term < 0) return nullptr;
+    
+    std::vector<char> mask = emotionMask(emotions);
+    std::vector<ScoredCandidate> songs;
+    size_t count = 0;
+    const uint32_t* ordinals = titleNames.items(static_cast<uint32_t>(term), count);
+    for (size_t i = 0; i < count && songs.size() < k; ++i) {
+        if (emotionAllowed(mask, ordinals[i])) {
+            songs.push_back(ScoredCandidate{ordinals[i], 0.0});
+        }
+    }
+    return buildResultList(songs);
+}
+
+void EmotionPlaylist::resolvePredicates(const Query& query, std::vector<int>& keys,
+                                        std::vector<PredicateStats>& stats,
+                                        std::vector<SpellingCorrection>* corrections) const {
+    keys.assign(query.nodes().size(), -1);
+    stats.assign(query.nodes().size(), PredicateStats{0.0, false});
+    for (size_t node = 0; node < query.nodes().size(); ++node) {
+        const QueryNode& current = query.nodes()[node];
+        int& key = keys[node];
+        PredicateStats& predicate = stats[node];
+        switch (current.kind) {
+            case QueryNode::Emotion: {
+                std::vector<std::string> resolved = resolveEmotions({current.value}, corrections);
+                EmotionNode* emotion = resolved.empty() ? nullptr : findEmotion(resolved[0]);
+                if (emotion != nullptr) key = emotion->id;
+                if (key >= 0) predicate.rows = static_cast<double>(emotionSongs[static_cast<size_t>(key)].size());
+                predicate.column = true;
+                break;
+            }
+            case QueryNode::Artist:
+                key = resolveName(artistNames, "artist", current.value, corrections);
+                if (key >= 0) predicate.rows = static_cast<double>(artistSongs[static_cast<size_t>(key)].size());
+                predicate.column = true;
+                break;
+            case QueryNode::Title: {
+                key = resolveName(titleNames, "title", current.value, corrections);
+                size_t count = 0;
+                if (key >= 0) titleNames.items(static_cast<uint32_t>(key), count);
+                predicate.rows = static_cast<double>(count);
+                predicate.column = true;
+                break;
+            }
+            case QueryNode::Text: {
+                // Every word must appear, so the rarest word bounds the matches
+                std::vector<std::string> words;
+                tokenize(current.value, words);
+                predicate.rows = words.empty() ? 0.0 : static_cast<double>(songTable.size());
+                for (const auto& word : words) {
+                    predicate.rows = std::min(predicate.rows, static_cast<double>(textIndex.documentFrequency(word)));
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+SongBitmap EmotionPlaylist::predicateSongs(const Query& query, const std::vector<int>& keys,
+                                           uint32_t node) const {
+    const QueryNode& current = query.nodes()[node];
+    SongBitmap songs;
+    if (current.kind != QueryNode::Text && keys[node] < 0) return songs;
+    
+    size_t key = static_cast<size_t>(keys[node]);
+    switch (current.kind) {
+        case QueryNode::Emotion:
+            songs = emotionSongs[key];
+            break;
+        case QueryNode::Artist:
+            songs = artistSongs[key];
+            break;
+        case QueryNode::Title: {
+            size_t count = 0;
+            const uint32_t* ordinals = titleNames.items(static_cast<uint32_t>(key), count);
+            for (size_t i = 0; i < count; ++i) songs.append(ordinals[i]);
+            break;
+        }
+        case QueryNode::Text: {
+            std::vector<std::string> words;
+            tokenize(current.value, words);
+            if (words.empty()) break;
+            std::vector<uint32_t> ordinals;
+            for (const auto& match : textIndex.search(words, songTable.size(), true)) {
+                ordinals.push_back(match.id);
+            }
+            std::sort(ordinals.begin(), ordinals.end());
+            for (uint32_t ordinal : ordinals) songs.append(ordinal);
+            break;
+        }
+        default:
+            break;
+    }
+    return songs;
+}
+
+bool EmotionPlaylist::songMatches(const Query& query, const std::vector<int>& keys,
+                                  uint32_t node, uint32_t ordinal) const {
+    const QueryNode& current = query.nodes()[node];
+    int key = keys[node];
+    switch (current.kind) {
+        case QueryNode::Emotion:
+            return songEmotion[ordinal] == key;
+        case QueryNode::Artist:
+            return key >= 0 && songArtist[ordinal] == static_cast<uint32_t>(key);
+        case QueryNode::Title:
+            return key >= 0 && songTitle[ordinal] == static_cast<uint32_t>(key);
+        case QueryNode::Not:
+            return !songMatches(query, keys, current.children[0], ordinal);
+        case QueryNode::And:
+            for (uint32_t child : current.children) {
+                if (!songMatches(query, keys, child, ordinal)) return false;
+            }
             return true;
+        case QueryNode::Or:
+            for (uint32_t child : current.children) {
+                if (songMatches(query, keys, child, ordinal)) return true;
+            }
+            return false;
+        default:
+            return false; // the planner never filters on text
+    }
+}
+
+SongBitmap EmotionPlaylist::runPlan(const Query& query, const std::vector<int>& keys,
+                                    PlanNode& step) const {
+    uint32_t catalog = static_cast<uint32_t>(songTable.size());
+    SongBitmap songs;
+    switch (step.op) {
+        case PlanNode::Limit:
+            for (uint32_t ordinal : runPlan(query, keys, step.children[0]).values(step.limit)) {
+                songs.append(ordinal);
+            }
+            break;
+        case PlanNode::IndexScan:
+            songs = predicateSongs(query, keys, step.node);
+            break;
+        case PlanNode::FullScan:
+            songs = SongBitmap::range(catalog);
+            break;
+        case PlanNode::Filter: {
+            // Run the whole chain of filters row by row, innermost first
+            std::vector<PlanNode*> chain;
+            PlanNode* source = &step;
+            for (; source->op == PlanNode::Filter; source = &source->children[0]) {
+                source->actualRows = 0;
+                chain.insert(chain.begin(), source);
+            }
+            // False once the limit is reached
+            auto accept = [&](uint32_t ordinal) {
+                for (PlanNode* filter : chain) {
+                    if (!songMatches(query, keys, filter->node, ordinal)) return true;
+                    filter->actualRows++;
+                }
+                songs.append(ordinal);
+                return songs.size() < step.limit;
+            };
+            if (source->op == PlanNode::FullScan) {
+                uint32_t ordinal = 0;
+                while (ordinal < catalog && accept(ordinal++)) {}
+                source->actualRows = ordinal;
+            } else {
+                for (uint32_t ordinal : runPlan(query, keys, *source).values()) {
+                    if (!accept(ordinal)) break;
+                }
+            }
+            return songs;
         }
-        current = current->next;
+        case PlanNode::Intersect:
+            songs = SongBitmap::intersect(runPlan(query, keys, step.children[0]),
+                                          runPlan(query, keys, step.children[1]));
+            break;
+        case PlanNode::Union:
+            for (PlanNode& child : step.children) {
+                songs = SongBitmap::unite(songs, runPlan(query, keys, child));
+            }
+            break;
+        case PlanNode::Difference:
+            songs = SongBitmap::subtract(runPlan(query, keys, step.children[0]),
+                                         runPlan(query, keys, step.children[1]));
+            break;
+        case PlanNode::Complement:
+            songs = SongBitmap::subtract(SongBitmap::range(catalog),
+                                         runPlan(query, keys, step.children[0]));
+            break;
     }
-    return false;
+    step.actualRows = songs.size();
+    return songs;
+}
+
+SongNode* EmotionPlaylist::searchQuery(const std::string& text,
+                                       const std::vector<std::string>& emotions, size_t k,
+                                       std::vector<SpellingCorrection>* corrections,
+                                       std::string* explain) const {
+    std::unique_ptr<Query> query;
+    {
+        ProfileStage stage("parse", text.size());
+        query.reset(new Query(text));
+        query->requireAny(QueryNode::Emotion, emotions);
+        stage.setRowsOut(query->nodes().size());
+    }
+    
+    std::vector<int> keys;
+    std::vector<PredicateStats> stats;
+    PlanNode plan;
+    {
+        ProfileStage stage("plan", query->nodes().size());
+        resolvePredicates(*query, keys, stats, corrections);
+        plan = QueryPlanner(*query, stats, songTable.size()).plan(k);
+    }
+    
+    SongBitmap songs;
+    {
+        ProfileStage stage("execute", songTable.size());
+        songs = runPlan(*query, keys, plan);
+        stage.setRowsOut(songs.size());
+    }
+    
+    if (explain != nullptr) *explain = explainPlan(*query, plan);
+    ProfileStage stage("build", songs.size());
+    stage.setRowsOut(std::min(k, songs.size()));
+    return buildResultList(songs, k);
+}
+
+size_t EmotionPlaylist::countByArtist(const std::string& artist) const {
+    int term = artistNames.find(artist);
+    return term < 0 ? 0 : artistSongs[static_cast<size_t>(term)].size();
+}
+
+SongNode* EmotionPlaylist::moreFromArtist(int songId, const std::vector<std::string>& emotions,
+                                          size_t k) const {
+    int ordinal = findOrdinal(songId);
+    if (ordinal < 0) {
+        throw std::runtime_error("Unknown song id: " + std::to_string(songId));
+    }
+    int term = artistNames.find(songTable[static_cast<size_t>(ordinal)]->data.artist);
+    
+    SongBitmap self;
+    self.append(static_cast<uint32_t>(ordinal));
+    SongBitmap others = SongBitmap::subtract(artistSongs[static_cast<size_t>(term)], self);
+    return buildResultList(restrictToEmotions(others, emotions), k);
 }
 
 SongNode* EmotionPlaylist::filterByEmotions(const std::vector<std::string>& emotions) const {
@@ -258,41 +749,499 @@ SongNode* EmotionPlaylist::filterByEmotions(const std::vector<std::string>& emot
         return resultHead;
     }
     
+    std::vector<const SongNode*> lists;
+    {
+        ProfileStage stage("lookup", emotions.size());
+        for (const auto& emotion : resolveEmotions(emotions)) {
+            EmotionNode* emotionNode = findEmotion(emotion);
+            if (emotionNode != nullptr) lists.push_back(emotionNode->songList);
+        }
+        stage.setRowsOut(lists.size());
+    }
+    
+    std::vector<const Song*> matches;
+    {
+        ProfileStage stage("filter", lists.size());
+        for (const SongNode* current : lists) {
+            for (; current != nullptr; current = current->next) {
+                matches.push_back(&current->data);
+            }
+        }
+        stage.setRowsOut(matches.size());
+    }
+    
+    // A song can be listed twice only through a repeated emotion or id
     SongNode* resultHead = nullptr;
     SongNode* resultTail = nullptr;
+    ProfileStage stage("dedupe", matches.size());
+    std::unordered_set<int> seen;
+    seen.reserve(matches.size());
+    size_t count = 0;
+    for (const Song* song : matches) {
+        if (seen.insert(song->id).second) {
+            SongNode* newNode = new SongNode(*song);
+            
+            if (resultHead == nullptr) {
+                resultHead = newNode;
+                resultTail = newNode;
+            } else {
+                resultTail->next = newNode;
+                resultTail = newNode;
+            }
+            count++;
+        }
+    }
+    stage.setRowsOut(count);
     
-    for (const auto& emotion : emotions) {
-        if (emotion.empty()) continue;
+    return resultHead;
+}
+
+int EmotionPlaylist::findOrdinal(int songId) const {
+    return songIds.find(songId);
+}
+
+const Song* EmotionPlaylist::getSongById(int id) const {
+    int ordinal = songIds.find(id);
+    return ordinal < 0 ? nullptr : &songTable[static_cast<size_t>(ordinal)]->data;
+}
+
+std::vector<const Song*> EmotionPlaylist::getSongs(const std::vector<int>& ids) const {
+    std::vector<int> ordinals(ids.size());
+    songIds.findMany(ids.data(), ids.size(), ordinals.data());
+    
+    std::vector<const Song*> songs(ids.size(), nullptr);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (ordinals[i] >= 0) {
+            songs[i] = &songTable[static_cast<size_t>(ordinals[i])]->data;
+        }
+    }
+    return songs;
+}
+
+void EmotionPlaylist::ensureEmbeddings() {
+    if (!embeddings.empty() || songTable.empty()) return;
+    
+    embeddings.reset(DEFAULT_EMBEDDING_DIM, songTable.size());
+    textEmbeddings = true;
+    
+    // Derive vectors from title and lyrics, one contiguous range per thread
+    size_t count = songTable.size();
+    unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+    size_t chunk = (count + threadCount - 1) / threadCount;
+    
+    auto worker = [this, count, chunk](size_t begin) {
+        TRACE_SCOPE("embed_lyrics");
+        size_t end = std::min(count, begin + chunk);
+        for (size_t i = begin; i < end; ++i) {
+            const Song& song = songTable[i]->data;
+            EmbeddingStore::embedText(song.title + " " + song.lyrics,
+                                      embeddings.row(i), embeddings.dimension());
+        }
+    };
+    
+    std::vector<std::thread> workers;
+    for (size_t begin = chunk; begin < count; begin += chunk) {
+        workers.emplace_back(worker, begin);
+    }
+    worker(0);
+    for (auto& t : workers) t.join();
+}
+
+void EmotionPlaylist::loadEmbeddings(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open embeddings file: " + path);
+    }
+    
+    vectorIndex.clear();
+    embeddings.reset(0, 0);
+    textEmbeddings = false;
+    
+    std::vector<bool> loaded(songTable.size(), false);
+    std::string line;
+    int lineNumber = 0;
+    
+    while (std::getline(file, line)) {
+        lineNumber++;
+        if (line.empty()) continue;
         
-        std::string lowerEmotion = emotion;
-        std::transform(lowerEmotion.begin(), lowerEmotion.end(), 
-                      lowerEmotion.begin(), ::tolower);
+        std::vector<float> values;
+        int songId = 0;
+        try {
+            std::istringstream fields(line);
+            std::string field;
+            std::getline(fields, field, ',');
+            songId = std::stoi(field);
+            while (std::getline(fields, field, ',')) {
+                values.push_back(std::stof(field));
+            }
+        } catch (const std::exception& e) {
+            // Tolerate a header row or stray text the same way the CSV loader does
+            std::cerr << "Warning: Skipping embedding line " << lineNumber
+                      << ": " << e.what() << std::endl;
+            continue;
+        }
+        
+        if (values.empty()) continue;
+        if (embeddings.empty()) {
+            embeddings.reset(values.size(), songTable.size());
+        }
+        if (values.size() != embeddings.dimension()) {
+            throw std::runtime_error("Embedding dimension mismatch on line " +
+                                     std::to_string(lineNumber) + " of " + path);
+        }
         
-        EmotionNode* emotionNode = findEmotion(lowerEmotion);
+        int ordinal = findOrdinal(songId);
+        if (ordinal < 0) continue;
         
-        if (emotionNode != nullptr) {
-            SongNode* current = emotionNode->songList;
-            
-            while (current != nullptr) {
-                // Check if song already exists in result list to avoid duplicates
-                if (!songExistsInList(resultHead, current->data.id)) {
-                    SongNode* newNode = new SongNode(current->data);
-                    
-                    if (resultHead == nullptr) {
-                        resultHead = newNode;
-                        resultTail = newNode;
-                    } else {
-                        resultTail->next = newNode;
-                        resultTail = newNode;
-                    }
+        float* row = embeddings.row(static_cast<size_t>(ordinal));
+        std::copy(values.begin(), values.end(), row);
+        EmbeddingStore::normalize(row, values.size());
+        loaded[static_cast<size_t>(ordinal)] = true;
+    }
+    
+    if (embeddings.empty()) {
+        std::cerr << "Warning: No embeddings found in " << path << std::endl;
+        return;
+    }
+    
+    for (size_t i = 0; i < songTable.size(); ++i) {
+        if (!loaded[i]) {
+            const Song& song = songTable[i]->data;
+            EmbeddingStore::embedText(song.title + " " + song.lyrics,
+                                      embeddings.row(i), embeddings.dimension());
+        }
+    }
+}
+
+void EmotionPlaylist::buildVectorIndex(const HnswIndex::Params& params) {
+    ensureEmbeddings();
+    vectorIndex.build(embeddings, params);
+}
+
+void EmotionPlaylist::saveVectorIndex(const std::string& path) const {
+    vectorIndex.save(path);
+}
+
+void EmotionPlaylist::loadVectorIndex(const std::string& path) {
+    ensureEmbeddings();
+    vectorIndex.load(path, embeddings);
+}
+
+void EmotionPlaylist::quantizeEmbeddings(VectorEncoding encoding, size_t rerankCandidates) {
+    ensureEmbeddings();
+    vectorRerank = rerankCandidates;
+    embeddings.quantize(encoding, 0, rerankCandidates > 0);
+}
+
+SongNode* EmotionPlaylist::findSimilar(int songId, size_t k, size_t ef,
+                                       const std::vector<std::string>& emotions) const {
+    int ordinal = findOrdinal(songId);
+    if (ordinal < 0) {
+        throw std::runtime_error("Unknown song id: " + std::to_string(songId));
+    }
+    if (vectorIndex.empty()) {
+        throw std::runtime_error("Vector index has not been built");
+    }
+    
+    std::vector<char> mask = emotionMask(emotions);
+    
+    uint32_t self = static_cast<uint32_t>(ordinal);
+    HnswIndex::Filter accept = [this, self, &mask](uint32_t id) {
+        return id != self && emotionAllowed(mask, id);
+    };
+    
+    std::vector<float> query(embeddings.dimension());
+    embeddings.decode(self, query.data());
+    
+    auto results = vectorIndex.search(query.data(), k, ef, accept, vectorRerank);
+    
+    std::vector<ScoredCandidate> ranked;
+    for (const auto& result : results) {
+        ranked.push_back(ScoredCandidate{result.id, -result.distance});
+    }
+    return buildResultList(ranked);
+}
+
+std::vector<char> EmotionPlaylist::emotionMask(const std::vector<std::string>& emotions) const {
+    std::vector<char> mask;
+    if (emotions.empty()) return mask;
+    
+    int emotionCount = 0;
+    for (EmotionNode* node = emotionHead; node != nullptr; node = node->next) {
+        emotionCount++;
+    }
+    mask.assign(static_cast<size_t>(emotionCount), 0);
+    
+    for (const auto& emotion : resolveEmotions(emotions)) {
+        EmotionNode* node = findEmotion(emotion);
+        if (node != nullptr) {
+            mask[static_cast<size_t>(node->id)] = 1;
+        }
+    }
+    return mask;
+}
+
+SongNode* EmotionPlaylist::buildResultList(const std::vector<ScoredCandidate>& candidates) const {
+    SongNode* resultHead = nullptr;
+    SongNode* resultTail = nullptr;
+    for (const auto& candidate : candidates) {
+        SongNode* newNode = new SongNode(songTable[candidate.id]->data);
+        if (resultHead == nullptr) {
+            resultHead = newNode;
+        } else {
+            resultTail->next = newNode;
+        }
+        resultTail = newNode;
+    }
+    return resultHead;
+}
+
+std::vector<ScoredCandidate> EmotionPlaylist::lexicalCandidates(
+        const std::string& text, size_t depth, bool requireAll,
+        const std::vector<char>& mask) const {
+    TextQuery query = parseTextQuery(text);
+    
+    TextIndex::Filter accept;
+    if (!mask.empty()) {
+        accept = [this, &mask](uint32_t id) { return emotionAllowed(mask, id); };
+    }
+    if (query.clauses.empty()) {
+        return textIndex.search(query.words, depth, requireAll, accept);
+    }
+    
+    // Phrases and NEAR groups are conjunctive, so loose words must match too
+    for (const auto& word : query.words) {
+        ProximityClause clause;
+        clause.terms.push_back(word);
+        query.clauses.push_back(clause);
+    }
+    return textIndex.searchProximity(query.clauses, depth, accept);
+}
+
+SongNode* EmotionPlaylist::searchText(const std::string& query,
+                                      const std::vector<std::string>& emotions,
+                                      size_t k, bool requireAll) const {
+    // Accept the text:"..." field syntax as well as bare words
+    std::string text = trim(query);
+    if (text.compare(0, 5, "text:") == 0) {
+        text = unquote(text.substr(5));
+    }
+    
+    std::vector<char> mask = emotionMask(emotions);
+    return buildResultList(lexicalCandidates(text, k, requireAll, mask));
+}
+
+std::vector<const std::string*> EmotionPlaylist::lyricsDocuments() const {
+    std::vector<const std::string*> documents;
+    documents.reserve(songTable.size());
+    for (SongNode* node : songTable) {
+        documents.push_back(&node->data.lyrics);
+    }
+    return documents;
+}
+
+void EmotionPlaylist::buildSubstringIndex(const FmIndex::Params& params) {
+    lyricsIndex.build(lyricsDocuments(), params);
+}
+
+void EmotionPlaylist::saveSubstringIndex(const std::string& path) const {
+    lyricsIndex.save(path);
+}
+
+void EmotionPlaylist::loadSubstringIndex(const std::string& path) {
+    lyricsIndex.load(path, lyricsDocuments());
+}
+
+void EmotionPlaylist::songNames(std::vector<const std::string*>& titles,
+                                std::vector<const std::string*>& artists) const {
+    titles.clear();
+    artists.clear();
+    for (SongNode* node : songTable) {
+        titles.push_back(&node->data.title);
+        artists.push_back(&node->data.artist);
+    }
+}
+
+void EmotionPlaylist::buildCompletionIndex() {
+    std::vector<const std::string*> titles;
+    std::vector<const std::string*> artists;
+    songNames(titles, artists);
+    completions.build(titles, artists);
+}
+
+void EmotionPlaylist::saveCompletionIndex(const std::string& path) const {
+    completions.save(path);
+}
+
+void EmotionPlaylist::loadCompletionIndex(const std::string& path) {
+    std::vector<const std::string*> titles;
+    std::vector<const std::string*> artists;
+    songNames(titles, artists);
+    completions.load(path, titles, artists);
+}
+
+std::vector<CompletionIndex::Completion> EmotionPlaylist::complete(const std::string& prefix,
+                                                                   size_t n) const {
+    if (completions.empty()) {
+        throw std::runtime_error("Completion index has not been built");
+    }
+    return completions.complete(prefix, n);
+}
+
+SongNode* EmotionPlaylist::searchSubstring(const std::string& text,
+                                           const std::vector<std::string>& emotions,
+                                           size_t k) const {
+    if (lyricsIndex.empty() && !songTable.empty()) {
+        throw std::runtime_error("Substring index has not been built");
+    }
+    
+    std::vector<char> mask = emotionMask(emotions);
+    std::vector<uint32_t> occurrences(songTable.size(), 0);
+    for (const auto& occurrence : lyricsIndex.locate(text)) {
+        occurrences[occurrence.document]++;
+    }
+    
+    std::vector<ScoredCandidate> ranked;
+    for (uint32_t id = 0; id < occurrences.size(); ++id) {
+        if (occurrences[id] > 0 && emotionAllowed(mask, id)) {
+            ranked.push_back(ScoredCandidate{id, static_cast<double>(occurrences[id])});
+        }
+    }
+    std::stable_sort(ranked.begin(), ranked.end(), [](const ScoredCandidate& a, const ScoredCandidate& b) {
+        return a.score > b.score;
+    });
+    if (ranked.size() > k) ranked.resize(k);
+    return buildResultList(ranked);
+}
+
+SongNode* EmotionPlaylist::searchRegex(const std::string& pattern,
+                                       const std::vector<std::string>& emotions,
+                                       size_t k) const {
+    Regex regex(pattern);
+    const std::vector<std::string>& literals = regex.requiredLiterals();
+    std::vector<char> mask = emotionMask(emotions);
+    
+    // Cheap literal scan first; the DFA only runs on fields containing one
+    // of the strings every match must contain
+    auto fieldMatches = [&](RegexMatcher& matcher, const std::string& field) {
+        if (!literals.empty()) {
+            bool candidate = false;
+            for (const auto& literal : literals) {
+                if (findSubstring(field.data(), field.size(), literal, regex.ignoreCase()) !=
+                    std::string::npos) {
+                    candidate = true;
+                    break;
+                }
+            }
+            if (!candidate) return false;
+        }
+        return matcher.search(field);
+    };
+    
+    // Blocks are handed out in catalog order, so once k matches are in, the
+    // blocks already taken hold the first k and the rest can be skipped
+    const size_t BLOCK = 1024;
+    size_t count = songTable.size();
+    size_t blocks = (count + BLOCK - 1) / BLOCK;
+    unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+    threadCount = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threadCount, blocks)));
+    
+    std::atomic<size_t> nextBlock(0);
+    std::atomic<size_t> found(0);
+    std::vector<std::vector<ScoredCandidate>> matches(threadCount);
+    
+    auto worker = [&](unsigned thread) {
+        TRACE_SCOPE("regex/scan");
+        RegexMatcher matcher(regex);
+        for (size_t block = nextBlock++; block < blocks; block = nextBlock++) {
+            if (found.load() >= k) break;
+            size_t end = std::min(count, (block + 1) * BLOCK);
+            for (size_t i = block * BLOCK; i < end; ++i) {
+                if (!emotionAllowed(mask, static_cast<uint32_t>(i))) continue;
+                const Song& song = songTable[i]->data;
+                if (fieldMatches(matcher, song.title) || fieldMatches(matcher, song.artist) ||
+                    fieldMatches(matcher, song.lyrics)) {
+                    matches[thread].push_back(ScoredCandidate{static_cast<uint32_t>(i), 0.0});
+                    found++;
                 }
-                
-                current = current->next;
             }
         }
+    };
+    
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threadCount; ++t) workers.emplace_back(worker, t);
+    worker(0);
+    for (auto& t : workers) t.join();
+    
+    std::vector<ScoredCandidate> results;
+    for (const auto& list : matches) results.insert(results.end(), list.begin(), list.end());
+    std::sort(results.begin(), results.end(), [](const ScoredCandidate& a, const ScoredCandidate& b) {
+        return a.id < b.id;
+    });
+    if (results.size() > k) results.resize(k);
+    return buildResultList(results);
+}
+
+std::vector<ScoredCandidate> EmotionPlaylist::semanticCandidates(
+        const float* query, size_t depth, size_t ef, const std::vector<char>& mask) const {
+    HnswIndex::Filter accept;
+    if (!mask.empty()) {
+        accept = [this, &mask](uint32_t id) { return emotionAllowed(mask, id); };
     }
     
-    return resultHead;
+    std::vector<ScoredCandidate> ranked;
+    for (const auto& result : vectorIndex.search(query, depth, std::max(ef, depth), accept,
+                                                 vectorRerank)) {
+        ranked.push_back(ScoredCandidate{result.id, -result.distance});
+    }
+    return ranked;
+}
+
+SongNode* EmotionPlaylist::hybridSearch(const std::string& text,
+                                        const std::vector<std::string>& emotions,
+                                        const HybridOptions& options) const {
+    std::vector<char> mask = emotionMask(emotions);
+    
+    // Pick the semantic query: a seed song's vector, or the text embedded the
+    // same way the catalog was (only possible for lyric-derived embeddings)
+    std::vector<float> query;
+    if (!vectorIndex.empty()) {
+        if (options.seedSongId >= 0) {
+            int ordinal = findOrdinal(options.seedSongId);
+            if (ordinal < 0) {
+                throw std::runtime_error("Unknown song id: " + std::to_string(options.seedSongId));
+            }
+            query.resize(embeddings.dimension());
+            embeddings.decode(static_cast<size_t>(ordinal), query.data());
+        } else if (textEmbeddings && !text.empty()) {
+            query.resize(embeddings.dimension());
+            EmbeddingStore::embedText(text, query.data(), query.size());
+        }
+    }
+    
+    std::future<std::vector<ScoredCandidate>> semantic;
+    if (!query.empty()) {
+        semantic = std::async(std::launch::async, [this, &query, &options, &mask]() {
+            TRACE_SCOPE("hybrid/semantic");
+            return semanticCandidates(query.data(), options.depth, options.ef, mask);
+        });
+    }
+    
+    std::vector<std::vector<ScoredCandidate>> lists(2);
+    {
+        TRACE_SCOPE("hybrid/lexical");
+        lists[0] = lexicalCandidates(text, options.depth, false, mask);
+    }
+    if (semantic.valid()) {
+        lists[1] = semantic.get();
+    }
+    
+    std::vector<double> weights;
+    weights.push_back(1.0 - options.semanticWeight);
+    weights.push_back(options.semanticWeight);
+    
+    return buildResultList(fuseRankings(lists, options.method, options.k, weights));
 }
 
 std::vector<std::string> EmotionPlaylist::getAvailableEmotions() const {
@@ -310,32 +1259,161 @@ std::vector<std::string> EmotionPlaylist::getAvailableEmotions() const {
 std::string EmotionPlaylist::escapeJsonString(const std::string& input) const {
     std::string output;
     output.reserve(input.length() * 1.1); // Reserve a bit more space
+    appendJsonString(output, input);
+    return output;
+}
+
+std::vector<MemoryUsage> EmotionPlaylist::memoryUsage() const {
+    size_t songStrings = 0;
+    for (const SongNode* node = songHead; node != nullptr; node = node->next) {
+        songStrings += songHeapBytes(node->data);
+    }
     
-    for (char c : input) {
-        switch (c) {
-            case '\"': output += "\\\""; break;
-            case '\\': output += "\\\\"; break;
-            case '\b': output += "\\b"; break;
-            case '\f': output += "\\f"; break;
-            case '\n': output += "\\n"; break;
-            case '\r': output += "\\r"; break;
-            case '\t': output += "\\t"; break;
-            default:
-                if (static_cast<unsigned char>(c) < 32) {
-                    // For control characters, use \u00XX format
-                    char buf[7];
-                    snprintf(buf, sizeof(buf), "\\u%04x", c);
-                    output += buf;
-                } else {
-                    output += c;
-                }
+    // Each emotion keeps its own copy of its songs
+    size_t emotionLists = 0;
+    for (const EmotionNode* emotion = emotionHead; emotion != nullptr; emotion = emotion->next) {
+        emotionLists += sizeof(EmotionNode) + stringHeapBytes(emotion->emotion);
+        for (const SongNode* node = emotion->songList; node != nullptr; node = node->next) {
+            emotionLists += sizeof(SongNode) + songHeapBytes(node->data);
         }
     }
     
-    return output;
+    return {{"song_nodes", songTable.size() * sizeof(SongNode)},
+            {"song_strings", songStrings},
+            {"song_table", songTable.capacity() * sizeof(SongNode*)},
+            {"song_columns", songEmotion.capacity() * sizeof(int) + songArtist.capacity() * sizeof(uint32_t) +
+                             songTitle.capacity() * sizeof(uint32_t)},
+            {"id_index", songIds.memoryBytes()},
+            {"emotion_lists", emotionLists},
+            {"emotion_postings", bitmapBytes(emotionSongs)},
+            {"artist_postings", bitmapBytes(artistSongs)},
+            {"text_index", textIndex.memoryBytes()},
+            {"emotion_names", emotionNames.memoryBytes()},
+            {"artist_names", artistNames.memoryBytes()},
+            {"title_names", titleNames.memoryBytes()},
+            {"embeddings", embeddings.empty() ? 0 : embeddings.memoryBytes()},
+            {"vector_index", vectorIndex.empty() ? 0 : vectorIndex.memoryBytes()},
+            {"substring_index", lyricsIndex.empty() ? 0 : lyricsIndex.memoryBytes()},
+            {"completion_index", completions.empty() ? 0 : completions.memoryBytes()}};
+}
+
+int EmotionPlaylist::emotionId(const char* name, size_t length) const {
+    while (length > 0 && std::isspace(static_cast<unsigned char>(name[0]))) {
+        name++;
+        length--;
+    }
+    while (length > 0 && std::isspace(static_cast<unsigned char>(name[length - 1]))) length--;
+    
+    for (EmotionNode* node = emotionHead; node != nullptr; node = node->next) {
+        if (node->emotion.size() != length) continue;
+        size_t i = 0;
+        while (i < length && node->emotion[i] == std::tolower(static_cast<unsigned char>(name[i]))) i++;
+        if (i == length) return node->id;
+    }
+    return -1;
+}
+
+size_t EmotionPlaylist::appendPlaylistJson(ArenaString& out, const int* emotionIds, size_t emotionCount,
+                                           size_t k, const std::vector<SpellingCorrection>& corrections) const {
+    char number[24];
+    size_t count = 0;
+    out += "{\"songs\": [";
+    // No emotions means the whole catalog, read as one list
+    for (size_t e = 0; e < std::max<size_t>(emotionCount, 1) && count < k; ++e) {
+        SongNode* list = songHead;
+        if (emotionCount > 0) {
+            // A repeated emotion adds nothing new
+            if (std::find(emotionIds, emotionIds + e, emotionIds[e]) != emotionIds + e) continue;
+            EmotionNode* emotion = emotionHead;
+            while (emotion != nullptr && emotion->id != emotionIds[e]) emotion = emotion->next;
+            if (emotion == nullptr) continue;
+            list = emotion->songList;
+        }
+        
+        for (SongNode* node = list; node != nullptr && count < k; node = node->next) {
+            const Song& song = node->data;
+            out += count == 0 ? "{\"id\": " : ", {\"id\": ";
+            out.append(number, static_cast<size_t>(std::to_chars(number, number + sizeof(number), song.id).ptr - number));
+            out += ", \"title\": \"";
+            appendJsonString(out, song.title);
+            out += "\", \"artist\": \"";
+            appendJsonString(out, song.artist);
+            out += "\", \"lyrics\": \"";
+            appendJsonString(out, song.lyrics);
+            out += "\", \"emotion\": \"";
+            appendJsonString(out, song.emotion);
+            out += "\"}";
+            count++;
+        }
+    }
+    out += "], \"count\": ";
+    out.append(number, static_cast<size_t>(std::to_chars(number, number + sizeof(number), count).ptr - number));
+    
+    if (!corrections.empty()) {
+        out += ", \"did_you_mean\": [";
+        for (size_t i = 0; i < corrections.size(); ++i) {
+            const auto& correction = corrections[i];
+            out += i == 0 ? "{\"field\": \"" : ", {\"field\": \"";
+            out += correction.field;
+            out += "\", \"query\": \"";
+            appendJsonString(out, correction.query);
+            out += "\", \"suggestion\": \"";
+            appendJsonString(out, correction.suggestion);
+            out += "\", \"distance\": ";
+            out.append(number, static_cast<size_t>(std::to_chars(number, number + sizeof(number), correction.distance).ptr - number));
+            out += "}";
+        }
+        out += "]";
+    }
+    out += "}";
+    return count;
+}
+
+size_t EmotionPlaylist::appendCompletionJson(ArenaString& out, const std::string& prefix, size_t n) const {
+    char number[24];
+    std::vector<CompletionIndex::Completion> found = complete(prefix, n);
+    out += "{\"completions\": [";
+    for (size_t i = 0; i < found.size(); ++i) {
+        const auto& completion = found[i];
+        out += i == 0 ? "{\"text\": \"" : ", {\"text\": \"";
+        appendJsonString(out, completion.text);
+        out += "\", \"kind\": \"";
+        out += completion.kinds == CompletionIndex::KIND_TITLE ? "title"
+             : completion.kinds == CompletionIndex::KIND_ARTIST ? "artist"
+             : "title,artist";
+        out += "\", \"songs\": ";
+        out.append(number, static_cast<size_t>(std::to_chars(number, number + sizeof(number), completion.weight).ptr - number));
+        out += "}";
+    }
+    out += "], \"count\": ";
+    out.append(number, static_cast<size_t>(std::to_chars(number, number + sizeof(number), found.size()).ptr - number));
+    out += "}";
+    return found.size();
+}
+
+std::string EmotionPlaylist::toJson(const std::vector<CompletionIndex::Completion>& completions) const {
+    std::ostringstream json;
+    json << "{\"completions\": [";
+    for (size_t i = 0; i < completions.size(); ++i) {
+        const auto& completion = completions[i];
+        const char* kind = completion.kinds == CompletionIndex::KIND_TITLE ? "title"
+                         : completion.kinds == CompletionIndex::KIND_ARTIST ? "artist"
+                         : "title,artist";
+        json << (i == 0 ? "\n" : ",\n")
+             << "  {\"text\": \"" << escapeJsonString(completion.text) << "\", "
+             << "\"kind\": \"" << kind << "\", "
+             << "\"songs\": " << completion.weight << "}";
+    }
+    json << "\n], \"count\": " << completions.size() << "}";
+    return json.str();
 }
 
 std::string EmotionPlaylist::toJson(SongNode* songList) const {
+    return toJson(songList, std::vector<SpellingCorrection>());
+}
+
+std::string EmotionPlaylist::toJson(SongNode* songList,
+                                    const std::vector<SpellingCorrection>& corrections) const {
     std::ostringstream json;
     json << "{\"songs\": [";
     
@@ -363,6 +1441,20 @@ std::string EmotionPlaylist::toJson(SongNode* songList) const {
         current = current->next;
     }
     
-    json << "\n], \"count\": " << count << "}";
+    json << "\n], \"count\": " << count;
+    
+    if (!corrections.empty()) {
+        json << ", \"did_you_mean\": [";
+        for (size_t i = 0; i < corrections.size(); ++i) {
+            const auto& correction = corrections[i];
+            json << (i == 0 ? "" : ", ")
+                 << "{\"field\": \"" << correction.field << "\", "
+                 << "\"query\": \"" << escapeJsonString(correction.query) << "\", "
+                 << "\"suggestion\": \"" << escapeJsonString(correction.suggestion) << "\", "
+                 << "\"distance\": " << correction.distance << "}";
+        }
+        json << "]";
+    }
+    json << "}";
     return json.str();
 }
@@ -1,8 +1,21 @@
 #ifndef PLAYLIST_H
 #define PLAYLIST_H
 
+#include <cstdint>
 #include <string>
+#include <utility>
 #include <vector>
+#include "arena.h"
+#include "completion_index.h"
+#include "embedding.h"
+#include "fm_index.h"
+#include "fuzzy_index.h"
+#include "fusion.h"
+#include "hnsw.h"
+#include "id_index.h"
+#include "query_plan.h"
+#include "song_bitmap.h"
+#include "text_index.h"
 
 // Song structure remains the same
 struct Song {
@@ -24,22 +37,79 @@ struct SongNode {
 // Doubly linked list node for emotions
 struct EmotionNode {
     std::string emotion;
+    int id; // Position in the emotion list, used as a compact per-song code
     SongNode* songList; // Points to a singly linked list of songs
+    SongNode* songTail; // Last node of songList, for O(1) appends
     EmotionNode* prev;
     EmotionNode* next;
     
-    EmotionNode(const std::string& e) : emotion(e), songList(nullptr), prev(nullptr), next(nullptr) {}
+    EmotionNode(const std::string& e)
+        : emotion(e), id(0), songList(nullptr), songTail(nullptr), prev(nullptr), next(nullptr) {}
+};
+
+// A query value that matched nothing exactly and was resolved to the
+// closest catalog value instead (reported as "did you mean")
+struct SpellingCorrection {
+    std::string field;      // "emotion", "artist" or "title"
+    std::string query;      // as given
+    std::string suggestion; // normalized catalog value used instead
+    unsigned distance;      // edit distance between the two
+};
+
+// Options for EmotionPlaylist::hybridSearch
+struct HybridOptions {
+    size_t k;              // songs to return
+    size_t depth;          // candidates taken from each retriever before fusion
+    FusionMethod method;
+    double semanticWeight; // lexical weight is 1 - semanticWeight
+    size_t ef;             // HNSW search breadth
+    int seedSongId;        // rank by this song's vector instead of the query text (-1: none)
+    
+    HybridOptions()
+        : k(10), depth(100), method(FusionMethod::ReciprocalRank),
+          semanticWeight(0.5), ef(64), seedSongId(-1) {}
+};
+
+// Bytes held by one part of a loaded catalog, summed from the capacity of
+// every node, container and heap string it owns (allocator overhead aside)
+struct MemoryUsage {
+    const char* part;
+    size_t bytes;
+    
+    MemoryUsage(const char* part, size_t bytes) : part(part), bytes(bytes) {}
 };
 
 class EmotionPlaylist {
 private:
     SongNode* songHead; // Head of the singly linked list of all songs
+    SongNode* songTail; // Last node of the song list, for O(1) appends
     EmotionNode* emotionHead; // Head of the doubly linked list of emotions
+    std::vector<SongNode*> songTable; // Song nodes by ordinal (load order)
+    IdIndex songIds; // Ordinal of each song id
+    
+    EmbeddingStore embeddings; // Per-song vectors, indexed by ordinal
+    HnswIndex vectorIndex; // Approximate nearest-neighbour graph over embeddings
+    size_t vectorRerank; // Candidates re-scored exactly after a quantized search
+    bool textEmbeddings; // Embeddings were derived from lyrics, so query text can be embedded too
+    size_t parseWarnings; // CSV records skipped by the last load
+    uint64_t catalogVersion; // Hash of the loaded CSV records
+    
+    std::vector<int> songEmotion; // Emotion id of each song, by ordinal
+    std::vector<SongBitmap> emotionSongs; // Songs of each emotion id
+    std::vector<SongBitmap> artistSongs;  // Songs of each artist, by artistNames term
+    std::vector<uint32_t> songArtist; // artistNames term of each song, by ordinal
+    std::vector<uint32_t> songTitle;  // titleNames term of each song, by ordinal
+    TextIndex textIndex; // BM25 inverted index over titles and lyrics
+    FmIndex lyricsIndex; // Compressed substring index over lyrics, built on demand
+    FuzzyIndex emotionNames; // Typo-tolerant lookup of emotions (items are emotion ids)
+    FuzzyIndex artistNames;  // ... of artists (items are song ordinals)
+    FuzzyIndex titleNames;   // ... of titles (items are song ordinals)
+    CompletionIndex completions; // Prefix autocomplete over titles and artists, built on demand
     
     void buildEmotionIndex();
     std::vector<std::string> parseCsvLine(const std::string& line);
-    std::string trim(const std::string& str);
-    std::string unquote(const std::string& str);
+    std::string trim(const std::string& str) const;
+    std::string unquote(const std::string& str) const;
     std::string escapeJsonString(const std::string& input) const;
     
     // Helper methods for linked list operations
@@ -47,7 +117,53 @@ private:
     void clearEmotionList();
     EmotionNode* findEmotion(const std::string& emotion) const;
     void addSongToEmotion(EmotionNode* emotionNode, const Song& song);
-    bool songExistsInList(SongNode* head, int songId) const;
+    int findOrdinal(int songId) const;
+    void ensureEmbeddings();
+    void buildTextIndex();
+    void buildFuzzyIndexes();
+    SongNode* buildResultList(const std::vector<ScoredCandidate>& candidates) const;
+    
+    // One flag per emotion id; empty when no emotions were requested (no filter)
+    std::vector<char> emotionMask(const std::vector<std::string>& emotions) const;
+    bool emotionAllowed(const std::vector<char>& mask, uint32_t ordinal) const {
+        return mask.empty() || mask[songEmotion[ordinal]] != 0;
+    }
+    
+    // Term of value in names, or of the closest value within
+    // FuzzyIndex::MAX_DISTANCE edits when none matches exactly; -1 if none
+    int resolveName(const FuzzyIndex& names, const char* field, const std::string& value,
+                    std::vector<SpellingCorrection>* corrections) const;
+    
+    // songs limited to the given emotions (all of songs when none are given)
+    SongBitmap restrictToEmotions(const SongBitmap& songs,
+                                  const std::vector<std::string>& emotions) const;
+    SongNode* buildResultList(const SongBitmap& songs, size_t k) const;
+    
+    // Index key of every query predicate (emotion id or name term, -1 when
+    // unknown, misspellings resolved) and its cardinality for the planner
+    void resolvePredicates(const Query& query, std::vector<int>& keys,
+                           std::vector<PredicateStats>& stats,
+                           std::vector<SpellingCorrection>* corrections) const;
+    SongBitmap predicateSongs(const Query& query, const std::vector<int>& keys, uint32_t node) const;
+    bool songMatches(const Query& query, const std::vector<int>& keys, uint32_t node,
+                     uint32_t ordinal) const;
+    
+    // Execute a plan, recording the actual rows of every step
+    SongBitmap runPlan(const Query& query, const std::vector<int>& keys, PlanNode& step) const;
+    
+    // Lyrics of every song, by ordinal
+    std::vector<const std::string*> lyricsDocuments() const;
+    
+    // Titles and artists of every song, by ordinal
+    void songNames(std::vector<const std::string*>& titles,
+                   std::vector<const std::string*>& artists) const;
+    
+    // Retrievers used by hybridSearch; both return ordinals best first
+    std::vector<ScoredCandidate> lexicalCandidates(const std::string& text, size_t depth,
+                                                   bool requireAll,
+                                                   const std::vector<char>& mask) const;
+    std::vector<ScoredCandidate> semanticCandidates(const float* query, size_t depth, size_t ef,
+                                                    const std::vector<char>& mask) const;
     
 public:
     EmotionPlaylist(const std::string& csvPath);
@@ -59,14 +175,143 @@ public:
     // Filter songs by one or more emotions
     SongNode* filterByEmotions(const std::vector<std::string>& emotions) const;
     
+    // Map each requested emotion to a catalog emotion: itself when it
+    // exists (ignoring case and surrounding spaces), otherwise the closest
+    // one within two edits, which is recorded in corrections. Unknown
+    // emotions are passed through. Every emotion filter resolves this way.
+    std::vector<std::string> resolveEmotions(const std::vector<std::string>& emotions,
+                                             std::vector<SpellingCorrection>* corrections = nullptr) const;
+    
+    // Songs by an artist or with a title, typo-tolerant as above, first k
+    // in catalog order
+    SongNode* findByArtist(const std::string& artist, const std::vector<std::string>& emotions,
+                           size_t k, std::vector<SpellingCorrection>* corrections = nullptr) const;
+    SongNode* findByTitle(const std::string& title, const std::vector<std::string>& emotions,
+                          size_t k, std::vector<SpellingCorrection>* corrections = nullptr) const;
+    
+    // Songs matching a boolean query over emotions, artists, titles and
+    // words (see query.h), first k in catalog order. A cost-based plan
+    // (see query_plan.h) combines index lookups and column checks; explain,
+    // when given, receives it with estimated and actual rows. Throws
+    // std::runtime_error on bad syntax.
+    SongNode* searchQuery(const std::string& query, const std::vector<std::string>& emotions,
+                          size_t k, std::vector<SpellingCorrection>* corrections = nullptr,
+                          std::string* explain = nullptr) const;
+    
+    // Number of songs by an artist (exact match, ignoring case and spacing)
+    size_t countByArtist(const std::string& artist) const;
+    
+    // Other songs by the artist of songId, first k in catalog order
+    SongNode* moreFromArtist(int songId, const std::vector<std::string>& emotions, size_t k) const;
+    
     // Get all songs
     SongNode* getAllSongs() const { return songHead; }
     
+    // Primary-key lookups. The songs stay owned by the playlist and are
+    // valid until the catalog is reloaded; unknown ids give nullptr.
+    const Song* getSongById(int id) const;
+    std::vector<const Song*> getSongs(const std::vector<int>& ids) const;
+    
     // Get all available emotions
     std::vector<std::string> getAvailableEmotions() const;
     
-    // Convert songs to JSON string
+    // Songs loaded, and CSV records the last load skipped as malformed
+    size_t getSongCount() const { return songTable.size(); }
+    size_t getParseWarnings() const { return parseWarnings; }
+    
+    // Fingerprint of the loaded catalog: the same records in the same
+    // order give the same value, any change to them another
+    uint64_t getCatalogVersion() const { return catalogVersion; }
+    
+    // Bytes held by each part of the catalog: the song nodes and their
+    // strings, the per-emotion song lists, per-song columns, postings and
+    // every index. Indexes not built report 0.
+    std::vector<MemoryUsage> memoryUsage() const;
+    
+    // Id of an emotion given exactly (ignoring case and surrounding spaces),
+    // -1 if there is none. Does not allocate.
+    int emotionId(const char* name, size_t length) const;
+    
+    // Append the first k songs of the given emotions (all songs when there
+    // are none) as one line of JSON, {"songs": [...], "count": n}, plus
+    // "did_you_mean" when corrections is not empty. Draws only on out's arena.
+    // Returns the number of songs written.
+    size_t appendPlaylistJson(ArenaString& out, const int* emotionIds, size_t emotionCount,
+                              size_t k, const std::vector<SpellingCorrection>& corrections) const;
+    
+    // Append the top n completions of prefix (see complete) as one line of
+    // JSON, {"completions": [...], "count": n}. Throws std::runtime_error if
+    // the completion index has not been built. Returns the number written.
+    size_t appendCompletionJson(ArenaString& out, const std::string& prefix, size_t n) const;
+    
+    // Load per-song vectors from a CSV of "id,v1,...,vN". Songs missing
+    // from the file fall back to vectors derived from their lyrics.
+    void loadEmbeddings(const std::string& path);
+    
+    // Build the HNSW index over song embeddings (lyric-derived unless
+    // loadEmbeddings was called first)
+    void buildVectorIndex(const HnswIndex::Params& params = HnswIndex::Params());
+    
+    // Persist / restore the HNSW index next to the catalog
+    void saveVectorIndex(const std::string& path) const;
+    void loadVectorIndex(const std::string& path);
+    bool hasVectorIndex() const { return !vectorIndex.empty(); }
+    
+    // Compress embeddings to int8 or product-quantized codes. Call after the
+    // index is built or loaded. With rerankCandidates > 0 the float vectors
+    // are kept so that many top candidates can be re-scored exactly.
+    void quantizeEmbeddings(VectorEncoding encoding, size_t rerankCandidates = 0);
+    size_t embeddingMemoryBytes() const { return embeddings.memoryBytes(); }
+    
+    // Songs most similar to songId, best first, optionally restricted to
+    // the given emotions. ef is the HNSW search breadth.
+    SongNode* findSimilar(int songId, size_t k, size_t ef,
+                          const std::vector<std::string>& emotions) const;
+    
+    // BM25 keyword search over titles and lyrics. query is plain words or
+    // text:"..."; requireAll keeps only songs containing every word. Quoted
+    // phrases and "a NEAR/k b" are matched by word position.
+    SongNode* searchText(const std::string& query, const std::vector<std::string>& emotions,
+                         size_t k, bool requireAll = false) const;
+    
+    // Songs whose title, artist or lyrics contain a match of pattern (see
+    // regex_matcher.h for the syntax), first k in catalog order. Throws
+    // std::runtime_error on a malformed pattern.
+    SongNode* searchRegex(const std::string& pattern, const std::vector<std::string>& emotions,
+                          size_t k) const;
+    
+    // Build, persist or restore the FM-index over all lyrics
+    void buildSubstringIndex(const FmIndex::Params& params = FmIndex::Params());
+    void saveSubstringIndex(const std::string& path) const;
+    void loadSubstringIndex(const std::string& path);
+    bool hasSubstringIndex() const { return !lyricsIndex.empty(); }
+    size_t substringIndexMemoryBytes() const { return lyricsIndex.memoryBytes(); }
+    
+    // Songs whose lyrics contain text as a raw substring (ASCII
+    // case-insensitive, no tokenization), most occurrences first
+    SongNode* searchSubstring(const std::string& text, const std::vector<std::string>& emotions,
+                              size_t k) const;
+    
+    // Build, persist or map back the autocomplete index
+    void buildCompletionIndex();
+    void saveCompletionIndex(const std::string& path) const;
+    void loadCompletionIndex(const std::string& path);
+    bool hasCompletionIndex() const { return !completions.empty(); }
+    
+    // Top n titles and artists starting with prefix (ignoring case), the
+    // most songs first
+    std::vector<CompletionIndex::Completion> complete(const std::string& prefix, size_t n) const;
+    
+    // Keyword and embedding retrieval run in parallel, merged by rank fusion
+    // (or weighted scores); only the fused top k songs are copied out.
+    SongNode* hybridSearch(const std::string& text, const std::vector<std::string>& emotions,
+                           const HybridOptions& options = HybridOptions()) const;
+    
+    // Convert songs to JSON string, with a "did_you_mean" list when any
+    // query value was corrected
     std::string toJson(SongNode* songList) const;
+    std::string toJson(SongNode* songList, const std::vector<SpellingCorrection>& corrections) const;
+    std::string toJson(const std::vector<CompletionIndex::Completion>& completions) const;
 };
 
 #endif // PLAYLIST_H
@@ -0,0 +1,345 @@
+#include "posting_codec.h"
+#include <algorithm>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define PLAYLIST_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+inline size_t byteLength(uint32_t value) {
+    if (value < (1u << 8)) return 1;
+    if (value < (1u << 16)) return 2;
+    if (value < (1u << 24)) return 3;
+    return 4;
+}
+
+// Per control byte: total data bytes and the pshufb mask that spreads
+// them into four little-endian 32-bit lanes
+struct ControlTables {
+    uint8_t length[256];
+    uint8_t shuffle[256][16];
+
+    ControlTables() {
+        for (int control = 0; control < 256; ++control) {
+            int offset = 0;
+            for (int lane = 0; lane < 4; ++lane) {
+                int bytes = ((control >> (2 * lane)) & 3) + 1;
+                for (int b = 0; b < 4; ++b) {
+                    shuffle[control][lane * 4 + b] =
+                        b < bytes ? static_cast<uint8_t>(offset + b) : 0xff;
+                }
+                offset += bytes;
+            }
+            length[control] = static_cast<uint8_t>(offset);
+        }
+    }
+};
+
+const ControlTables& controlTables() {
+    static const ControlTables tables;
+    return tables;
+}
+
+inline uint32_t readValue(const uint8_t* data, size_t bytes) {
+    uint32_t value = 0;
+    for (size_t b = 0; b < bytes; ++b) value |= static_cast<uint32_t>(data[b]) << (8 * b);
+    return value;
+}
+
+size_t decodeScalar(const uint8_t* in, size_t count, uint32_t* out, bool delta, uint32_t base) {
+    const uint8_t* control = in;
+    const uint8_t* data = in + (count + 3) / 4;
+    uint32_t previous = base;
+    for (size_t i = 0; i < count; ++i) {
+        size_t bytes = ((control[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        uint32_t value = readValue(data, bytes);
+        data += bytes;
+        if (delta) {
+            previous += value;
+            value = previous;
+        }
+        out[i] = value;
+    }
+    return static_cast<size_t>(data - in);
+}
+
+#ifdef PLAYLIST_X86_DISPATCH
+
+__attribute__((target("ssse3")))
+size_t decodeSsse3(const uint8_t* in, size_t count, uint32_t* out, bool delta, uint32_t base) {
+    const ControlTables& tables = controlTables();
+    const uint8_t* control = in;
+    const uint8_t* data = in + (count + 3) / 4;
+    __m128i previous = _mm_set1_epi32(static_cast<int>(base));
+
+    size_t groups = count / 4;
+    for (size_t g = 0; g < groups; ++g) {
+        uint8_t c = control[g];
+        __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.shuffle[c]));
+        __m128i values = _mm_shuffle_epi8(raw, mask);
+        data += tables.length[c];
+
+        if (delta) {
+            // In-register prefix sum of the four gaps, then add the running total
+            values = _mm_add_epi32(values, _mm_slli_si128(values, 4));
+            values = _mm_add_epi32(values, _mm_slli_si128(values, 8));
+            values = _mm_add_epi32(values, previous);
+            previous = _mm_shuffle_epi32(values, 0xff);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * g), values);
+    }
+
+    uint32_t running = static_cast<uint32_t>(_mm_cvtsi128_si32(previous));
+    for (size_t i = groups * 4; i < count; ++i) {
+        size_t bytes = ((control[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        uint32_t value = readValue(data, bytes);
+        data += bytes;
+        if (delta) {
+            running += value;
+            value = running;
+        }
+        out[i] = value;
+    }
+    return static_cast<size_t>(data - in);
+}
+
+#endif // PLAYLIST_X86_DISPATCH
+
+typedef size_t (*DecodeFunction)(const uint8_t*, size_t, uint32_t*, bool, uint32_t);
+
+struct Decoder {
+    DecodeFunction decode;
+    const char* name;
+};
+
+Decoder selectDecoder() {
+#ifdef PLAYLIST_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3")) {
+        controlTables();
+        return Decoder{decodeSsse3, "ssse3"};
+    }
+#endif
+    return Decoder{decodeScalar, "scalar"};
+}
+
+const Decoder& decoder() {
+    static const Decoder selected = selectDecoder();
+    return selected;
+}
+
+} // namespace
+
+size_t streamVByteMaxBytes(size_t count) {
+    return (count + 3) / 4 + count * 4;
+}
+
+size_t streamVByteEncode(const uint32_t* in, size_t count, uint8_t* out) {
+    uint8_t* control = out;
+    uint8_t* data = out + (count + 3) / 4;
+    std::memset(control, 0, (count + 3) / 4);
+
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t value = in[i];
+        size_t bytes = byteLength(value);
+        control[i / 4] |= static_cast<uint8_t>((bytes - 1) << (2 * (i % 4)));
+        for (size_t b = 0; b < bytes; ++b) *data++ = static_cast<uint8_t>(value >> (8 * b));
+    }
+    return static_cast<size_t>(data - out);
+}
+
+size_t streamVByteDecode(const uint8_t* in, size_t count, uint32_t* out) {
+    return decoder().decode(in, count, out, false, 0);
+}
+
+size_t streamVByteDecodeDelta(const uint8_t* in, size_t count, uint32_t base, uint32_t* out) {
+    return decoder().decode(in, count, out, true, base);
+}
+
+size_t streamVByteDecodeScalar(const uint8_t* in, size_t count, uint32_t* out) {
+    return decodeScalar(in, count, out, false, 0);
+}
+
+size_t streamVByteDecodeDeltaScalar(const uint8_t* in, size_t count, uint32_t base, uint32_t* out) {
+    return decodeScalar(in, count, out, true, base);
+}
+
+const char* postingDecoderName() {
+    return decoder().name;
+}
+
+void CompressedPostings::encode(const std::vector<uint32_t>& docs,
+                                const std::vector<uint32_t>& freqs,
+                                const std::vector<uint32_t>* positionCounts,
+                                const std::vector<uint32_t>* positions) {
+    count = static_cast<uint32_t>(docs.size());
+    skips.clear();
+    bytes.clear();
+    positionBytes.clear();
+    bool withPositions = positionCounts != nullptr && positions != nullptr;
+
+    std::vector<uint32_t> gaps(POSTING_BLOCK);
+    std::vector<uint8_t> scratch(streamVByteMaxBytes(POSTING_BLOCK));
+    std::vector<uint32_t> positionGaps;
+    std::vector<uint8_t> positionScratch;
+    size_t nextPosition = 0;
+    uint32_t previous = 0;
+
+    for (size_t start = 0; start < docs.size(); start += POSTING_BLOCK) {
+        size_t length = std::min(POSTING_BLOCK, docs.size() - start);
+        for (size_t i = 0; i < length; ++i) {
+            gaps[i] = docs[start + i] - previous;
+            previous = docs[start + i];
+        }
+
+        Skip skip;
+        skip.lastDoc = previous;
+        skip.docOffset = static_cast<uint32_t>(bytes.size());
+        size_t written = streamVByteEncode(gaps.data(), length, scratch.data());
+        bytes.insert(bytes.end(), scratch.begin(), scratch.begin() + written);
+
+        skip.freqOffset = static_cast<uint32_t>(bytes.size());
+        written = streamVByteEncode(&freqs[start], length, scratch.data());
+        bytes.insert(bytes.end(), scratch.begin(), scratch.begin() + written);
+
+        // Positions: the block's per-document counts, then every position
+        // as a gap from the previous one in the same document
+        skip.positionOffset = static_cast<uint32_t>(positionBytes.size());
+        if (withPositions) {
+            written = streamVByteEncode(&(*positionCounts)[start], length, scratch.data());
+            positionBytes.insert(positionBytes.end(), scratch.begin(), scratch.begin() + written);
+
+            positionGaps.clear();
+            for (size_t i = 0; i < length; ++i) {
+                uint32_t last = 0;
+                for (uint32_t p = 0; p < (*positionCounts)[start + i]; ++p) {
+                    uint32_t position = (*positions)[nextPosition++];
+                    positionGaps.push_back(position - last);
+                    last = position;
+                }
+            }
+            positionScratch.resize(streamVByteMaxBytes(positionGaps.size()));
+            written = streamVByteEncode(positionGaps.data(), positionGaps.size(),
+                                        positionScratch.data());
+            positionBytes.insert(positionBytes.end(), positionScratch.begin(),
+                                 positionScratch.begin() + written);
+        }
+        skips.push_back(skip);
+    }
+
+    bytes.resize(bytes.size() + STREAM_VBYTE_PADDING, 0);
+    bytes.shrink_to_fit();
+    if (withPositions && count > 0) {
+        positionBytes.resize(positionBytes.size() + STREAM_VBYTE_PADDING, 0);
+    }
+    positionBytes.shrink_to_fit();
+    skips.shrink_to_fit();
+}
+
+size_t CompressedPostings::blockSize(size_t block) const {
+    size_t start = block * POSTING_BLOCK;
+    return std::min(POSTING_BLOCK, static_cast<size_t>(count) - start);
+}
+
+void CompressedPostings::decodeDocs(size_t block, uint32_t* docs) const {
+    uint32_t base = block == 0 ? 0 : skips[block - 1].lastDoc;
+    streamVByteDecodeDelta(&bytes[skips[block].docOffset], blockSize(block), base, docs);
+}
+
+void CompressedPostings::decodeFreqs(size_t block, uint32_t* freqs) const {
+    streamVByteDecode(&bytes[skips[block].freqOffset], blockSize(block), freqs);
+}
+
+void CompressedPostings::decodePositions(size_t block, std::vector<uint32_t>& positions,
+                                         uint32_t* starts) const {
+    size_t length = blockSize(block);
+    uint32_t counts[POSTING_BLOCK];
+    const uint8_t* in = &positionBytes[skips[block].positionOffset];
+    in += streamVByteDecode(in, length, counts);
+
+    starts[0] = 0;
+    for (size_t i = 0; i < length; ++i) starts[i + 1] = starts[i] + counts[i];
+    positions.resize(starts[length]);
+    streamVByteDecode(in, positions.size(), positions.data());
+
+    for (size_t i = 0; i < length; ++i) {
+        for (uint32_t p = starts[i] + 1; p < starts[i + 1]; ++p) positions[p] += positions[p - 1];
+    }
+}
+
+size_t CompressedPostings::memoryBytes() const {
+    return sizeof(*this) + skips.capacity() * sizeof(Skip) + bytes.capacity() +
+           positionBytes.capacity();
+}
+
+PostingCursor::PostingCursor(const CompressedPostings* postings)
+    : list(postings), block(0), pos(0), blockLength(0), freqsDecoded(false),
+      positionsDecoded(false) {
+    if (list->blockCount() > 0) loadBlock(0);
+}
+
+void PostingCursor::loadBlock(size_t index) {
+    block = index;
+    pos = 0;
+    freqsDecoded = false;
+    positionsDecoded = false;
+    if (done()) return;
+    blockLength = list->blockSize(block);
+    list->decodeDocs(block, docs);
+}
+
+uint32_t PostingCursor::freq() {
+    if (!freqsDecoded) {
+        list->decodeFreqs(block, freqs);
+        freqsDecoded = true;
+    }
+    return freqs[pos];
+}
+
+const uint32_t* PostingCursor::positions(size_t& count) {
+    if (!positionsDecoded) {
+        list->decodePositions(block, positionBuffer, positionStarts);
+        positionsDecoded = true;
+    }
+    count = positionStarts[pos + 1] - positionStarts[pos];
+    return positionBuffer.data() + positionStarts[pos];
+}
+
+void PostingCursor::next() {
+    if (++pos >= blockLength) loadBlock(block + 1);
+}
+
+void PostingCursor::advanceTo(uint32_t target) {
+    if (done() || docs[pos] >= target) return;
+
+    if (list->blockLastDoc(block) < target) {
+        // Skip whole blocks: gallop over the skip entries, then binary search
+        // for the first block ending at or after the target
+        size_t blocks = list->blockCount();
+        size_t low = block + 1;
+        size_t high = low;
+        size_t step = 1;
+        while (high < blocks && list->blockLastDoc(high) < target) {
+            low = high + 1;
+            high += step;
+            step *= 2;
+        }
+        high = std::min(high, blocks);
+        while (low < high) {
+            size_t mid = low + (high - low) / 2;
+            if (list->blockLastDoc(mid) < target) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        loadBlock(low);
+        if (done()) return;
+    }
+
+    pos = static_cast<size_t>(std::lower_bound(docs + pos, docs + blockLength, target) - docs);
+}
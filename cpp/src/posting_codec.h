@@ -0,0 +1,117 @@
+#ifndef POSTING_CODEC_H
+#define POSTING_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Documents per compressed block; skip entries are kept per block
+const size_t POSTING_BLOCK = 128;
+
+// Stream-VByte: one control byte holds the byte lengths (1-4) of four
+// integers, followed by the integers' significant bytes. Decoding runs
+// four integers per shuffle on SSSE3 CPUs, with a scalar fallback.
+// Decoders may read up to 16 bytes past the encoded data, so buffers
+// handed to them must carry that much padding.
+const size_t STREAM_VBYTE_PADDING = 16;
+
+size_t streamVByteMaxBytes(size_t count);
+size_t streamVByteEncode(const uint32_t* in, size_t count, uint8_t* out);
+
+// Decode count integers; returns bytes consumed
+size_t streamVByteDecode(const uint8_t* in, size_t count, uint32_t* out);
+
+// Decode count gaps and prefix-sum them onto base (delta-coded doc ids)
+size_t streamVByteDecodeDelta(const uint8_t* in, size_t count, uint32_t base, uint32_t* out);
+
+// The same with the portable decoder, whatever the CPU supports; the
+// selected decoder must produce identical output
+size_t streamVByteDecodeScalar(const uint8_t* in, size_t count, uint32_t* out);
+size_t streamVByteDecodeDeltaScalar(const uint8_t* in, size_t count, uint32_t base, uint32_t* out);
+
+// Name of the decoder selected for this CPU ("ssse3" or "scalar")
+const char* postingDecoderName();
+
+// An immutable posting list: ascending document ids with a frequency per
+// document, delta-encoded in blocks of POSTING_BLOCK with a skip entry
+// (last doc id and byte offsets) per block. Word positions, when given,
+// go to a separate stream so that plain BM25 never touches them.
+class CompressedPostings {
+public:
+    struct Skip {
+        uint32_t lastDoc;
+        uint32_t docOffset;
+        uint32_t freqOffset;
+        uint32_t positionOffset;
+    };
+
+    CompressedPostings() : count(0) {}
+
+    // positionCounts holds the number of positions of each document and
+    // positions their ascending values, concatenated in document order
+    void encode(const std::vector<uint32_t>& docs, const std::vector<uint32_t>& freqs,
+                const std::vector<uint32_t>* positionCounts = nullptr,
+                const std::vector<uint32_t>* positions = nullptr);
+
+    size_t size() const { return count; }
+    size_t blockCount() const { return skips.size(); }
+    size_t blockSize(size_t block) const;
+    uint32_t blockLastDoc(size_t block) const { return skips[block].lastDoc; }
+
+    // Decode one block into arrays of at least POSTING_BLOCK entries
+    void decodeDocs(size_t block, uint32_t* docs) const;
+    void decodeFreqs(size_t block, uint32_t* freqs) const;
+
+    // Decode the positions of one block; document i's positions are
+    // positions[starts[i]] .. positions[starts[i + 1]] (starts holds
+    // POSTING_BLOCK + 1 entries)
+    bool hasPositions() const { return !positionBytes.empty(); }
+    void decodePositions(size_t block, std::vector<uint32_t>& positions, uint32_t* starts) const;
+
+    size_t memoryBytes() const;
+    size_t positionMemoryBytes() const { return positionBytes.capacity(); }
+
+private:
+    uint32_t count;
+    std::vector<Skip> skips;
+    std::vector<uint8_t> bytes;
+    std::vector<uint8_t> positionBytes;
+};
+
+// Forward iterator over a CompressedPostings list. Blocks are decoded on
+// entry; frequencies and positions only when first asked for.
+class PostingCursor {
+public:
+    explicit PostingCursor(const CompressedPostings* list);
+
+    bool done() const { return block >= list->blockCount(); }
+    uint32_t doc() const { return docs[pos]; }
+    uint32_t freq();
+
+    // Ascending positions of the current document; valid until the cursor moves
+    const uint32_t* positions(size_t& count);
+
+    void next();
+
+    // Move to the first document >= target, skipping whole blocks via the
+    // skip entries without decoding them
+    void advanceTo(uint32_t target);
+
+    const CompressedPostings* postings() const { return list; }
+
+private:
+    const CompressedPostings* list;
+    size_t block;
+    size_t pos;
+    size_t blockLength;
+    bool freqsDecoded;
+    bool positionsDecoded;
+    uint32_t docs[POSTING_BLOCK];
+    uint32_t freqs[POSTING_BLOCK];
+    uint32_t positionStarts[POSTING_BLOCK + 1];
+    std::vector<uint32_t> positionBuffer;
+
+    void loadBlock(size_t index);
+};
+
+#endif // POSTING_CODEC_H
@@ -0,0 +1,174 @@
+#include "profile.h"
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+thread_local uint64_t allocationCount = 0;
+thread_local uint64_t allocationBytes = 0;
+thread_local QueryProfile* currentProfile = nullptr;
+thread_local unsigned stageDepth = 0;
+
+} // namespace
+
+#ifdef PLAYLIST_COUNT_ALLOCATIONS
+namespace {
+
+void* countedAllocate(std::size_t size) noexcept {
+    allocationCount++;
+    allocationBytes += size;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* countedAllocate(std::size_t size, std::align_val_t alignment) noexcept {
+    allocationCount++;
+    allocationBytes += size;
+    // aligned_alloc wants a multiple of the alignment
+    std::size_t align = static_cast<std::size_t>(alignment);
+    return std::aligned_alloc(align, (size + align - 1) / align * align + (size == 0 ? align : 0));
+}
+
+} // namespace
+
+// Counting replacements for every global allocation function. All of them
+// allocate with malloc and free with free, so memory taken by one form (the
+// standard library uses the nothrow one) can be released by any other.
+void* operator new(std::size_t size) {
+    if (void* memory = countedAllocate(size)) return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    if (void* memory = countedAllocate(size)) return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return countedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return countedAllocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    if (void* memory = countedAllocate(size, alignment)) return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    if (void* memory = countedAllocate(size, alignment)) return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return countedAllocate(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return countedAllocate(size, alignment);
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { std::free(memory); }
+#endif
+
+bool countingAllocations() {
+#ifdef PLAYLIST_COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint64_t threadAllocations() {
+    return allocationCount;
+}
+
+uint64_t threadAllocatedBytes() {
+    return allocationBytes;
+}
+
+ProfileSession::ProfileSession(QueryProfile* profile) : previous(currentProfile) {
+    currentProfile = profile;
+}
+
+ProfileSession::~ProfileSession() {
+    currentProfile = previous;
+}
+
+QueryProfile* ProfileSession::active() {
+    return currentProfile;
+}
+
+ProfileStage::ProfileStage(const char* name, size_t rowsIn)
+    : profile(currentProfile), index(0), trace(name) {
+    if (profile == nullptr) return;
+    index = profile->stages.size();
+    profile->stages.push_back(StageTiming{name, 0, rowsIn, 0, 0, 0, stageDepth++});
+    profile->stages[index].allocations = allocationCount;
+    profile->stages[index].allocatedBytes = allocationBytes;
+    start = std::chrono::steady_clock::now();
+}
+
+ProfileStage::~ProfileStage() {
+    stop();
+}
+
+void ProfileStage::stop() {
+    trace.stop();
+    if (profile == nullptr) return;
+    StageTiming& stage = profile->stages[index];
+    stage.nanos = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    stage.allocations = allocationCount - stage.allocations;
+    stage.allocatedBytes = allocationBytes - stage.allocatedBytes;
+    stageDepth--;
+    profile = nullptr;
+}
+
+void ProfileStage::setRowsIn(size_t rows) {
+    if (profile != nullptr) profile->stages[index].rowsIn = rows;
+}
+
+void ProfileStage::setRowsOut(size_t rows) {
+    if (profile != nullptr) profile->stages[index].rowsOut = rows;
+}
+
+uint64_t QueryProfile::totalNanos() const {
+    uint64_t total = 0;
+    for (const auto& stage : stages) {
+        if (stage.depth == 0) total += stage.nanos;
+    }
+    return total;
+}
+
+std::string QueryProfile::toJson() const {
+    std::string json = "{\"total_ns\": " + std::to_string(totalNanos()) +
+                       ", \"bytes_serialized\": " + std::to_string(bytesSerialized) + ", \"stages\": [";
+    for (size_t i = 0; i < stages.size(); ++i) {
+        const StageTiming& stage = stages[i];
+        if (i > 0) json += ", ";
+        json += "{\"stage\": \"" + std::string(stage.name) + "\"";
+        json += ", \"depth\": " + std::to_string(stage.depth);
+        json += ", \"ns\": " + std::to_string(stage.nanos);
+        json += ", \"rows_in\": " + std::to_string(stage.rowsIn);
+        json += ", \"rows_out\": " + std::to_string(stage.rowsOut);
+        if (countingAllocations()) {
+            json += ", \"allocations\": " + std::to_string(stage.allocations);
+            json += ", \"allocated_bytes\": " + std::to_string(stage.allocatedBytes);
+        }
+        json += "}";
+    }
+    return json + "]}";
+}
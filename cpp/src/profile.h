@@ -0,0 +1,82 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "trace.h"
+
+// Time, rows and heap allocations of one stage of a request
+struct StageTiming {
+    const char* name;
+    uint64_t nanos;
+    size_t rowsIn;
+    size_t rowsOut;
+    uint64_t allocations;
+    uint64_t allocatedBytes;
+    unsigned depth; // number of enclosing stages
+};
+
+// Per-stage breakdown of one request, stages in the order they started.
+// While a ProfileSession is open on a thread, every ProfileStage on that
+// thread records into it.
+struct QueryProfile {
+    std::vector<StageTiming> stages;
+    size_t bytesSerialized; // size of the serialized response
+
+    QueryProfile() : bytesSerialized(0) {}
+
+    uint64_t totalNanos() const; // of the outermost stages
+    std::string toJson() const;
+};
+
+// Operator new calls and bytes requested by the calling thread so far.
+// Counting replaces the global operator new, so it covers every container.
+// It is built in with COUNT_ALLOCATIONS; without it both stay 0.
+bool countingAllocations();
+uint64_t threadAllocations();
+uint64_t threadAllocatedBytes();
+
+// Routes the calling thread's stages into profile for the session's lifetime
+class ProfileSession {
+public:
+    explicit ProfileSession(QueryProfile* profile);
+    ~ProfileSession();
+
+    ProfileSession(const ProfileSession&) = delete;
+    ProfileSession& operator=(const ProfileSession&) = delete;
+
+    // The calling thread's profile, or nullptr when not profiling
+    static QueryProfile* active();
+
+private:
+    QueryProfile* previous;
+};
+
+// Times the enclosing scope as one stage, which is also a trace span (see
+// trace.h). Outside a session and a trace it costs a thread-local load and
+// no clock reads.
+class ProfileStage {
+public:
+    explicit ProfileStage(const char* name, size_t rowsIn = 0);
+    ~ProfileStage();
+
+    ProfileStage(const ProfileStage&) = delete;
+    ProfileStage& operator=(const ProfileStage&) = delete;
+
+    void setRowsIn(size_t rows);
+    void setRowsOut(size_t rows);
+
+    // End the stage before the scope does
+    void stop();
+
+private:
+    QueryProfile* profile;
+    size_t index; // of this stage in profile->stages
+    std::chrono::steady_clock::time_point start;
+    TraceSpan trace;
+};
+
+#endif // PROFILE_H
@@ -0,0 +1,203 @@
+#include "quantization.h"
+#include "distance_kernels.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+// Training uses at most this many vectors per codebook
+const size_t MAX_TRAINING_VECTORS = 32768;
+const int KMEANS_ITERATIONS = 12;
+
+// Lloyd's k-means over count points of subDim floats (stride apart)
+void kmeans(const float* points, size_t count, size_t stride, size_t subDim,
+            size_t clusters, float* centers, std::mt19937_64& rng) {
+    std::vector<size_t> order(count);
+    for (size_t i = 0; i < count; ++i) order[i] = i;
+    std::shuffle(order.begin(), order.end(), rng);
+
+    for (size_t c = 0; c < clusters; ++c) {
+        const float* p = points + order[c % count] * stride;
+        std::copy(p, p + subDim, centers + c * subDim);
+    }
+
+    std::vector<uint32_t> assignment(count, 0);
+    std::vector<float> sums(clusters * subDim);
+    std::vector<size_t> sizes(clusters);
+
+    for (int iteration = 0; iteration < KMEANS_ITERATIONS; ++iteration) {
+        for (size_t i = 0; i < count; ++i) {
+            const float* p = points + i * stride;
+            float best = std::numeric_limits<float>::max();
+            for (size_t c = 0; c < clusters; ++c) {
+                float d = l2SquaredKernel(p, centers + c * subDim, subDim);
+                if (d < best) {
+                    best = d;
+                    assignment[i] = static_cast<uint32_t>(c);
+                }
+            }
+        }
+
+        std::fill(sums.begin(), sums.end(), 0.0f);
+        std::fill(sizes.begin(), sizes.end(), 0);
+        for (size_t i = 0; i < count; ++i) {
+            const float* p = points + i * stride;
+            float* sum = &sums[assignment[i] * subDim];
+            for (size_t d = 0; d < subDim; ++d) sum[d] += p[d];
+            sizes[assignment[i]]++;
+        }
+
+        std::uniform_int_distribution<size_t> pick(0, count - 1);
+        for (size_t c = 0; c < clusters; ++c) {
+            float* center = centers + c * subDim;
+            if (sizes[c] == 0) {
+                // Re-seed empty clusters from a random point
+                const float* p = points + pick(rng) * stride;
+                std::copy(p, p + subDim, center);
+                continue;
+            }
+            for (size_t d = 0; d < subDim; ++d) {
+                center[d] = sums[c * subDim + d] / static_cast<float>(sizes[c]);
+            }
+        }
+    }
+}
+
+} // namespace
+
+void ScalarQuantizer::train(const float* data, size_t count, size_t dimension) {
+    dim = dimension;
+    lower.assign(dim, std::numeric_limits<float>::max());
+    std::vector<float> upper(dim, std::numeric_limits<float>::lowest());
+
+    for (size_t i = 0; i < count; ++i) {
+        const float* vec = data + i * dim;
+        for (size_t d = 0; d < dim; ++d) {
+            lower[d] = std::min(lower[d], vec[d]);
+            upper[d] = std::max(upper[d], vec[d]);
+        }
+    }
+
+    step.assign(dim, 1.0f);
+    weight.assign(dim, 1.0f);
+    for (size_t d = 0; d < dim; ++d) {
+        if (count == 0) lower[d] = 0.0f;
+        float range = count == 0 ? 0.0f : upper[d] - lower[d];
+        step[d] = range > 0.0f ? range / 255.0f : 1.0f;
+        weight[d] = step[d] * step[d];
+    }
+}
+
+void ScalarQuantizer::encode(const float* vec, uint8_t* code) const {
+    for (size_t d = 0; d < dim; ++d) {
+        float q = std::round((vec[d] - lower[d]) / step[d]);
+        code[d] = static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, q)));
+    }
+}
+
+void ScalarQuantizer::decode(const uint8_t* code, float* out) const {
+    for (size_t d = 0; d < dim; ++d) out[d] = lower[d] + step[d] * code[d];
+}
+
+void ScalarQuantizer::prepare(const float* query, float* prepared) const {
+    for (size_t d = 0; d < dim; ++d) prepared[d] = (query[d] - lower[d]) / step[d];
+}
+
+float ScalarQuantizer::distance(const float* prepared, const uint8_t* code) const {
+    return scalarCodeDistanceKernel(prepared, weight.data(), code, dim);
+}
+
+size_t ScalarQuantizer::memoryBytes() const {
+    return (lower.capacity() + step.capacity() + weight.capacity()) * sizeof(float);
+}
+
+void ProductQuantizer::train(const float* data, size_t count, size_t dimension,
+                             size_t subspaceCount, unsigned threads, unsigned long long seed) {
+    if (subspaceCount == 0 || dimension % subspaceCount != 0) {
+        throw std::invalid_argument("Product quantizer subspaces must divide the dimension");
+    }
+    if (count == 0) {
+        throw std::invalid_argument("Product quantizer needs training vectors");
+    }
+
+    dim = dimension;
+    subspaces = subspaceCount;
+    subDim = dim / subspaces;
+    centroids.assign(subspaces * CENTROIDS * subDim, 0.0f);
+
+    // Copy an evenly spaced sample so training cost does not grow with the catalog
+    size_t sampleCount = std::min(count, MAX_TRAINING_VECTORS);
+    std::vector<float> sample(sampleCount * dim);
+    for (size_t i = 0; i < sampleCount; ++i) {
+        const float* vec = data + (i * count / sampleCount) * dim;
+        std::copy(vec, vec + dim, sample.begin() + i * dim);
+    }
+
+    size_t clusters = std::min(CENTROIDS, sampleCount);
+    unsigned threadCount = threads != 0 ? threads : std::thread::hardware_concurrency();
+    threadCount = std::max(1u, std::min<unsigned>(threadCount, static_cast<unsigned>(subspaces)));
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        TRACE_SCOPE("pq/kmeans");
+        for (size_t s = next++; s < subspaces; s = next++) {
+            std::mt19937_64 rng(seed + s);
+            kmeans(sample.data() + s * subDim, sampleCount, dim, subDim, clusters,
+                   &centroids[s * CENTROIDS * subDim], rng);
+            // Unused centroid slots (tiny catalogs) never win: push them far away
+            for (size_t c = clusters; c < CENTROIDS; ++c) {
+                float* center = &centroids[(s * CENTROIDS + c) * subDim];
+                std::fill(center, center + subDim, 1e18f);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threadCount; ++t) workers.emplace_back(worker);
+    worker();
+    for (auto& t : workers) t.join();
+}
+
+void ProductQuantizer::encode(const float* vec, uint8_t* code) const {
+    for (size_t s = 0; s < subspaces; ++s) {
+        const float* part = vec + s * subDim;
+        const float* book = &centroids[s * CENTROIDS * subDim];
+        float best = std::numeric_limits<float>::max();
+        uint8_t bestCode = 0;
+        for (size_t c = 0; c < CENTROIDS; ++c) {
+            float d = l2SquaredKernel(part, book + c * subDim, subDim);
+            if (d < best) {
+                best = d;
+                bestCode = static_cast<uint8_t>(c);
+            }
+        }
+        code[s] = bestCode;
+    }
+}
+
+void ProductQuantizer::decode(const uint8_t* code, float* out) const {
+    for (size_t s = 0; s < subspaces; ++s) {
+        const float* center = &centroids[(s * CENTROIDS + code[s]) * subDim];
+        std::copy(center, center + subDim, out + s * subDim);
+    }
+}
+
+void ProductQuantizer::computeTable(const float* query, float* table) const {
+    for (size_t s = 0; s < subspaces; ++s) {
+        const float* part = query + s * subDim;
+        const float* book = &centroids[s * CENTROIDS * subDim];
+        for (size_t c = 0; c < CENTROIDS; ++c) {
+            table[s * CENTROIDS + c] = l2SquaredKernel(part, book + c * subDim, subDim);
+        }
+    }
+}
+
+float ProductQuantizer::distance(const float* table, const uint8_t* code) const {
+    return tableDistanceKernel(table, code, subspaces);
+}
@@ -0,0 +1,66 @@
+#ifndef QUANTIZATION_H
+#define QUANTIZATION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 8-bit scalar quantizer: each dimension is mapped linearly from its
+// trained [min, max] range onto 0..255 (4x smaller than float32).
+class ScalarQuantizer {
+private:
+    size_t dim;
+    std::vector<float> lower;  // per-dimension minimum
+    std::vector<float> step;   // per-dimension width of one code
+    std::vector<float> weight; // step^2, scales code-space distance back
+
+public:
+    ScalarQuantizer() : dim(0) {}
+
+    void train(const float* data, size_t count, size_t dimension);
+    void encode(const float* vec, uint8_t* code) const;
+    void decode(const uint8_t* code, float* out) const;
+
+    // Map a float query into code space; prepared must hold dimension floats
+    void prepare(const float* query, float* prepared) const;
+
+    // Squared L2 distance between a prepared query and an encoded vector
+    float distance(const float* prepared, const uint8_t* code) const;
+
+    size_t codeSize() const { return dim; }
+    size_t memoryBytes() const;
+};
+
+// Product quantizer: the vector is split into subspaces, each encoded as
+// the index of its nearest of 256 k-means centroids (one byte per subspace).
+class ProductQuantizer {
+private:
+    size_t dim;
+    size_t subspaces;
+    size_t subDim;
+    std::vector<float> centroids; // [subspace][256][subDim]
+
+public:
+    static constexpr size_t CENTROIDS = 256;
+
+    ProductQuantizer() : dim(0), subspaces(0), subDim(0) {}
+
+    // Train codebooks with k-means on (a sample of) data. dimension must be
+    // divisible by subspaceCount. Subspaces are trained in parallel.
+    void train(const float* data, size_t count, size_t dimension, size_t subspaceCount,
+               unsigned threads, unsigned long long seed);
+    void encode(const float* vec, uint8_t* code) const;
+    void decode(const uint8_t* code, float* out) const;
+
+    // Per-query lookup table of partial distances; table holds tableSize() floats
+    void computeTable(const float* query, float* table) const;
+    size_t tableSize() const { return subspaces * CENTROIDS; }
+
+    // Asymmetric distance: query (through its table) to an encoded vector
+    float distance(const float* table, const uint8_t* code) const;
+
+    size_t codeSize() const { return subspaces; }
+    size_t memoryBytes() const { return centroids.capacity() * sizeof(float); }
+};
+
+#endif // QUANTIZATION_H
@@ -0,0 +1,285 @@
+#include "query.h"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+// Parenthesis / NOT nesting beyond which a query is rejected
+const size_t MAX_DEPTH = 256;
+
+struct Token {
+    enum Type { Open, Close, And, Or, Not, Predicate, End };
+    Type type;
+    size_t position;
+    QueryNode::Kind kind; // Predicate only
+    std::string value;
+};
+
+const char* fieldName(QueryNode::Kind kind) {
+    switch (kind) {
+        case QueryNode::Emotion: return "emotion";
+        case QueryNode::Artist: return "artist";
+        case QueryNode::Title: return "title";
+        case QueryNode::Text: return "text";
+        default: return "";
+    }
+}
+
+std::string quoteValue(const std::string& value) {
+    bool plain = !value.empty() && value != "AND" && value != "OR" && value != "NOT";
+    for (char c : value) {
+        if (std::isspace(static_cast<unsigned char>(c)) || c == '(' || c == ')' || c == '"' ||
+            c == ':' || c == '\\') {
+            plain = false;
+        }
+    }
+    if (plain) return value;
+
+    std::string quoted = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+} // namespace
+
+class Query::Parser {
+public:
+    Parser(const std::string& text, std::vector<QueryNode>& nodes)
+        : source(text), tree(nodes), next(0), depth(0) {
+        tokenize();
+    }
+
+    uint32_t parse() {
+        if (tokens[0].type == Token::End) fail(0, "empty query");
+        uint32_t root = parseOr();
+        if (tokens[next].type != Token::End) {
+            fail(tokens[next].position, tokens[next].type == Token::Close ? "unbalanced ')'"
+                                                                           : "unexpected token");
+        }
+        return root;
+    }
+
+private:
+    const std::string& source;
+    std::vector<QueryNode>& tree;
+    std::vector<Token> tokens;
+    size_t next;
+    size_t depth;
+
+    [[noreturn]] void fail(size_t position, const std::string& message) const {
+        throw std::runtime_error("Query syntax error at position " + std::to_string(position + 1) +
+                                 ": " + message);
+    }
+
+    // Quoted string starting at source[at] == '"'; at ends past the quote
+    std::string readQuoted(size_t& at) const {
+        size_t start = at++;
+        std::string value;
+        while (at < source.size() && source[at] != '"') {
+            if (source[at] == '\\' && at + 1 < source.size()) at++;
+            value += source[at++];
+        }
+        if (at >= source.size()) fail(start, "unterminated quote");
+        at++;
+        return value;
+    }
+
+    void tokenize() {
+        size_t at = 0;
+        while (true) {
+            while (at < source.size() && std::isspace(static_cast<unsigned char>(source[at]))) at++;
+            Token token;
+            token.position = at;
+            token.kind = QueryNode::Emotion;
+            if (at >= source.size()) {
+                token.type = Token::End;
+                tokens.push_back(token);
+                return;
+            }
+
+            char c = source[at];
+            if (c == '(' || c == ')') {
+                token.type = c == '(' ? Token::Open : Token::Close;
+                at++;
+            } else if (c == '"') {
+                token.type = Token::Predicate;
+                token.value = readQuoted(at);
+            } else {
+                size_t start = at;
+                while (at < source.size() && !std::isspace(static_cast<unsigned char>(source[at])) &&
+                       source[at] != '(' && source[at] != ')' && source[at] != '"') {
+                    at++;
+                }
+                std::string word = source.substr(start, at - start);
+                size_t colon = word.find(':');
+                if (word == "AND") {
+                    token.type = Token::And;
+                } else if (word == "OR") {
+                    token.type = Token::Or;
+                } else if (word == "NOT") {
+                    token.type = Token::Not;
+                } else if (colon == std::string::npos) {
+                    token.type = Token::Predicate;
+                    token.value = word;
+                } else {
+                    token.type = Token::Predicate;
+                    std::string field = word.substr(0, colon);
+                    std::transform(field.begin(), field.end(), field.begin(), ::tolower);
+                    if (field == "emotion") {
+                        token.kind = QueryNode::Emotion;
+                    } else if (field == "artist") {
+                        token.kind = QueryNode::Artist;
+                    } else if (field == "title") {
+                        token.kind = QueryNode::Title;
+                    } else if (field == "text") {
+                        token.kind = QueryNode::Text;
+                    } else {
+                        fail(start, "unknown field '" + field + "'");
+                    }
+                    token.value = word.substr(colon + 1);
+                    if (token.value.empty() && at < source.size() && source[at] == '"') {
+                        token.value = readQuoted(at);
+                    }
+                    if (token.value.empty()) fail(start, "missing value for " + field);
+                }
+            }
+            tokens.push_back(token);
+        }
+    }
+
+    uint32_t add(QueryNode node) {
+        tree.push_back(std::move(node));
+        return static_cast<uint32_t>(tree.size() - 1);
+    }
+
+    // Operator over operands, absorbing operands that are the same operator
+    uint32_t combine(QueryNode::Kind kind, const std::vector<uint32_t>& operands) {
+        if (operands.size() == 1) return operands[0];
+        QueryNode node;
+        node.kind = kind;
+        for (uint32_t operand : operands) {
+            if (tree[operand].kind == kind) {
+                std::vector<uint32_t> nested = tree[operand].children;
+                node.children.insert(node.children.end(), nested.begin(), nested.end());
+            } else {
+                node.children.push_back(operand);
+            }
+        }
+        return add(node);
+    }
+
+    uint32_t parseOr() {
+        std::vector<uint32_t> operands(1, parseAnd());
+        while (tokens[next].type == Token::Or) {
+            next++;
+            operands.push_back(parseAnd());
+        }
+        return combine(QueryNode::Or, operands);
+    }
+
+    uint32_t parseAnd() {
+        std::vector<uint32_t> operands(1, parseUnary());
+        while (true) {
+            Token::Type type = tokens[next].type;
+            if (type == Token::And) {
+                next++;
+            } else if (type != Token::Not && type != Token::Open && type != Token::Predicate) {
+                break; // adjacent terms are ANDed implicitly
+            }
+            operands.push_back(parseUnary());
+        }
+        return combine(QueryNode::And, operands);
+    }
+
+    uint32_t parseUnary() {
+        const Token& token = tokens[next];
+        if (++depth > MAX_DEPTH) fail(token.position, "query nested too deeply");
+        uint32_t result = 0;
+        switch (token.type) {
+            case Token::Not: {
+                next++;
+                QueryNode node;
+                node.kind = QueryNode::Not;
+                node.children.push_back(parseUnary());
+                result = add(node);
+                break;
+            }
+            case Token::Open:
+                next++;
+                result = parseOr();
+                if (tokens[next].type != Token::Close) fail(token.position, "unbalanced '('");
+                next++;
+                break;
+            case Token::Predicate: {
+                next++;
+                QueryNode node;
+                node.kind = token.kind;
+                node.value = token.value;
+                result = add(node);
+                break;
+            }
+            case Token::End:
+                fail(token.position, "query ends early");
+            default:
+                fail(token.position, "expected a term");
+        }
+        depth--;
+        return result;
+    }
+};
+
+Query::Query(const std::string& text) : top(0) {
+    Parser parser(text, tree);
+    top = parser.parse();
+}
+
+void Query::requireAny(QueryNode::Kind field, const std::vector<std::string>& values) {
+    if (values.empty()) return;
+
+    QueryNode any;
+    any.kind = QueryNode::Or;
+    for (const auto& value : values) {
+        QueryNode predicate;
+        predicate.kind = field;
+        predicate.value = value;
+        tree.push_back(predicate);
+        any.children.push_back(static_cast<uint32_t>(tree.size() - 1));
+    }
+    if (any.children.size() > 1) tree.push_back(any);
+    uint32_t required = static_cast<uint32_t>(tree.size() - 1);
+
+    if (tree[top].kind == QueryNode::And) {
+        tree[top].children.push_back(required);
+        return;
+    }
+    QueryNode both;
+    both.kind = QueryNode::And;
+    both.children.push_back(top);
+    both.children.push_back(required);
+    tree.push_back(both);
+    top = static_cast<uint32_t>(tree.size() - 1);
+}
+
+std::string Query::toString(uint32_t node) const {
+    const QueryNode& current = tree[node];
+    switch (current.kind) {
+        case QueryNode::Not:
+            return "NOT " + toString(current.children[0]);
+        case QueryNode::And:
+        case QueryNode::Or: {
+            std::string text = "(";
+            for (size_t i = 0; i < current.children.size(); ++i) {
+                if (i > 0) text += current.kind == QueryNode::And ? " AND " : " OR ";
+                text += toString(current.children[i]);
+            }
+            return text + ")";
+        }
+        default:
+            return std::string(fieldName(current.kind)) + ":" + quoteValue(current.value);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One node of a parsed playlist query. Operators refer to their operands
+// by index into Query::nodes().
+struct QueryNode {
+    enum Kind { And, Or, Not, Emotion, Artist, Title, Text };
+    Kind kind;
+    std::string value;              // predicate argument
+    std::vector<uint32_t> children; // operator operands
+};
+
+// Boolean playlist query, e.g.
+//     (happy OR excited) AND NOT artist:"Melancholy Souls"
+//
+// Predicates are field:value with field one of emotion, artist, title or
+// text (songs whose title or lyrics contain every word); a bare value is
+// an emotion. Values with spaces are "quoted". AND, OR and NOT are
+// uppercase and bind NOT > AND > OR; adjacent terms are ANDed and
+// parentheses group. Nested ANDs and ORs are flattened.
+class Query {
+public:
+    // Throws std::runtime_error with the offending position on bad syntax
+    explicit Query(const std::string& text);
+
+    const std::vector<QueryNode>& nodes() const { return tree; }
+    uint32_t root() const { return top; }
+
+    // AND the query with "any of values" for a field; no-op when empty
+    void requireAny(QueryNode::Kind field, const std::vector<std::string>& values);
+
+    // Canonical form, fully parenthesized and with every field named
+    std::string toString() const { return toString(top); }
+    std::string toString(uint32_t node) const;
+
+private:
+    class Parser;
+
+    std::vector<QueryNode> tree;
+    uint32_t top;
+};
+
+#endif // QUERY_H
@@ -0,0 +1,162 @@
+#include "query_log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+const char MAGIC[8] = {'P', 'L', 'Q', 'L', 'O', 'G', '1', '\n'};
+const size_t RECORD_HEADER = 8 + 8 + 4 + 4 + 2;
+
+std::atomic<size_t> nextLogId(1);
+
+void putLittle(std::vector<char>& out, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+uint64_t getLittle(const char* in, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i) value |= static_cast<uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+    return value;
+}
+
+} // namespace
+
+QueryLog::QueryLog(const std::string& path)
+    : file(std::fopen(path.c_str(), "wb")), droppedRecords(0), stopping(false), flushWanted(false), id(nextLogId++) {
+    if (file == nullptr) {
+        throw std::runtime_error("Could not create query log: " + path);
+    }
+    std::fwrite(MAGIC, 1, sizeof(MAGIC), file);
+    flusher = std::thread(&QueryLog::flushLoop, this);
+}
+
+QueryLog::~QueryLog() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    flusher.join();
+    std::fclose(file);
+}
+
+uint64_t QueryLog::now() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+QueryLog::Ring& QueryLog::localRing() {
+    // Each thread remembers its ring in the log it last recorded to
+    thread_local size_t ringLog = 0;
+    thread_local Ring* ring = nullptr;
+    if (ringLog != id) {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        rings.emplace_back(new Ring());
+        ring = rings.back().get();
+        ringLog = id;
+    }
+    return *ring;
+}
+
+void QueryLog::record(uint64_t timeNanos, uint64_t catalogVersion, uint64_t latencyNanos, size_t results,
+                      const char* request, size_t length) {
+    Ring& ring = localRing();
+    size_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) == RING_SLOTS) {
+        droppedRecords.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Slot& slot = ring.slots[head % RING_SLOTS];
+    slot.timeNanos = timeNanos;
+    slot.catalogVersion = catalogVersion;
+    slot.latencyNanos = static_cast<uint32_t>(std::min<uint64_t>(latencyNanos, UINT32_MAX));
+    slot.results = static_cast<uint32_t>(std::min<size_t>(results, UINT32_MAX));
+    slot.length = static_cast<uint16_t>(std::min(length, MAX_REQUEST));
+    std::memcpy(slot.request, request, slot.length);
+    ring.head.store(head + 1, std::memory_order_release);
+    // Drain early under bursts rather than drop; a wakeup racing with the
+    // flusher is caught by its next timed wait
+    if (head + 1 - ring.tail.load(std::memory_order_relaxed) == RING_SLOTS / 2) {
+        flushWanted.store(true, std::memory_order_relaxed);
+        wake.notify_one();
+    }
+}
+
+void QueryLog::flushLoop() {
+    std::vector<char> buffer;
+    buffer.reserve(1 << 20);
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    while (!stopping) {
+        wake.wait_for(lock, std::chrono::milliseconds(100), [this]() {
+            return stopping.load() || flushWanted.exchange(false, std::memory_order_relaxed);
+        });
+        lock.unlock();
+        drain(buffer);
+        lock.lock();
+    }
+    lock.unlock();
+    drain(buffer);
+}
+
+void QueryLog::drain(std::vector<char>& buffer) {
+    std::vector<Ring*> pending;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (const auto& ring : rings) pending.push_back(ring.get());
+    }
+    buffer.clear();
+    for (Ring* ring : pending) {
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        size_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            const Slot& slot = ring->slots[tail % RING_SLOTS];
+            putLittle(buffer, slot.timeNanos, 8);
+            putLittle(buffer, slot.catalogVersion, 8);
+            putLittle(buffer, slot.latencyNanos, 4);
+            putLittle(buffer, slot.results, 4);
+            putLittle(buffer, slot.length, 2);
+            buffer.insert(buffer.end(), slot.request, slot.request + slot.length);
+        }
+        ring->tail.store(tail, std::memory_order_release);
+    }
+    if (buffer.empty()) return;
+    std::fwrite(buffer.data(), 1, buffer.size(), file);
+    std::fflush(file);
+}
+
+std::vector<QueryRecord> readQueryLog(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("Could not open query log: " + path);
+    }
+    std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(MAGIC) || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Not a query log: " + path);
+    }
+
+    // A log cut short while being written ends at its last whole record
+    std::vector<QueryRecord> records;
+    size_t at = sizeof(MAGIC);
+    while (at + RECORD_HEADER <= data.size()) {
+        const char* p = data.data() + at;
+        size_t length = static_cast<size_t>(getLittle(p + 24, 2));
+        if (at + RECORD_HEADER + length > data.size()) break;
+        QueryRecord record;
+        record.timeNanos = getLittle(p, 8);
+        record.catalogVersion = getLittle(p + 8, 8);
+        record.latencyNanos = static_cast<uint32_t>(getLittle(p + 16, 4));
+        record.results = static_cast<uint32_t>(getLittle(p + 20, 4));
+        record.request.assign(p + RECORD_HEADER, length);
+        records.push_back(std::move(record));
+        at += RECORD_HEADER + length;
+    }
+    // Rings drain one thread at a time, so restore arrival order
+    std::stable_sort(records.begin(), records.end(), [](const QueryRecord& a, const QueryRecord& b) {
+        return a.timeNanos < b.timeNanos;
+    });
+    return records;
+}
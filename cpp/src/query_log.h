@@ -0,0 +1,94 @@
+#ifndef QUERY_LOG_H
+#define QUERY_LOG_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One answered request as kept in a query log
+struct QueryRecord {
+    uint64_t timeNanos;      // when it arrived, system clock
+    uint64_t catalogVersion; // EmotionPlaylist::getCatalogVersion() answering it
+    uint32_t latencyNanos;   // saturates at about 4.3 s
+    uint32_t results;        // songs returned
+    std::string request;     // normalized request line
+
+    QueryRecord() : timeNanos(0), catalogVersion(0), latencyNanos(0), results(0) {}
+};
+
+// Records every request of a daemon into a binary log. Each thread that
+// records gets its own single-producer ring, so recording is a few stores
+// and never waits; a background thread drains the rings to the file every
+// 100 ms, or sooner once a ring is half full. When a ring is full anyway
+// the record is dropped and counted rather than blocking.
+//
+// File format, all integers little-endian: the 8-byte magic "PLQLOG1\n",
+// then per record u64 time, u64 catalog version, u32 latency, u32 results,
+// u16 request length and the request bytes.
+class QueryLog {
+public:
+    // Throws std::runtime_error if path cannot be created
+    explicit QueryLog(const std::string& path);
+    ~QueryLog(); // drains and closes
+
+    QueryLog(const QueryLog&) = delete;
+    QueryLog& operator=(const QueryLog&) = delete;
+
+    // Requests longer than MAX_REQUEST are cut short. Does not allocate
+    // once the calling thread's ring exists.
+    void record(uint64_t timeNanos, uint64_t catalogVersion, uint64_t latencyNanos, size_t results,
+                const char* request, size_t length);
+
+    uint64_t dropped() const { return droppedRecords.load(std::memory_order_relaxed); }
+
+    static constexpr size_t MAX_REQUEST = 240;
+    static constexpr size_t RING_SLOTS = 4096;
+
+    static uint64_t now(); // system clock, for timeNanos
+
+private:
+    struct Slot {
+        uint64_t timeNanos;
+        uint64_t catalogVersion;
+        uint32_t latencyNanos;
+        uint32_t results;
+        uint16_t length;
+        char request[MAX_REQUEST];
+    };
+
+    // Written by its thread only (head), read by the flusher (tail)
+    struct Ring {
+        Slot slots[RING_SLOTS];
+        alignas(64) std::atomic<size_t> head;
+        alignas(64) std::atomic<size_t> tail;
+
+        Ring() : head(0), tail(0) {}
+    };
+
+    FILE* file;
+    std::mutex ringsMutex;
+    std::vector<std::unique_ptr<Ring>> rings;
+    std::atomic<uint64_t> droppedRecords;
+    std::atomic<bool> stopping;
+    std::atomic<bool> flushWanted; // a ring is half full
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::thread flusher;
+    size_t id; // tells this log's thread rings from another log's
+
+    Ring& localRing();
+    void flushLoop();
+    void drain(std::vector<char>& buffer);
+};
+
+// Reads a file written by QueryLog; throws std::runtime_error if it is not one
+std::vector<QueryRecord> readQueryLog(const std::string& path);
+
+#endif // QUERY_LOG_H
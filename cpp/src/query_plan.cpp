@@ -0,0 +1,215 @@
+#include "query_plan.h"
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+
+namespace {
+
+PlanNode step(PlanNode::Operator op, uint32_t node = 0) {
+    PlanNode result;
+    result.op = op;
+    result.node = node;
+    result.limit = SIZE_MAX;
+    result.estimatedRows = 0.0;
+    result.cost = 0.0;
+    result.actualRows = 0;
+    return result;
+}
+
+// Rows a filter chain keeping fraction keep of its input reads before it has
+// produced limit of them
+double rowsRead(double input, double keep, size_t limit) {
+    if (limit == SIZE_MAX || keep <= 0.0) return input;
+    return std::min(input, static_cast<double>(limit) / keep);
+}
+
+const char* operatorName(PlanNode::Operator op) {
+    switch (op) {
+        case PlanNode::Limit: return "Limit";
+        case PlanNode::IndexScan: return "IndexScan";
+        case PlanNode::FullScan: return "FullScan";
+        case PlanNode::Filter: return "Filter";
+        case PlanNode::Intersect: return "Intersect";
+        case PlanNode::Union: return "Union";
+        case PlanNode::Difference: return "Difference";
+        case PlanNode::Complement: return "Complement";
+    }
+    return "";
+}
+
+void explainStep(const Query& query, const PlanNode& plan, size_t depth, std::string& out) {
+    std::string label = std::string(depth * 2, ' ') + operatorName(plan.op);
+    if (plan.op == PlanNode::Limit) {
+        label += " " + std::to_string(plan.limit);
+    } else if (plan.op == PlanNode::IndexScan || plan.op == PlanNode::Filter) {
+        label += " " + query.toString(plan.node);
+    }
+    char rows[96];
+    std::snprintf(rows, sizeof(rows), "  (est %.0f, actual %zu, cost %.0f)\n",
+                  plan.estimatedRows, plan.actualRows, plan.cost);
+    out += label + rows;
+    for (const PlanNode& child : plan.children) explainStep(query, child, depth + 1, out);
+}
+
+} // namespace
+
+QueryPlanner::QueryPlanner(const Query& query, const std::vector<PredicateStats>& stats,
+                           size_t catalogSize)
+    : query(query), stats(stats), catalog(static_cast<double>(catalogSize)) {}
+
+double QueryPlanner::estimate(uint32_t node) const {
+    const QueryNode& current = query.nodes()[node];
+    switch (current.kind) {
+        case QueryNode::Not:
+            return catalog - estimate(current.children[0]);
+        case QueryNode::And: {
+            double rows = catalog;
+            for (uint32_t child : current.children) {
+                rows *= catalog > 0.0 ? estimate(child) / catalog : 0.0;
+            }
+            return rows;
+        }
+        case QueryNode::Or: {
+            double missed = 1.0;
+            for (uint32_t child : current.children) {
+                missed *= catalog > 0.0 ? 1.0 - estimate(child) / catalog : 1.0;
+            }
+            return catalog * (1.0 - missed);
+        }
+        default:
+            return stats[node].rows;
+    }
+}
+
+bool QueryPlanner::checkable(uint32_t node) const {
+    const QueryNode& current = query.nodes()[node];
+    if (current.children.empty()) return stats[node].column;
+    for (uint32_t child : current.children) {
+        if (!checkable(child)) return false;
+    }
+    return true;
+}
+
+PlanNode QueryPlanner::plan(size_t limit) const {
+    PlanNode root = step(PlanNode::Limit);
+    root.limit = limit;
+    root.children.push_back(planNode(query.root(), limit));
+    root.estimatedRows = std::min(static_cast<double>(limit), root.children[0].estimatedRows);
+    root.cost = root.children[0].cost;
+    return root;
+}
+
+PlanNode QueryPlanner::planNode(uint32_t node, size_t limit) const {
+    const QueryNode& current = query.nodes()[node];
+    switch (current.kind) {
+        case QueryNode::And:
+            return planAnd(node, limit);
+        case QueryNode::Or: {
+            // The first limit rows of a union come from the first limit of each side
+            PlanNode result = step(PlanNode::Union);
+            result.limit = limit;
+            for (uint32_t child : current.children) {
+                result.children.push_back(planNode(child, limit));
+                result.cost += result.children.back().cost + result.children.back().estimatedRows;
+            }
+            result.estimatedRows = estimate(node);
+            return result;
+        }
+        case QueryNode::Not: {
+            PlanNode result = step(PlanNode::Complement);
+            result.children.push_back(planNode(current.children[0], SIZE_MAX));
+            result.estimatedRows = estimate(node);
+            result.cost = result.children[0].cost + catalog;
+            return result;
+        }
+        default: {
+            PlanNode result = step(PlanNode::IndexScan, node);
+            result.estimatedRows = stats[node].rows;
+            result.cost = stats[node].rows;
+            return result;
+        }
+    }
+}
+
+PlanNode QueryPlanner::planAnd(uint32_t node, size_t limit) const {
+    // Most selective first; the smallest positive operand drives the rest
+    std::vector<uint32_t> operands = query.nodes()[node].children;
+    std::stable_sort(operands.begin(), operands.end(), [this](uint32_t a, uint32_t b) {
+        return estimate(a) < estimate(b);
+    });
+    auto positive = std::find_if(operands.begin(), operands.end(), [this](uint32_t operand) {
+        return query.nodes()[operand].kind != QueryNode::Not;
+    });
+
+    PlanNode current = step(PlanNode::FullScan);
+    current.estimatedRows = catalog;
+    current.cost = catalog;
+    if (positive != operands.end()) {
+        current = planNode(*positive, SIZE_MAX);
+        operands.erase(positive);
+    }
+
+    // Probe an index only when merging its rows costs less than checking
+    // the rows that are left
+    std::vector<uint32_t> filters;
+    for (uint32_t operand : operands) {
+        const QueryNode& term = query.nodes()[operand];
+        bool negated = term.kind == QueryNode::Not;
+        PlanNode probe = planNode(negated ? term.children[0] : operand, SIZE_MAX);
+        double mergeCost = probe.cost + current.estimatedRows + probe.estimatedRows;
+        if (checkable(operand) && current.estimatedRows <= mergeCost) {
+            filters.push_back(operand);
+            continue;
+        }
+        PlanNode combined = step(negated ? PlanNode::Difference : PlanNode::Intersect);
+        combined.estimatedRows = catalog > 0.0 ? current.estimatedRows * estimate(operand) / catalog : 0.0;
+        combined.cost = current.cost + mergeCost;
+        combined.children.push_back(std::move(current));
+        combined.children.push_back(std::move(probe));
+        current = std::move(combined);
+    }
+    PlanNode indexed = addFilters(std::move(current), filters, limit);
+    if (!checkable(node)) return indexed;
+
+    // With column checks only, scanning the catalog in order can stop early
+    PlanNode scan = step(PlanNode::FullScan);
+    scan.estimatedRows = catalog;
+    PlanNode scanned = addFilters(std::move(scan), query.nodes()[node].children, limit);
+    return scanned.cost < indexed.cost ? scanned : indexed;
+}
+
+PlanNode QueryPlanner::addFilters(PlanNode input, const std::vector<uint32_t>& filters,
+                                  size_t limit) const {
+    if (filters.empty()) return input;
+
+    std::vector<uint32_t> ordered = filters;
+    std::stable_sort(ordered.begin(), ordered.end(), [this](uint32_t a, uint32_t b) {
+        return estimate(a) < estimate(b);
+    });
+    double keep = 1.0;
+    for (uint32_t filter : ordered) keep *= catalog > 0.0 ? estimate(filter) / catalog : 0.0;
+
+    // A scan streams, so it only costs the rows it reads
+    double rows = rowsRead(input.estimatedRows, keep, limit);
+    if (input.op == PlanNode::FullScan) {
+        input.estimatedRows = rows;
+        input.cost = rows;
+    }
+    PlanNode current = std::move(input);
+    for (uint32_t filter : ordered) {
+        PlanNode checked = step(PlanNode::Filter, filter);
+        checked.limit = limit;
+        checked.cost = current.cost + rows;
+        rows *= catalog > 0.0 ? estimate(filter) / catalog : 0.0;
+        checked.estimatedRows = rows;
+        checked.children.push_back(std::move(current));
+        current = std::move(checked);
+    }
+    return current;
+}
+
+std::string explainPlan(const Query& query, const PlanNode& plan) {
+    std::string out;
+    explainStep(query, plan, 0, out);
+    return out;
+}
@@ -0,0 +1,60 @@
+#ifndef QUERY_PLAN_H
+#define QUERY_PLAN_H
+
+#include "query.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One step of a query plan. Scans and set operations produce a set of song
+// ordinals; a Filter passes on the rows of its input that satisfy its query
+// node, checked song by song against per-song columns, and stops as soon as
+// the rows above it have enough.
+struct PlanNode {
+    enum Operator { Limit, IndexScan, FullScan, Filter, Intersect, Union, Difference, Complement };
+    Operator op;
+    uint32_t node;        // query node a scan or filter evaluates
+    size_t limit;         // rows needed from this step (SIZE_MAX: all)
+    double estimatedRows;
+    double cost;          // estimated rows touched by this step and its inputs
+    size_t actualRows;    // set when the plan runs
+    std::vector<PlanNode> children;
+};
+
+// What the catalog knows about one predicate
+struct PredicateStats {
+    double rows;  // matching songs, from the index's per-value counts
+    bool column;  // can also be checked per song from a column
+};
+
+// Cost-based planner for a parsed Query. Operands of an AND are applied from
+// the most to the least selective; each one either probes its index and
+// intersects, or, when that touches more rows than remain, becomes a column
+// Filter. The result limit is pushed into filters and unions so a scan can
+// stop early, and an AND of column predicates may scan the catalog instead.
+class QueryPlanner {
+public:
+    // stats holds one entry per query node; only predicates are read
+    QueryPlanner(const Query& query, const std::vector<PredicateStats>& stats, size_t catalogSize);
+
+    PlanNode plan(size_t limit) const;
+
+    // Songs matching a node, assuming its predicates are independent
+    double estimate(uint32_t node) const;
+
+private:
+    const Query& query;
+    const std::vector<PredicateStats>& stats;
+    double catalog;
+
+    bool checkable(uint32_t node) const; // every predicate below has a column
+    PlanNode planNode(uint32_t node, size_t limit) const;
+    PlanNode planAnd(uint32_t node, size_t limit) const;
+    PlanNode addFilters(PlanNode input, const std::vector<uint32_t>& filters, size_t limit) const;
+};
+
+// Indented plan, one step per line, with estimated and actual rows
+std::string explainPlan(const Query& query, const PlanNode& plan);
+
+#endif // QUERY_PLAN_H
@@ -0,0 +1,656 @@
+#include "regex_matcher.h"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+namespace {
+
+// Bounds on pattern size: counted repetitions and compiled instructions
+const int MAX_REPEAT = 1000;
+const size_t MAX_INSTRUCTIONS = 100000;
+
+// Largest literal set worth handing to the prefilter
+const size_t MAX_LITERALS = 64;
+
+// Literal strings implied by a subpattern. When exact, every match of the
+// subpattern is one of the strings; otherwise every match contains one of
+// them (none known when empty).
+struct LiteralSet {
+    bool exact;
+    std::vector<std::string> strings;
+};
+
+size_t shortest(const std::vector<std::string>& strings) {
+    if (strings.empty()) return 0;
+    size_t length = strings[0].size();
+    for (const auto& s : strings) length = std::min(length, s.size());
+    return length;
+}
+
+void dedupe(std::vector<std::string>& strings) {
+    std::sort(strings.begin(), strings.end());
+    strings.erase(std::unique(strings.begin(), strings.end()), strings.end());
+}
+
+LiteralSet exactly(const std::string& value) {
+    return LiteralSet{true, std::vector<std::string>(1, value)};
+}
+
+LiteralSet unknown() {
+    return LiteralSet{false, std::vector<std::string>()};
+}
+
+int firstMember(const std::bitset<256>& set) {
+    for (int b = 0; b < 256; ++b) {
+        if (set[b]) return b;
+    }
+    return -1;
+}
+
+} // namespace
+
+struct Regex::Node {
+    enum Type { Empty, Set, Concat, Alternate, Repeat, Begin, End };
+
+    Type type;
+    std::bitset<256> set;
+    std::vector<Node> children;
+    int min;
+    int max; // -1 = unbounded
+
+    explicit Node(Type nodeType = Empty) : type(nodeType), min(1), max(1) {}
+};
+
+// Recursive-descent parser producing the syntax tree, plus the literal
+// analysis that runs over it
+class Regex::Parser {
+public:
+    Parser(const std::string& fullPattern, const std::string& body, bool ignoreCase)
+        : pattern(fullPattern), text(body), pos(0), caseless(ignoreCase) {}
+
+    Node parse() {
+        Node root = alternation();
+        if (pos < text.size()) fail("unmatched ')'");
+        return root;
+    }
+
+    std::vector<std::string> requiredLiterals(const Node& root) const {
+        LiteralSet literals = analyze(root);
+        if (shortest(literals.strings) == 0) return std::vector<std::string>();
+
+        // A text containing "ab" is found by "b" anyway: drop supersets
+        std::vector<std::string> minimal;
+        for (const auto& candidate : literals.strings) {
+            bool redundant = false;
+            for (const auto& other : literals.strings) {
+                if (other.size() < candidate.size() && candidate.find(other) != std::string::npos) {
+                    redundant = true;
+                    break;
+                }
+            }
+            if (!redundant) minimal.push_back(candidate);
+        }
+        return minimal;
+    }
+
+private:
+    const std::string& pattern;
+    const std::string& text;
+    size_t pos;
+    bool caseless;
+
+    void fail(const std::string& message) const {
+        throw std::runtime_error("Invalid regex '" + pattern + "': " + message);
+    }
+
+    Node setNode(std::bitset<256> set) const {
+        if (caseless) {
+            for (int c = 'a'; c <= 'z'; ++c) {
+                int upper = c - 'a' + 'A';
+                if (set[c] || set[upper]) {
+                    set[c] = true;
+                    set[upper] = true;
+                }
+            }
+        }
+        Node node(Node::Set);
+        node.set = set;
+        return node;
+    }
+
+    Node alternation() {
+        Node first = concatenation();
+        if (pos >= text.size() || text[pos] != '|') return first;
+
+        Node node(Node::Alternate);
+        node.children.push_back(first);
+        while (pos < text.size() && text[pos] == '|') {
+            ++pos;
+            node.children.push_back(concatenation());
+        }
+        return node;
+    }
+
+    Node concatenation() {
+        Node node(Node::Concat);
+        while (pos < text.size() && text[pos] != '|' && text[pos] != ')') {
+            node.children.push_back(repetition());
+        }
+        if (node.children.empty()) return Node(Node::Empty);
+        if (node.children.size() == 1) return node.children[0];
+        return node;
+    }
+
+    Node repetition() {
+        Node node = atom();
+        while (pos < text.size()) {
+            int min = 0;
+            int max = 0;
+            char c = text[pos];
+            if (c == '*') {
+                min = 0;
+                max = -1;
+                ++pos;
+            } else if (c == '+') {
+                min = 1;
+                max = -1;
+                ++pos;
+            } else if (c == '?') {
+                min = 0;
+                max = 1;
+                ++pos;
+            } else if (c != '{' || !braces(min, max)) {
+                break;
+            }
+            // A lazy modifier matches the same texts for a yes/no search
+            if (pos < text.size() && text[pos] == '?') ++pos;
+            if (node.type == Node::Begin || node.type == Node::End) fail("nothing to repeat");
+
+            Node repeat(Node::Repeat);
+            repeat.min = min;
+            repeat.max = max;
+            repeat.children.push_back(node);
+            node = repeat;
+        }
+        return node;
+    }
+
+    // {m}, {m,} or {m,n} at pos; leaves pos alone and returns false when
+    // the brace is not a quantifier (it is then a literal '{')
+    bool braces(int& min, int& max) {
+        size_t p = pos + 1;
+        auto number = [&](int& value) {
+            size_t begin = p;
+            value = 0;
+            while (p < text.size() && std::isdigit(static_cast<unsigned char>(text[p]))) {
+                value = std::min(value * 10 + (text[p] - '0'), MAX_REPEAT + 1);
+                ++p;
+            }
+            return p > begin;
+        };
+
+        if (!number(min)) return false;
+        max = min;
+        if (p < text.size() && text[p] == ',') {
+            ++p;
+            if (!number(max)) max = -1;
+        }
+        if (p >= text.size() || text[p] != '}') return false;
+        if (min > MAX_REPEAT || max > MAX_REPEAT) fail("repetition count above 1000");
+        if (max >= 0 && max < min) fail("bad repetition range");
+        pos = p + 1;
+        return true;
+    }
+
+    Node atom() {
+        char c = text[pos++];
+        std::bitset<256> set;
+        switch (c) {
+        case '(': {
+            if (text.compare(pos, 2, "?:") == 0) {
+                pos += 2;
+            } else if (pos < text.size() && text[pos] == '?') {
+                fail("unsupported group syntax");
+            }
+            Node inner = alternation();
+            if (pos >= text.size() || text[pos] != ')') fail("missing ')'");
+            ++pos;
+            return inner;
+        }
+        case '*':
+        case '+':
+        case '?':
+            fail("nothing to repeat");
+            break;
+        case '[':
+            return setNode(characterClass());
+        case '.':
+            set.set();
+            set['\n'] = false;
+            return setNode(set);
+        case '^':
+            return Node(Node::Begin);
+        case '$':
+            return Node(Node::End);
+        case '\\':
+            escape(set);
+            return setNode(set);
+        default:
+            set[static_cast<unsigned char>(c)] = true;
+            return setNode(set);
+        }
+        return Node(Node::Empty);
+    }
+
+    // Escape after a backslash; returns true when it names a single byte
+    bool escape(std::bitset<256>& set) {
+        if (pos >= text.size()) fail("trailing backslash");
+        char c = text[pos++];
+        auto addRange = [&set](int low, int high) {
+            for (int b = low; b <= high; ++b) set[b] = true;
+        };
+        auto single = [&set](int b) {
+            set[b] = true;
+            return true;
+        };
+
+        switch (c) {
+        case 'd':
+        case 'D':
+        case 'w':
+        case 'W':
+        case 's':
+        case 'S': {
+            std::bitset<256> members;
+            std::swap(members, set);
+            char lower = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            if (lower == 'd') {
+                addRange('0', '9');
+            } else if (lower == 'w') {
+                addRange('0', '9');
+                addRange('a', 'z');
+                addRange('A', 'Z');
+                set['_'] = true;
+            } else {
+                for (char space : std::string(" \t\n\r\f\v")) set[static_cast<unsigned char>(space)] = true;
+            }
+            if (c != lower) set.flip();
+            set |= members;
+            return false;
+        }
+        case 'n':
+            return single('\n');
+        case 't':
+            return single('\t');
+        case 'r':
+            return single('\r');
+        case 'f':
+            return single('\f');
+        case 'v':
+            return single('\v');
+        case 'x': {
+            if (pos + 2 > text.size() || !std::isxdigit(static_cast<unsigned char>(text[pos])) ||
+                !std::isxdigit(static_cast<unsigned char>(text[pos + 1]))) {
+                fail("\\x needs two hex digits");
+            }
+            int value = std::stoi(text.substr(pos, 2), nullptr, 16);
+            pos += 2;
+            return single(value);
+        }
+        default:
+            if (std::isalnum(static_cast<unsigned char>(c))) {
+                fail(std::string("unsupported escape \\") + c);
+            }
+            return single(static_cast<unsigned char>(c));
+        }
+    }
+
+    std::bitset<256> characterClass() {
+        std::bitset<256> set;
+        bool negate = pos < text.size() && text[pos] == '^';
+        if (negate) ++pos;
+
+        bool first = true;
+        while (pos < text.size() && (text[pos] != ']' || first)) {
+            first = false;
+            std::bitset<256> element;
+            int low = -1;
+            if (text[pos] == '\\') {
+                ++pos;
+                if (escape(element)) low = firstMember(element);
+            } else {
+                low = static_cast<unsigned char>(text[pos++]);
+                element[low] = true;
+            }
+
+            // Range a-z; a '-' before ']' is literal
+            if (low >= 0 && pos + 1 < text.size() && text[pos] == '-' && text[pos + 1] != ']') {
+                ++pos;
+                int high;
+                if (text[pos] == '\\') {
+                    ++pos;
+                    std::bitset<256> end;
+                    if (!escape(end)) fail("bad character range");
+                    high = firstMember(end);
+                } else {
+                    high = static_cast<unsigned char>(text[pos++]);
+                }
+                if (high < low) fail("bad character range");
+                for (int b = low; b <= high; ++b) element[b] = true;
+            }
+            set |= element;
+        }
+        if (pos >= text.size()) fail("missing ']'");
+        ++pos;
+
+        if (negate) set.flip();
+        return set;
+    }
+
+    LiteralSet analyze(const Node& node) const {
+        switch (node.type) {
+        case Node::Empty:
+        case Node::Begin:
+        case Node::End:
+            return exactly("");
+        case Node::Set: {
+            LiteralSet literals{true, std::vector<std::string>()};
+            for (int b = 0; b < 256; ++b) {
+                if (!node.set[b]) continue;
+                int c = caseless ? std::tolower(b) : b;
+                literals.strings.push_back(std::string(1, static_cast<char>(c)));
+            }
+            dedupe(literals.strings);
+            if (literals.strings.size() > 4) return unknown();
+            return literals;
+        }
+        case Node::Alternate: {
+            LiteralSet merged{true, std::vector<std::string>()};
+            for (const auto& child : node.children) {
+                LiteralSet literals = analyze(child);
+                if (!literals.exact) merged.exact = false;
+                if (!literals.exact && shortest(literals.strings) == 0) return unknown();
+                merged.strings.insert(merged.strings.end(), literals.strings.begin(),
+                                      literals.strings.end());
+            }
+            dedupe(merged.strings);
+            if (merged.strings.size() > MAX_LITERALS) return unknown();
+            // An exact alternative that may be empty still leaves an exact set
+            if (!merged.exact && shortest(merged.strings) == 0) return unknown();
+            return merged;
+        }
+        case Node::Repeat: {
+            LiteralSet literals = analyze(node.children[0]);
+            if (node.min == 0) {
+                if (node.max == 1 && literals.exact) {
+                    literals.strings.push_back("");
+                    dedupe(literals.strings);
+                    return literals;
+                }
+                return unknown();
+            }
+            if (node.min == 1 && node.max == 1) return literals;
+            // One or more copies: each copy's literals are still required
+            if (shortest(literals.strings) == 0) return unknown();
+            literals.exact = false;
+            return literals;
+        }
+        case Node::Concat: {
+            // Join neighbouring exact children into longer exact strings; the
+            // best run or inexact child becomes the requirement
+            LiteralSet best = unknown();
+            LiteralSet run = exactly("");
+            bool wholeRun = true;
+            auto consider = [&best](const LiteralSet& candidate) {
+                size_t length = shortest(candidate.strings);
+                size_t bestLength = shortest(best.strings);
+                if (length > bestLength ||
+                    (length == bestLength && length > 0 &&
+                     candidate.strings.size() < best.strings.size())) {
+                    best = LiteralSet{false, candidate.strings};
+                }
+            };
+
+            for (const auto& child : node.children) {
+                LiteralSet literals = analyze(child);
+                if (literals.exact && run.strings.size() * literals.strings.size() <= MAX_LITERALS) {
+                    std::vector<std::string> joined;
+                    for (const auto& prefix : run.strings) {
+                        for (const auto& suffix : literals.strings) joined.push_back(prefix + suffix);
+                    }
+                    dedupe(joined);
+                    run.strings.swap(joined);
+                    continue;
+                }
+                wholeRun = false;
+                consider(run);
+                consider(literals);
+                run = literals.exact ? literals : exactly("");
+            }
+            if (wholeRun) return run;
+            consider(run);
+            return best;
+        }
+        }
+        return unknown();
+    }
+};
+
+Regex::Regex(const std::string& pattern)
+    : source(pattern), caseless(false), entry(0), classCount(1) {
+    std::string body = pattern;
+    if (body.compare(0, 4, "(?i)") == 0) {
+        caseless = true;
+        body = body.substr(4);
+    }
+
+    Parser parser(pattern, body, caseless);
+    Node root = parser.parse();
+    literals = parser.requiredLiterals(root);
+
+    uint32_t match = emit(Instruction::Match, 0);
+    entry = compile(root, match);
+    computeByteClasses();
+}
+
+uint32_t Regex::emit(Instruction::Op op, uint32_t out, uint32_t alt, uint32_t set) {
+    if (instructions.size() >= MAX_INSTRUCTIONS) {
+        throw std::runtime_error("Invalid regex '" + source + "': pattern is too large");
+    }
+    instructions.push_back(Instruction{op, out, alt, set});
+    return static_cast<uint32_t>(instructions.size() - 1);
+}
+
+// Thompson construction, emitted back to front: returns the entry of an
+// NFA fragment for node that continues to next
+uint32_t Regex::compile(const Node& node, uint32_t next) {
+    switch (node.type) {
+    case Node::Empty:
+        return next;
+    case Node::Set:
+        sets.push_back(node.set);
+        return emit(Instruction::ByteSet, next, 0, static_cast<uint32_t>(sets.size() - 1));
+    case Node::Begin:
+        return emit(Instruction::AssertBegin, next);
+    case Node::End:
+        return emit(Instruction::AssertEnd, next);
+    case Node::Concat:
+        for (size_t i = node.children.size(); i-- > 0;) next = compile(node.children[i], next);
+        return next;
+    case Node::Alternate: {
+        uint32_t branch = compile(node.children.back(), next);
+        for (size_t i = node.children.size() - 1; i-- > 0;) {
+            uint32_t option = compile(node.children[i], next);
+            branch = emit(Instruction::Split, option, branch);
+        }
+        return branch;
+    }
+    case Node::Repeat: {
+        const Node& child = node.children[0];
+        uint32_t current = next;
+        if (node.max < 0) {
+            uint32_t loop = emit(Instruction::Split, 0, next);
+            instructions[loop].out = compile(child, loop);
+            current = loop;
+        } else {
+            // x{0,n}: nested optional copies, each able to skip to next
+            for (int i = node.min; i < node.max; ++i) {
+                uint32_t body = compile(child, current);
+                current = emit(Instruction::Split, body, next);
+            }
+        }
+        for (int i = 0; i < node.min; ++i) current = compile(child, current);
+        return current;
+    }
+    }
+    return next;
+}
+
+void Regex::computeByteClasses() {
+    // Split classes by membership in each byte set
+    std::fill(classes, classes + 256, 0);
+    classCount = 1;
+    std::vector<int> remap;
+    for (const auto& set : sets) {
+        remap.assign(classCount * 2, -1);
+        size_t count = 0;
+        for (int b = 0; b < 256; ++b) {
+            int& target = remap[classes[b] * 2 + (set[b] ? 1 : 0)];
+            if (target < 0) target = static_cast<int>(count++);
+            classes[b] = static_cast<uint8_t>(target);
+        }
+        classCount = count;
+    }
+}
+
+RegexMatcher::RegexMatcher(const Regex& compiled, size_t stateLimit)
+    : regex(compiled), maxStates(std::max<size_t>(stateLimit, 16)),
+      classCount(compiled.byteClassCount()), startState(0),
+      mark(compiled.program().size(), 0), generation(0) {
+    reset();
+}
+
+void RegexMatcher::reset() {
+    states.clear();
+    status.clear();
+    transitions.clear();
+    index.clear();
+
+    std::vector<uint32_t> seed(1, regex.start());
+    bool matched = false;
+    closure(seed, true, false, matched);
+    startState = addState(seed, matched);
+}
+
+// Follow empty transitions from threads, keeping the instructions that wait
+// on input (or on the end of text when not atEnd), sorted
+void RegexMatcher::closure(std::vector<uint32_t>& threads, bool atBegin, bool atEnd,
+                           bool& matched) {
+    if (++generation == 0) {
+        std::fill(mark.begin(), mark.end(), 0);
+        generation = 1;
+    }
+    const auto& program = regex.program();
+    stack.assign(threads.begin(), threads.end());
+    threads.clear();
+    matched = false;
+
+    while (!stack.empty()) {
+        uint32_t id = stack.back();
+        stack.pop_back();
+        if (mark[id] == generation) continue;
+        mark[id] = generation;
+
+        const Regex::Instruction& instruction = program[id];
+        switch (instruction.op) {
+        case Regex::Instruction::ByteSet:
+            threads.push_back(id);
+            break;
+        case Regex::Instruction::Match:
+            matched = true;
+            break;
+        case Regex::Instruction::Split:
+            stack.push_back(instruction.alt);
+            stack.push_back(instruction.out);
+            break;
+        case Regex::Instruction::AssertBegin:
+            if (atBegin) stack.push_back(instruction.out);
+            break;
+        case Regex::Instruction::AssertEnd:
+            if (atEnd) {
+                stack.push_back(instruction.out);
+            } else {
+                threads.push_back(id);
+            }
+            break;
+        }
+    }
+    std::sort(threads.begin(), threads.end());
+}
+
+int32_t RegexMatcher::addState(const std::vector<uint32_t>& threads, bool matched) {
+    std::vector<uint32_t> key(threads);
+    if (matched) key.push_back(UINT32_MAX);
+
+    auto it = index.find(key);
+    if (it != index.end()) return it->second;
+
+    int32_t id = static_cast<int32_t>(states.size());
+    states.push_back(State{threads, -1});
+    status.push_back(matched ? Matched : (threads.empty() ? Dead : Running));
+    transitions.resize(transitions.size() + classCount, -1);
+    index.emplace(key, id);
+    return id;
+}
+
+int32_t RegexMatcher::step(int32_t state, uint8_t byteClass, uint8_t byte) {
+    const auto& program = regex.program();
+    const auto& sets = regex.byteSets();
+
+    std::vector<uint32_t> next;
+    for (uint32_t id : states[state].threads) {
+        const Regex::Instruction& instruction = program[id];
+        if (instruction.op == Regex::Instruction::ByteSet && sets[instruction.set][byte]) {
+            next.push_back(instruction.out);
+        }
+    }
+    // Unanchored search: a new match attempt starts at every byte
+    next.push_back(regex.start());
+    bool matched = false;
+    closure(next, false, false, matched);
+
+    if (states.size() >= maxStates) {
+        // Cache full: start over, keeping only the state being entered
+        reset();
+        return addState(next, matched);
+    }
+    int32_t target = addState(next, matched);
+    transitions[static_cast<size_t>(state) * classCount + byteClass] = target;
+    return target;
+}
+
+bool RegexMatcher::matchesAtEnd(int32_t state) {
+    if (states[state].matchesAtEnd < 0) {
+        std::vector<uint32_t> pending;
+        for (uint32_t id : states[state].threads) {
+            if (regex.program()[id].op == Regex::Instruction::AssertEnd) pending.push_back(id);
+        }
+        bool matched = false;
+        if (!pending.empty()) closure(pending, false, true, matched);
+        states[state].matchesAtEnd = matched ? 1 : 0;
+    }
+    return states[state].matchesAtEnd == 1;
+}
+
+bool RegexMatcher::search(const char* text, size_t length) {
+    const uint8_t* classes = regex.byteClasses();
+    int32_t state = startState;
+    for (size_t i = 0; i < length && status[state] == Running; ++i) {
+        uint8_t byte = static_cast<uint8_t>(text[i]);
+        uint8_t byteClass = classes[byte];
+        int32_t next = transitions[static_cast<size_t>(state) * classCount + byteClass];
+        state = next >= 0 ? next : step(state, byteClass, byte);
+    }
+    if (status[state] != Running) return status[state] == Matched;
+    return matchesAtEnd(state);
+}
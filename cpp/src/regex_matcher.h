@@ -0,0 +1,107 @@
+#ifndef REGEX_MATCHER_H
+#define REGEX_MATCHER_H
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Byte-oriented regular expressions for catalog search. The pattern is
+// compiled to a Thompson NFA once; each RegexMatcher runs it as a lazily
+// built DFA, so matching is linear in the text with no backtracking.
+//
+// Supported: literals, '.', [classes] and [^negated] ones, \d \w \s and
+// their negations, (groups), (?:groups), '|', '*', '+', '?', {m}, {m,},
+// {m,n}, '^' / '$' (start / end of the text) and a leading (?i) for
+// ASCII case-insensitive matching.
+class Regex {
+public:
+    struct Instruction {
+        enum Op { ByteSet, Split, Match, AssertBegin, AssertEnd };
+        Op op;
+        uint32_t out;
+        uint32_t alt;  // second branch of Split
+        uint32_t set;  // index into byteSets for ByteSet
+    };
+
+    // Throws std::runtime_error on a malformed pattern
+    explicit Regex(const std::string& pattern);
+
+    const std::string& pattern() const { return source; }
+    bool ignoreCase() const { return caseless; }
+
+    // Every match contains at least one of these strings (lowercase when
+    // ignoreCase). Empty when nothing useful could be extracted.
+    const std::vector<std::string>& requiredLiterals() const { return literals; }
+
+    const std::vector<Instruction>& program() const { return instructions; }
+    const std::vector<std::bitset<256>>& byteSets() const { return sets; }
+    uint32_t start() const { return entry; }
+
+    // Bytes that no instruction tells apart share a class; DFA tables are
+    // indexed by class rather than by byte
+    const uint8_t* byteClasses() const { return classes; }
+    size_t byteClassCount() const { return classCount; }
+
+private:
+    struct Node;
+    class Parser;
+
+    std::string source;
+    bool caseless;
+    std::vector<std::string> literals;
+    std::vector<Instruction> instructions;
+    std::vector<std::bitset<256>> sets;
+    uint32_t entry;
+    uint8_t classes[256];
+    size_t classCount;
+
+    uint32_t compile(const Node& node, uint32_t next);
+    uint32_t emit(Instruction::Op op, uint32_t out, uint32_t alt = 0, uint32_t set = 0);
+    void computeByteClasses();
+};
+
+// Unanchored search ("does the text contain a match") with its own DFA
+// cache. Not thread-safe: use one matcher per thread over a shared Regex.
+class RegexMatcher {
+public:
+    // When the cache grows past maxStates it is flushed and rebuilt
+    explicit RegexMatcher(const Regex& regex, size_t maxStates = 4096);
+
+    bool search(const char* text, size_t length);
+    bool search(const std::string& text) { return search(text.data(), text.size()); }
+
+    size_t stateCount() const { return states.size(); }
+
+private:
+    enum Status : uint8_t { Running, Matched, Dead };
+
+    struct State {
+        std::vector<uint32_t> threads; // NFA instructions waiting on input
+        int8_t matchesAtEnd;           // -1 unknown, else whether $ completes a match
+    };
+
+    const Regex& regex;
+    size_t maxStates;
+    size_t classCount;
+    std::vector<State> states;
+    std::vector<uint8_t> status;      // Status per state, checked every byte
+    std::vector<int32_t> transitions; // states x byte classes, -1 = not built yet
+    std::map<std::vector<uint32_t>, int32_t> index;
+    int32_t startState;
+
+    // Scratch for closures
+    std::vector<uint32_t> stack;
+    std::vector<uint32_t> mark;
+    uint32_t generation;
+
+    void reset();
+    void closure(std::vector<uint32_t>& threads, bool atBegin, bool atEnd, bool& matched);
+    int32_t addState(const std::vector<uint32_t>& threads, bool matched);
+    int32_t step(int32_t state, uint8_t byteClass, uint8_t byte);
+    bool matchesAtEnd(int32_t state);
+};
+
+#endif // REGEX_MATCHER_H
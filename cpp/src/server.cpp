@@ -0,0 +1,457 @@
+#include "server.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+bool equals(const char* text, size_t length, const char* literal) {
+    return length == std::strlen(literal) && std::memcmp(text, literal, length) == 0;
+}
+
+uint64_t nanosSince(std::chrono::steady_clock::time_point start) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+}
+
+void summarize(RequestSummary* summary, const char* text, size_t length, bool lower) {
+    for (size_t i = 0; i < length && summary->length < sizeof(summary->request); ++i) {
+        char c = text[i];
+        summary->request[summary->length++] = lower ? static_cast<char>(std::tolower(static_cast<unsigned char>(c))) : c;
+    }
+}
+
+// Writes as much of data as the socket takes without blocking; -1 once
+// the peer is gone
+ssize_t sendSome(int fd, const char* data, size_t length) {
+    size_t total = 0;
+    while (total < length) {
+        ssize_t sent = ::send(fd, data + total, length - total, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (sent <= 0) return -1;
+        total += static_cast<size_t>(sent);
+    }
+    return static_cast<ssize_t>(total);
+}
+
+} // namespace
+
+RequestHandler::RequestHandler(const EmotionPlaylist& playlist) : playlist(playlist) {}
+
+void RequestHandler::addEmotion(const char* name, size_t length, ArenaVector<int>& emotionIds) {
+    int id = playlist.emotionId(name, length);
+    if (id < 0) {
+        // Misspelled: take the fuzzy path, which allocates
+        std::vector<std::string> resolved = playlist.resolveEmotions({std::string(name, length)}, &corrections);
+        if (!resolved.empty()) id = playlist.emotionId(resolved[0].data(), resolved[0].size());
+    }
+    // Unknown emotions match nothing, as on the command line
+    if (id >= 0 && emotionIds.size() < MAX_EMOTIONS) emotionIds.push_back(id);
+}
+
+ServerMetrics::RequestType RequestHandler::error(const char* message, size_t start, ArenaString& out) const {
+    out.resize(start);
+    // Messages are fixed literals that need no escaping
+    out += "{\"error\": \"";
+    out += message;
+    out += "\"}";
+    return ServerMetrics::Error;
+}
+
+ServerMetrics::RequestType RequestHandler::handle(const char* request, size_t length, ArenaString& out,
+                                                  RequestSummary* summary) {
+    TRACE_SCOPE("request");
+    size_t start = out.size();
+    corrections.clear();
+    if (length > 0 && request[length - 1] == '\r') length--;
+    if (summary != nullptr) {
+        summary->length = 0;
+        summary->results = 0;
+        summarize(summary, request, length, false);
+    }
+
+    // Parse key=value pairs separated by '&'
+    const char* emotions = nullptr;
+    size_t emotionsLength = 0;
+    const char* prefix = nullptr;
+    size_t prefixLength = 0;
+    size_t k = DEFAULT_K;
+    bool profiling = false;
+    const char* end = request + length;
+    for (const char* field = request; field < end;) {
+        const char* fieldEnd = std::find(field, end, '&');
+        const char* equal = std::find(field, fieldEnd, '=');
+        if (equal == fieldEnd) {
+            if (fieldEnd != field) return error("expected key=value", start, out);
+        } else {
+            const char* value = equal + 1;
+            size_t valueLength = static_cast<size_t>(fieldEnd - value);
+            size_t keyLength = static_cast<size_t>(equal - field);
+            if (equals(field, keyLength, "emotions")) {
+                emotions = value;
+                emotionsLength = valueLength;
+            } else if (equals(field, keyLength, "complete")) {
+                prefix = value;
+                prefixLength = valueLength;
+            } else if (equals(field, keyLength, "k")) {
+                auto parsed = std::from_chars(value, fieldEnd, k);
+                if (parsed.ec != std::errc() || parsed.ptr != fieldEnd) return error("invalid k", start, out);
+            } else if (equals(field, keyLength, "profile")) {
+                if (!equals(value, valueLength, "true") && !equals(value, valueLength, "false")) {
+                    return error("invalid profile", start, out);
+                }
+                profiling = equals(value, valueLength, "true");
+            } else {
+                return error("unknown key", start, out);
+            }
+        }
+        field = fieldEnd + 1;
+    }
+    if (prefix != nullptr) {
+        if (emotions != nullptr) return error("complete does not take emotions", start, out);
+        if (!playlist.hasCompletionIndex()) return error("autocomplete index not built", start, out);
+    }
+
+    if (summary != nullptr) {
+        summary->length = 0;
+        if (prefix != nullptr) {
+            summarize(summary, "complete=", 9, false);
+            summarize(summary, prefix, prefixLength, false);
+        } else {
+            summarize(summary, "emotions=", 9, false);
+        }
+    }
+    if (profiling) {
+        profile.stages.clear();
+        profile.bytesSerialized = 0;
+    }
+    ProfileSession session(profiling ? &profile : nullptr);
+    size_t results;
+    if (prefix != nullptr) {
+        ProfileStage stage("complete");
+        results = playlist.appendCompletionJson(out, std::string(prefix, prefixLength), k);
+        stage.setRowsOut(results);
+    } else {
+        results = answerPlaylist(emotions, emotionsLength, k, out, summary);
+    }
+    if (summary != nullptr) {
+        char number[24];
+        summarize(summary, "&k=", 3, false);
+        char* numberEnd = std::to_chars(number, number + sizeof(number), k).ptr;
+        summarize(summary, number, static_cast<size_t>(numberEnd - number), false);
+        if (profiling) summarize(summary, "&profile=true", 13, false);
+        summary->results = results;
+    }
+    if (profiling) {
+        profile.bytesSerialized = out.size() - start;
+        std::string json = ", \"profile\": " + profile.toJson();
+        out.insert(out.size() - 1, json.data(), json.size());
+        return ServerMetrics::Profiled;
+    }
+    return prefix != nullptr ? ServerMetrics::Completion : ServerMetrics::Playlist;
+}
+
+size_t RequestHandler::answerPlaylist(const char* emotions, size_t emotionsLength, size_t k, ArenaString& out,
+                                      RequestSummary* summary) {
+    ArenaVector<int> emotionIds{ArenaAllocator<int>(threadArena())};
+    emotionIds.reserve(MAX_EMOTIONS);
+    {
+        // Comma-separated emotions, or '*' (the default) for all of them
+        ProfileStage stage("resolve");
+        if (emotions != nullptr && !equals(emotions, emotionsLength, "*")) {
+            const char* listEnd = emotions + emotionsLength;
+            bool listed = false;
+            for (const char* name = emotions; name <= listEnd;) {
+                const char* nameEnd = std::find(name, listEnd, ',');
+                const char* first = name;
+                const char* last = nameEnd;
+                while (first < last && std::isspace(static_cast<unsigned char>(*first))) first++;
+                while (last > first && std::isspace(static_cast<unsigned char>(last[-1]))) last--;
+                name = nameEnd + 1;
+                // Blank names ("emotions=" or "happy,") are skipped, as on the command line
+                if (first == last) continue;
+                addEmotion(first, static_cast<size_t>(last - first), emotionIds);
+                if (summary != nullptr) {
+                    if (listed) summarize(summary, ",", 1, false);
+                    summarize(summary, first, static_cast<size_t>(last - first), true);
+                }
+                listed = true;
+            }
+            // Nothing known was asked for: an empty list would mean every song
+            if (emotionIds.empty()) emotionIds.push_back(-1);
+        } else if (summary != nullptr) {
+            summarize(summary, "*", 1, false);
+        }
+        stage.setRowsOut(emotionIds.size());
+    }
+    ProfileStage stage("serialize");
+    return playlist.appendPlaylistJson(out, emotionIds.data(), emotionIds.size(), k, corrections);
+}
+
+PlaylistServer::PlaylistServer(const EmotionPlaylist& playlist, int port, size_t workers)
+    : playlist(playlist), listenFd(-1), boundPort(port), workerCount(std::max<size_t>(workers, 1)),
+      pollFd(-1), wakeFd(-1), stopping(false), queryLog(nullptr) {
+    listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        throw std::runtime_error(std::string("Could not create socket: ") + std::strerror(errno));
+    }
+    int reuse = 1;
+    ::setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    socklen_t addressLength = sizeof(address);
+    if (::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        ::listen(listenFd, 128) < 0 ||
+        ::getsockname(listenFd, reinterpret_cast<sockaddr*>(&address), &addressLength) < 0) {
+        std::string reason = std::strerror(errno);
+        ::close(listenFd);
+        throw std::runtime_error("Could not listen on port " + std::to_string(port) + ": " + reason);
+    }
+    boundPort = ntohs(address.sin_port);
+
+    // The wake event stays readable, so every worker sees it
+    pollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    epoll_event wake;
+    std::memset(&wake, 0, sizeof(wake));
+    wake.events = EPOLLIN;
+    wake.data.ptr = nullptr;
+    if (pollFd < 0 || wakeFd < 0 || ::epoll_ctl(pollFd, EPOLL_CTL_ADD, wakeFd, &wake) < 0) {
+        std::string reason = std::strerror(errno);
+        for (int fd : {listenFd, pollFd, wakeFd}) {
+            if (fd >= 0) ::close(fd);
+        }
+        throw std::runtime_error("Could not create epoll set: " + reason);
+    }
+}
+
+PlaylistServer::~PlaylistServer() {
+    stop();
+    for (auto& worker : workers) {
+        if (worker.joinable()) worker.join();
+    }
+    for (const auto& connection : connections) ::close(connection->fd);
+    ::close(wakeFd);
+    ::close(pollFd);
+    ::close(listenFd);
+}
+
+void PlaylistServer::run() {
+    for (size_t i = 0; i < workerCount; ++i) workers.emplace_back(&PlaylistServer::work, this);
+
+    while (!stopping) {
+        int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (stopping) break;
+            if (errno != EINTR && errno != ECONNABORTED) {
+                std::cerr << "Warning: accept failed: " << std::strerror(errno) << std::endl;
+            }
+            continue;
+        }
+        serverMetrics.recordConnection();
+        int noDelay = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        Connection* connection;
+        {
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            if (stopping) {
+                ::close(fd);
+                break;
+            }
+            connections.emplace_back(new Connection(fd));
+            connection = connections.back().get();
+        }
+        connection->input.reserve(READ_BUFFER * 2);
+        watch(connection, EPOLL_CTL_ADD);
+    }
+
+    for (auto& worker : workers) worker.join();
+    workers.clear();
+}
+
+void PlaylistServer::stop() {
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    if (stopping.exchange(true)) return;
+    // Wake the accept loop and the waiting workers
+    ::shutdown(listenFd, SHUT_RDWR);
+    for (const auto& connection : connections) ::shutdown(connection->fd, SHUT_RDWR);
+    uint64_t one = 1;
+    ssize_t written = ::write(wakeFd, &one, sizeof(one));
+    (void)written;
+}
+
+void PlaylistServer::watch(Connection* connection, int operation) {
+    // One-shot: the worker that takes the event owns the connection until
+    // it watches it again. A connection with answers to send, or requests
+    // left unanswered at the end of its turn, waits to be writable, which
+    // for the latter is at once
+    bool busy = !connection->output.empty() ||
+                (connection->protocol == Connection::Lines && connection->input.find('\n') != std::string::npos);
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = (busy ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT;
+    event.data.ptr = connection;
+    if (::epoll_ctl(pollFd, operation, connection->fd, &event) < 0) closeConnection(connection);
+}
+
+void PlaylistServer::closeConnection(Connection* connection) {
+    ::epoll_ctl(pollFd, EPOLL_CTL_DEL, connection->fd, nullptr);
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    // Closed under the lock, so stop() never shuts down a reused descriptor
+    ::close(connection->fd);
+    connections.erase(std::find_if(connections.begin(), connections.end(),
+                                   [connection](const std::unique_ptr<Connection>& open) {
+                                       return open.get() == connection;
+                                   }));
+}
+
+void PlaylistServer::work() {
+    // Per-worker state, reused for every connection and request
+    RequestHandler handler(playlist);
+
+    while (!stopping) {
+        epoll_event event;
+        int ready = ::epoll_wait(pollFd, &event, 1, -1);
+        if (ready < 0 && errno != EINTR) {
+            std::cerr << "Warning: epoll_wait failed: " << std::strerror(errno) << std::endl;
+            return;
+        }
+        if (ready <= 0) continue;
+        if (event.data.ptr == nullptr) return; // stop()
+        Connection* connection = static_cast<Connection*>(event.data.ptr);
+        uint64_t allocations = threadAllocations();
+        bool open = serve(*connection, handler);
+        serverMetrics.recordAllocations(threadAllocations() - allocations);
+        if (open && !stopping) {
+            watch(connection, EPOLL_CTL_MOD);
+        } else {
+            closeConnection(connection);
+        }
+    }
+}
+
+bool PlaylistServer::serve(Connection& connection, RequestHandler& handler) {
+    std::string& input = connection.input;
+    std::string& pending = connection.output;
+    if (!pending.empty()) {
+        ssize_t sent = sendSome(connection.fd, pending.data(), pending.size());
+        if (sent < 0) return false;
+        pending.erase(0, static_cast<size_t>(sent));
+        if (!pending.empty()) return true;
+    }
+    if (connection.closing) return false;
+
+    char buffer[READ_BUFFER];
+    RequestSummary summary;
+    Arena& arena = threadArena();
+    for (size_t turn = 0; turn < READS_PER_TURN; ++turn) {
+        // Read more only once every buffered request is answered
+        if (connection.protocol != Connection::Lines || input.find('\n') == std::string::npos) {
+            ssize_t received = ::recv(connection.fd, buffer, sizeof(buffer), 0);
+            if (received < 0 && errno == EINTR) continue;
+            if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+            if (received <= 0) return false;
+            input.append(buffer, static_cast<size_t>(received));
+            // Only the first bytes of a connection say whether it is HTTP
+            if (connection.protocol == Connection::Undecided &&
+                (input.size() >= 4 || input.find('\n') != std::string::npos)) {
+                connection.protocol = input.compare(0, 4, "GET ") == 0 ? Connection::Http : Connection::Lines;
+            }
+            if (connection.protocol == Connection::Http) return serveHttp(connection);
+        }
+
+        // Answer complete lines up to MAX_OUTPUT, then send them in one write
+        bool gone;
+        {
+            ArenaString output{ArenaAllocator<char>(arena)};
+            output.reserve(READ_BUFFER);
+            size_t consumed = 0;
+            size_t newline;
+            while (output.size() < MAX_OUTPUT && (newline = input.find('\n', consumed)) != std::string::npos) {
+                QueryLog* log = queryLog.load(std::memory_order_relaxed);
+                uint64_t arrived = log != nullptr ? QueryLog::now() : 0;
+                auto start = std::chrono::steady_clock::now();
+                size_t before = output.size();
+                ServerMetrics::RequestType type = handler.handle(input.data() + consumed, newline - consumed,
+                                                                 output, log != nullptr ? &summary : nullptr);
+                output += '\n';
+                uint64_t nanos = nanosSince(start);
+                serverMetrics.recordRequest(type, nanos, output.size() - before);
+                if (log != nullptr) {
+                    log->record(arrived, playlist.getCatalogVersion(), nanos, summary.results, summary.request,
+                                summary.length);
+                }
+                consumed = newline + 1;
+            }
+            input.erase(0, consumed);
+            if (input.size() > MAX_REQUEST && input.find('\n') == std::string::npos) {
+                output += "{\"error\": \"request too long\"}\n";
+                connection.closing = true;
+            }
+            ssize_t sent = sendSome(connection.fd, output.data(), output.size());
+            gone = sent < 0;
+            if (!gone && static_cast<size_t>(sent) < output.size()) {
+                // Sized once for the largest batch, so a slow reader does
+                // not cost an allocation per batch
+                pending.reserve(std::max(output.size(), MAX_OUTPUT));
+                pending.assign(output.data() + sent, output.size() - static_cast<size_t>(sent));
+            }
+        }
+        arena.reset();
+        if (gone) return false;
+        // Wait for the socket to take the rest before reading any further
+        if (!pending.empty()) return true;
+        if (connection.closing) return false;
+    }
+    // Still more to read: back in line behind the other connections
+    return true;
+}
+
+bool PlaylistServer::serveHttp(Connection& connection) {
+    // Wait for the rest of the request head; its body, if any, is ignored
+    std::string& input = connection.input;
+    if (input.find("\r\n\r\n") == std::string::npos && input.find("\n\n") == std::string::npos) {
+        return input.size() <= MAX_REQUEST;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    size_t pathEnd = input.find_first_of(" \r\n", 4);
+    std::string path = input.substr(4, pathEnd - 4);
+    std::string status = "200 OK";
+    std::string body;
+    if (path == "/metrics") {
+        body = serverMetrics.scrape(playlist);
+    } else {
+        status = "404 Not Found";
+        body = "Not found; metrics are at /metrics\n";
+    }
+    std::string response = "HTTP/1.1 " + status + "\r\nContent-Type: text/plain; version=0.0.4\r\n" +
+                           "Content-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" +
+                           body;
+    serverMetrics.recordRequest(status[0] == '2' ? ServerMetrics::Scrape : ServerMetrics::Error,
+                                nanosSince(start), response.size());
+    input.clear();
+    ssize_t sent = sendSome(connection.fd, response.data(), response.size());
+    if (sent < 0) return false;
+    // Closed once the rest of the response is out
+    connection.output.assign(response, static_cast<size_t>(sent), std::string::npos);
+    connection.closing = true;
+    return !connection.output.empty();
+}
@@ -0,0 +1,138 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "arena.h"
+#include "metrics.h"
+#include "playlist.h"
+#include "profile.h"
+#include "query_log.h"
+
+// A request as the query log keeps it, and the songs it returned.
+// Accepted requests are normalized to "emotions=a,b&k=n" (names trimmed and
+// lower-cased, '*' for all) or "complete=prefix&k=n", plus "&profile=true";
+// rejected ones are kept as sent, so a replay is rejected the same way.
+struct RequestSummary {
+    char request[QueryLog::MAX_REQUEST];
+    size_t length;
+    size_t results;
+};
+
+// Answers one playlist request line, e.g.
+//
+//     emotions=happy,excited&k=5&profile=true
+//
+// with one line of JSON (see EmotionPlaylist::appendPlaylistJson), or
+// {"error": "..."}. emotions defaults to every emotion ('*'), k to 10.
+// complete=prefix&k=n asks for the top n title and artist completions of
+// prefix instead (EmotionPlaylist::appendCompletionJson), once the
+// playlist's completion index is built.
+// Request temporaries come from the calling thread's arena (threadArena()),
+// so once it is warm a request with correctly spelled emotions performs no
+// heap allocation. Misspellings, completions, errors and profile=true
+// allocate as usual.
+class RequestHandler {
+public:
+    explicit RequestHandler(const EmotionPlaylist& playlist);
+
+    // Appends the answer to request (a line without its newline) to out
+    // and says what kind of request it was. The caller resets the arena
+    // once out has been sent.
+    ServerMetrics::RequestType handle(const char* request, size_t length, ArenaString& out,
+                                      RequestSummary* summary = nullptr);
+
+private:
+    const EmotionPlaylist& playlist;
+    std::vector<SpellingCorrection> corrections;
+    QueryProfile profile;
+
+    static constexpr size_t DEFAULT_K = 10;
+    static constexpr size_t MAX_EMOTIONS = 64;
+
+    // Adds the id of one requested emotion, resolving misspellings
+    void addEmotion(const char* name, size_t length, ArenaVector<int>& emotionIds);
+    // Appends the playlist of the emotions value; returns the songs written
+    size_t answerPlaylist(const char* emotions, size_t emotionsLength, size_t k, ArenaString& out,
+                          RequestSummary* summary);
+    ServerMetrics::RequestType error(const char* message, size_t start, ArenaString& out) const;
+};
+
+// Line-oriented TCP front end: each connection sends request lines and gets
+// one response line per request, in order; requests may be pipelined.
+// Accepted connections are non-blocking and go into one epoll set shared
+// by a fixed pool of workers, each with its own RequestHandler and arena.
+// A connection with input is handed to one worker at a time
+// (EPOLLONESHOT), which answers the requests it has read, sends the
+// answers in one write, resets its arena and puts the connection back, so
+// idle connections hold no worker. Answers the socket will not take yet
+// wait in the connection, which reads no further requests until they are
+// sent, so a client that stops reading stalls only itself.
+// A connection that starts with "GET /metrics" gets the metrics over
+// HTTP instead, for Prometheus to scrape.
+class PlaylistServer {
+public:
+    // port 0 picks a free port; throws std::runtime_error if the socket
+    // cannot be bound
+    PlaylistServer(const EmotionPlaylist& playlist, int port, size_t workers);
+    ~PlaylistServer();
+
+    PlaylistServer(const PlaylistServer&) = delete;
+    PlaylistServer& operator=(const PlaylistServer&) = delete;
+
+    int port() const { return boundPort; }
+    ServerMetrics& metrics() { return serverMetrics; }
+
+    // Record every request into log (not owned) from now on
+    void logQueries(QueryLog* log) { queryLog = log; }
+
+    // Accepts connections until stop() is called
+    void run();
+    void stop();
+
+private:
+    const EmotionPlaylist& playlist;
+    int listenFd;
+    int boundPort;
+    size_t workerCount;
+    int pollFd;    // epoll set of the open connections
+    int wakeFd;    // eventfd in pollFd, readable once stop() is called
+    std::atomic<bool> stopping;
+
+    struct Connection {
+        // Told apart by the first bytes the connection sends
+        enum Protocol { Undecided, Lines, Http };
+
+        int fd;
+        Protocol protocol;
+        bool closing;       // close once output is sent
+        std::string input;  // request lines not answered yet, kept between turns
+        std::string output; // answers the socket did not take yet
+
+        explicit Connection(int fd) : fd(fd), protocol(Undecided), closing(false) {}
+    };
+
+    std::mutex connectionsMutex;
+    std::vector<std::unique_ptr<Connection>> connections; // open ones, shut down by stop()
+    std::vector<std::thread> workers;
+    ServerMetrics serverMetrics;
+    std::atomic<QueryLog*> queryLog;
+
+    static constexpr size_t READ_BUFFER = 1 << 16;
+    static constexpr size_t MAX_REQUEST = 1 << 20;
+    static constexpr size_t MAX_OUTPUT = 1 << 20; // no more answers once a write holds this much
+    static constexpr size_t READS_PER_TURN = 16;  // then other connections get a worker
+
+    void work();
+    void watch(Connection* connection, int operation);
+    void closeConnection(Connection* connection);
+    bool serve(Connection& connection, RequestHandler& handler);
+    bool serveHttp(Connection& connection);
+};
+
+#endif // SERVER_H
@@ -0,0 +1,271 @@
+#include "song_bitmap.h"
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace {
+
+inline void setBit(std::vector<uint64_t>& bits, uint16_t low) {
+    bits[low >> 6] |= uint64_t(1) << (low & 63);
+}
+
+inline bool testBit(const std::vector<uint64_t>& bits, uint16_t low) {
+    return (bits[low >> 6] >> (low & 63)) & 1;
+}
+
+uint32_t popcount(const std::vector<uint64_t>& bits) {
+    uint32_t count = 0;
+    for (uint64_t word : bits) count += static_cast<uint32_t>(__builtin_popcountll(word));
+    return count;
+}
+
+// Size ratio at which intersecting two arrays switches from a linear merge to
+// binary-searching the larger one for each entry of the smaller
+const size_t GALLOP_RATIO = 32;
+
+} // namespace
+
+void SongBitmap::append(uint32_t ordinal) {
+    uint16_t key = static_cast<uint16_t>(ordinal >> 16);
+    uint16_t low = static_cast<uint16_t>(ordinal & 0xffff);
+    if (chunks.empty() || chunks.back().key != key) {
+        chunks.push_back(Chunk());
+        chunks.back().key = key;
+        chunks.back().count = 0;
+    }
+
+    Chunk& chunk = chunks.back();
+    if (chunk.dense()) {
+        setBit(chunk.bitset, low);
+    } else {
+        chunk.array.push_back(low);
+        if (chunk.array.size() > ARRAY_MAX) {
+            chunk.bitset.assign(BITSET_WORDS, 0);
+            for (uint16_t value : chunk.array) setBit(chunk.bitset, value);
+            std::vector<uint16_t>().swap(chunk.array);
+        }
+    }
+    chunk.count++;
+    total++;
+}
+
+SongBitmap SongBitmap::range(uint32_t count) {
+    SongBitmap bitmap;
+    for (uint64_t start = 0; start < count; start += 65536) {
+        uint32_t length = static_cast<uint32_t>(std::min<uint64_t>(65536, count - start));
+        Chunk chunk;
+        chunk.key = static_cast<uint16_t>(start >> 16);
+        chunk.count = length;
+        if (length > ARRAY_MAX) {
+            chunk.bitset.assign(BITSET_WORDS, 0);
+            for (uint32_t w = 0; w < length / 64; ++w) chunk.bitset[w] = ~uint64_t(0);
+            if (length % 64 != 0) chunk.bitset[length / 64] = (uint64_t(1) << (length % 64)) - 1;
+        } else {
+            chunk.array.resize(length);
+            for (uint32_t i = 0; i < length; ++i) chunk.array[i] = static_cast<uint16_t>(i);
+        }
+        bitmap.push(std::move(chunk));
+    }
+    return bitmap;
+}
+
+void SongBitmap::shrink(Chunk& chunk) {
+    if (!chunk.dense() || chunk.count > ARRAY_MAX) return;
+    chunk.array.reserve(chunk.count);
+    for (size_t w = 0; w < BITSET_WORDS; ++w) {
+        for (uint64_t word = chunk.bitset[w]; word != 0; word &= word - 1) {
+            chunk.array.push_back(static_cast<uint16_t>(w * 64 + __builtin_ctzll(word)));
+        }
+    }
+    std::vector<uint64_t>().swap(chunk.bitset);
+}
+
+void SongBitmap::push(Chunk&& chunk) {
+    if (chunk.count == 0) return;
+    total += chunk.count;
+    chunks.push_back(std::move(chunk));
+}
+
+SongBitmap::Chunk SongBitmap::intersectChunks(const Chunk& a, const Chunk& b) {
+    Chunk out;
+    out.key = a.key;
+    out.count = 0;
+
+    if (a.dense() && b.dense()) {
+        out.bitset.resize(BITSET_WORDS);
+        for (size_t w = 0; w < BITSET_WORDS; ++w) out.bitset[w] = a.bitset[w] & b.bitset[w];
+        out.count = popcount(out.bitset);
+        shrink(out);
+    } else if (a.dense() || b.dense()) {
+        const Chunk& sparse = a.dense() ? b : a;
+        const Chunk& dense = a.dense() ? a : b;
+        for (uint16_t value : sparse.array) {
+            if (testBit(dense.bitset, value)) out.array.push_back(value);
+        }
+    } else {
+        const std::vector<uint16_t>& small = a.array.size() <= b.array.size() ? a.array : b.array;
+        const std::vector<uint16_t>& large = a.array.size() <= b.array.size() ? b.array : a.array;
+        if (small.size() * GALLOP_RATIO < large.size()) {
+            auto from = large.begin();
+            for (uint16_t value : small) {
+                from = std::lower_bound(from, large.end(), value);
+                if (from == large.end()) break;
+                if (*from == value) out.array.push_back(value);
+            }
+        } else {
+            std::set_intersection(small.begin(), small.end(), large.begin(), large.end(),
+                                  std::back_inserter(out.array));
+        }
+    }
+    if (!out.dense()) out.count = static_cast<uint32_t>(out.array.size());
+    return out;
+}
+
+SongBitmap::Chunk SongBitmap::uniteChunks(const Chunk& a, const Chunk& b) {
+    Chunk out;
+    out.key = a.key;
+
+    if (!a.dense() && !b.dense()) {
+        std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                       std::back_inserter(out.array));
+        out.count = static_cast<uint32_t>(out.array.size());
+        if (out.count > ARRAY_MAX) {
+            out.bitset.assign(BITSET_WORDS, 0);
+            for (uint16_t value : out.array) setBit(out.bitset, value);
+            std::vector<uint16_t>().swap(out.array);
+        }
+        return out;
+    }
+
+    if (a.dense() && b.dense()) {
+        out.bitset.resize(BITSET_WORDS);
+        for (size_t w = 0; w < BITSET_WORDS; ++w) out.bitset[w] = a.bitset[w] | b.bitset[w];
+        out.count = popcount(out.bitset);
+    } else {
+        const Chunk& sparse = a.dense() ? b : a;
+        const Chunk& dense = a.dense() ? a : b;
+        out.bitset = dense.bitset;
+        out.count = dense.count;
+        for (uint16_t value : sparse.array) {
+            if (!testBit(out.bitset, value)) {
+                setBit(out.bitset, value);
+                out.count++;
+            }
+        }
+    }
+    return out;
+}
+
+SongBitmap::Chunk SongBitmap::subtractChunks(const Chunk& a, const Chunk& b) {
+    Chunk out;
+    out.key = a.key;
+
+    if (!a.dense()) {
+        if (b.dense()) {
+            for (uint16_t value : a.array) {
+                if (!testBit(b.bitset, value)) out.array.push_back(value);
+            }
+        } else {
+            std::set_difference(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                                std::back_inserter(out.array));
+        }
+        out.count = static_cast<uint32_t>(out.array.size());
+        return out;
+    }
+
+    out.bitset = a.bitset;
+    if (b.dense()) {
+        for (size_t w = 0; w < BITSET_WORDS; ++w) out.bitset[w] &= ~b.bitset[w];
+    } else {
+        for (uint16_t value : b.array) out.bitset[value >> 6] &= ~(uint64_t(1) << (value & 63));
+    }
+    out.count = popcount(out.bitset);
+    shrink(out);
+    return out;
+}
+
+SongBitmap SongBitmap::intersect(const SongBitmap& a, const SongBitmap& b) {
+    SongBitmap out;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.chunks.size() && j < b.chunks.size()) {
+        if (a.chunks[i].key < b.chunks[j].key) {
+            i++;
+        } else if (a.chunks[i].key > b.chunks[j].key) {
+            j++;
+        } else {
+            out.push(intersectChunks(a.chunks[i++], b.chunks[j++]));
+        }
+    }
+    return out;
+}
+
+SongBitmap SongBitmap::unite(const SongBitmap& a, const SongBitmap& b) {
+    SongBitmap out;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.chunks.size() || j < b.chunks.size()) {
+        if (j == b.chunks.size() || (i < a.chunks.size() && a.chunks[i].key < b.chunks[j].key)) {
+            out.push(Chunk(a.chunks[i++]));
+        } else if (i == a.chunks.size() || b.chunks[j].key < a.chunks[i].key) {
+            out.push(Chunk(b.chunks[j++]));
+        } else {
+            out.push(uniteChunks(a.chunks[i++], b.chunks[j++]));
+        }
+    }
+    return out;
+}
+
+SongBitmap SongBitmap::subtract(const SongBitmap& a, const SongBitmap& b) {
+    SongBitmap out;
+    size_t j = 0;
+    for (const Chunk& chunk : a.chunks) {
+        while (j < b.chunks.size() && b.chunks[j].key < chunk.key) j++;
+        if (j < b.chunks.size() && b.chunks[j].key == chunk.key) {
+            out.push(subtractChunks(chunk, b.chunks[j]));
+        } else {
+            out.push(Chunk(chunk));
+        }
+    }
+    return out;
+}
+
+bool SongBitmap::contains(uint32_t ordinal) const {
+    uint16_t key = static_cast<uint16_t>(ordinal >> 16);
+    uint16_t low = static_cast<uint16_t>(ordinal & 0xffff);
+    auto chunk = std::lower_bound(chunks.begin(), chunks.end(), key,
+                                  [](const Chunk& c, uint16_t k) { return c.key < k; });
+    if (chunk == chunks.end() || chunk->key != key) return false;
+    if (chunk->dense()) return testBit(chunk->bitset, low);
+    return std::binary_search(chunk->array.begin(), chunk->array.end(), low);
+}
+
+std::vector<uint32_t> SongBitmap::values(size_t limit) const {
+    std::vector<uint32_t> out;
+    out.reserve(std::min(limit, total));
+    for (const Chunk& chunk : chunks) {
+        uint32_t high = static_cast<uint32_t>(chunk.key) << 16;
+        if (chunk.dense()) {
+            for (size_t w = 0; w < BITSET_WORDS; ++w) {
+                for (uint64_t word = chunk.bitset[w]; word != 0; word &= word - 1) {
+                    if (out.size() == limit) return out;
+                    out.push_back(high | static_cast<uint32_t>(w * 64 + __builtin_ctzll(word)));
+                }
+            }
+        } else {
+            for (uint16_t low : chunk.array) {
+                if (out.size() == limit) return out;
+                out.push_back(high | low);
+            }
+        }
+    }
+    return out;
+}
+
+size_t SongBitmap::memoryBytes() const {
+    size_t bytes = sizeof(*this) + chunks.capacity() * sizeof(Chunk);
+    for (const Chunk& chunk : chunks) {
+        bytes += chunk.array.capacity() * sizeof(uint16_t) + chunk.bitset.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
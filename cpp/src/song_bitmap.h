@@ -0,0 +1,59 @@
+#ifndef SONG_BITMAP_H
+#define SONG_BITMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compressed set of song ordinals in the Roaring layout: ordinals are split
+// by their high 16 bits into chunks, and each chunk is stored as a sorted
+// array of low halves when sparse (up to 4096 entries) or as a 65536-bit
+// bitset when dense. Intersections merge or probe arrays and AND bitsets
+// word by word, so combining two small sets never touches the catalog.
+class SongBitmap {
+public:
+    SongBitmap() : total(0) {}
+
+    // Append an ordinal larger than every ordinal added so far
+    void append(uint32_t ordinal);
+
+    // Every ordinal in [0, count)
+    static SongBitmap range(uint32_t count);
+
+    static SongBitmap intersect(const SongBitmap& a, const SongBitmap& b);
+    static SongBitmap unite(const SongBitmap& a, const SongBitmap& b);
+    static SongBitmap subtract(const SongBitmap& a, const SongBitmap& b); // a and not b
+
+    bool contains(uint32_t ordinal) const;
+    bool empty() const { return total == 0; }
+    size_t size() const { return total; }
+
+    // Ascending ordinals, at most limit of them
+    std::vector<uint32_t> values(size_t limit = SIZE_MAX) const;
+
+    size_t memoryBytes() const;
+
+private:
+    static constexpr size_t ARRAY_MAX = 4096;  // larger chunks become bitsets
+    static constexpr size_t BITSET_WORDS = 1024;
+
+    struct Chunk {
+        uint16_t key;                  // high 16 bits of the ordinals
+        uint32_t count;
+        std::vector<uint16_t> array;   // sorted low halves, or
+        std::vector<uint64_t> bitset;  // BITSET_WORDS words when dense
+
+        bool dense() const { return !bitset.empty(); }
+    };
+
+    std::vector<Chunk> chunks; // ascending keys
+    size_t total;
+
+    static Chunk intersectChunks(const Chunk& a, const Chunk& b);
+    static Chunk uniteChunks(const Chunk& a, const Chunk& b);
+    static Chunk subtractChunks(const Chunk& a, const Chunk& b);
+    static void shrink(Chunk& chunk); // bitset back to an array when sparse
+    void push(Chunk&& chunk);         // keep non-empty chunks only
+};
+
+#endif // SONG_BITMAP_H
@@ -0,0 +1,107 @@
+#include "substring_search.h"
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define PLAYLIST_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+inline unsigned char foldByte(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c + ('a' - 'A')) : c;
+}
+
+bool equalsFolded(const char* text, const char* needle, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        if (foldByte(static_cast<unsigned char>(text[i])) != static_cast<unsigned char>(needle[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t findScalar(const char* text, size_t length, const char* needle, size_t size,
+                  bool ignoreCase, size_t from) {
+    unsigned char first = static_cast<unsigned char>(needle[0]);
+    for (size_t i = from; i + size <= length; ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (ignoreCase) {
+            if (foldByte(c) == first && equalsFolded(text + i + 1, needle + 1, size - 1)) return i;
+        } else if (c == first && std::memcmp(text + i + 1, needle + 1, size - 1) == 0) {
+            return i;
+        }
+    }
+    return std::string::npos;
+}
+
+size_t findPortable(const char* text, size_t length, const char* needle, size_t size,
+                    bool ignoreCase) {
+    return findScalar(text, length, needle, size, ignoreCase, 0);
+}
+
+#ifdef PLAYLIST_X86_DISPATCH
+
+__attribute__((target("avx2")))
+size_t findAvx2(const char* text, size_t length, const char* needle, size_t size,
+                bool ignoreCase) {
+    // Setting bit 0x20 lowercases letters (and maps a few other bytes onto
+    // each other); the candidate check below stays exact
+    const __m256i fold = _mm256_set1_epi8(ignoreCase ? 0x20 : 0);
+    const __m256i first = _mm256_or_si256(_mm256_set1_epi8(needle[0]), fold);
+    const __m256i last = _mm256_or_si256(_mm256_set1_epi8(needle[size - 1]), fold);
+
+    size_t i = 0;
+    for (; i + size - 1 + 32 <= length; i += 32) {
+        __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+        __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i + size - 1));
+        head = _mm256_or_si256(head, fold);
+        tail = _mm256_or_si256(tail, fold);
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last))));
+        while (mask != 0) {
+            size_t offset = i + static_cast<size_t>(__builtin_ctz(mask));
+            bool equal = ignoreCase ? equalsFolded(text + offset, needle, size)
+                                    : std::memcmp(text + offset + 1, needle + 1, size - 1) == 0;
+            if (equal) return offset;
+            mask &= mask - 1;
+        }
+    }
+    return findScalar(text, length, needle, size, ignoreCase, i);
+}
+
+#endif // PLAYLIST_X86_DISPATCH
+
+typedef size_t (*FindFunction)(const char*, size_t, const char*, size_t, bool);
+
+struct Finder {
+    FindFunction find;
+    const char* name;
+};
+
+Finder selectFinder() {
+#ifdef PLAYLIST_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return Finder{findAvx2, "avx2"};
+#endif
+    return Finder{findPortable, "scalar"};
+}
+
+const Finder& finder() {
+    static const Finder selected = selectFinder();
+    return selected;
+}
+
+} // namespace
+
+size_t findSubstring(const char* text, size_t length, const std::string& needle,
+                     bool ignoreCase) {
+    if (needle.empty()) return 0;
+    if (needle.size() > length) return std::string::npos;
+    return finder().find(text, length, needle.data(), needle.size(), ignoreCase);
+}
+
+const char* substringSearchName() {
+    return finder().name;
+}
@@ -0,0 +1,21 @@
+#ifndef SUBSTRING_SEARCH_H
+#define SUBSTRING_SEARCH_H
+
+#include <cstddef>
+#include <string>
+
+// Substring search used to prefilter regex candidates. Compares the first
+// and last needle bytes across 32 positions at a time with AVX2 when the
+// CPU supports it (chosen on first use), verifying only the positions
+// where both agree; scalar code elsewhere.
+
+// Offset of the first occurrence of needle in text, or std::string::npos.
+// With ignoreCase, ASCII letters match either case; needle must then be
+// lowercase.
+size_t findSubstring(const char* text, size_t length, const std::string& needle,
+                     bool ignoreCase);
+
+// Name of the implementation selected for this CPU ("avx2" or "scalar")
+const char* substringSearchName();
+
+#endif // SUBSTRING_SEARCH_H
@@ -0,0 +1,275 @@
+#include "succinct.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+
+namespace {
+
+template <typename T>
+void writePod(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void readPod(std::ifstream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void writeVector(std::ofstream& out, const std::vector<T>& values) {
+    unsigned long long size = values.size();
+    writePod(out, size);
+    out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+template <typename T>
+void readVector(std::ifstream& in, std::vector<T>& values, size_t limit) {
+    unsigned long long size = 0;
+    readPod(in, size);
+    if (!in || size > limit) throw std::runtime_error("Corrupt succinct structure");
+    values.resize(static_cast<size_t>(size));
+    in.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(T));
+}
+
+} // namespace
+
+void RankBitVector::push(bool bit) {
+    size_t block = bitCount / BLOCK_BITS;
+    if (block == blocks.size()) blocks.push_back(Block());
+    if (bit) blocks[block].words[(bitCount % BLOCK_BITS) / 64] |= uint64_t(1) << (bitCount % 64);
+    bitCount++;
+}
+
+void RankBitVector::finalize() {
+    // One block past the last full one, so rank1(size()) stays in range
+    blocks.resize(bitCount / BLOCK_BITS + 1);
+    blocks.shrink_to_fit();
+    uint64_t running = 0;
+    for (auto& block : blocks) {
+        block.rank = running;
+        for (uint64_t word : block.words) running += static_cast<uint64_t>(__builtin_popcountll(word));
+    }
+}
+
+size_t RankBitVector::rank1(size_t i) const {
+    const Block& block = blocks[i / BLOCK_BITS];
+    size_t offset = i % BLOCK_BITS;
+    size_t count = static_cast<size_t>(block.rank);
+    size_t word = offset / 64;
+    for (size_t w = 0; w < word; ++w) count += static_cast<size_t>(__builtin_popcountll(block.words[w]));
+    size_t bits = offset % 64;
+    if (bits != 0) count += static_cast<size_t>(__builtin_popcountll(block.words[word] & ((uint64_t(1) << bits) - 1)));
+    return count;
+}
+
+size_t RankBitVector::memoryBytes() const {
+    return blocks.capacity() * sizeof(Block);
+}
+
+void RankBitVector::save(std::ofstream& out) const {
+    unsigned long long bits = bitCount;
+    writePod(out, bits);
+    writeVector(out, blocks);
+}
+
+void RankBitVector::load(std::ifstream& in) {
+    unsigned long long bits = 0;
+    readPod(in, bits);
+    readVector(in, blocks, static_cast<size_t>(bits / BLOCK_BITS + 1));
+    bitCount = static_cast<size_t>(bits);
+    if (!in || blocks.size() != bitCount / BLOCK_BITS + 1) {
+        throw std::runtime_error("Corrupt succinct structure");
+    }
+    finalize();
+}
+
+WaveletTree::WaveletTree() : length(0), root(-1) {
+    std::memset(codes, 0, sizeof(codes));
+    std::memset(lengths, 0, sizeof(lengths));
+}
+
+void WaveletTree::build(const std::vector<uint8_t>& sequence) {
+    nodes.clear();
+    length = sequence.size();
+    std::memset(codes, 0, sizeof(codes));
+    std::memset(lengths, 0, sizeof(lengths));
+
+    uint64_t frequency[256] = {0};
+    for (uint8_t symbol : sequence) frequency[symbol]++;
+
+    // Huffman tree: leaves are -(symbol + 1), merges become internal nodes
+    typedef std::pair<uint64_t, int32_t> Weighted;
+    std::priority_queue<Weighted, std::vector<Weighted>, std::greater<Weighted>> queue;
+    for (int symbol = 0; symbol < 256; ++symbol) {
+        if (frequency[symbol] > 0) queue.push(Weighted(frequency[symbol], -(symbol + 1)));
+    }
+    if (queue.empty()) {
+        root = -1;
+        return;
+    }
+    while (queue.size() > 1) {
+        Weighted left = queue.top();
+        queue.pop();
+        Weighted right = queue.top();
+        queue.pop();
+        Node node;
+        node.child[0] = left.second;
+        node.child[1] = right.second;
+        nodes.push_back(node);
+        queue.push(Weighted(left.first + right.first, static_cast<int32_t>(nodes.size() - 1)));
+    }
+    root = queue.top().second;
+
+    // Codes by walking down from the root; node sizes for reservation
+    std::vector<uint64_t> nodeSize(nodes.size(), 0);
+    std::function<void(int32_t, uint64_t, uint8_t)> assign = [&](int32_t node, uint64_t code,
+                                                                uint8_t depth) {
+        if (node < 0) {
+            int symbol = -node - 1;
+            if (depth > 64) throw std::runtime_error("Huffman code longer than 64 bits");
+            codes[symbol] = code;
+            lengths[symbol] = depth;
+            return;
+        }
+        for (int bit = 0; bit < 2; ++bit) {
+            assign(nodes[node].child[bit], code | (uint64_t(bit) << depth),
+                   static_cast<uint8_t>(depth + 1));
+        }
+    };
+    assign(root, 0, 0);
+    for (int symbol = 0; symbol < 256; ++symbol) {
+        int32_t node = root;
+        for (uint8_t d = 0; d < lengths[symbol]; ++d) {
+            nodeSize[node] += frequency[symbol];
+            node = nodes[node].child[(codes[symbol] >> d) & 1];
+        }
+    }
+    for (size_t n = 0; n < nodes.size(); ++n) nodes[n].bits.reserve(nodeSize[n]);
+
+    for (uint8_t symbol : sequence) {
+        int32_t node = root;
+        for (uint8_t d = 0; d < lengths[symbol]; ++d) {
+            int bit = static_cast<int>((codes[symbol] >> d) & 1);
+            nodes[node].bits.push(bit != 0);
+            node = nodes[node].child[bit];
+        }
+    }
+    for (auto& node : nodes) node.bits.finalize();
+}
+
+size_t WaveletTree::rank(uint8_t symbol, size_t i) const {
+    if (lengths[symbol] == 0) return root < 0 && -root - 1 == symbol ? i : 0;
+    int32_t node = root;
+    for (uint8_t d = 0; d < lengths[symbol]; ++d) {
+        const RankBitVector& bits = nodes[node].bits;
+        size_t ones = bits.rank1(i);
+        int bit = static_cast<int>((codes[symbol] >> d) & 1);
+        i = bit ? ones : i - ones;
+        node = nodes[node].child[bit];
+    }
+    return i;
+}
+
+uint8_t WaveletTree::inverseSelect(size_t i, size_t& rankAtI) const {
+    int32_t node = root;
+    while (node >= 0) {
+        const RankBitVector& bits = nodes[node].bits;
+        size_t ones = bits.rank1(i);
+        int bit = bits.get(i) ? 1 : 0;
+        i = bit ? ones : i - ones;
+        node = nodes[node].child[bit];
+    }
+    rankAtI = i;
+    return static_cast<uint8_t>(-node - 1);
+}
+
+size_t WaveletTree::memoryBytes() const {
+    size_t bytes = sizeof(*this) + nodes.capacity() * sizeof(Node);
+    for (const auto& node : nodes) bytes += node.bits.memoryBytes();
+    return bytes;
+}
+
+void WaveletTree::save(std::ofstream& out) const {
+    unsigned long long count = nodes.size();
+    unsigned long long symbols = length;
+    writePod(out, symbols);
+    writePod(out, root);
+    out.write(reinterpret_cast<const char*>(codes), sizeof(codes));
+    out.write(reinterpret_cast<const char*>(lengths), sizeof(lengths));
+    writePod(out, count);
+    for (const auto& node : nodes) {
+        writePod(out, node.child[0]);
+        writePod(out, node.child[1]);
+        node.bits.save(out);
+    }
+}
+
+void WaveletTree::load(std::ifstream& in) {
+    unsigned long long count = 0;
+    unsigned long long symbols = 0;
+    readPod(in, symbols);
+    length = static_cast<size_t>(symbols);
+    readPod(in, root);
+    in.read(reinterpret_cast<char*>(codes), sizeof(codes));
+    in.read(reinterpret_cast<char*>(lengths), sizeof(lengths));
+    readPod(in, count);
+    if (!in || count > 255) throw std::runtime_error("Corrupt succinct structure");
+
+    nodes.assign(static_cast<size_t>(count), Node());
+    for (auto& node : nodes) {
+        readPod(in, node.child[0]);
+        readPod(in, node.child[1]);
+        node.bits.load(in);
+    }
+
+    bool valid = static_cast<bool>(in) && root < static_cast<int32_t>(count) && root >= -256;
+    for (const auto& node : nodes) {
+        for (int bit = 0; bit < 2; ++bit) {
+            valid = valid && node.child[bit] < static_cast<int32_t>(count) && node.child[bit] >= -256;
+        }
+    }
+    for (int symbol = 0; symbol < 256; ++symbol) valid = valid && lengths[symbol] <= 64;
+    if (!valid || !consistent()) throw std::runtime_error("Corrupt succinct structure");
+}
+
+bool WaveletTree::consistent() const {
+    // A single symbol is a leaf root with no code
+    if (root < 0) {
+        bool codeless = std::all_of(lengths, lengths + 256, [](uint8_t bits) { return bits == 0; });
+        return nodes.empty() && codeless;
+    }
+
+    // Every node is reached exactly once from the root, holds one bit per
+    // symbol its parent sends its way, and every leaf is reached along its
+    // symbol's code
+    struct Visit {
+        int32_t node;
+        uint64_t code;
+        uint8_t depth;
+        size_t bits;
+    };
+    std::vector<bool> seen(nodes.size(), false);
+    std::vector<Visit> pending(1, Visit{root, 0, 0, length});
+    size_t leaves = 0;
+    while (!pending.empty()) {
+        Visit visit = pending.back();
+        pending.pop_back();
+        if (visit.node < 0) {
+            int symbol = -visit.node - 1;
+            if (lengths[symbol] != visit.depth || codes[symbol] != visit.code) return false;
+            leaves++;
+            continue;
+        }
+        const Node& node = nodes[visit.node];
+        if (seen[visit.node] || visit.depth >= 64 || node.bits.size() != visit.bits) return false;
+        seen[visit.node] = true;
+        size_t ones = node.bits.rank1(visit.bits);
+        uint8_t depth = static_cast<uint8_t>(visit.depth + 1);
+        pending.push_back(Visit{node.child[0], visit.code, depth, visit.bits - ones});
+        pending.push_back(Visit{node.child[1], visit.code | (uint64_t(1) << visit.depth), depth, ones});
+    }
+    size_t coded = static_cast<size_t>(std::count_if(lengths, lengths + 256, [](uint8_t bits) { return bits > 0; }));
+    return leaves == coded && std::find(seen.begin(), seen.end(), false) == seen.end();
+}
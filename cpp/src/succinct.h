@@ -0,0 +1,81 @@
+#ifndef SUCCINCT_H
+#define SUCCINCT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+// Bit vector with constant-time rank. Bits are stored 448 to a 64-byte
+// cache line, next to the count of set bits before them, so a rank is one
+// cache miss plus a few popcounts (14% space overhead).
+class RankBitVector {
+public:
+    RankBitVector() : bitCount(0) {}
+
+    void push(bool bit);
+    void reserve(size_t bits) { blocks.reserve(bits / BLOCK_BITS + 1); }
+    void finalize(); // build rank counts; call once after the last push
+
+    size_t size() const { return bitCount; }
+    bool get(size_t i) const {
+        return (blocks[i / BLOCK_BITS].words[(i % BLOCK_BITS) / 64] >> (i % 64)) & 1;
+    }
+
+    // Number of set bits in [0, i)
+    size_t rank1(size_t i) const;
+
+    size_t memoryBytes() const;
+    void save(std::ofstream& out) const;
+    void load(std::ifstream& in);
+
+private:
+    static const size_t BLOCK_BITS = 448;
+
+    struct alignas(64) Block {
+        uint64_t rank; // set bits in all earlier blocks
+        uint64_t words[7];
+    };
+
+    size_t bitCount;
+    std::vector<Block> blocks;
+};
+
+// Wavelet tree over a byte sequence, shaped by the symbols' Huffman codes:
+// frequent bytes sit near the root, so the tree takes about H0 bits per
+// symbol plus rank overhead and common symbols need fewer rank steps.
+class WaveletTree {
+public:
+    WaveletTree();
+
+    void build(const std::vector<uint8_t>& sequence);
+
+    // Occurrences of symbol in [0, i)
+    size_t rank(uint8_t symbol, size_t i) const;
+
+    // Symbol at i together with its rank at i, in one root-to-leaf walk
+    uint8_t inverseSelect(size_t i, size_t& rankAtI) const;
+
+    size_t size() const { return length; } // symbols in the sequence
+
+    size_t memoryBytes() const;
+    void save(std::ofstream& out) const;
+    void load(std::ifstream& in);
+
+private:
+    struct Node {
+        RankBitVector bits;
+        int32_t child[2]; // >= 0: node index, < 0: leaf for symbol -(child + 1)
+    };
+
+    std::vector<Node> nodes;
+    size_t length;
+    int32_t root;         // node index, or a leaf when only one symbol occurs
+    uint64_t codes[256];  // Huffman code, first branch in the lowest bit
+    uint8_t lengths[256]; // code length in bits, 0 = symbol absent
+
+    // Whether the loaded nodes form the tree of the loaded codes
+    bool consistent() const;
+};
+
+#endif // SUCCINCT_H
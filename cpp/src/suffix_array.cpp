@@ -0,0 +1,193 @@
+#include "suffix_array.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace {
+
+// Groups at least this large are radix sorted by all threads together
+const size_t RADIX_SORT_MIN = 1 << 16;
+
+// Stable LSD radix sort of values on their high 32 bits (the key; the low
+// bits carry the suffix), one byte per pass. Threads histogram and
+// scatter their own slice; passes where every key shares the byte are
+// skipped. buffer must hold count values.
+void radixSortByKey(uint64_t* values, uint64_t* buffer, size_t count, unsigned threads) {
+    unsigned slices = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, count / 65536)));
+    std::vector<size_t> histogram(static_cast<size_t>(slices) * 256);
+    uint64_t* source = values;
+    uint64_t* target = buffer;
+
+    for (int shift = 32; shift < 64; shift += 8) {
+        auto slice = [&](unsigned s, size_t& begin, size_t& end) {
+            begin = count * s / slices;
+            end = count * (s + 1) / slices;
+        };
+        auto countDigits = [&](unsigned s) {
+            TRACE_SCOPE("suffix_array/count");
+            size_t* bins = &histogram[static_cast<size_t>(s) * 256];
+            std::fill(bins, bins + 256, 0);
+            size_t begin, end;
+            slice(s, begin, end);
+            for (size_t i = begin; i < end; ++i) bins[(source[i] >> shift) & 0xff]++;
+        };
+        std::vector<std::thread> workers;
+        for (unsigned s = 1; s < slices; ++s) workers.emplace_back(countDigits, s);
+        countDigits(0);
+        for (auto& t : workers) t.join();
+
+        // Exclusive offsets in (digit, slice) order keep the sort stable
+        size_t offset = 0;
+        bool trivial = false;
+        for (int digit = 0; digit < 256; ++digit) {
+            size_t total = 0;
+            for (unsigned s = 0; s < slices; ++s) {
+                size_t& bin = histogram[static_cast<size_t>(s) * 256 + digit];
+                size_t value = bin;
+                bin = offset;
+                offset += value;
+                total += value;
+            }
+            if (total == count) trivial = true;
+        }
+        if (trivial) continue;
+
+        auto scatter = [&](unsigned s) {
+            TRACE_SCOPE("suffix_array/scatter");
+            size_t* bins = &histogram[static_cast<size_t>(s) * 256];
+            size_t begin, end;
+            slice(s, begin, end);
+            for (size_t i = begin; i < end; ++i) target[bins[(source[i] >> shift) & 0xff]++] = source[i];
+        };
+        workers.clear();
+        for (unsigned s = 1; s < slices; ++s) workers.emplace_back(scatter, s);
+        scatter(0);
+        for (auto& t : workers) t.join();
+        std::swap(source, target);
+    }
+    if (source != values) std::copy(source, source + count, values);
+}
+
+struct Group {
+    uint32_t begin;
+    uint32_t end;
+};
+
+} // namespace
+
+std::vector<uint32_t> buildSuffixArray(const std::vector<uint8_t>& text, unsigned threads) {
+    if (text.size() >= UINT32_MAX) {
+        throw std::runtime_error("Text too large for a 32-bit suffix array");
+    }
+    uint32_t n = static_cast<uint32_t>(text.size());
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    threads = std::max(1u, threads);
+
+    std::vector<uint32_t> sa(n);
+    std::vector<uint32_t> rank(n);
+    std::vector<uint32_t> keys(n); // sort key of sa[j] during a round
+    std::vector<Group> pending;
+
+    // Round 0: sort by the first four bytes (zero padded past the end;
+    // the unique sentinel keeps those suffixes distinct)
+    {
+        std::vector<uint64_t> packed(n);
+        for (uint32_t i = 0; i < n; ++i) {
+            uint32_t prefix = 0;
+            for (uint32_t b = 0; b < 4; ++b) {
+                prefix = (prefix << 8) | (i + b < n ? text[i + b] : 0);
+            }
+            packed[i] = (static_cast<uint64_t>(prefix) << 32) | i;
+        }
+        std::vector<uint64_t> buffer(n);
+        radixSortByKey(packed.data(), buffer.data(), n, threads);
+
+        uint32_t groupBegin = 0;
+        for (uint32_t j = 0; j < n; ++j) {
+            sa[j] = static_cast<uint32_t>(packed[j]);
+            if (j > 0 && (packed[j] >> 32) != (packed[j - 1] >> 32)) {
+                if (j - groupBegin > 1) pending.push_back(Group{groupBegin, j});
+                groupBegin = j;
+            }
+            rank[sa[j]] = groupBegin;
+        }
+        if (n - groupBegin > 1) pending.push_back(Group{groupBegin, n});
+    }
+
+    // Doubling rounds. Within a round, sorting only reads rank and renaming
+    // only writes it, so groups can be handled by any thread in any order.
+    for (uint32_t h = 4; !pending.empty(); h = h > UINT32_MAX / 2 ? UINT32_MAX : h * 2) {
+        auto sortGroup = [&](const Group& group, std::vector<uint64_t>& scratch, unsigned sortThreads) {
+            size_t size = group.end - group.begin;
+            scratch.resize(size * (size >= RADIX_SORT_MIN ? 2 : 1));
+            for (uint32_t j = group.begin; j < group.end; ++j) {
+                uint32_t suffix = sa[j];
+                // Tied suffixes share their first h bytes, so neither reaches
+                // the sentinel and suffix + h is in range
+                scratch[j - group.begin] = (static_cast<uint64_t>(rank[suffix + h]) << 32) | suffix;
+            }
+            if (size >= RADIX_SORT_MIN) {
+                radixSortByKey(scratch.data(), scratch.data() + size, size, sortThreads);
+            } else {
+                std::sort(scratch.data(), scratch.data() + size);
+            }
+            for (uint32_t j = group.begin; j < group.end; ++j) {
+                uint64_t entry = scratch[j - group.begin];
+                sa[j] = static_cast<uint32_t>(entry);
+                keys[j] = static_cast<uint32_t>(entry >> 32);
+            }
+        };
+
+        // Large groups use every thread in turn, small ones are shared out
+        std::vector<uint64_t> scratch;
+        std::vector<Group> small;
+        for (const Group& group : pending) {
+            if (group.end - group.begin >= RADIX_SORT_MIN) {
+                sortGroup(group, scratch, threads);
+            } else {
+                small.push_back(group);
+            }
+        }
+
+        std::atomic<size_t> next(0);
+        auto sortSmall = [&]() {
+            TRACE_SCOPE("suffix_array/sort");
+            std::vector<uint64_t> local;
+            for (size_t g = next++; g < small.size(); g = next++) sortGroup(small[g], local, 1);
+        };
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads && t < small.size(); ++t) workers.emplace_back(sortSmall);
+        sortSmall();
+        for (auto& t : workers) t.join();
+
+        // Rename: each subgroup's rank is its first index; ties remain pending
+        std::vector<std::vector<Group>> stillTied(threads);
+        next = 0;
+        auto rename = [&](unsigned thread) {
+            TRACE_SCOPE("suffix_array/rename");
+            for (size_t g = next++; g < pending.size(); g = next++) {
+                const Group& group = pending[g];
+                uint32_t subBegin = group.begin;
+                for (uint32_t j = group.begin; j < group.end; ++j) {
+                    if (j > group.begin && keys[j] != keys[j - 1]) {
+                        if (j - subBegin > 1) stillTied[thread].push_back(Group{subBegin, j});
+                        subBegin = j;
+                    }
+                    rank[sa[j]] = subBegin;
+                }
+                if (group.end - subBegin > 1) stillTied[thread].push_back(Group{subBegin, group.end});
+            }
+        };
+        workers.clear();
+        for (unsigned t = 1; t < threads && t < pending.size(); ++t) workers.emplace_back(rename, t);
+        rename(0);
+        for (auto& t : workers) t.join();
+
+        pending.clear();
+        for (const auto& groups : stillTied) pending.insert(pending.end(), groups.begin(), groups.end());
+    }
+    return sa;
+}
@@ -0,0 +1,17 @@
+#ifndef SUFFIX_ARRAY_H
+#define SUFFIX_ARRAY_H
+
+#include <cstdint>
+#include <vector>
+
+// Suffix array of text by prefix doubling: suffixes are first sorted by
+// their leading four bytes, then each round re-sorts only the groups that
+// still tie, by the rank of the suffix h bytes further on, doubling h.
+// Large groups are radix sorted; work is spread across threads (0 =
+// hardware concurrency).
+//
+// text must end in a byte that occurs nowhere else and is smaller than
+// every other byte (a 0 sentinel), and be shorter than 2^32 bytes.
+std::vector<uint32_t> buildSuffixArray(const std::vector<uint8_t>& text, unsigned threads = 0);
+
+#endif // SUFFIX_ARRAY_H
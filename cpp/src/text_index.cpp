@@ -0,0 +1,592 @@
+#include "text_index.h"
+#include "tokenizer.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <numeric>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+// A title match counts as this many lyric matches
+const uint32_t TITLE_WEIGHT = 2;
+
+// Lyric positions start here, so title words come first and no phrase or
+// NEAR window can span both fields
+const uint32_t BODY_POSITION_BASE = 1u << 16;
+
+// Min-heap order on score, so the weakest of the current top k is on top
+struct WorseFirst {
+    bool operator()(const ScoredCandidate& a, const ScoredCandidate& b) const {
+        if (a.score != b.score) return a.score > b.score;
+        return a.id < b.id;
+    }
+};
+
+// Bounded heap holding the k best candidates seen so far
+class TopK {
+public:
+    explicit TopK(size_t k) : limit(k) {}
+
+    void offer(uint32_t doc, double score) {
+        ScoredCandidate candidate{doc, score};
+        if (heap.size() < limit) {
+            heap.push(candidate);
+        } else if (WorseFirst()(candidate, heap.top())) {
+            heap.pop();
+            heap.push(candidate);
+        }
+    }
+
+    bool full() const { return heap.size() >= limit; }
+    double threshold() const { return heap.top().score; }
+
+    // Best first
+    std::vector<ScoredCandidate> take() {
+        std::vector<ScoredCandidate> results;
+        while (!heap.empty()) {
+            results.push_back(heap.top());
+            heap.pop();
+        }
+        std::reverse(results.begin(), results.end());
+        return results;
+    }
+
+private:
+    size_t limit;
+    std::priority_queue<ScoredCandidate, std::vector<ScoredCandidate>, WorseFirst> heap;
+};
+
+struct PositionSpan {
+    const uint32_t* begin;
+    const uint32_t* end;
+};
+
+uint32_t matchWeight(uint32_t position) {
+    return position < BODY_POSITION_BASE ? TITLE_WEIGHT : 1;
+}
+
+// Weighted count of phrase occurrences: term i at start + i for every i
+uint32_t phraseMatches(const std::vector<PositionSpan>& spans, std::vector<uint32_t>& starts) {
+    starts.assign(spans[0].begin, spans[0].end);
+    for (size_t i = 1; i < spans.size() && !starts.empty(); ++i) {
+        const uint32_t* p = spans[i].begin;
+        size_t kept = 0;
+        for (uint32_t start : starts) {
+            uint32_t wanted = start + static_cast<uint32_t>(i);
+            while (p != spans[i].end && *p < wanted) ++p;
+            if (p == spans[i].end) break;
+            if (*p == wanted) starts[kept++] = start;
+        }
+        starts.resize(kept);
+    }
+
+    uint32_t matches = 0;
+    for (uint32_t start : starts) matches += matchWeight(start);
+    return matches;
+}
+
+// Weighted count of windows holding every term with at most distance other
+// words inside, one per leftmost position. Consumes the spans.
+uint32_t nearMatches(std::vector<PositionSpan>& spans, uint32_t distance) {
+    uint32_t words = static_cast<uint32_t>(spans.size());
+    uint32_t matches = 0;
+    while (true) {
+        size_t lowest = 0;
+        uint32_t low = UINT32_MAX;
+        uint32_t high = 0;
+        for (size_t i = 0; i < spans.size(); ++i) {
+            uint32_t position = *spans[i].begin;
+            if (position < low) {
+                low = position;
+                lowest = i;
+            }
+            high = std::max(high, position);
+        }
+        bool sameField = (low < BODY_POSITION_BASE) == (high < BODY_POSITION_BASE);
+        if (sameField && high - low + 1 <= words + distance) matches += matchWeight(low);
+        if (++spans[lowest].begin == spans[lowest].end) break;
+    }
+    return matches;
+}
+
+// "NEAR/<k>" between two words
+bool parseNearOperator(const std::string& piece, uint32_t& distance) {
+    if (piece.size() < 6 || piece.size() > 11 || piece.compare(0, 5, "NEAR/") != 0) return false;
+    uint32_t value = 0;
+    for (size_t i = 5; i < piece.size(); ++i) {
+        if (!std::isdigit(static_cast<unsigned char>(piece[i]))) return false;
+        value = value * 10 + static_cast<uint32_t>(piece[i] - '0');
+    }
+    distance = value;
+    return true;
+}
+
+} // namespace
+
+TextQuery parseTextQuery(const std::string& query) {
+    TextQuery parsed;
+    std::vector<std::string> tokens;
+    size_t lastWords = SIZE_MAX; // words added by the previous bare piece start here
+    bool lastWasNear = false;    // previous piece extended parsed.clauses.back()
+    bool nearPending = false;
+    uint32_t nearDistance = 0;
+
+    size_t i = 0;
+    while (i < query.size()) {
+        if (std::isspace(static_cast<unsigned char>(query[i]))) {
+            ++i;
+            continue;
+        }
+
+        if (query[i] == '"') {
+            size_t close = query.find('"', i + 1);
+            if (close == std::string::npos) close = query.size();
+            tokenize(query.substr(i + 1, close - i - 1), tokens);
+            if (!tokens.empty()) {
+                ProximityClause clause;
+                clause.terms = tokens;
+                parsed.clauses.push_back(clause);
+            }
+            i = close + 1;
+            lastWords = SIZE_MAX;
+            lastWasNear = false;
+            nearPending = false;
+            continue;
+        }
+
+        size_t end = i;
+        while (end < query.size() && query[end] != '"' &&
+               !std::isspace(static_cast<unsigned char>(query[end]))) {
+            ++end;
+        }
+        std::string piece = query.substr(i, end - i);
+        i = end;
+
+        uint32_t distance = 0;
+        if (parseNearOperator(piece, distance)) {
+            // Only words can be NEAR operands; a dangling operator is dropped
+            if (lastWords != SIZE_MAX || lastWasNear) {
+                nearPending = true;
+                nearDistance = distance;
+            }
+            continue;
+        }
+
+        tokenize(piece, tokens);
+        if (tokens.empty()) continue;
+        if (nearPending) {
+            if (!lastWasNear) {
+                ProximityClause clause;
+                clause.phrase = false;
+                clause.terms.assign(parsed.words.begin() + lastWords, parsed.words.end());
+                parsed.words.resize(lastWords);
+                parsed.clauses.push_back(clause);
+            }
+            ProximityClause& clause = parsed.clauses.back();
+            clause.terms.insert(clause.terms.end(), tokens.begin(), tokens.end());
+            clause.distance = std::max(clause.distance, nearDistance);
+            nearPending = false;
+            lastWasNear = true;
+            lastWords = SIZE_MAX;
+        } else {
+            lastWords = parsed.words.size();
+            parsed.words.insert(parsed.words.end(), tokens.begin(), tokens.end());
+            lastWasNear = false;
+        }
+    }
+
+    // A repeated word adds nothing to a NEAR window
+    for (auto& clause : parsed.clauses) {
+        if (clause.phrase) continue;
+        std::sort(clause.terms.begin(), clause.terms.end());
+        clause.terms.erase(std::unique(clause.terms.begin(), clause.terms.end()), clause.terms.end());
+    }
+    return parsed;
+}
+
+void TextIndex::clear() {
+    dictionary.clear();
+    postings.clear();
+    docLengths.clear();
+    avgDocLength = 0.0;
+}
+
+void TextIndex::build(const std::vector<TextDocument>& documents, const Params& buildParams) {
+    clear();
+    params = buildParams;
+
+    size_t count = documents.size();
+    docLengths.assign(count, 0);
+    if (count == 0) return;
+
+    unsigned threadCount = params.threads != 0 ? params.threads : std::thread::hardware_concurrency();
+    threadCount = std::max(1u, std::min<unsigned>(threadCount, static_cast<unsigned>(count)));
+    size_t chunk = (count + threadCount - 1) / threadCount;
+
+    // Phase 1: each shard indexes a contiguous ordinal range with its own
+    // dictionary, so postings within a shard are already in ordinal order.
+    struct RawList {
+        std::vector<uint32_t> docs;  // ascending ordinals
+        std::vector<uint32_t> freqs; // weighted term frequency per doc
+        std::vector<uint32_t> positionCounts;
+        std::vector<uint32_t> positions;
+    };
+    struct Shard {
+        std::unordered_map<std::string, uint32_t> terms;
+        std::vector<RawList> lists;
+    };
+    std::vector<Shard> shards((count + chunk - 1) / chunk);
+
+    auto worker = [&](size_t shardIndex) {
+        TRACE_SCOPE("text_index/shard");
+        Shard& shard = shards[shardIndex];
+        size_t begin = shardIndex * chunk;
+        size_t end = std::min(count, begin + chunk);
+
+        std::vector<std::string> tokens;
+        std::vector<std::pair<uint32_t, uint32_t>> docTerms; // (local term, position)
+
+        for (size_t doc = begin; doc < end; ++doc) {
+            docTerms.clear();
+            uint32_t length = 0;
+
+            const std::string* fields[2] = {documents[doc].title, documents[doc].body};
+            for (int f = 0; f < 2; ++f) {
+                if (fields[f] == nullptr) continue;
+                tokenize(*fields[f], tokens);
+                length += static_cast<uint32_t>(tokens.size());
+                for (size_t t = 0; t < tokens.size(); ++t) {
+                    auto inserted = shard.terms.emplace(tokens[t], static_cast<uint32_t>(shard.lists.size()));
+                    if (inserted.second) shard.lists.emplace_back();
+                    uint32_t position = f == 0
+                        ? static_cast<uint32_t>(std::min<size_t>(t, BODY_POSITION_BASE - 2))
+                        : BODY_POSITION_BASE + static_cast<uint32_t>(t);
+                    docTerms.push_back(std::make_pair(inserted.first->second, position));
+                }
+            }
+
+            docLengths[doc] = length;
+            std::sort(docTerms.begin(), docTerms.end());
+            for (size_t i = 0; i < docTerms.size();) {
+                uint32_t term = docTerms[i].first;
+                RawList& list = shard.lists[term];
+                uint32_t freq = 0;
+                size_t first = i;
+                for (; i < docTerms.size() && docTerms[i].first == term; ++i) {
+                    uint32_t position = docTerms[i].second;
+                    freq += position < BODY_POSITION_BASE ? TITLE_WEIGHT : 1;
+                    if (params.positions) list.positions.push_back(position);
+                }
+                list.docs.push_back(static_cast<uint32_t>(doc));
+                list.freqs.push_back(freq);
+                if (params.positions) list.positionCounts.push_back(static_cast<uint32_t>(i - first));
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t s = 1; s < shards.size(); ++s) workers.emplace_back(worker, s);
+    worker(0);
+    for (auto& t : workers) t.join();
+
+    // Phase 2: append shard postings in shard order to keep lists sorted
+    TraceSpan mergeSpan("text_index/merge");
+    std::vector<RawList> merged;
+    for (Shard& shard : shards) {
+        for (auto& entry : shard.terms) {
+            auto inserted = dictionary.emplace(entry.first, static_cast<uint32_t>(merged.size()));
+            if (inserted.second) merged.emplace_back();
+
+            RawList& target = merged[inserted.first->second];
+            RawList& source = shard.lists[entry.second];
+            target.docs.insert(target.docs.end(), source.docs.begin(), source.docs.end());
+            target.freqs.insert(target.freqs.end(), source.freqs.begin(), source.freqs.end());
+            target.positionCounts.insert(target.positionCounts.end(), source.positionCounts.begin(),
+                                         source.positionCounts.end());
+            target.positions.insert(target.positions.end(), source.positions.begin(),
+                                    source.positions.end());
+        }
+        shard = Shard();
+    }
+
+    mergeSpan.stop();
+
+    // Phase 3: compress every list, terms spread across threads
+    postings.resize(merged.size());
+    std::atomic<size_t> nextTerm(0);
+    auto encoder = [&]() {
+        TRACE_SCOPE("text_index/encode");
+        for (size_t term = nextTerm++; term < merged.size(); term = nextTerm++) {
+            RawList& list = merged[term];
+            if (params.positions) {
+                postings[term].encode(list.docs, list.freqs, &list.positionCounts, &list.positions);
+            } else {
+                postings[term].encode(list.docs, list.freqs);
+            }
+            merged[term] = RawList();
+        }
+    };
+    workers.clear();
+    for (unsigned t = 1; t < threadCount; ++t) workers.emplace_back(encoder);
+    encoder();
+    for (auto& t : workers) t.join();
+
+    double totalLength = 0.0;
+    for (uint32_t length : docLengths) totalLength += length;
+    avgDocLength = totalLength / static_cast<double>(count);
+}
+
+double TextIndex::idf(size_t df) const {
+    double n = static_cast<double>(docLengths.size());
+    return std::log(1.0 + (n - df + 0.5) / (df + 0.5));
+}
+
+double TextIndex::termScore(uint32_t freq, uint32_t doc, double termIdf) const {
+    double tf = static_cast<double>(freq);
+    double norm = params.k1 * (1.0 - params.b + params.b * docLengths[doc] / std::max(avgDocLength, 1.0));
+    return termIdf * tf * (params.k1 + 1.0) / (tf + norm);
+}
+
+size_t TextIndex::documentFrequency(const std::string& term) const {
+    auto it = dictionary.find(term);
+    return it == dictionary.end() ? 0 : postings[it->second].size();
+}
+
+const CompressedPostings* TextIndex::postingsFor(const std::string& term) const {
+    auto it = dictionary.find(term);
+    return it == dictionary.end() ? nullptr : &postings[it->second];
+}
+
+std::vector<ScoredCandidate> TextIndex::search(const std::vector<std::string>& terms, size_t k,
+                                               bool requireAll, const Filter& accept) const {
+    std::vector<ScoredCandidate> results;
+    if (k == 0 || terms.empty()) return results;
+
+    std::vector<std::string> unique(terms);
+    std::sort(unique.begin(), unique.end());
+    unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+    std::vector<Cursor> cursors;
+    for (const auto& term : unique) {
+        auto it = dictionary.find(term);
+        if (it == dictionary.end()) {
+            if (requireAll) return results;
+            continue;
+        }
+        const CompressedPostings& list = postings[it->second];
+        cursors.push_back(Cursor(&list, idf(list.size())));
+    }
+    if (cursors.empty()) return results;
+
+    TopK top(k);
+    auto offer = [&](uint32_t doc, double score) {
+        if (!accept || accept(doc)) top.offer(doc, score);
+    };
+
+    if (requireAll) {
+        // Leapfrog intersection driven by the rarest term
+        std::sort(cursors.begin(), cursors.end(), [](const Cursor& a, const Cursor& b) {
+            return a.size() < b.size();
+        });
+        bool exhausted = false;
+        while (!exhausted && !cursors[0].done()) {
+            uint32_t candidate = cursors[0].doc();
+            bool matched = true;
+            for (size_t i = 1; i < cursors.size(); ++i) {
+                cursors[i].postings.advanceTo(candidate);
+                if (cursors[i].done()) {
+                    exhausted = true;
+                    matched = false;
+                    break;
+                }
+                if (cursors[i].doc() != candidate) {
+                    cursors[0].postings.advanceTo(cursors[i].doc());
+                    matched = false;
+                    break;
+                }
+            }
+            if (!matched) continue;
+
+            double score = 0.0;
+            for (Cursor& cursor : cursors) {
+                score += termScore(cursor.postings.freq(), candidate, cursor.idf);
+            }
+            offer(candidate, score);
+            cursors[0].postings.next();
+        }
+    } else {
+        // Union with MaxScore pruning: once the top k is full, lists whose
+        // combined best case cannot beat the k-th score stop driving the
+        // traversal and are only probed for documents found elsewhere.
+        for (Cursor& cursor : cursors) cursor.bound = cursor.idf * (params.k1 + 1.0);
+        std::sort(cursors.begin(), cursors.end(), [](const Cursor& a, const Cursor& b) {
+            return a.bound < b.bound;
+        });
+        std::vector<double> prefixBound(cursors.size());
+        double running = 0.0;
+        for (size_t i = 0; i < cursors.size(); ++i) {
+            running += cursors[i].bound;
+            prefixBound[i] = running;
+        }
+
+        size_t firstEssential = 0;
+        double threshold = -1.0;
+        while (firstEssential < cursors.size()) {
+            uint32_t doc = UINT32_MAX;
+            for (size_t i = firstEssential; i < cursors.size(); ++i) {
+                if (!cursors[i].done()) doc = std::min(doc, cursors[i].doc());
+            }
+            if (doc == UINT32_MAX) break;
+
+            double score = 0.0;
+            for (size_t i = firstEssential; i < cursors.size(); ++i) {
+                Cursor& cursor = cursors[i];
+                if (!cursor.done() && cursor.doc() == doc) {
+                    score += termScore(cursor.postings.freq(), doc, cursor.idf);
+                    cursor.postings.next();
+                }
+            }
+
+            bool viable = true;
+            for (size_t i = firstEssential; i-- > 0;) {
+                if (score + prefixBound[i] <= threshold) {
+                    viable = false;
+                    break;
+                }
+                Cursor& cursor = cursors[i];
+                cursor.postings.advanceTo(doc);
+                if (!cursor.done() && cursor.doc() == doc) {
+                    score += termScore(cursor.postings.freq(), doc, cursor.idf);
+                }
+            }
+            if (!viable) continue;
+
+            offer(doc, score);
+            if (top.full()) {
+                threshold = top.threshold();
+                while (firstEssential < cursors.size() && prefixBound[firstEssential] <= threshold) {
+                    firstEssential++;
+                }
+            }
+        }
+    }
+
+    return top.take();
+}
+
+std::vector<ScoredCandidate> TextIndex::searchProximity(const std::vector<ProximityClause>& clauses,
+                                                        size_t k, const Filter& accept) const {
+    if (!params.positions) {
+        throw std::runtime_error("Text index was built without word positions");
+    }
+    if (k == 0) return std::vector<ScoredCandidate>();
+
+    // One cursor per clause term; clause c owns cursors [first[c], first[c + 1])
+    std::vector<Cursor> cursors;
+    std::vector<const ProximityClause*> active;
+    std::vector<size_t> first;
+    std::vector<double> clauseIdf;
+    for (const auto& clause : clauses) {
+        if (clause.terms.empty()) continue;
+        active.push_back(&clause);
+        first.push_back(cursors.size());
+        double idfSum = 0.0;
+        for (const auto& term : clause.terms) {
+            auto it = dictionary.find(term);
+            if (it == dictionary.end()) return std::vector<ScoredCandidate>();
+            const CompressedPostings& list = postings[it->second];
+            cursors.push_back(Cursor(&list, idf(list.size())));
+            idfSum += cursors.back().idf;
+        }
+        clauseIdf.push_back(idfSum);
+    }
+    if (cursors.empty()) return std::vector<ScoredCandidate>();
+    first.push_back(cursors.size());
+
+    // Documents holding every term, by leapfrog from the rarest, then the
+    // positions of each clause are checked
+    std::vector<size_t> order(cursors.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&cursors](size_t a, size_t b) {
+        return cursors[a].size() < cursors[b].size();
+    });
+    Cursor& lead = cursors[order[0]];
+
+    TopK top(k);
+    std::vector<PositionSpan> spans;
+    std::vector<uint32_t> starts;
+    bool exhausted = false;
+    while (!exhausted && !lead.done()) {
+        uint32_t candidate = lead.doc();
+        bool matched = true;
+        for (size_t i = 1; i < order.size(); ++i) {
+            Cursor& cursor = cursors[order[i]];
+            cursor.postings.advanceTo(candidate);
+            if (cursor.done()) {
+                exhausted = true;
+                matched = false;
+                break;
+            }
+            if (cursor.doc() != candidate) {
+                lead.postings.advanceTo(cursor.doc());
+                matched = false;
+                break;
+            }
+        }
+        if (!matched) continue;
+
+        if (!accept || accept(candidate)) {
+            double score = 0.0;
+            for (size_t c = 0; c < active.size() && matched; ++c) {
+                spans.clear();
+                for (size_t i = first[c]; i < first[c + 1]; ++i) {
+                    size_t count = 0;
+                    const uint32_t* positions = cursors[i].postings.positions(count);
+                    spans.push_back(PositionSpan{positions, positions + count});
+                }
+                uint32_t matches = active[c]->phrase ? phraseMatches(spans, starts)
+                                                     : nearMatches(spans, active[c]->distance);
+                if (matches == 0) {
+                    matched = false;
+                } else {
+                    score += termScore(matches, candidate, clauseIdf[c]);
+                }
+            }
+            if (matched) top.offer(candidate, score);
+        }
+        lead.postings.next();
+    }
+    return top.take();
+}
+
+size_t TextIndex::postingCount() const {
+    size_t total = 0;
+    for (const auto& list : postings) total += list.size();
+    return total;
+}
+
+size_t TextIndex::postingBytes() const {
+    size_t bytes = 0;
+    for (const auto& list : postings) bytes += list.memoryBytes() - list.positionMemoryBytes();
+    return bytes;
+}
+
+size_t TextIndex::positionBytes() const {
+    size_t bytes = 0;
+    for (const auto& list : postings) bytes += list.positionMemoryBytes();
+    return bytes;
+}
+
+size_t TextIndex::memoryBytes() const {
+    size_t bytes = docLengths.capacity() * sizeof(uint32_t) + postingBytes() + positionBytes();
+    for (const auto& entry : dictionary) {
+        bytes += sizeof(entry) + entry.first.capacity() + sizeof(void*);
+    }
+    bytes += dictionary.bucket_count() * sizeof(void*);
+    return bytes;
+}
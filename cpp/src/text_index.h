@@ -0,0 +1,114 @@
+#ifndef TEXT_INDEX_H
+#define TEXT_INDEX_H
+
+#include "fusion.h"
+#include "posting_codec.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// One document to index: a title (matches weigh double) and a body
+struct TextDocument {
+    const std::string* title;
+    const std::string* body;
+};
+
+// A positional constraint: the terms as an exact phrase, or all of them
+// within a window of at most distance other words, in any order (NEAR/k)
+struct ProximityClause {
+    std::vector<std::string> terms;
+    bool phrase;
+    uint32_t distance;
+
+    ProximityClause() : phrase(true), distance(0) {}
+};
+
+// A keyword query split into loose words and positional clauses.
+// "quoted words" become phrases and a NEAR/3 b becomes a NEAR clause.
+struct TextQuery {
+    std::vector<std::string> words;
+    std::vector<ProximityClause> clauses;
+};
+
+TextQuery parseTextQuery(const std::string& query);
+
+// Tokenized inverted index over song titles and lyrics with BM25 ranking.
+// Document ids are song ordinals; posting lists are sorted by ordinal and
+// stored delta-encoded in Stream-VByte blocks with per-block skip entries.
+// Word positions are kept alongside for phrase and proximity queries.
+class TextIndex {
+public:
+    struct Params {
+        double k1;        // term-frequency saturation
+        double b;         // document length normalisation
+        unsigned threads; // build threads, 0 = hardware concurrency
+        bool positions;   // store word positions (needed by searchProximity)
+
+        Params() : k1(1.2), b(0.75), threads(0), positions(true) {}
+    };
+
+    // Return false to drop a matching document from the results
+    typedef std::function<bool(uint32_t)> Filter;
+
+    TextIndex() : avgDocLength(0.0) {}
+
+    // Tokenize and index every document, sharding the work across threads
+    void build(const std::vector<TextDocument>& documents, const Params& params = Params());
+    void clear();
+
+    // Top k documents by BM25 for the given (already tokenized) terms.
+    // requireAll keeps only documents containing every term.
+    std::vector<ScoredCandidate> search(const std::vector<std::string>& terms, size_t k,
+                                        bool requireAll, const Filter& accept = Filter()) const;
+
+    // Top k documents matching every clause, found by positional
+    // intersection. A clause scores as one BM25 term whose frequency is its
+    // number of matches and whose idf is the sum of its terms' idfs.
+    std::vector<ScoredCandidate> searchProximity(const std::vector<ProximityClause>& clauses,
+                                                 size_t k, const Filter& accept = Filter()) const;
+
+    // Number of documents containing term
+    size_t documentFrequency(const std::string& term) const;
+
+    size_t documentCount() const { return docLengths.size(); }
+    size_t termCount() const { return postings.size(); }
+    size_t postingCount() const;
+    size_t memoryBytes() const;
+
+    // Bytes the posting lists would take as plain uint32 doc/frequency arrays
+    size_t uncompressedPostingBytes() const { return postingCount() * 2 * sizeof(uint32_t); }
+    size_t postingBytes() const;  // compressed doc ids and frequencies
+    size_t positionBytes() const; // compressed word positions
+    bool hasPositions() const { return params.positions; }
+
+    // Compressed posting list of a term, or nullptr if it never occurs
+    const CompressedPostings* postingsFor(const std::string& term) const;
+
+private:
+    // Cursor over one posting list during document-at-a-time evaluation
+    struct Cursor {
+        PostingCursor postings;
+        double idf;
+        double bound; // upper bound on this term's score contribution
+
+        Cursor(const CompressedPostings* list, double termIdf)
+            : postings(list), idf(termIdf), bound(0.0) {}
+
+        uint32_t doc() const { return postings.doc(); }
+        bool done() const { return postings.done(); }
+        size_t size() const { return postings.postings()->size(); }
+    };
+
+    Params params;
+    std::unordered_map<std::string, uint32_t> dictionary;
+    std::vector<CompressedPostings> postings;
+    std::vector<uint32_t> docLengths;
+    double avgDocLength;
+
+    double termScore(uint32_t freq, uint32_t doc, double idf) const;
+    double idf(size_t df) const;
+};
+
+#endif // TEXT_INDEX_H
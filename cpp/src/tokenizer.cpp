@@ -0,0 +1,26 @@
+#include "tokenizer.h"
+
+void tokenize(const std::string& text, std::vector<std::string>& tokens) {
+    tokens.clear();
+    std::string current;
+
+    for (char ch : text) {
+        unsigned char c = static_cast<unsigned char>(ch);
+        if (isTokenChar(c)) {
+            if (c >= 'A' && c <= 'Z') {
+                c = static_cast<unsigned char>(c - 'A' + 'a');
+            }
+            current += static_cast<char>(c);
+        } else if (c == '\'') {
+            // Keep contractions together ("i'm" -> "im")
+            continue;
+        } else if (!current.empty()) {
+            tokens.push_back(current);
+            current.clear();
+        }
+    }
+
+    if (!current.empty()) {
+        tokens.push_back(current);
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <string>
+#include <vector>
+
+// Split text into lower-cased word tokens. ASCII letters and digits form
+// words; bytes >= 0x80 are kept so UTF-8 words survive as single tokens.
+// Everything else (punctuation, '/', whitespace) separates tokens.
+void tokenize(const std::string& text, std::vector<std::string>& tokens);
+
+// True if the byte belongs to a word token
+inline bool isTokenChar(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+// 64-bit FNV-1a hash, used for feature hashing of tokens
+inline unsigned long long hashToken(const std::string& token) {
+    unsigned long long h = 1469598103934665603ULL;
+    for (unsigned char c : token) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+#endif // TOKENIZER_H
@@ -0,0 +1,116 @@
+#include "trace.h"
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#ifdef PLAYLIST_TRACING
+
+std::atomic<bool> tracingEnabled(false);
+
+namespace {
+
+struct Span {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+// Spans recorded per buffer; a full buffer is kept and a new one started,
+// so recording never copies earlier spans
+const size_t SPANS_PER_BLOCK = 1 << 14;
+
+// Spans of one thread. Buffers are owned by the registry, so spans of
+// threads that have exited are still written.
+struct ThreadTrace {
+    unsigned tid;
+    std::vector<std::vector<Span>> blocks;
+};
+
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadTrace>> registry;
+uint64_t traceStart = 0;
+
+ThreadTrace& localTrace() {
+    thread_local ThreadTrace* trace = nullptr;
+    if (trace == nullptr) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.emplace_back(new ThreadTrace());
+        trace = registry.back().get();
+        trace->tid = static_cast<unsigned>(registry.size());
+    }
+    return *trace;
+}
+
+} // namespace
+
+void recordSpan(const char* name, uint64_t start, uint64_t end) {
+    ThreadTrace& trace = localTrace();
+    if (trace.blocks.empty() || trace.blocks.back().size() == SPANS_PER_BLOCK) {
+        trace.blocks.emplace_back();
+        trace.blocks.back().reserve(SPANS_PER_BLOCK);
+    }
+    trace.blocks.back().push_back(Span{name, start, end});
+}
+
+void startTracing() {
+    traceStart = traceNanos();
+    tracingEnabled.store(true, std::memory_order_relaxed);
+}
+
+void writeTrace(const std::string& path) {
+    tracingEnabled.store(false, std::memory_order_relaxed);
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        throw std::runtime_error("Could not write trace file: " + path);
+    }
+
+    // Complete ("X") events in microseconds from the start of tracing, and
+    // a name for every thread that recorded any
+    std::lock_guard<std::mutex> lock(registryMutex);
+    out << "{\"traceEvents\": [";
+    bool first = true;
+    char line[160];
+    for (const auto& thread : registry) {
+        if (thread->blocks.empty()) continue;
+        std::snprintf(line, sizeof(line),
+                      "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, "
+                      "\"args\": {\"name\": \"thread %u\"}}",
+                      first ? "" : ",", thread->tid, thread->tid);
+        out << line;
+        first = false;
+        for (const auto& block : thread->blocks) {
+            for (const Span& span : block) {
+                if (span.start < traceStart) continue;
+                std::snprintf(line, sizeof(line),
+                              ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, "
+                              "\"ts\": %.3f, \"dur\": %.3f}",
+                              span.name, thread->tid, (span.start - traceStart) / 1e3,
+                              (span.end - span.start) / 1e3);
+                out << line;
+            }
+        }
+    }
+    out << "\n], \"displayTimeUnit\": \"ns\"}\n";
+    if (!out) {
+        throw std::runtime_error("Could not write trace file: " + path);
+    }
+}
+
+bool tracingCompiled() {
+    return true;
+}
+
+#else
+
+void startTracing() {}
+
+void writeTrace(const std::string&) {}
+
+bool tracingCompiled() {
+    return false;
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Scoped spans in the Chrome trace_event format, for chrome://tracing and
+// Perfetto. TRACE_SCOPE("name") records the enclosing scope as one span of
+// the calling thread; every ProfileStage is a span too. Spans are built in
+// with the TRACING CMake option: then a span outside startTracing() costs
+// one relaxed load and a recorded one two clock reads and an append to a
+// per-thread buffer. Without the option they compile to nothing.
+
+// Record spans on every thread from now on
+void startTracing();
+
+// Stop recording and write the spans as trace_event JSON. Call once the
+// traced threads are done. Throws std::runtime_error if path cannot be
+// written.
+void writeTrace(const std::string& path);
+
+bool tracingCompiled();
+
+#ifdef PLAYLIST_TRACING
+
+extern std::atomic<bool> tracingEnabled;
+
+inline uint64_t traceNanos() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void recordSpan(const char* name, uint64_t start, uint64_t end);
+
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name)
+        : name(name), start(tracingEnabled.load(std::memory_order_relaxed) ? traceNanos() : IDLE) {}
+    ~TraceSpan() { stop(); }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    // End the span before the scope does
+    void stop() {
+        if (start == IDLE) return;
+        recordSpan(name, start, traceNanos());
+        start = IDLE;
+    }
+
+private:
+    static constexpr uint64_t IDLE = UINT64_MAX;
+
+    const char* name;
+    uint64_t start;
+};
+
+#else
+
+class TraceSpan {
+public:
+    explicit TraceSpan(const char*) {}
+    void stop() {}
+};
+
+#endif
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(name)
+
+#endif // TRACE_H
@@ -0,0 +1,255 @@
+// Tests for the suffix array builder and the FM-index: the parallel
+// prefix-doubling build against plain sorts of the suffixes, on random and
+// highly repetitive text (large enough for the radix-sorted path),
+// FmIndex::count / locate against std::string::find, and loading of
+// damaged index files.
+
+#include "fm_index.h"
+#include "suffix_array.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Larger than the suffix array's RADIX_SORT_MIN, and twice it, so groups
+// this size are radix sorted by more than one thread
+const size_t RADIX_TEXT = (1 << 17) + 3;
+
+const unsigned THREADS[] = {1, 4};
+
+// Random bytes from alphabet, ending in the 0 sentinel
+std::vector<uint8_t> randomText(size_t length, const std::string& alphabet, std::mt19937& rng) {
+    std::vector<uint8_t> text(length + 1, 0);
+    for (size_t i = 0; i < length; ++i) text[i] = static_cast<uint8_t>(alphabet[rng() % alphabet.size()]);
+    return text;
+}
+
+std::vector<uint8_t> repeatedText(size_t length, const std::string& unit) {
+    std::vector<uint8_t> text(length + 1, 0);
+    for (size_t i = 0; i < length; ++i) text[i] = static_cast<uint8_t>(unit[i % unit.size()]);
+    return text;
+}
+
+// Suffixes sorted by comparing them byte by byte; quadratic on repetitive
+// text, so only for short inputs
+std::vector<uint32_t> naiveSuffixArray(const std::vector<uint8_t>& text) {
+    std::vector<uint32_t> suffixes(text.size());
+    std::iota(suffixes.begin(), suffixes.end(), 0);
+    std::sort(suffixes.begin(), suffixes.end(), [&text](uint32_t a, uint32_t b) {
+        return std::lexicographical_compare(text.begin() + a, text.end(), text.begin() + b, text.end());
+    });
+    return suffixes;
+}
+
+// Suffixes sorted with std::sort on (rank, rank h further on) pairs,
+// doubling h until every rank is distinct
+std::vector<uint32_t> doublingSuffixArray(const std::vector<uint8_t>& text) {
+    size_t n = text.size();
+    std::vector<uint32_t> suffixes(n);
+    std::vector<uint32_t> rank(text.begin(), text.end());
+    std::vector<uint32_t> next(n);
+    std::iota(suffixes.begin(), suffixes.end(), 0);
+    for (size_t h = 1;; h *= 2) {
+        auto key = [&](uint32_t s) {
+            return std::make_pair(rank[s], s + h < n ? rank[s + h] + 1 : 0);
+        };
+        std::sort(suffixes.begin(), suffixes.end(), [&](uint32_t a, uint32_t b) { return key(a) < key(b); });
+        next[suffixes[0]] = 0;
+        for (size_t i = 1; i < n; ++i) {
+            next[suffixes[i]] = next[suffixes[i - 1]] + (key(suffixes[i - 1]) < key(suffixes[i]) ? 1 : 0);
+        }
+        rank.swap(next);
+        if (rank[suffixes[n - 1]] == n - 1) return suffixes;
+    }
+}
+
+// First index where the suffix arrays differ, or SIZE_MAX; gtest's own
+// diff of vectors this long would take minutes
+size_t firstDifference(const std::vector<uint32_t>& actual, const std::vector<uint32_t>& expected) {
+    if (actual.size() != expected.size()) return std::min(actual.size(), expected.size());
+    auto mismatch = std::mismatch(actual.begin(), actual.end(), expected.begin());
+    return mismatch.first == actual.end() ? SIZE_MAX : static_cast<size_t>(mismatch.first - actual.begin());
+}
+
+// Positions of pattern in text, overlapping ones included
+std::vector<uint32_t> findAll(const std::string& text, const std::string& pattern) {
+    std::vector<uint32_t> positions;
+    for (size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1)) {
+        positions.push_back(static_cast<uint32_t>(at));
+    }
+    return positions;
+}
+
+std::string lowercase(std::string text) {
+    for (char& c : text) {
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c + ('a' - 'A'));
+    }
+    return text;
+}
+
+} // namespace
+
+TEST(SuffixArrayTest, MatchesNaiveSortOnShortText) {
+    std::mt19937 rng(1);
+    std::vector<std::vector<uint8_t>> texts;
+    texts.push_back(std::vector<uint8_t>(1, 0));
+    texts.push_back(randomText(1, "ab", rng));
+    texts.push_back(randomText(3, "ab", rng));
+    texts.push_back(randomText(1000, "ab", rng));
+    texts.push_back(randomText(5000, "abcdefghijklmnopqrstuvwxyz ", rng));
+    texts.push_back(repeatedText(3000, "a"));
+    texts.push_back(repeatedText(3000, "ab"));
+    texts.push_back(repeatedText(2999, "abcabd"));
+    for (const std::vector<uint8_t>& text : texts) {
+        std::vector<uint32_t> expected = naiveSuffixArray(text);
+        for (unsigned threads : THREADS) {
+            EXPECT_EQ(firstDifference(buildSuffixArray(text, threads), expected), SIZE_MAX)
+                << text.size() << " bytes, " << threads << " threads";
+        }
+    }
+}
+
+TEST(SuffixArrayTest, MatchesReferenceOnRadixSortedGroups) {
+    std::mt19937 rng(2);
+    std::vector<std::vector<uint8_t>> texts;
+    texts.push_back(randomText(RADIX_TEXT, "ab", rng));
+    texts.push_back(randomText(RADIX_TEXT, "abcdefghijklmnopqrstuvwxyz ", rng));
+    texts.push_back(repeatedText(RADIX_TEXT, "abc"));
+    texts.push_back(repeatedText(RADIX_TEXT, "la la la, "));
+    for (const std::vector<uint8_t>& text : texts) {
+        std::vector<uint32_t> expected = doublingSuffixArray(text);
+        for (unsigned threads : THREADS) {
+            EXPECT_EQ(firstDifference(buildSuffixArray(text, threads), expected), SIZE_MAX)
+                << text.size() << " bytes, " << threads << " threads";
+        }
+    }
+}
+
+TEST(SuffixArrayTest, SortsRunOfOneByte) {
+    // Every suffix ties on its leading bytes until h reaches its length;
+    // shorter runs sort first because the sentinel is smallest
+    std::vector<uint8_t> text = repeatedText(RADIX_TEXT, "a");
+    std::vector<uint32_t> expected(text.size());
+    for (size_t i = 0; i < text.size(); ++i) expected[i] = static_cast<uint32_t>(text.size() - 1 - i);
+    for (unsigned threads : THREADS) {
+        EXPECT_EQ(firstDifference(buildSuffixArray(text, threads), expected), SIZE_MAX) << threads << " threads";
+    }
+}
+
+TEST(FmIndexTest, CountAndLocateMatchFind) {
+    std::mt19937 rng(3);
+    std::vector<std::string> documents;
+    for (size_t d = 0; d < 40; ++d) {
+        std::vector<uint8_t> bytes = randomText(rng() % 400, "aAbBc ,", rng);
+        documents.push_back(std::string(bytes.begin(), bytes.end() - 1));
+    }
+    documents.push_back("");
+    documents.push_back(std::string(3000, 'a'));
+    documents.push_back("Golden rays, golden RAYS, goldengolden");
+    std::vector<const std::string*> pointers;
+    for (const std::string& document : documents) pointers.push_back(&document);
+
+    std::vector<std::string> patterns = {"a", "A", "ab", "aB c", "aaaa", std::string(700, 'a'), "golden",
+                                         "GOLDEN RAYS", "goldengolden", "x", "ray s", ",,,", "c ,a"};
+    for (size_t p = 0; p < 60; ++p) {
+        // Substrings of the documents, some running to a document's end
+        const std::string& document = documents[rng() % documents.size()];
+        if (document.empty()) continue;
+        size_t start = rng() % document.size();
+        patterns.push_back(document.substr(start, 1 + rng() % 12));
+    }
+
+    for (uint32_t sampleRate : {1u, 4u, 32u}) {
+        FmIndex::Params params;
+        params.sampleRate = sampleRate;
+        params.threads = 2;
+        FmIndex index;
+        index.build(pointers, params);
+        ASSERT_EQ(index.documentCount(), documents.size());
+
+        for (const std::string& pattern : patterns) {
+            std::vector<std::pair<uint32_t, uint32_t>> expected;
+            for (size_t d = 0; d < documents.size(); ++d) {
+                for (uint32_t at : findAll(lowercase(documents[d]), lowercase(pattern))) {
+                    expected.emplace_back(static_cast<uint32_t>(d), at);
+                }
+            }
+            EXPECT_EQ(index.count(pattern), expected.size()) << "'" << pattern << "' rate " << sampleRate;
+
+            std::vector<std::pair<uint32_t, uint32_t>> located;
+            for (const FmIndex::Occurrence& occurrence : index.locate(pattern)) {
+                located.emplace_back(occurrence.document, occurrence.offset);
+            }
+            std::sort(located.begin(), located.end());
+            EXPECT_EQ(located, expected) << "'" << pattern << "' rate " << sampleRate;
+
+            size_t limit = expected.size() / 2;
+            EXPECT_EQ(index.locate(pattern, limit).size(), limit) << "'" << pattern << "'";
+        }
+        EXPECT_EQ(index.count(""), 0u);
+        EXPECT_TRUE(index.locate("").empty());
+    }
+}
+
+TEST(FmIndexTest, LoadRejectsDamagedFiles) {
+    std::mt19937 rng(4);
+    std::vector<std::string> documents;
+    for (size_t d = 0; d < 30; ++d) {
+        std::vector<uint8_t> bytes = randomText(rng() % 200, "abcde ", rng);
+        documents.push_back(std::string(bytes.begin(), bytes.end() - 1));
+    }
+    std::vector<const std::string*> pointers;
+    for (const std::string& document : documents) pointers.push_back(&document);
+    FmIndex::Params params;
+    params.sampleRate = 8;
+    FmIndex built;
+    built.build(pointers, params);
+    std::string path = ::testing::TempDir() + "fm_index_test.idx";
+    built.save(path);
+
+    std::ifstream in(path, std::ios::binary);
+    std::string image((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    FmIndex intact;
+    intact.load(path, pointers);
+    EXPECT_EQ(intact.count("ab"), built.count("ab"));
+
+    // Damage single bytes, or cut the file short: load either throws or
+    // yields an index whose queries stay in bounds and terminate
+    size_t rejected = 0;
+    for (size_t trial = 0; trial < 3000; ++trial) {
+        std::string damaged = image;
+        if (trial % 10 == 9) {
+            damaged.resize(rng() % image.size());
+        } else {
+            damaged[rng() % damaged.size()] ^= static_cast<char>(1 + rng() % 255);
+        }
+        std::ofstream(path, std::ios::binary | std::ios::trunc).write(damaged.data(), damaged.size());
+
+        FmIndex index;
+        try {
+            index.load(path, pointers);
+        } catch (const std::runtime_error&) {
+            EXPECT_TRUE(index.empty());
+            rejected++;
+            continue;
+        }
+        for (const char* pattern : {"a", "ab", "cde", "e a"}) {
+            for (const FmIndex::Occurrence& occurrence : index.locate(pattern)) {
+                ASSERT_LT(occurrence.document, documents.size());
+            }
+        }
+    }
+    EXPECT_GT(rejected, 0u);
+    std::remove(path.c_str());
+}
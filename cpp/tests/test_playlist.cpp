@@ -0,0 +1,266 @@
+// Tests for the daemon's request path: once warm, answering a request must
+// not touch the heap, whether it goes straight to a RequestHandler or
+// through a PlaylistServer connection. Allocations are only counted with
+// COUNT_ALLOCATIONS, so without it these tests are skipped. Also checks the
+// handler's answers to complete= requests.
+
+#include "playlist.h"
+#include "profile.h"
+#include "server.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t CATALOG_SONGS = 3000;
+
+// songs.csv-style catalog; each song serializes to roughly 400 bytes
+void writeCatalog(const std::string& path, size_t n) {
+    static const char* emotions[] = {"happy", "sad", "calm", "energetic"};
+    std::mt19937_64 rng(7);
+    std::ofstream out(path);
+    out << "id,title,artist,lyrics,emotion\n";
+    for (size_t i = 0; i < n; ++i) {
+        std::string lyrics;
+        for (size_t w = 0; w < 40; ++w) {
+            if (w > 0) lyrics += ' ';
+            lyrics += "word" + std::to_string(rng() % 500);
+        }
+        out << i + 1 << ",\"Title " << i << "\",Artist " << rng() % 50 << ",\"" << lyrics << "\","
+            << emotions[i % 4] << '\n';
+    }
+}
+
+// Blocking client of a PlaylistServer on the loopback interface
+class Client {
+public:
+    explicit Client(int port) : fd(::socket(AF_INET, SOCK_STREAM, 0)) {
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            std::perror("connect");
+            std::abort();
+        }
+    }
+    ~Client() { ::close(fd); }
+
+    bool send(const std::string& data) {
+        for (size_t sent = 0; sent < data.size();) {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // Reads until lines answer lines are in; empty if the server closed first
+    std::string receive(size_t lines) {
+        std::string answers;
+        char buffer[1 << 16];
+        size_t seen = 0;
+        while (seen < lines) {
+            ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) return std::string();
+            answers.append(buffer, static_cast<size_t>(n));
+            seen += static_cast<size_t>(std::count(buffer, buffer + n, '\n'));
+        }
+        return answers;
+    }
+
+private:
+    int fd;
+};
+
+// A PlaylistServer on a free port, running on its own thread until destroyed
+class RunningServer {
+public:
+    RunningServer(const EmotionPlaylist& playlist, size_t workers)
+        : server(playlist, 0, workers), thread([this]() { server.run(); }) {}
+    ~RunningServer() {
+        server.stop();
+        thread.join();
+    }
+
+    PlaylistServer server;
+
+private:
+    std::thread thread;
+};
+
+} // namespace
+
+class ServeTest : public ::testing::Test {
+protected:
+    static std::string catalogPath;
+    static EmotionPlaylist* playlist;
+
+    static void SetUpTestSuite() {
+        catalogPath = ::testing::TempDir() + "serve_test_songs.csv";
+        writeCatalog(catalogPath, CATALOG_SONGS);
+        playlist = new EmotionPlaylist(catalogPath);
+    }
+
+    static void TearDownTestSuite() {
+        delete playlist;
+        playlist = nullptr;
+        std::remove(catalogPath.c_str());
+    }
+
+    void SetUp() override {
+        if (!countingAllocations()) GTEST_SKIP() << "built without COUNT_ALLOCATIONS";
+    }
+
+    // Heap allocations the workers of server made so far
+    static uint64_t serveAllocations(PlaylistServer& server) {
+        std::string metrics = server.metrics().scrape(*playlist);
+        size_t at = metrics.find("\nplaylist_serve_allocations_total ");
+        if (at == std::string::npos) return ~uint64_t(0);
+        return std::strtoull(metrics.c_str() + at + 34, nullptr, 10);
+    }
+
+    // Answers request on the calling thread the way a worker does; false
+    // if the answer is not a playlist
+    static bool answer(RequestHandler& handler, const std::string& request) {
+        Arena& arena = threadArena();
+        bool songs;
+        {
+            ArenaString out{ArenaAllocator<char>(arena)};
+            handler.handle(request.data(), request.size(), out);
+            songs = out.compare(0, 10, "{\"songs\": ") == 0;
+        }
+        arena.reset();
+        return songs;
+    }
+};
+
+std::string ServeTest::catalogPath;
+EmotionPlaylist* ServeTest::playlist = nullptr;
+
+TEST_F(ServeTest, WarmHandlerDoesNotAllocate) {
+    RequestHandler handler(*playlist);
+    const std::string requests[] = {"emotions=happy&k=10",
+                                    "emotions=happy,sad&k=50",
+                                    "emotions=*&k=10",
+                                    "emotions= Calm , ENERGETIC &k=100",
+                                    "emotions=*&k=150",
+                                    "emotions=*&k=1000", // outgrows the arena's first chunk
+                                    "emotions=happy&k=10&profile=false"};
+    for (const std::string& request : requests) {
+        ASSERT_TRUE(answer(handler, request)) << request;
+        uint64_t before = threadAllocations();
+        for (size_t r = 0; r < 100; ++r) answer(handler, request);
+        EXPECT_EQ(threadAllocations() - before, 0u) << request;
+    }
+}
+
+TEST_F(ServeTest, PipelinedBatchDoesNotAllocate) {
+    RunningServer running(*playlist, 1);
+    Client client(running.server.port());
+    const size_t BATCH = 20;
+    std::string batch;
+    for (size_t i = 0; i < BATCH; ++i) {
+        batch += i % 2 == 0 ? "emotions=happy&k=10\n" : "emotions=sad,calm&k=5\n";
+    }
+
+    for (size_t round = 0; round < 3; ++round) {
+        ASSERT_TRUE(client.send(batch));
+        ASSERT_FALSE(client.receive(BATCH).empty());
+    }
+    // A worker counts its turn after sending the answers; let it finish
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    uint64_t before = serveAllocations(running.server);
+    for (size_t round = 0; round < 20; ++round) {
+        ASSERT_TRUE(client.send(batch));
+        std::string answers = client.receive(BATCH);
+        ASSERT_FALSE(answers.empty());
+        EXPECT_EQ(answers.find("error"), std::string::npos);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(serveAllocations(running.server) - before, 0u);
+}
+
+TEST_F(ServeTest, BatchesLargerThanAnArenaChunkDoNotAllocateOnceWarm) {
+    // Each k=1000 answer is a few hundred kilobytes, so one batch outgrows
+    // the arena's first chunk and one write
+    RunningServer running(*playlist, 1);
+    Client client(running.server.port());
+    const size_t BATCH = 6;
+    std::string batch;
+    for (size_t i = 0; i < BATCH; ++i) batch += i % 2 == 0 ? "emotions=*&k=1000\n" : "emotions=happy&k=10\n";
+
+    for (size_t round = 0; round < 3; ++round) {
+        ASSERT_TRUE(client.send(batch));
+        ASSERT_FALSE(client.receive(BATCH).empty());
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    uint64_t before = serveAllocations(running.server);
+    for (size_t round = 0; round < 10; ++round) {
+        ASSERT_TRUE(client.send(batch));
+        std::string answers = client.receive(BATCH);
+        ASSERT_GT(answers.size(), Arena::DEFAULT_CHUNK);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(serveAllocations(running.server) - before, 0u);
+}
+
+TEST(RequestHandlerTest, AnswersCompleteRequests) {
+    std::string path = ::testing::TempDir() + "complete_test_songs.csv";
+    writeCatalog(path, 200);
+    EmotionPlaylist playlist(path);
+    std::remove(path.c_str());
+    RequestHandler handler(playlist);
+    Arena& arena = threadArena();
+    auto handle = [&](const std::string& request, std::string& answer, RequestSummary* summary = nullptr) {
+        ServerMetrics::RequestType type;
+        {
+            ArenaString out{ArenaAllocator<char>(arena)};
+            type = handler.handle(request.data(), request.size(), out, summary);
+            answer.assign(out.data(), out.size());
+        }
+        arena.reset();
+        return type;
+    };
+
+    std::string answer;
+    EXPECT_EQ(handle("complete=title&k=5", answer), ServerMetrics::Error);
+    EXPECT_NE(answer.find("autocomplete index not built"), std::string::npos);
+
+    playlist.buildCompletionIndex();
+    RequestSummary summary;
+    ASSERT_EQ(handle("complete=Title 1&k=5", answer, &summary), ServerMetrics::Completion) << answer;
+    EXPECT_EQ(answer.find('\n'), std::string::npos);
+    EXPECT_EQ(std::string(summary.request, summary.length), "complete=Title 1&k=5");
+    EXPECT_EQ(summary.results, 5u);
+    std::string expected = "{\"completions\": [";
+    for (const CompletionIndex::Completion& completion : playlist.complete("Title 1", 5)) {
+        if (expected.back() == '}') expected += ", ";
+        expected += "{\"text\": \"" + completion.text + "\", \"kind\": \"title\", \"songs\": " +
+                    std::to_string(completion.weight) + "}";
+    }
+    expected += "], \"count\": 5}";
+    EXPECT_EQ(answer, expected);
+
+    EXPECT_EQ(handle("complete=artist&k=3&profile=true", answer), ServerMetrics::Profiled);
+    EXPECT_EQ(answer.compare(0, 17, "{\"completions\": ["), 0) << answer;
+    EXPECT_NE(answer.find("\"profile\": "), std::string::npos);
+
+    EXPECT_EQ(handle("complete=nothing like it&k=5", answer), ServerMetrics::Completion);
+    EXPECT_EQ(answer, "{\"completions\": [], \"count\": 0}");
+    EXPECT_EQ(handle("complete=title&emotions=happy", answer), ServerMetrics::Error);
+    EXPECT_EQ(handle("complete=title&k=x", answer), ServerMetrics::Error);
+}
@@ -0,0 +1,222 @@
+// Tests for the Stream-VByte codec and compressed posting lists: round
+// trips over every byte length and tail size, the SIMD decoder against the
+// scalar one, and PostingCursor::advanceTo against std::lower_bound.
+
+#include "posting_codec.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Values whose encoded lengths cycle through 1, 2, 3 and 4 bytes
+std::vector<uint32_t> mixedLengths(size_t count, std::mt19937& rng) {
+    static const uint32_t limits[] = {1u << 8, 1u << 16, 1u << 24, 0};
+    std::vector<uint32_t> values(count);
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t limit = limits[(i + rng()) % 4];
+        values[i] = limit == 0 ? (1u << 24) + rng() % (~0u - (1u << 24)) : rng() % limit;
+    }
+    return values;
+}
+
+// Encodes values into a buffer with the padding decoders may read
+std::vector<uint8_t> encode(const std::vector<uint32_t>& values, size_t& written) {
+    std::vector<uint8_t> bytes(streamVByteMaxBytes(values.size()) + STREAM_VBYTE_PADDING, 0);
+    written = streamVByteEncode(values.data(), values.size(), bytes.data());
+    return bytes;
+}
+
+// Counts with every tail size (0-3 past a group of four) around one and
+// several posting blocks
+const size_t COUNTS[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 31, 126, 127, 128, 129, 130, 131, 257, 1001};
+
+} // namespace
+
+TEST(StreamVByteTest, RoundTripsEveryByteLengthAndTail) {
+    std::mt19937 rng(1);
+    for (size_t count : COUNTS) {
+        std::vector<uint32_t> values = mixedLengths(count, rng);
+        size_t written;
+        std::vector<uint8_t> bytes = encode(values, written);
+        ASSERT_LE(written, streamVByteMaxBytes(count));
+
+        std::vector<uint32_t> decoded(count + 4);
+        EXPECT_EQ(streamVByteDecode(bytes.data(), count, decoded.data()), written) << count;
+        decoded.resize(count);
+        EXPECT_EQ(decoded, values) << count;
+    }
+}
+
+TEST(StreamVByteTest, EncodesEachByteLength) {
+    const uint32_t values[] = {0, 255, 256, 65535, 65536, (1u << 24) - 1, 1u << 24, ~0u};
+    const size_t lengths[] = {1, 1, 2, 2, 3, 3, 4, 4};
+    for (size_t i = 0; i < 8; ++i) {
+        uint8_t bytes[1 + 4 + STREAM_VBYTE_PADDING] = {};
+        EXPECT_EQ(streamVByteEncode(&values[i], 1, bytes), 1 + lengths[i]) << values[i];
+        uint32_t decoded = 0;
+        streamVByteDecode(bytes, 1, &decoded);
+        EXPECT_EQ(decoded, values[i]);
+    }
+}
+
+TEST(StreamVByteTest, DeltaRoundTripsAscendingValues) {
+    std::mt19937 rng(2);
+    for (size_t count : COUNTS) {
+        std::vector<uint32_t> gaps = mixedLengths(count, rng);
+        for (uint32_t& gap : gaps) gap >>= 6; // keeps the running sum inside 32 bits
+        uint32_t base = rng() % 1000;
+        std::vector<uint32_t> expected(count);
+        uint32_t running = base;
+        for (size_t i = 0; i < count; ++i) expected[i] = running += gaps[i];
+
+        size_t written;
+        std::vector<uint8_t> bytes = encode(gaps, written);
+        std::vector<uint32_t> decoded(count);
+        EXPECT_EQ(streamVByteDecodeDelta(bytes.data(), count, base, decoded.data()), written) << count;
+        EXPECT_EQ(decoded, expected) << count;
+    }
+}
+
+TEST(StreamVByteTest, SelectedDecoderMatchesScalar) {
+    std::mt19937 rng(3);
+    for (size_t count : COUNTS) {
+        for (int trial = 0; trial < 8; ++trial) {
+            // Full 32-bit values and bases, so the delta sums wrap as well
+            std::vector<uint32_t> values = mixedLengths(count, rng);
+            size_t written;
+            std::vector<uint8_t> bytes = encode(values, written);
+            uint32_t base = rng();
+
+            std::vector<uint32_t> selected(count), scalar(count);
+            EXPECT_EQ(streamVByteDecode(bytes.data(), count, selected.data()),
+                      streamVByteDecodeScalar(bytes.data(), count, scalar.data()));
+            EXPECT_EQ(selected, scalar) << postingDecoderName() << " count " << count;
+
+            EXPECT_EQ(streamVByteDecodeDelta(bytes.data(), count, base, selected.data()),
+                      streamVByteDecodeDeltaScalar(bytes.data(), count, base, scalar.data()));
+            EXPECT_EQ(selected, scalar) << postingDecoderName() << " delta count " << count;
+        }
+    }
+}
+
+namespace {
+
+// Ascending doc ids with gaps of every encoded length, frequencies and
+// per-document positions
+struct PostingList {
+    std::vector<uint32_t> docs;
+    std::vector<uint32_t> freqs;
+    std::vector<uint32_t> positionCounts;
+    std::vector<uint32_t> positions;
+
+    PostingList(size_t count, std::mt19937& rng) {
+        static const uint32_t gapLimits[] = {4, 300, 70000, 1u << 20};
+        uint32_t doc = 0;
+        for (size_t i = 0; i < count; ++i) {
+            doc += 1 + rng() % gapLimits[rng() % 4];
+            docs.push_back(doc);
+            freqs.push_back(1 + rng() % (i % 5 == 0 ? 100000 : 10));
+            uint32_t positionCount = rng() % 4;
+            positionCounts.push_back(positionCount);
+            uint32_t position = 0;
+            for (uint32_t p = 0; p < positionCount; ++p) positions.push_back(position += rng() % 500);
+        }
+    }
+};
+
+} // namespace
+
+TEST(CompressedPostingsTest, BlocksDecodeToTheEncodedList) {
+    std::mt19937 rng(4);
+    for (size_t count : COUNTS) {
+        PostingList list(count, rng);
+        CompressedPostings postings;
+        postings.encode(list.docs, list.freqs, &list.positionCounts, &list.positions);
+        ASSERT_EQ(postings.size(), count);
+        ASSERT_EQ(postings.blockCount(), (count + POSTING_BLOCK - 1) / POSTING_BLOCK);
+
+        std::vector<uint32_t> docs, freqs, positions;
+        std::vector<uint32_t> blockPositions;
+        uint32_t blockDocs[POSTING_BLOCK], blockFreqs[POSTING_BLOCK], starts[POSTING_BLOCK + 1];
+        for (size_t block = 0; block < postings.blockCount(); ++block) {
+            size_t length = postings.blockSize(block);
+            postings.decodeDocs(block, blockDocs);
+            postings.decodeFreqs(block, blockFreqs);
+            postings.decodePositions(block, blockPositions, starts);
+            EXPECT_EQ(postings.blockLastDoc(block), blockDocs[length - 1]);
+            docs.insert(docs.end(), blockDocs, blockDocs + length);
+            freqs.insert(freqs.end(), blockFreqs, blockFreqs + length);
+            positions.insert(positions.end(), blockPositions.begin(), blockPositions.end());
+            for (size_t i = 0; i < length; ++i) {
+                EXPECT_EQ(starts[i + 1] - starts[i], list.positionCounts[block * POSTING_BLOCK + i]);
+            }
+        }
+        EXPECT_EQ(docs, list.docs) << count;
+        EXPECT_EQ(freqs, list.freqs) << count;
+        EXPECT_EQ(positions, list.positions) << count;
+    }
+}
+
+TEST(PostingCursorTest, WalksEveryDocument) {
+    std::mt19937 rng(5);
+    PostingList list(1001, rng);
+    CompressedPostings postings;
+    postings.encode(list.docs, list.freqs, &list.positionCounts, &list.positions);
+
+    PostingCursor cursor(&postings);
+    size_t nextPosition = 0;
+    for (size_t i = 0; i < list.docs.size(); ++i) {
+        ASSERT_FALSE(cursor.done());
+        EXPECT_EQ(cursor.doc(), list.docs[i]);
+        EXPECT_EQ(cursor.freq(), list.freqs[i]);
+        size_t count;
+        const uint32_t* positions = cursor.positions(count);
+        ASSERT_EQ(count, list.positionCounts[i]);
+        for (size_t p = 0; p < count; ++p) EXPECT_EQ(positions[p], list.positions[nextPosition++]);
+        cursor.next();
+    }
+    EXPECT_TRUE(cursor.done());
+}
+
+TEST(PostingCursorTest, AdvanceToMatchesLowerBound) {
+    std::mt19937 rng(6);
+    for (size_t count : COUNTS) {
+        PostingList list(count, rng);
+        CompressedPostings postings;
+        postings.encode(list.docs, list.freqs);
+        uint32_t last = list.docs.empty() ? 0 : list.docs.back();
+
+        // Ascending targets with short and long strides, so the cursor
+        // moves within a block, to the next one and gallops over many
+        for (int trial = 0; trial < 20; ++trial) {
+            PostingCursor cursor(&postings);
+            uint32_t target = 0;
+            while (true) {
+                uint32_t stride = trial % 2 == 0 ? rng() % 2000 : rng() % (last / 4 + 2);
+                target += stride;
+                cursor.advanceTo(target);
+                auto expected = std::lower_bound(list.docs.begin(), list.docs.end(), target);
+                if (expected == list.docs.end()) {
+                    EXPECT_TRUE(cursor.done()) << count << " target " << target;
+                    break;
+                }
+                ASSERT_FALSE(cursor.done()) << count << " target " << target;
+                EXPECT_EQ(cursor.doc(), *expected) << count << " target " << target;
+                EXPECT_EQ(cursor.freq(), list.freqs[expected - list.docs.begin()]);
+            }
+        }
+
+        // Exact doc ids, and a target at or behind the cursor leaves it in place
+        PostingCursor cursor(&postings);
+        for (size_t i = 0; i < list.docs.size(); i += 1 + rng() % 150) {
+            cursor.advanceTo(list.docs[i]);
+            ASSERT_FALSE(cursor.done());
+            EXPECT_EQ(cursor.doc(), list.docs[i]);
+            cursor.advanceTo(list.docs[i] / 2);
+            EXPECT_EQ(cursor.doc(), list.docs[i]);
+        }
+    }
+}
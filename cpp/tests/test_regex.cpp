@@ -0,0 +1,191 @@
+// Tests for catalog regex search: RegexMatcher against std::regex on the
+// syntax both accept, the literal prefilter never discarding a match, a
+// DFA cache small enough to be flushed mid-text, and
+// EmotionPlaylist::searchRegex against a plain std::regex scan.
+
+#include "playlist.h"
+#include "regex_matcher.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Patterns in the common subset of Regex and ECMAScript std::regex
+const char* PATTERNS[] = {
+    "ab",
+    "a|b",
+    "(ab|)c",          // alternation with an empty branch
+    "x(|yz)w",
+    "(?:ab|cd|)e",
+    "ba{0,3}b",        // counted repetition allowing zero copies
+    "a{0,2}",
+    "(ab){0,2}c",
+    "x(yz)?w",
+    "(?i)ab?c",
+    "c{2,}",
+    "(?i)AbC",
+    "(?i)b[a-c]+",
+    "(?i)^a.*B$",
+    "^ab",
+    "b$",
+    "^$",
+    "^(ab|ba)*$",
+    "\\d+a",
+    "\\w\\s\\w",
+    "\\W\\S",
+    "[^ab]b",
+    "a.b",
+    "a+b+",
+    "(a|ab)(c|bcd)",
+    "(a|b)*a(a|b){6}",
+    "a(a|b){6}c",      // 2^7 DFA states on a run of a and b, more than a small cache holds
+};
+
+const char ALPHABET[] = "aAbBcdxyzw01 \t_";
+
+std::string randomText(size_t length, std::mt19937& rng, const std::string& alphabet = ALPHABET) {
+    std::string text(length, ' ');
+    for (char& c : text) c = alphabet[rng() % alphabet.size()];
+    return text;
+}
+
+// Catalog field: the loader trims whitespace and skips empty fields
+std::string randomField(size_t length, std::mt19937& rng) {
+    std::string text = randomText(length, rng);
+    text.front() = 'x';
+    text.back() = 'y';
+    return text;
+}
+
+std::vector<std::string> texts() {
+    std::mt19937 rng(1);
+    std::vector<std::string> result = {"", "ab", "abc", "c", "xw", "xyzw", "e", "bb", "baaab", "baaaab",
+                                       "ABC", "a\tb", "aabababab", "ba", "0a", "abbb", "abcd"};
+    for (size_t i = 0; i < 400; ++i) result.push_back(randomText(rng() % 40, rng));
+    // Long texts, so the DFA sees many states in one search
+    for (size_t i = 0; i < 20; ++i) result.push_back(randomText(2000, rng));
+    for (size_t i = 0; i < 5; ++i) result.push_back(randomText(2000, rng, "ab"));
+    return result;
+}
+
+// std::regex for one of PATTERNS, honouring a leading (?i)
+std::regex reference(const std::string& pattern) {
+    if (pattern.compare(0, 4, "(?i)") == 0) {
+        return std::regex(pattern.substr(4), std::regex::ECMAScript | std::regex::icase);
+    }
+    return std::regex(pattern, std::regex::ECMAScript);
+}
+
+std::string lowercase(std::string text) {
+    for (char& c : text) {
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c + ('a' - 'A'));
+    }
+    return text;
+}
+
+// Whether the prefilter would let text through to the DFA
+bool passesPrefilter(const Regex& regex, const std::string& text) {
+    if (regex.requiredLiterals().empty()) return true;
+    std::string haystack = regex.ignoreCase() ? lowercase(text) : text;
+    for (const std::string& literal : regex.requiredLiterals()) {
+        if (haystack.find(literal) != std::string::npos) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+TEST(RegexTest, MatchesStdRegex) {
+    std::vector<std::string> inputs = texts();
+    for (const char* pattern : PATTERNS) {
+        Regex regex(pattern);
+        RegexMatcher matcher(regex);
+        std::regex expected = reference(pattern);
+        for (const std::string& text : inputs) {
+            EXPECT_EQ(matcher.search(text), std::regex_search(text, expected))
+                << "/" << pattern << "/ on '" << text << "'";
+        }
+    }
+}
+
+TEST(RegexTest, PrefilterKeepsEveryMatch) {
+    std::vector<std::string> inputs = texts();
+    for (const char* pattern : PATTERNS) {
+        Regex regex(pattern);
+        std::regex expected = reference(pattern);
+        for (const std::string& text : inputs) {
+            if (std::regex_search(text, expected)) {
+                EXPECT_TRUE(passesPrefilter(regex, text)) << "/" << pattern << "/ on '" << text << "'";
+            }
+        }
+    }
+    // Patterns with an empty branch or optional part still yield literals
+    EXPECT_FALSE(Regex("(ab|)c").requiredLiterals().empty());
+    EXPECT_FALSE(Regex("x(|yz)w").requiredLiterals().empty());
+    EXPECT_FALSE(Regex("(?i)AbC").requiredLiterals().empty());
+    // ...and ones that can match the empty string yield none
+    EXPECT_TRUE(Regex("a{0,2}").requiredLiterals().empty());
+    EXPECT_TRUE(Regex("(?:ab|cd|)e|").requiredLiterals().empty());
+}
+
+TEST(RegexTest, SmallStateCacheGivesSameAnswers) {
+    // The smallest cache RegexMatcher allows; it is flushed and rebuilt
+    // partway through the long texts
+    std::vector<std::string> inputs = texts();
+    for (const char* pattern : PATTERNS) {
+        Regex regex(pattern);
+        RegexMatcher large(regex);
+        RegexMatcher small(regex, 1);
+        for (const std::string& text : inputs) {
+            EXPECT_EQ(small.search(text), large.search(text)) << "/" << pattern << "/ on '" << text << "'";
+            EXPECT_LE(small.stateCount(), 16u);
+        }
+    }
+}
+
+TEST(RegexTest, SearchRegexMatchesScan) {
+    std::string path = ::testing::TempDir() + "regex_test_songs.csv";
+    {
+        static const char* emotions[] = {"happy", "sad", "calm"};
+        std::mt19937 rng(2);
+        std::ofstream out(path);
+        out << "id,title,artist,lyrics,emotion\n";
+        for (size_t i = 0; i < 3000; ++i) {
+            out << i + 1 << "," << randomField(1 + rng() % 12, rng) << "," << randomField(1 + rng() % 8, rng) << ","
+                << randomField(1 + rng() % 60, rng) << "," << emotions[i % 3] << '\n';
+        }
+    }
+    EmotionPlaylist playlist(path);
+    std::remove(path.c_str());
+
+    for (const char* pattern : PATTERNS) {
+        std::regex expected = reference(pattern);
+        std::vector<int> scanned;
+        for (SongNode* node = playlist.getAllSongs(); node != nullptr; node = node->next) {
+            const Song& song = node->data;
+            if (std::regex_search(song.title, expected) || std::regex_search(song.artist, expected) ||
+                std::regex_search(song.lyrics, expected)) {
+                scanned.push_back(song.id);
+            }
+        }
+
+        for (size_t k : {size_t(5), size_t(100000)}) {
+            std::vector<int> found;
+            SongNode* results = playlist.searchRegex(pattern, std::vector<std::string>(), k);
+            while (results != nullptr) {
+                SongNode* next = results->next;
+                found.push_back(results->data.id);
+                delete results;
+                results = next;
+            }
+            std::vector<int> firstK(scanned.begin(), scanned.begin() + std::min(k, scanned.size()));
+            EXPECT_EQ(found, firstK) << "/" << pattern << "/ k " << k;
+        }
+    }
+}
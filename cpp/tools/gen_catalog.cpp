@@ -0,0 +1,267 @@
+// Synthetic catalog generator for scale testing.
+//
+// Writes a songs.csv-compatible catalog of any size: emotions and artists
+// drawn Zipfian (a few dominate, a long tail stays rare), lyric lengths
+// log-normal around a median, lyrics split into lines, and titles that
+// sometimes carry commas or quotes, so the output exercises every CSV
+// quoting rule (quoted fields, embedded commas and newlines, "" escapes).
+// The same seed and options always produce the same bytes.
+//
+//     gen_catalog --songs 1000000 --out songs_1m.csv
+//     gen_catalog --bytes 2000000000 --seed 3 > songs_2g.csv
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Output is staged in a buffer and written in large blocks
+const size_t FLUSH_BYTES = 1 << 22;
+
+class Random {
+private:
+    std::mt19937_64 engine;
+
+public:
+    explicit Random(unsigned long long seed) : engine(seed) {}
+
+    // Uniform in [0, 1)
+    double uniform() { return static_cast<double>(engine() >> 11) * 0x1.0p-53; }
+    size_t below(size_t n) { return static_cast<size_t>(uniform() * static_cast<double>(n)); }
+    bool chance(double p) { return uniform() < p; }
+    double normal() { return std::normal_distribution<double>(0.0, 1.0)(engine); }
+};
+
+// Zipfian ranks in O(1) per draw with Vose's alias method: slot i keeps
+// rank i with probability keep[i] and otherwise yields alias[i]
+class ZipfSampler {
+private:
+    std::vector<double> keep;
+    std::vector<uint32_t> alias;
+
+public:
+    ZipfSampler(size_t n, double exponent) : keep(n), alias(n) {
+        std::vector<double> weight(n);
+        double sum = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            weight[i] = 1.0 / std::pow(static_cast<double>(i + 1), exponent);
+            sum += weight[i];
+        }
+        std::vector<uint32_t> small;
+        std::vector<uint32_t> large;
+        for (size_t i = 0; i < n; ++i) {
+            weight[i] *= static_cast<double>(n) / sum;
+            (weight[i] < 1.0 ? small : large).push_back(static_cast<uint32_t>(i));
+        }
+        while (!small.empty() && !large.empty()) {
+            uint32_t less = small.back();
+            uint32_t more = large.back();
+            small.pop_back();
+            keep[less] = weight[less];
+            alias[less] = more;
+            weight[more] -= 1.0 - weight[less];
+            if (weight[more] < 1.0) {
+                large.pop_back();
+                small.push_back(more);
+            }
+        }
+        for (uint32_t i : small) keep[i] = 1.0;
+        for (uint32_t i : large) keep[i] = 1.0;
+    }
+
+    size_t operator()(Random& random) const {
+        double u = random.uniform() * static_cast<double>(keep.size());
+        size_t slot = std::min(static_cast<size_t>(u), keep.size() - 1);
+        return u - static_cast<double>(slot) < keep[slot] ? slot : alias[slot];
+    }
+};
+
+// Pronounceable word for a vocabulary rank; frequent ranks get short words
+std::string makeWord(size_t rank) {
+    static const char* syllables[] = {"la", "mo", "ri", "sa", "te", "vu", "ne", "ko",
+                                      "da", "pi", "lu", "ge", "ba", "so", "fi", "ra"};
+    std::string word;
+    do {
+        word += syllables[rank % 16];
+        rank /= 16;
+    } while (rank > 0);
+    return word;
+}
+
+std::vector<std::string> emotionNames(size_t count) {
+    static const char* names[] = {"happy", "sad", "calm", "energetic", "romantic", "angry",
+                                  "nostalgic", "hopeful", "melancholic", "excited", "peaceful",
+                                  "anxious", "joyful", "lonely", "grateful", "bitter", "dreamy",
+                                  "fierce", "tender", "restless", "playful", "somber",
+                                  "triumphant", "wistful"};
+    std::vector<std::string> emotions;
+    for (size_t i = 0; i < count; ++i) {
+        emotions.push_back(i < 24 ? names[i] : "mood" + std::to_string(i + 1));
+    }
+    return emotions;
+}
+
+// Append value as a CSV field, quoted (and its quotes doubled) when needed
+void appendField(std::string& out, const std::string& value) {
+    if (value.find_first_of(",\"\n") == std::string::npos) {
+        out += value;
+        return;
+    }
+    out += '"';
+    for (char c : value) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    out += '"';
+}
+
+void capitalize(std::string& word) {
+    if (!word.empty()) word[0] = static_cast<char>(word[0] - 'a' + 'A');
+}
+
+void printUsage(const char* programName) {
+    std::fprintf(stderr,
+                 "Usage: %s [--songs N | --bytes B] [--out PATH] [--seed S]\n"
+                 "          [--emotions E] [--emotion-skew X] [--artists A] [--artist-skew X]\n"
+                 "          [--vocab W] [--lyric-words MEDIAN]\n"
+                 "  Defaults: 100000 songs to stdout, seed 1, 12 emotions (skew 1.0),\n"
+                 "  songs/20 artists (skew 0.9), 20000 words, 120 lyric words.\n",
+                 programName);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t songs = 100000;
+    size_t bytes = 0; // stop at this size instead of a song count
+    std::string outPath;
+    unsigned long long seed = 1;
+    size_t emotionCount = 12;
+    double emotionSkew = 1.0;
+    size_t artists = 0;
+    double artistSkew = 0.9;
+    size_t vocab = 20000;
+    double lyricWords = 120.0;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        const char* value = argv[i + 1];
+        if (option == "--songs") songs = std::strtoull(value, nullptr, 10);
+        else if (option == "--bytes") bytes = std::strtoull(value, nullptr, 10);
+        else if (option == "--out") outPath = value;
+        else if (option == "--seed") seed = std::strtoull(value, nullptr, 10);
+        else if (option == "--emotions") emotionCount = std::strtoull(value, nullptr, 10);
+        else if (option == "--emotion-skew") emotionSkew = std::strtod(value, nullptr);
+        else if (option == "--artists") artists = std::strtoull(value, nullptr, 10);
+        else if (option == "--artist-skew") artistSkew = std::strtod(value, nullptr);
+        else if (option == "--vocab") vocab = std::strtoull(value, nullptr, 10);
+        else if (option == "--lyric-words") lyricWords = std::strtod(value, nullptr);
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (bytes > 0) songs = SIZE_MAX;
+    if (artists == 0) artists = std::max<size_t>(1, std::min<size_t>(songs, 2000000) / 20);
+    if (argc % 2 == 0 || songs == 0 || emotionCount == 0 || vocab == 0 || lyricWords < 1.0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    FILE* out = outPath.empty() ? stdout : std::fopen(outPath.c_str(), "wb");
+    if (out == nullptr) {
+        std::fprintf(stderr, "Error: Could not open %s\n", outPath.c_str());
+        return 1;
+    }
+
+    Random random(seed);
+    ZipfSampler emotionRank(emotionCount, emotionSkew);
+    ZipfSampler artistRank(artists, artistSkew);
+    ZipfSampler wordRank(vocab, 1.0);
+    std::vector<std::string> emotions = emotionNames(emotionCount);
+    std::vector<std::string> words(vocab);
+    for (size_t w = 0; w < vocab; ++w) words[w] = makeWord(w);
+
+    // Artist names are generated on first use so huge pools cost nothing up front
+    std::vector<std::string> artistNames(artists);
+    auto artistName = [&](size_t rank) -> const std::string& {
+        std::string& name = artistNames[rank];
+        if (name.empty()) {
+            std::string first = makeWord(rank % 4096 + 16);
+            std::string last = makeWord(rank / 4096 + 256);
+            capitalize(first);
+            capitalize(last);
+            name = first + " " + last;
+        }
+        return name;
+    };
+
+    std::string buffer = "id,title,artist,lyrics,emotion\n";
+    buffer.reserve(FLUSH_BYTES + (1 << 16));
+    size_t written = 0;
+    std::string title;
+    std::string lyrics;
+    for (size_t id = 1; id <= songs && (bytes == 0 || written + buffer.size() < bytes); ++id) {
+        // Titles: one to four words, sometimes with a comma or a quoted word
+        title.clear();
+        size_t titleWords = 1 + random.below(4);
+        for (size_t w = 0; w < titleWords; ++w) {
+            std::string word = words[wordRank(random)];
+            capitalize(word);
+            if (w > 0) title += w == 1 && random.chance(0.1) ? ", " : " ";
+            if (w == titleWords - 1 && titleWords > 1 && random.chance(0.05)) {
+                title += "\"" + word + "\"";
+            } else {
+                title += word;
+            }
+        }
+
+        // Lyrics: log-normal word count, lines of four to ten words
+        lyrics.clear();
+        double length = lyricWords * std::exp(0.5 * random.normal());
+        size_t lyricLength = static_cast<size_t>(std::min(4000.0, std::max(1.0, length)));
+        size_t lineLeft = 4 + random.below(7);
+        for (size_t w = 0; w < lyricLength; ++w) {
+            if (w > 0) {
+                if (--lineLeft == 0) {
+                    lyrics += '\n';
+                    lineLeft = 4 + random.below(7);
+                } else {
+                    lyrics += random.chance(0.05) ? ", " : " ";
+                }
+            }
+            lyrics += words[wordRank(random)];
+        }
+
+        buffer += std::to_string(id);
+        buffer += ',';
+        appendField(buffer, title);
+        buffer += ',';
+        appendField(buffer, artistName(artistRank(random)));
+        buffer += ',';
+        appendField(buffer, lyrics);
+        buffer += ',';
+        buffer += emotions[emotionRank(random)];
+        buffer += '\n';
+
+        if (buffer.size() >= FLUSH_BYTES) {
+            written += std::fwrite(buffer.data(), 1, buffer.size(), out);
+            buffer.clear();
+        }
+    }
+    written += std::fwrite(buffer.data(), 1, buffer.size(), out);
+
+    bool failed = std::ferror(out) != 0;
+    if (out != stdout) failed = std::fclose(out) != 0 || failed;
+    if (failed) {
+        std::fprintf(stderr, "Error: Could not write %s\n", outPath.empty() ? "output" : outPath.c_str());
+        return 1;
+    }
+    return 0;
+}
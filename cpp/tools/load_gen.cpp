@@ -0,0 +1,471 @@
+// Load generator for the `emotion_playlist --serve <port>` daemon.
+//
+// Closed loop (the default) keeps one request outstanding per connection;
+// open loop sends on a fixed schedule whatever the responses do, the way
+// independent users arrive. Latencies go into HDR histograms (three
+// significant digits from 1 ns to hours) and are reported up to p99.99,
+// both as measured and corrected for coordinated omission: a stalled
+// server also delays requests the client had not sent yet, and measuring
+// from when each request was due rather than when it went out counts that
+// delay instead of hiding it.
+//
+//     load_gen --port 8080 --connections 16 --duration 30
+//     load_gen --port 8080 --mode open --rate 20000 --mix queries.log
+//
+// The mix is a query log from --query-log, or text with one request per
+// line, or JSON lines carrying "request" and an optional "weight".
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "query_log.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void printUsage(const char* programName) {
+    std::fprintf(stderr,
+                 "Usage: %s --port P [--host H] [--mode closed|open] [--connections N]\n"
+                 "          [--rate R] [--duration S] [--mix PATH] [--seed S]\n"
+                 "  Defaults: 127.0.0.1, closed loop over 4 connections for 10 s, each\n"
+                 "  request 'emotions=*&k=10', seed 1. --rate is requests per second over\n"
+                 "  all connections: required open loop, optional pacing closed loop.\n",
+                 programName);
+}
+
+// Counts values with a relative error under 1/1024: below 2048 every value
+// has its own bucket, and each further power of two is split into 1024
+class HdrHistogram {
+private:
+    static constexpr int SUB_BITS = 10;
+    static constexpr uint64_t SUB_COUNT = 1ULL << SUB_BITS;
+    static constexpr size_t BUCKETS = (65 - SUB_BITS) * SUB_COUNT;
+
+    std::vector<uint64_t> counts;
+    uint64_t total;
+    uint64_t maxValue;
+    double sum;
+
+    static size_t indexOf(uint64_t value) {
+        if (value < 2 * SUB_COUNT) return static_cast<size_t>(value);
+        int shift = 63 - __builtin_clzll(value) - SUB_BITS;
+        return static_cast<size_t>((shift + 1) * SUB_COUNT + ((value >> shift) - SUB_COUNT));
+    }
+
+    // Highest value that lands in bucket index
+    static uint64_t valueAt(size_t index) {
+        if (index < 2 * SUB_COUNT) return index;
+        int shift = static_cast<int>(index / SUB_COUNT) - 1;
+        uint64_t base = (index % SUB_COUNT + SUB_COUNT) << shift;
+        return base + ((1ULL << shift) - 1);
+    }
+
+public:
+    HdrHistogram() : counts(BUCKETS, 0), total(0), maxValue(0), sum(0.0) {}
+
+    void record(uint64_t value, uint64_t count = 1) {
+        counts[indexOf(value)] += count;
+        total += count;
+        maxValue = std::max(maxValue, value);
+        sum += static_cast<double>(value) * static_cast<double>(count);
+    }
+
+    // Also records the requests a stall of value held back when one was due
+    // every interval, as HdrHistogram's recordValueWithExpectedInterval does
+    void recordCorrected(uint64_t value, uint64_t interval) {
+        record(value);
+        if (interval == 0 || value <= interval) return;
+        for (uint64_t missing = value - interval; missing >= interval; missing -= interval) record(missing);
+    }
+
+    void add(const HdrHistogram& other) {
+        for (size_t i = 0; i < BUCKETS; ++i) counts[i] += other.counts[i];
+        total += other.total;
+        maxValue = std::max(maxValue, other.maxValue);
+        sum += other.sum;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return maxValue; }
+    double mean() const { return total == 0 ? 0.0 : sum / static_cast<double>(total); }
+
+    uint64_t percentile(double p) const {
+        if (total == 0) return 0;
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p / 100.0 * static_cast<double>(total) + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen >= rank) return std::min(valueAt(i), maxValue);
+        }
+        return maxValue;
+    }
+};
+
+struct MixEntry {
+    std::string request; // without the newline
+    double weight;
+
+    MixEntry(const std::string& request, double weight) : request(request), weight(weight) {}
+};
+
+// The JSON string starting at the quote at, with \" \\ \n \t \/ unescaped
+bool jsonString(const std::string& line, size_t at, std::string& out) {
+    out.clear();
+    for (++at; at < line.size(); ++at) {
+        char c = line[at];
+        if (c == '"') return true;
+        if (c == '\\' && at + 1 < line.size()) {
+            c = line[++at];
+            if (c == 'n') c = '\n';
+            else if (c == 't') c = '\t';
+        }
+        out += c;
+    }
+    return false;
+}
+
+std::vector<MixEntry> loadMix(const std::string& path) {
+    std::vector<MixEntry> mix;
+    std::ifstream probe(path, std::ios::binary);
+    if (!probe.is_open()) throw std::runtime_error("Could not open mix: " + path);
+    char magic[8] = {};
+    probe.read(magic, sizeof(magic));
+    if (std::memcmp(magic, "PLQLOG1\n", sizeof(magic)) == 0) {
+        // Each logged request once, so the mix follows recorded traffic
+        for (const QueryRecord& record : readQueryLog(path)) mix.emplace_back(record.request, 1.0);
+        return mix;
+    }
+
+    std::ifstream in(path);
+    std::string line;
+    std::string request;
+    size_t lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        if (line[0] != '{') {
+            mix.emplace_back(line, 1.0);
+            continue;
+        }
+        size_t key = line.find("\"request\"");
+        size_t quote = key == std::string::npos ? key : line.find('"', line.find(':', key));
+        if (quote == std::string::npos || !jsonString(line, quote, request)) {
+            throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": no \"request\" string");
+        }
+        double weight = 1.0;
+        size_t weightKey = line.find("\"weight\"");
+        if (weightKey != std::string::npos) {
+            weight = std::strtod(line.c_str() + line.find(':', weightKey) + 1, nullptr);
+        }
+        if (weight > 0.0) mix.emplace_back(request, weight);
+    }
+    return mix;
+}
+
+int connectTo(const std::string& host, int port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (fd < 0 || ::inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1 ||
+        ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        if (fd >= 0) ::close(fd);
+        return -1;
+    }
+    int noDelay = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    return fd;
+}
+
+bool sendAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = ::send(fd, data, length, MSG_NOSIGNAL);
+        if (sent <= 0) return false;
+        data += sent;
+        length -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+uint64_t nanosBetween(Clock::time_point from, Clock::time_point to) {
+    if (to <= from) return 0;
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+}
+
+// Picks requests by weight
+class MixSampler {
+private:
+    const std::vector<MixEntry>& mix;
+    std::vector<double> cumulative;
+    std::mt19937_64 engine;
+
+public:
+    MixSampler(const std::vector<MixEntry>& mix, unsigned long long seed) : mix(mix), engine(seed) {
+        double sum = 0.0;
+        for (const MixEntry& entry : mix) cumulative.push_back(sum += entry.weight);
+    }
+
+    const std::string& next() {
+        double u = std::uniform_real_distribution<double>(0.0, cumulative.back())(engine);
+        auto found = std::upper_bound(cumulative.begin(), cumulative.end(), u);
+        size_t index = std::min(static_cast<size_t>(found - cumulative.begin()), mix.size() - 1);
+        return mix[index].request;
+    }
+};
+
+// One connection's requests in flight and what its responses measured.
+// corrected times from when each request was due, measured from when it
+// was sent.
+struct Connection {
+    int fd;
+    std::mutex mutex;
+    std::deque<std::pair<Clock::time_point, Clock::time_point>> pending; // due, sent
+    HdrHistogram measured;
+    HdrHistogram corrected;
+    uint64_t responses;
+    uint64_t errors;
+    bool failed;
+
+    Connection() : fd(-1), responses(0), errors(0), failed(false) {}
+};
+
+// Splits received bytes into response lines
+class LineReader {
+private:
+    int fd;
+    std::string input;
+    size_t consumed;
+    char buffer[1 << 16];
+
+public:
+    explicit LineReader(int fd) : fd(fd), consumed(0) {}
+
+    // Whether the next line is an error response; false at end of stream
+    bool next(bool& error) {
+        size_t newline;
+        while ((newline = input.find('\n', consumed)) == std::string::npos) {
+            input.erase(0, consumed);
+            consumed = 0;
+            ssize_t received = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (received <= 0) return false;
+            input.append(buffer, static_cast<size_t>(received));
+        }
+        error = input.compare(consumed, 10, "{\"error\": ") == 0;
+        consumed = newline + 1;
+        return true;
+    }
+};
+
+// One request at a time. With an interval each request is due one interval
+// after the previous was; without, it is due when sent, and the correction
+// assumes the mean latency as the interval, as wrk does.
+void runClosed(Connection& connection, MixSampler sampler, Clock::duration interval, Clock::time_point start,
+               Clock::time_point end) {
+    LineReader reader(connection.fd);
+    std::string line;
+    std::vector<uint64_t> latencies;
+    Clock::time_point due = interval.count() > 0 ? start : Clock::now();
+    while (due < end) {
+        if (interval.count() > 0) std::this_thread::sleep_until(due);
+        line = sampler.next();
+        line += '\n';
+        Clock::time_point sent = Clock::now();
+        bool error;
+        if (!sendAll(connection.fd, line.data(), line.size()) || !reader.next(error)) {
+            connection.failed = true;
+            break;
+        }
+        Clock::time_point received = Clock::now();
+        connection.responses++;
+        if (error) connection.errors++;
+        connection.measured.record(nanosBetween(sent, received));
+        if (interval.count() > 0) {
+            connection.corrected.record(nanosBetween(due, received));
+            due += interval;
+        } else {
+            latencies.push_back(nanosBetween(sent, received));
+            due = received;
+        }
+    }
+    if (interval.count() == 0) {
+        uint64_t mean = static_cast<uint64_t>(connection.measured.mean());
+        for (uint64_t latency : latencies) connection.corrected.recordCorrected(latency, mean);
+    }
+}
+
+// Requests go out on schedule whether or not earlier ones were answered; a
+// reader thread matches responses to them in order
+void runOpen(Connection& connection, MixSampler sampler, Clock::duration interval, Clock::time_point start,
+             Clock::time_point end) {
+    std::thread readerThread([&connection]() {
+        LineReader reader(connection.fd);
+        bool error;
+        while (reader.next(error)) {
+            Clock::time_point received = Clock::now();
+            std::pair<Clock::time_point, Clock::time_point> request;
+            {
+                std::lock_guard<std::mutex> lock(connection.mutex);
+                if (connection.pending.empty()) break;
+                request = connection.pending.front();
+                connection.pending.pop_front();
+            }
+            connection.responses++;
+            if (error) connection.errors++;
+            connection.measured.record(nanosBetween(request.second, received));
+            connection.corrected.record(nanosBetween(request.first, received));
+        }
+    });
+
+    std::string line;
+    for (Clock::time_point due = start; due < end; due += interval) {
+        std::this_thread::sleep_until(due);
+        line = sampler.next();
+        line += '\n';
+        {
+            std::lock_guard<std::mutex> lock(connection.mutex);
+            connection.pending.emplace_back(due, Clock::now());
+        }
+        if (!sendAll(connection.fd, line.data(), line.size())) {
+            connection.failed = true;
+            break;
+        }
+    }
+    ::shutdown(connection.fd, SHUT_WR);
+    readerThread.join();
+}
+
+void printPercentiles(const char* label, const HdrHistogram& histogram) {
+    static const double PERCENTILES[] = {50.0, 75.0, 90.0, 99.0, 99.9, 99.99};
+    std::printf("%-10s", label);
+    for (double p : PERCENTILES) std::printf("  %9.1f", histogram.percentile(p) / 1e3);
+    std::printf("  %9.1f  %9.1f\n", histogram.max() / 1e3, histogram.mean() / 1e3);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string host = "127.0.0.1";
+    int port = -1;
+    bool open = false;
+    size_t connectionCount = 4;
+    double rate = 0.0;
+    double duration = 10.0;
+    std::string mixPath;
+    unsigned long long seed = 1;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        const char* value = argv[i + 1];
+        if (option == "--host") host = value;
+        else if (option == "--port") port = std::atoi(value);
+        else if (option == "--mode" && (std::strcmp(value, "open") == 0 || std::strcmp(value, "closed") == 0)) {
+            open = std::strcmp(value, "open") == 0;
+        } else if (option == "--connections") connectionCount = std::strtoull(value, nullptr, 10);
+        else if (option == "--rate") rate = std::strtod(value, nullptr);
+        else if (option == "--duration") duration = std::strtod(value, nullptr);
+        else if (option == "--mix") mixPath = value;
+        else if (option == "--seed") seed = std::strtoull(value, nullptr, 10);
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc % 2 == 0 || port < 0 || connectionCount == 0 || duration <= 0.0 || rate < 0.0 ||
+        (open && rate == 0.0)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<MixEntry> mix;
+    try {
+        if (mixPath.empty()) mix.emplace_back("emotions=*&k=10", 1.0);
+        else mix = loadMix(mixPath);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
+    }
+    if (mix.empty()) {
+        std::fprintf(stderr, "Error: %s holds no requests\n", mixPath.c_str());
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<Connection>> connections;
+    for (size_t c = 0; c < connectionCount; ++c) {
+        connections.emplace_back(new Connection());
+        connections.back()->fd = connectTo(host, port);
+        if (connections.back()->fd < 0) {
+            std::fprintf(stderr, "Error: Could not connect to %s:%d\n", host.c_str(), port);
+            return 1;
+        }
+    }
+
+    // The rate is split evenly; connections start staggered across one interval
+    Clock::duration interval = Clock::duration::zero();
+    if (rate > 0.0) {
+        interval = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(static_cast<double>(connectionCount) / rate));
+    }
+    Clock::time_point start = Clock::now();
+    Clock::time_point end =
+        start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(duration));
+    std::vector<std::thread> threads;
+    for (size_t c = 0; c < connectionCount; ++c) {
+        Connection* connection = connections[c].get();
+        MixSampler sampler(mix, seed + c);
+        Clock::time_point first = start + interval * static_cast<long>(c) / static_cast<long>(connectionCount);
+        if (open) {
+            threads.emplace_back(runOpen, std::ref(*connection), sampler, interval, first, end);
+        } else {
+            threads.emplace_back(runClosed, std::ref(*connection), sampler, interval, first, end);
+        }
+    }
+    for (std::thread& thread : threads) thread.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    HdrHistogram measured;
+    HdrHistogram corrected;
+    uint64_t responses = 0;
+    uint64_t errors = 0;
+    size_t failed = 0;
+    for (auto& connection : connections) {
+        measured.add(connection->measured);
+        corrected.add(connection->corrected);
+        responses += connection->responses;
+        errors += connection->errors;
+        if (connection->failed) failed++;
+        ::close(connection->fd);
+    }
+
+    std::printf("%s loop, %zu connections, %zu distinct requests", open ? "open" : "closed", connectionCount,
+                mix.size());
+    if (rate > 0.0) std::printf(", target %.0f/s", rate);
+    std::printf("\n%llu responses in %.3f s: %.0f/s, %llu errors, %zu connections failed\n",
+                static_cast<unsigned long long>(responses), seconds, static_cast<double>(responses) / seconds,
+                static_cast<unsigned long long>(errors), failed);
+    std::printf("%-10s  %9s  %9s  %9s  %9s  %9s  %9s  %9s  %9s\n", "latency_us", "p50", "p75", "p90", "p99",
+                "p99.9", "p99.99", "max", "mean");
+    printPercentiles("measured", measured);
+    printPercentiles("corrected", corrected);
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,302 @@
+// Replays a query log recorded by `emotion_playlist --serve <port>
+// --query-log <path>` against a running daemon, keeping the recorded
+// arrival pattern: requests go out at their original offsets divided by
+// --speed (0 sends them back to back). Reports replay latency next to the
+// recorded one and every request whose result count changed.
+//
+//     replay_queries --log queries.log --port 8080 --speed 4 --connections 8
+//     replay_queries --log queries.log --print
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "playlist.h"
+#include "query_log.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void printUsage(const char* programName) {
+    std::fprintf(stderr,
+                 "Usage: %s --log PATH [--print]\n"
+                 "       %s --log PATH --port P [--host H] [--speed X] [--connections N]\n"
+                 "          [--catalog CSV]\n"
+                 "  --print dumps the log as text. Otherwise the log is replayed at X times\n"
+                 "  its recorded rate (default 1; 0 = as fast as possible) over N connections\n"
+                 "  (default 1) to H (default 127.0.0.1). --catalog checks that CSV loads to\n"
+                 "  the catalog version the log was recorded against.\n",
+                 programName, programName);
+}
+
+// A sent request waiting for its response, oldest first per connection
+struct Pending {
+    size_t record;
+    Clock::time_point sent;
+
+    Pending(size_t record, Clock::time_point sent) : record(record), sent(sent) {}
+};
+
+struct Connection {
+    int fd;
+    std::mutex mutex;
+    std::deque<Pending> pending;
+    std::thread reader;
+
+    Connection() : fd(-1) {}
+};
+
+// What came back for one record
+struct Outcome {
+    uint64_t latencyNanos;
+    long results; // -1 for an error response
+    bool answered;
+
+    Outcome() : latencyNanos(0), results(-1), answered(false) {}
+};
+
+int connectTo(const std::string& host, int port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (fd < 0 || ::inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1 ||
+        ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        if (fd >= 0) ::close(fd);
+        return -1;
+    }
+    int noDelay = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    return fd;
+}
+
+bool sendAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = ::send(fd, data, length, MSG_NOSIGNAL);
+        if (sent <= 0) return false;
+        data += sent;
+        length -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+// Songs in a response line, -1 if it is an error
+long resultCount(const std::string& line) {
+    // Strings inside the response are escaped, so the last bare key is the real one
+    size_t at = line.rfind("\"count\": ");
+    if (line.compare(0, 10, "{\"error\": ") == 0 || at == std::string::npos) return -1;
+    return std::strtol(line.c_str() + at + 9, nullptr, 10);
+}
+
+// Reads response lines until the server closes, matching them to requests in order
+void readResponses(Connection& connection, std::vector<Outcome>& outcomes) {
+    std::string input;
+    char buffer[1 << 16];
+    ssize_t received;
+    while ((received = ::recv(connection.fd, buffer, sizeof(buffer), 0)) > 0) {
+        Clock::time_point now = Clock::now();
+        input.append(buffer, static_cast<size_t>(received));
+        size_t consumed = 0;
+        size_t newline;
+        while ((newline = input.find('\n', consumed)) != std::string::npos) {
+            Pending request(0, now);
+            {
+                std::lock_guard<std::mutex> lock(connection.mutex);
+                if (connection.pending.empty()) return;
+                request = connection.pending.front();
+                connection.pending.pop_front();
+            }
+            Outcome& outcome = outcomes[request.record];
+            outcome.latencyNanos = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(now - request.sent).count());
+            outcome.results = resultCount(input.substr(consumed, newline - consumed));
+            outcome.answered = true;
+            consumed = newline + 1;
+        }
+        input.erase(0, consumed);
+    }
+}
+
+uint64_t percentile(std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = static_cast<size_t>(p / 100.0 * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+void printLatencies(const char* label, std::vector<uint64_t> nanos) {
+    std::sort(nanos.begin(), nanos.end());
+    std::printf("%-10s p50 %9.1f us  p90 %9.1f us  p99 %9.1f us  max %9.1f us\n", label,
+                percentile(nanos, 50) / 1e3, percentile(nanos, 90) / 1e3, percentile(nanos, 99) / 1e3,
+                nanos.empty() ? 0.0 : nanos.back() / 1e3);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string logPath;
+    std::string host = "127.0.0.1";
+    int port = -1;
+    double speed = 1.0;
+    size_t connectionCount = 1;
+    bool print = false;
+    std::string catalogPath;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--print") {
+            print = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (option == "--log") logPath = value;
+        else if (option == "--host") host = value;
+        else if (option == "--port") port = std::atoi(value);
+        else if (option == "--speed") speed = std::strtod(value, nullptr);
+        else if (option == "--connections") connectionCount = std::strtoull(value, nullptr, 10);
+        else if (option == "--catalog") catalogPath = value;
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (logPath.empty() || (!print && port < 0) || speed < 0.0 || connectionCount == 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<QueryRecord> records;
+    try {
+        records = readQueryLog(logPath);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
+    }
+    if (records.empty()) {
+        std::fprintf(stderr, "Error: %s holds no requests\n", logPath.c_str());
+        return 1;
+    }
+    uint64_t firstNanos = records.front().timeNanos;
+
+    if (print) {
+        std::printf("%12s  %16s  %10s  %7s  request\n", "offset_ms", "catalog", "latency_us", "results");
+        for (const QueryRecord& record : records) {
+            std::printf("%12.3f  %016llx  %10.1f  %7u  %s\n", (record.timeNanos - firstNanos) / 1e6,
+                        static_cast<unsigned long long>(record.catalogVersion), record.latencyNanos / 1e3,
+                        record.results, record.request.c_str());
+        }
+        return 0;
+    }
+
+    // Result counts only compare against the catalog they were recorded on
+    std::vector<uint64_t> versions;
+    for (const QueryRecord& record : records) versions.push_back(record.catalogVersion);
+    std::sort(versions.begin(), versions.end());
+    versions.erase(std::unique(versions.begin(), versions.end()), versions.end());
+    if (versions.size() > 1) {
+        std::fprintf(stderr, "Warning: log spans %zu catalog versions\n", versions.size());
+    }
+    if (!catalogPath.empty()) {
+        try {
+            EmotionPlaylist catalog(catalogPath);
+            if (std::find(versions.begin(), versions.end(), catalog.getCatalogVersion()) == versions.end()) {
+                std::fprintf(stderr, "Warning: %s is not the catalog the log was recorded against\n",
+                             catalogPath.c_str());
+            }
+        } catch (const std::exception& e) {
+            std::fprintf(stderr, "Error: %s\n", e.what());
+            return 1;
+        }
+    }
+
+    std::vector<Outcome> outcomes(records.size());
+    std::vector<std::unique_ptr<Connection>> connections;
+    for (size_t c = 0; c < connectionCount; ++c) {
+        connections.emplace_back(new Connection());
+        connections.back()->fd = connectTo(host, port);
+        if (connections.back()->fd < 0) {
+            std::fprintf(stderr, "Error: Could not connect to %s:%d\n", host.c_str(), port);
+            return 1;
+        }
+    }
+    for (auto& connection : connections) {
+        Connection* reading = connection.get();
+        reading->reader = std::thread([reading, &outcomes]() { readResponses(*reading, outcomes); });
+    }
+
+    // Requests go out on schedule, round robin over the connections
+    Clock::time_point start = Clock::now();
+    size_t sendErrors = 0;
+    std::string line;
+    for (size_t r = 0; r < records.size(); ++r) {
+        if (speed > 0.0) {
+            auto offset = std::chrono::nanoseconds(
+                static_cast<uint64_t>(static_cast<double>(records[r].timeNanos - firstNanos) / speed));
+            std::this_thread::sleep_until(start + offset);
+        }
+        Connection& connection = *connections[r % connections.size()];
+        line = records[r].request;
+        line += '\n';
+        {
+            std::lock_guard<std::mutex> lock(connection.mutex);
+            connection.pending.emplace_back(r, Clock::now());
+        }
+        if (!sendAll(connection.fd, line.data(), line.size())) sendErrors++;
+    }
+    for (auto& connection : connections) {
+        ::shutdown(connection->fd, SHUT_WR);
+        connection->reader.join();
+        ::close(connection->fd);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<uint64_t> recorded;
+    std::vector<uint64_t> replayed;
+    size_t unanswered = 0;
+    size_t errors = 0;
+    size_t changed = 0;
+    for (size_t r = 0; r < records.size(); ++r) {
+        const Outcome& outcome = outcomes[r];
+        recorded.push_back(records[r].latencyNanos);
+        if (!outcome.answered) {
+            unanswered++;
+            continue;
+        }
+        replayed.push_back(outcome.latencyNanos);
+        if (outcome.results < 0) {
+            errors++;
+        } else if (static_cast<uint64_t>(outcome.results) != records[r].results) {
+            if (changed++ < 10) {
+                std::fprintf(stderr, "Changed: %s returned %ld songs, recorded %u\n", records[r].request.c_str(),
+                             outcome.results, records[r].results);
+            }
+        }
+    }
+
+    std::printf("%zu requests in %.3f s (%.0f/s) over %zu connections at speed %g\n", records.size(), seconds,
+                static_cast<double>(records.size()) / seconds, connections.size(), speed);
+    std::printf("%zu error responses, %zu unanswered, %zu send failures, %zu result counts changed\n", errors,
+                unanswered, sendErrors, changed);
+    // Recorded latency is time in the handler; replayed latency adds the network round trip
+    printLatencies("recorded", recorded);
+    printLatencies("replayed", replayed);
+    return unanswered > 0 || sendErrors > 0 ? 1 : 0;
+}